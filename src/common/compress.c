@@ -0,0 +1,259 @@
+#include "compress.h"
+#include "hash_utils.h"
+#include <stdint.h>
+#include <string.h>
+
+#define HASH_LOG 12
+#define MIN_MATCH 4
+#define LAST_LITERALS 5              // Format rule: a block ends with literals
+#define MATCH_FIND_LIMIT 12          // No match may start in the last 12 bytes
+#define MAX_OFFSET 65535
+
+static uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t hash4(uint32_t v) {
+    return (v * 2654435761u) >> (32 - HASH_LOG);
+}
+
+size_t compress_bound(size_t len) {
+    return len + len / 255 + 16;
+}
+
+// Length continuation bytes after a 15 in the token nibble
+static uint8_t* write_length(uint8_t* op, size_t len) {
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+static uint8_t* write_sequence(uint8_t* op, const uint8_t* oend, const uint8_t* literals,
+                               size_t literal_len, size_t offset, size_t match_len) {
+    // Token, both length tails, literals and offset
+    size_t worst = 1 + literal_len / 255 + 1 + literal_len + 2 + match_len / 255 + 1;
+    if ((size_t)(oend - op) < worst) return NULL;
+
+    uint8_t* token = op++;
+    if (literal_len >= 15) {
+        *token = 15 << 4;
+        op = write_length(op, literal_len - 15);
+    } else {
+        *token = (uint8_t)(literal_len << 4);
+    }
+    memcpy(op, literals, literal_len);
+    op += literal_len;
+
+    if (match_len == 0) return op;   // Final literals-only sequence
+
+    *op++ = (uint8_t)(offset & 0xff);
+    *op++ = (uint8_t)(offset >> 8);
+    size_t ml = match_len - MIN_MATCH;
+    if (ml >= 15) {
+        *token |= 15;
+        op = write_length(op, ml - 15);
+    } else {
+        *token |= (uint8_t)ml;
+    }
+    return op;
+}
+
+size_t compress_block(const void* src, size_t src_len, void* dst, size_t dst_cap) {
+    if (!src || !dst || src_len > COMPRESS_MAX_INPUT) return 0;
+
+    const uint8_t* base = (const uint8_t*)src;
+    const uint8_t* ip = base;
+    const uint8_t* anchor = base;
+    const uint8_t* iend = base + src_len;
+    uint8_t* op = (uint8_t*)dst;
+    const uint8_t* oend = op + dst_cap;
+
+    if (src_len > MATCH_FIND_LIMIT) {
+        const uint8_t* mflimit = iend - MATCH_FIND_LIMIT;
+        const uint8_t* matchlimit = iend - LAST_LITERALS;
+        uint32_t table[1 << HASH_LOG];
+        memset(table, 0, sizeof(table));
+
+        while (ip < mflimit) {
+            uint32_t h = hash4(read32(ip));
+            const uint8_t* candidate = base + table[h];
+            table[h] = (uint32_t)(ip - base);
+
+            if (candidate >= ip || ip - candidate > MAX_OFFSET ||
+                read32(candidate) != read32(ip)) {
+                ip++;
+                continue;
+            }
+
+            // Grow the match backwards into pending literals, then forwards
+            while (ip > anchor && candidate > base && ip[-1] == candidate[-1]) {
+                ip--;
+                candidate--;
+            }
+            size_t match_len = MIN_MATCH;
+            while (ip + match_len < matchlimit && ip[match_len] == candidate[match_len]) {
+                match_len++;
+            }
+
+            op = write_sequence(op, oend, anchor, (size_t)(ip - anchor),
+                                (size_t)(ip - candidate), match_len);
+            if (!op) return 0;
+            ip += match_len;
+            anchor = ip;
+        }
+    }
+
+    op = write_sequence(op, oend, anchor, (size_t)(iend - anchor), 0, 0);
+    if (!op) return 0;
+    return (size_t)(op - (uint8_t*)dst);
+}
+
+long decompress_block(const void* src, size_t src_len, void* dst, size_t dst_len) {
+    if (!src || (!dst && dst_len > 0)) return -1;
+
+    const uint8_t* ip = (const uint8_t*)src;
+    const uint8_t* iend = ip + src_len;
+    uint8_t* op = (uint8_t*)dst;
+    uint8_t* ostart = op;
+    uint8_t* oend = op + dst_len;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+
+        size_t literal_len = token >> 4;
+        if (literal_len == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                literal_len += b;
+            } while (b == 255);
+        }
+        if (literal_len > (size_t)(iend - ip) || literal_len > (size_t)(oend - op)) return -1;
+        memcpy(op, ip, literal_len);
+        ip += literal_len;
+        op += literal_len;
+
+        if (ip == iend) break;       // Last sequence has no match
+
+        if (iend - ip < 2) return -1;
+        size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - ostart)) return -1;
+
+        size_t match_len = token & 15;
+        if (match_len == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                match_len += b;
+            } while (b == 255);
+        }
+        match_len += MIN_MATCH;
+        if (match_len > (size_t)(oend - op)) return -1;
+
+        // Byte at a time: the source may overlap what is being written
+        const uint8_t* match = op - offset;
+        for (size_t i = 0; i < match_len; i++) op[i] = match[i];
+        op += match_len;
+    }
+
+    return op == oend ? (long)dst_len : -1;
+}
+
+CompressCodec compress_negotiate(const char* offered) {
+    if (!offered) return COMPRESS_NONE;
+
+    // First codec we implement, in the peer's order of preference
+    const char* p = offered;
+    while (*p) {
+        size_t len = strcspn(p, ",");
+        if (len == 3 && strncmp(p, "lz4", 3) == 0) return COMPRESS_LZ4;
+        p += len;
+        if (*p == ',') p++;
+    }
+    return COMPRESS_NONE;
+}
+
+const char* compress_codec_name(CompressCodec codec) {
+    return codec == COMPRESS_LZ4 ? "lz4" : "none";
+}
+
+size_t compress_frames_bound(size_t len) {
+    size_t frames = (len + COMPRESS_FRAME_SIZE - 1) / COMPRESS_FRAME_SIZE;
+    return len + frames * sizeof(CompressFrameHeader);
+}
+
+size_t compress_frames(const void* src, size_t src_len, void* dst, size_t dst_cap) {
+    if ((!src && src_len > 0) || !dst || dst_cap < compress_frames_bound(src_len)) return 0;
+
+    const uint8_t* ip = (const uint8_t*)src;
+    uint8_t* op = (uint8_t*)dst;
+    for (size_t pos = 0; pos < src_len; ) {
+        size_t raw_len = src_len - pos < COMPRESS_FRAME_SIZE ? src_len - pos : COMPRESS_FRAME_SIZE;
+        uint8_t* body = op + sizeof(CompressFrameHeader);
+
+        // Anything not strictly smaller goes raw, so stored_len == raw_len
+        // always means a raw frame
+        size_t stored_len = raw_len > 1 ? compress_block(ip + pos, raw_len, body, raw_len - 1) : 0;
+        if (stored_len == 0) {
+            memcpy(body, ip + pos, raw_len);
+            stored_len = raw_len;
+        }
+
+        CompressFrameHeader header;
+        header.raw_len = (uint32_t)raw_len;
+        header.stored_len = (uint32_t)stored_len;
+        header.crc = crc32c(0, body, stored_len);
+        memcpy(op, &header, sizeof(header));
+
+        op = body + stored_len;
+        pos += raw_len;
+    }
+    return (size_t)(op - (uint8_t*)dst);
+}
+
+long decompress_frames(const void* src, size_t src_len, void* dst, size_t dst_len) {
+    if ((!src && src_len > 0) || (!dst && dst_len > 0)) return -1;
+
+    const uint8_t* ip = (const uint8_t*)src;
+    uint8_t* op = (uint8_t*)dst;
+    size_t in = 0, out = 0;
+    while (in < src_len) {
+        CompressFrameHeader header;
+        if (src_len - in < sizeof(header)) return -1;
+        memcpy(&header, ip + in, sizeof(header));
+        in += sizeof(header);
+
+        if (header.raw_len == 0 || header.raw_len > COMPRESS_MAX_INPUT ||
+            header.stored_len > header.raw_len || header.stored_len > src_len - in ||
+            header.raw_len > dst_len - out ||
+            crc32c(0, ip + in, header.stored_len) != header.crc) {
+            return -1;
+        }
+
+        if (header.stored_len == header.raw_len) {
+            memcpy(op + out, ip + in, header.raw_len);
+        } else if (decompress_block(ip + in, header.stored_len, op + out, header.raw_len) < 0) {
+            return -1;
+        }
+        in += header.stored_len;
+        out += header.raw_len;
+    }
+    return out == dst_len ? (long)dst_len : -1;
+}
+
+void compress_stats_add(CompressStats* stats, size_t raw_bytes, size_t wire_bytes,
+                        bool passthrough) {
+    if (!stats) return;
+    __atomic_fetch_add(&stats->payloads, 1, __ATOMIC_RELAXED);
+    if (passthrough) __atomic_fetch_add(&stats->passthrough, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->raw_bytes, (uint64_t)raw_bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->wire_bytes, (uint64_t)wire_bytes, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,71 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// LZ4 block format (greedy single-probe matcher; output is readable by any
+// LZ4 block decoder). Blocks are independent and at most COMPRESS_MAX_INPUT.
+#define COMPRESS_MAX_INPUT (16 * 1024 * 1024)
+
+// Worst-case compressed size of len bytes
+size_t compress_bound(size_t len);
+
+// Compress src into dst. Returns the compressed size, or 0 if the result
+// would not fit in dst_cap (callers then store the block uncompressed).
+size_t compress_block(const void* src, size_t src_len, void* dst, size_t dst_cap);
+
+// Decompress a block that expands to exactly dst_len bytes. Returns
+// dst_len, or -1 on malformed input; never reads or writes out of bounds.
+long decompress_block(const void* src, size_t src_len, void* dst, size_t dst_len);
+
+// Wire compression: a payload is sent as a run of frames, each a
+// CompressFrameHeader followed by stored_len bytes. A frame covers up to
+// COMPRESS_FRAME_SIZE bytes of the payload and is stored raw when
+// compressing doesn't make it smaller (stored_len == raw_len). Cold
+// files use the same block layout, so their blocks go out as they are.
+#define COMPRESS_FRAME_SIZE (64 * 1024)
+#define COMPRESS_MIN_PAYLOAD 4096        // Smaller payloads are sent plain
+
+typedef struct {
+    uint32_t raw_len;
+    uint32_t stored_len;
+    uint32_t crc;                        // CRC32C of the stored bytes
+} CompressFrameHeader;
+
+// Codecs a connection can negotiate; offers of others (zstd) are ignored
+typedef enum {
+    COMPRESS_NONE = 0,
+    COMPRESS_LZ4 = 1
+} CompressCodec;
+
+// Pick a codec from a comma-separated offer ("lz4,zstd")
+CompressCodec compress_negotiate(const char* offered);
+
+// Name for the wire ("lz4", "none")
+const char* compress_codec_name(CompressCodec codec);
+
+// Worst-case framed size of len bytes
+size_t compress_frames_bound(size_t len);
+
+// Frame src into dst (at least compress_frames_bound(src_len) bytes).
+// Returns the framed size.
+size_t compress_frames(const void* src, size_t src_len, void* dst, size_t dst_cap);
+
+// Expand frames that hold exactly dst_len bytes, checking every CRC.
+// Returns dst_len, or -1 on malformed or corrupt input.
+long decompress_frames(const void* src, size_t src_len, void* dst, size_t dst_len);
+
+// Bytes saved by wire compression; updated atomically
+typedef struct {
+    uint64_t payloads;                   // Payloads sent framed
+    uint64_t passthrough;                // ... of which stored compressed at rest
+    uint64_t raw_bytes;                  // Their size uncompressed
+    uint64_t wire_bytes;                 // Their size on the wire
+} CompressStats;
+
+void compress_stats_add(CompressStats* stats, size_t raw_bytes, size_t wire_bytes,
+                        bool passthrough);
+
+#endif // COMPRESS_H
@@ -0,0 +1,35 @@
+#ifndef HASH_UTILS_H
+#define HASH_UTILS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_LEN 32
+#define SHA256_HEX_LEN 65   // 64 hex chars + NUL
+
+// FNV-1a 64-bit (fast non-cryptographic hash for table keys)
+uint64_t fnv1a_64(const void* data, size_t len);
+uint64_t hash_mix64(uint64_t x);
+
+// CRC32C (Castagnoli; integrity checks on stored and transferred data).
+// Pass 0 to start; feed the result back in to continue a running CRC.
+uint32_t crc32c(uint32_t crc, const void* data, size_t len);
+
+// SHA-256 (used for content addressing)
+typedef struct {
+    uint32_t state[8];
+    uint64_t bit_count;
+    uint8_t buffer[64];
+    size_t buffer_len;
+} Sha256Context;
+
+void sha256_init(Sha256Context* ctx);
+void sha256_update(Sha256Context* ctx, const void* data, size_t len);
+void sha256_final(Sha256Context* ctx, uint8_t digest[SHA256_DIGEST_LEN]);
+void sha256(const void* data, size_t len, uint8_t digest[SHA256_DIGEST_LEN]);
+
+// Hex encoding helpers
+void hex_encode(const uint8_t* bytes, size_t len, char* out);
+int hex_decode(const char* hex, uint8_t* out, size_t out_len);
+
+#endif // HASH_UTILS_H
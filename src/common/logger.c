@@ -0,0 +1,618 @@
+#include "logger.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+_Static_assert(sizeof(LogRecord) == 56, "LogRecord is an on-disk format");
+
+// One thread's lines and records, waiting for the flusher. Single
+// producer (the owning thread) and single consumer (whoever holds
+// g_log.mutex); heads and tails only grow, and their difference is what
+// is pending.
+typedef struct LogRing {
+    char* buf;
+    size_t cap;                          // Power of two
+    uint64_t head;                       // Written by the owner
+    uint64_t tail;                       // Written by the consumer
+    uint64_t lines;
+    uint64_t dropped;
+
+    LogRecord* records;                  // LOG_RECORD_RING_SLOTS, allocated on first use
+    uint64_t record_head;
+    uint64_t record_tail;
+    uint64_t records_pushed;
+    uint64_t records_dropped;
+
+    bool orphaned;                       // Owner exited; freed once drained
+    struct LogRing* next;
+} LogRing;
+
+// An output file and the batch being built for it
+typedef struct {
+    char path[512];
+    int fd;
+    off_t size;
+    char* batch;
+    size_t batch_len;
+    size_t batch_cap;
+    bool binary;                         // Every file starts with a LogFileHeader
+} LogFile;
+
+static struct {
+    pthread_mutex_t mutex;               // Ring list, files, consumer side
+    pthread_cond_t cond;                 // Wakes the flusher
+    pthread_t thread;
+    bool running;
+    bool started;
+    bool binary_enabled;
+
+    LoggerConfig config;
+    LogFile text;
+    LogFile binary;
+
+    LogRing* rings;
+    pthread_key_t ring_key;
+
+    LoggerStats stats;                   // Counters of freed rings + file totals
+} g_log = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+    .text = { .fd = -1 },
+    .binary = { .fd = -1, .binary = true },
+};
+
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+static __thread LogRing* t_ring;
+static __thread time_t t_stamp_sec = -1;
+static __thread char t_stamp[32];
+
+/* ===============================================
+ * NAMES
+ * =============================================== */
+
+static const char* const op_names[LOG_OP_COUNT] = {
+    [LOG_OP_OTHER] = "OTHER",
+    [LOG_OP_READ] = "READ",
+    [LOG_OP_WRITE] = "WRITE",
+    [LOG_OP_WRITE_BEGIN] = "WRITE_BEGIN",
+    [LOG_OP_CREATE] = "CREATE",
+    [LOG_OP_DELETE] = "DELETE",
+    [LOG_OP_INFO] = "INFO",
+    [LOG_OP_STREAM] = "STREAM",
+    [LOG_OP_COPY] = "COPY",
+    [LOG_OP_CHECKPOINT] = "CHECKPOINT",
+    [LOG_OP_VIEWCHECKPOINT] = "VIEWCHECKPOINT",
+    [LOG_OP_REVERT] = "REVERT",
+    [LOG_OP_LISTCHECKPOINTS] = "LISTCHECKPOINTS",
+};
+
+LogOp log_op_from_name(const char* name) {
+    if (!name) return LOG_OP_OTHER;
+    if (strcmp(name, "ETIRW") == 0) return LOG_OP_WRITE;
+    for (int op = 1; op < LOG_OP_COUNT; op++) {
+        if (strcmp(name, op_names[op]) == 0) return (LogOp)op;
+    }
+    return LOG_OP_OTHER;
+}
+
+const char* log_op_name(LogOp op) {
+    return op >= 0 && op < LOG_OP_COUNT ? op_names[op] : "OTHER";
+}
+
+const char* log_component_name(LogComponent component) {
+    switch (component) {
+        case LOG_COMP_NM: return "NM";
+        case LOG_COMP_SS: return "SS";
+        case LOG_COMP_CLIENT: return "CLIENT";
+        default: return "-";
+    }
+}
+
+/* ===============================================
+ * FORMATTING
+ * =============================================== */
+
+// Formatted once per second per thread instead of per line
+static const char* cached_timestamp(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME_COARSE, &now);
+    if (now.tv_sec != t_stamp_sec) {
+        struct tm tm_info;
+        localtime_r(&now.tv_sec, &tm_info);
+        strftime(t_stamp, sizeof(t_stamp), "%Y-%m-%d %H:%M:%S", &tm_info);
+        t_stamp_sec = now.tv_sec;
+    }
+    return t_stamp;
+}
+
+static size_t format_line(char* line, const char* component, const char* ip, int port,
+                          const char* username, const char* operation,
+                          const char* details, const char* result) {
+    int len = snprintf(line, LOG_LINE_MAX, "[%s] [%s] [%s:%d] [%s] %s %s - %s\n",
+                       cached_timestamp(), component ? component : "-", ip ? ip : "-",
+                       port, username ? username : "-", operation ? operation : "-",
+                       details ? details : "-", result ? result : "-");
+    if (len < 0) return 0;
+    if (len >= LOG_LINE_MAX) {
+        // Truncated: keep the line terminated
+        len = LOG_LINE_MAX - 1;
+        line[len - 1] = '\n';
+    }
+    return (size_t)len;
+}
+
+static void write_fully(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+}
+
+/* ===============================================
+ * RINGS (PRODUCER SIDE)
+ * =============================================== */
+
+static void orphan_ring(void* arg) {
+    LogRing* ring = (LogRing*)arg;
+    __atomic_store_n(&ring->orphaned, true, __ATOMIC_RELEASE);
+}
+
+static void create_ring_key(void) {
+    pthread_key_create(&g_log.ring_key, orphan_ring);
+}
+
+// First line from this thread: give it a ring the flusher can see
+static LogRing* attach_ring(void) {
+    LogRing* ring = calloc(1, sizeof(LogRing));
+    if (!ring) return NULL;
+
+    pthread_mutex_lock(&g_log.mutex);
+    size_t cap = 4096;
+    while (cap < g_log.config.ring_bytes) cap *= 2;
+    ring->buf = malloc(cap);
+    if (!ring->buf) {
+        pthread_mutex_unlock(&g_log.mutex);
+        free(ring);
+        return NULL;
+    }
+    ring->cap = cap;
+    ring->next = g_log.rings;
+    g_log.rings = ring;
+    pthread_mutex_unlock(&g_log.mutex);
+
+    pthread_setspecific(g_log.ring_key, ring);
+    t_ring = ring;
+    return ring;
+}
+
+static LogRing* current_ring(void) {
+    if (!__atomic_load_n(&g_log.running, __ATOMIC_ACQUIRE)) return NULL;
+    return t_ring ? t_ring : attach_ring();
+}
+
+static void wake_flusher(void) {
+    pthread_cond_signal(&g_log.cond);
+}
+
+// Waits for the flusher under LOG_FULL_BLOCK; false means drop
+static bool wait_for_room(void) {
+    if (g_log.config.full_policy == LOG_FULL_DROP ||
+        !__atomic_load_n(&g_log.running, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    wake_flusher();
+    struct timespec pause = { 0, 100 * 1000 };
+    nanosleep(&pause, NULL);
+    return true;
+}
+
+static bool ring_push(LogRing* ring, const char* line, size_t len) {
+    uint64_t head = ring->head;
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    while (ring->cap - (size_t)(head - tail) < len) {
+        if (!wait_for_room()) {
+            __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+            return false;
+        }
+        tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    }
+
+    size_t pos = (size_t)head & (ring->cap - 1);
+    size_t first = ring->cap - pos < len ? ring->cap - pos : len;
+    memcpy(ring->buf + pos, line, first);
+    memcpy(ring->buf, line + first, len - first);
+    __atomic_store_n(&ring->head, head + len, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&ring->lines, 1, __ATOMIC_RELAXED);
+
+    // Don't wait out the interval once the ring is half full
+    if ((size_t)(head + len - tail) > ring->cap / 2) wake_flusher();
+    return true;
+}
+
+void log_message(const char* component, const char* ip, int port,
+                 const char* username, const char* operation,
+                 const char* details, const char* result) {
+    bool running = __atomic_load_n(&g_log.running, __ATOMIC_ACQUIRE);
+    if (running && !g_log.config.text && !g_log.config.echo) return;
+
+    char line[LOG_LINE_MAX];
+    size_t len = format_line(line, component, ip, port, username, operation, details, result);
+    if (len == 0) return;
+
+    LogRing* ring = running ? current_ring() : NULL;
+    if (!ring) {
+        // No flusher: straight to the terminal, as before the logger started
+        write_fully(STDOUT_FILENO, line, len);
+        return;
+    }
+    ring_push(ring, line, len);
+}
+
+bool logger_binary_enabled(void) {
+    return __atomic_load_n(&g_log.running, __ATOMIC_ACQUIRE) &&
+           __atomic_load_n(&g_log.binary_enabled, __ATOMIC_RELAXED);
+}
+
+void log_request(const LogRecord* record) {
+    if (!record || !logger_binary_enabled()) return;
+    LogRing* ring = current_ring();
+    if (!ring) return;
+
+    if (!ring->records) {
+        LogRecord* records = malloc(LOG_RECORD_RING_SLOTS * sizeof(LogRecord));
+        if (!records) return;
+        __atomic_store_n(&ring->records, records, __ATOMIC_RELEASE);
+    }
+
+    uint64_t head = ring->record_head;
+    uint64_t tail = __atomic_load_n(&ring->record_tail, __ATOMIC_ACQUIRE);
+    while (head - tail >= LOG_RECORD_RING_SLOTS) {
+        if (!wait_for_room()) {
+            __atomic_fetch_add(&ring->records_dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        tail = __atomic_load_n(&ring->record_tail, __ATOMIC_ACQUIRE);
+    }
+
+    LogRecord* slot = &ring->records[head & (LOG_RECORD_RING_SLOTS - 1)];
+    *slot = *record;
+    if (slot->timestamp_ns == 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        slot->timestamp_ns = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+    }
+    __atomic_store_n(&ring->record_head, head + 1, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&ring->records_pushed, 1, __ATOMIC_RELAXED);
+
+    if (head + 1 - tail > LOG_RECORD_RING_SLOTS / 2) wake_flusher();
+}
+
+/* ===============================================
+ * FILES (CONSUMER SIDE)
+ * =============================================== */
+
+FILE* log_open_binary(const char* path) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return NULL;
+
+    LogFileHeader header;
+    if (fread(&header, sizeof(header), 1, fp) != 1 ||
+        memcmp(header.magic, LOG_BINARY_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != LOG_BINARY_VERSION || header.record_size != sizeof(LogRecord)) {
+        fclose(fp);
+        return NULL;
+    }
+    return fp;
+}
+
+// Caller holds g_log.mutex
+static int open_log_file(LogFile* file, int extra_flags) {
+    file->fd = open(file->path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC | extra_flags, 0644);
+    if (file->fd < 0) return -1;
+
+    struct stat st;
+    file->size = fstat(file->fd, &st) == 0 ? st.st_size : 0;
+    if (file->binary && file->size == 0) {
+        LogFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, LOG_BINARY_MAGIC, sizeof(header.magic));
+        header.version = LOG_BINARY_VERSION;
+        header.record_size = sizeof(LogRecord);
+        write_fully(file->fd, (const char*)&header, sizeof(header));
+        file->size = sizeof(header);
+    }
+    return 0;
+}
+
+// Caller holds g_log.mutex. Renames path.N-1 -> path.N ... path -> path.1
+// and starts a new file.
+static void rotate_file(LogFile* file) {
+    close(file->fd);
+
+    char from[sizeof(file->path) + 16];
+    char to[sizeof(file->path) + 16];
+    for (int i = g_log.config.max_files - 1; i >= 1; i--) {
+        snprintf(from, sizeof(from), "%s.%d", file->path, i);
+        snprintf(to, sizeof(to), "%s.%d", file->path, i + 1);
+        rename(from, to);
+    }
+
+    int flags = 0;
+    if (g_log.config.max_files > 0) {
+        snprintf(to, sizeof(to), "%s.1", file->path);
+        rename(file->path, to);
+    } else {
+        flags = O_TRUNC;
+    }
+    file->size = 0;
+    open_log_file(file, flags);
+    g_log.stats.rotations++;
+}
+
+// Caller holds g_log.mutex
+static void write_batch(LogFile* file, bool echo) {
+    if (file->batch_len == 0) return;
+
+    if (file->fd >= 0) {
+        off_t header = file->binary ? (off_t)sizeof(LogFileHeader) : 0;
+        if (g_log.config.max_file_bytes > 0 && file->size > header &&
+            file->size + (off_t)file->batch_len > g_log.config.max_file_bytes) {
+            rotate_file(file);
+        }
+        if (file->fd >= 0) {
+            write_fully(file->fd, file->batch, file->batch_len);
+            file->size += (off_t)file->batch_len;
+            g_log.stats.writes++;
+            g_log.stats.bytes_written += file->batch_len;
+        }
+    }
+    if (echo) {
+        write_fully(STDOUT_FILENO, file->batch, file->batch_len);
+    }
+    file->batch_len = 0;
+}
+
+// Caller holds g_log.mutex
+static void drain_lines(LogRing* ring) {
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t tail = ring->tail;
+    LogFile* file = &g_log.text;
+
+    while (tail < head) {
+        size_t pos = (size_t)tail & (ring->cap - 1);
+        size_t n = (size_t)(head - tail);
+        if (n > ring->cap - pos) n = ring->cap - pos;
+        if (n > file->batch_cap - file->batch_len) n = file->batch_cap - file->batch_len;
+        memcpy(file->batch + file->batch_len, ring->buf + pos, n);
+        file->batch_len += n;
+        tail += n;
+        if (file->batch_len == file->batch_cap) write_batch(file, g_log.config.echo);
+    }
+    __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+}
+
+// Caller holds g_log.mutex. Records are copied whole, so a rotation never
+// splits one across files.
+static void drain_records(LogRing* ring) {
+    LogRecord* records = __atomic_load_n(&ring->records, __ATOMIC_ACQUIRE);
+    if (!records) return;
+
+    uint64_t head = __atomic_load_n(&ring->record_head, __ATOMIC_ACQUIRE);
+    uint64_t tail = ring->record_tail;
+    LogFile* file = &g_log.binary;
+
+    for (; tail < head; tail++) {
+        if (file->batch && file->batch_cap - file->batch_len < sizeof(LogRecord)) {
+            write_batch(file, false);
+        }
+        if (file->batch) {
+            memcpy(file->batch + file->batch_len,
+                   &records[tail & (LOG_RECORD_RING_SLOTS - 1)], sizeof(LogRecord));
+            file->batch_len += sizeof(LogRecord);
+        }
+    }
+    __atomic_store_n(&ring->record_tail, tail, __ATOMIC_RELEASE);
+}
+
+// Caller holds g_log.mutex. Moves every ring's pending output to the files.
+static void drain_rings(void) {
+    LogRing** link = &g_log.rings;
+    while (*link) {
+        LogRing* ring = *link;
+        bool orphaned = __atomic_load_n(&ring->orphaned, __ATOMIC_ACQUIRE);
+        drain_lines(ring);
+        drain_records(ring);
+
+        if (orphaned) {
+            // Its thread is gone, so nothing more will be pushed
+            g_log.stats.lines += ring->lines;
+            g_log.stats.dropped += ring->dropped;
+            g_log.stats.records += ring->records_pushed;
+            g_log.stats.records_dropped += ring->records_dropped;
+            *link = ring->next;
+            free(ring->records);
+            free(ring->buf);
+            free(ring);
+        } else {
+            link = &ring->next;
+        }
+    }
+    write_batch(&g_log.text, g_log.config.echo);
+    write_batch(&g_log.binary, false);
+}
+
+static void* flusher_main(void* arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&g_log.mutex);
+    while (g_log.running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += LOG_FLUSH_INTERVAL_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&g_log.cond, &g_log.mutex, &deadline);
+        drain_rings();
+    }
+    pthread_mutex_unlock(&g_log.mutex);
+    return NULL;
+}
+
+/* ===============================================
+ * LIFECYCLE
+ * =============================================== */
+
+void logger_default_config(LoggerConfig* config) {
+    config->ring_bytes = LOG_RING_DEFAULT_BYTES;
+    config->full_policy = LOG_FULL_DROP;
+    config->max_file_bytes = LOG_DEFAULT_MAX_FILE_BYTES;
+    config->max_files = LOG_DEFAULT_MAX_FILES;
+    config->echo = true;
+    config->text = true;
+    config->binary_path = NULL;
+}
+
+// Caller holds g_log.mutex
+static void close_log_file(LogFile* file) {
+    if (file->fd >= 0) close(file->fd);
+    file->fd = -1;
+    free(file->batch);
+    file->batch = NULL;
+    file->batch_len = 0;
+}
+
+// Caller holds g_log.mutex
+static int start_log_file(LogFile* file, const char* path) {
+    snprintf(file->path, sizeof(file->path), "%s", path);
+    file->batch_cap = LOG_WRITE_BATCH;
+    if (file->binary) file->batch_cap -= LOG_WRITE_BATCH % sizeof(LogRecord);
+    file->batch = malloc(file->batch_cap);
+    file->batch_len = 0;
+    if (!file->batch || open_log_file(file, 0) < 0) {
+        fprintf(stderr, "Failed to open log file %s: %s\n", path, strerror(errno));
+        close_log_file(file);
+        return -1;
+    }
+
+    // Never append records to a file of another format; rotate it aside
+    if (file->binary) {
+        FILE* existing = log_open_binary(path);
+        if (existing) {
+            fclose(existing);
+        } else {
+            rotate_file(file);
+            if (file->fd < 0) {
+                close_log_file(file);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int init_logger_config(const char* log_file_path, const LoggerConfig* config) {
+    if (!log_file_path || !config) return -1;
+    if (g_log.started) close_logger();
+    pthread_once(&ring_key_once, create_ring_key);
+
+    pthread_mutex_lock(&g_log.mutex);
+    g_log.config = *config;
+    g_log.config.binary_path = NULL;
+    if (g_log.config.ring_bytes == 0) g_log.config.ring_bytes = LOG_RING_DEFAULT_BYTES;
+    if (g_log.config.max_files < 0) g_log.config.max_files = 0;
+
+    // The text batch also carries terminal echo when the file is off
+    int result = 0;
+    if (config->text) {
+        result = start_log_file(&g_log.text, log_file_path);
+    } else {
+        g_log.text.batch_cap = LOG_WRITE_BATCH;
+        g_log.text.batch = malloc(LOG_WRITE_BATCH);
+        if (!g_log.text.batch) result = -1;
+    }
+    bool binary = false;
+    if (result == 0 && config->binary_path) {
+        result = start_log_file(&g_log.binary, config->binary_path);
+        binary = result == 0;
+    }
+    __atomic_store_n(&g_log.binary_enabled, binary, __ATOMIC_RELAXED);
+    if (result < 0) {
+        close_log_file(&g_log.text);
+        close_log_file(&g_log.binary);
+        pthread_mutex_unlock(&g_log.mutex);
+        return -1;
+    }
+    __atomic_store_n(&g_log.running, true, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&g_log.mutex);
+
+    if (pthread_create(&g_log.thread, NULL, flusher_main, NULL) != 0) {
+        pthread_mutex_lock(&g_log.mutex);
+        __atomic_store_n(&g_log.running, false, __ATOMIC_RELEASE);
+        close_log_file(&g_log.text);
+        close_log_file(&g_log.binary);
+        pthread_mutex_unlock(&g_log.mutex);
+        return -1;
+    }
+    g_log.started = true;
+    return 0;
+}
+
+void init_logger(const char* log_file_path) {
+    LoggerConfig config;
+    logger_default_config(&config);
+    init_logger_config(log_file_path, &config);
+}
+
+void close_logger() {
+    if (!g_log.started) return;
+
+    pthread_mutex_lock(&g_log.mutex);
+    __atomic_store_n(&g_log.running, false, __ATOMIC_RELEASE);
+    pthread_cond_signal(&g_log.cond);
+    pthread_mutex_unlock(&g_log.mutex);
+    pthread_join(g_log.thread, NULL);
+    g_log.started = false;
+
+    // Rings of live threads stay attached (their owners still point at
+    // them) and are drained again if the logger is restarted
+    pthread_mutex_lock(&g_log.mutex);
+    drain_rings();
+    close_log_file(&g_log.text);
+    close_log_file(&g_log.binary);
+    __atomic_store_n(&g_log.binary_enabled, false, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&g_log.mutex);
+}
+
+void logger_flush(void) {
+    pthread_mutex_lock(&g_log.mutex);
+    if (g_log.text.batch) drain_rings();
+    pthread_mutex_unlock(&g_log.mutex);
+}
+
+void logger_get_stats(LoggerStats* stats) {
+    if (!stats) return;
+
+    pthread_mutex_lock(&g_log.mutex);
+    *stats = g_log.stats;
+    for (LogRing* ring = g_log.rings; ring; ring = ring->next) {
+        stats->lines += __atomic_load_n(&ring->lines, __ATOMIC_RELAXED);
+        stats->dropped += __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+        stats->records += __atomic_load_n(&ring->records_pushed, __ATOMIC_RELAXED);
+        stats->records_dropped += __atomic_load_n(&ring->records_dropped, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&g_log.mutex);
+}
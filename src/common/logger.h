@@ -0,0 +1,140 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// Asynchronous logger. log_message formats the line in the calling thread
+// and appends it to that thread's ring buffer without taking a lock; a
+// background flusher drains every ring into large write()s to the log
+// file (and the terminal). Lines from one thread stay in order; lines
+// from different threads are interleaved per flush.
+#define LOG_LINE_MAX 1024
+#define LOG_RING_DEFAULT_BYTES (64 * 1024)          // Per logging thread
+#define LOG_FLUSH_INTERVAL_MS 100
+#define LOG_WRITE_BATCH (256 * 1024)
+#define LOG_DEFAULT_MAX_FILE_BYTES (64 * 1024 * 1024)
+#define LOG_DEFAULT_MAX_FILES 5
+
+// Binary request log: a LogFileHeader, then fixed-size LogRecords. IDs
+// are fnv1a_64 of the name (file IDs match the storage server's), so
+// tools filter by hashing the name they are given.
+#define LOG_BINARY_MAGIC "SSLOGB\r\n"               // 8 bytes
+#define LOG_BINARY_VERSION 2                        // 2: trace ID and stage times
+#define LOG_RECORD_RING_SLOTS 1024                  // Per logging thread
+
+typedef enum {
+    LOG_COMP_UNKNOWN = 0,
+    LOG_COMP_NM = 1,
+    LOG_COMP_SS = 2,
+    LOG_COMP_CLIENT = 3
+} LogComponent;
+
+typedef enum {
+    LOG_OP_OTHER = 0,
+    LOG_OP_READ,
+    LOG_OP_WRITE,                        // One-shot WRITE or a session's ETIRW
+    LOG_OP_WRITE_BEGIN,
+    LOG_OP_CREATE,
+    LOG_OP_DELETE,
+    LOG_OP_INFO,
+    LOG_OP_STREAM,
+    LOG_OP_COPY,
+    LOG_OP_CHECKPOINT,
+    LOG_OP_VIEWCHECKPOINT,
+    LOG_OP_REVERT,
+    LOG_OP_LISTCHECKPOINTS,
+    LOG_OP_COUNT
+} LogOp;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+} LogFileHeader;
+
+typedef struct {
+    uint64_t timestamp_ns;               // Wall clock when the request finished
+    uint64_t user_id;                    // 0 if unknown
+    uint64_t file_id;                    // 0 if none
+    uint64_t trace_id;                   // Shared by every hop of one request; 0 if untraced
+    uint32_t latency_us;
+    uint32_t bytes;                      // Document bytes read or written
+    uint32_t lock_wait_us;               // Stages within latency_us
+    uint32_t disk_us;
+    uint16_t status;                     // ERR_* code, 0 on success
+    uint8_t component;                   // LogComponent
+    uint8_t op;                          // LogOp
+    uint32_t reserved;
+} LogRecord;
+
+// Names as used in the protocol ("READ", "ETIRW" maps to LOG_OP_WRITE)
+LogOp log_op_from_name(const char* name);
+const char* log_op_name(LogOp op);
+const char* log_component_name(LogComponent component);
+
+// What a thread does when its ring is full
+typedef enum {
+    LOG_FULL_DROP = 0,                   // Discard the line (counted)
+    LOG_FULL_BLOCK = 1                   // Wait for the flusher to make room
+} LogFullPolicy;
+
+typedef struct {
+    size_t ring_bytes;                   // Per-thread ring (power of two; 0 = default)
+    LogFullPolicy full_policy;
+    off_t max_file_bytes;                // Rotate before exceeding (0 = never)
+    int max_files;                       // Rotated files kept: path.1 .. path.N
+    bool echo;                           // Also write lines to stdout
+    bool text;                           // Write text lines to the log file
+    const char* binary_path;             // Binary request log, NULL for none
+} LoggerConfig;
+
+typedef struct {
+    uint64_t lines;                      // Accepted into a ring
+    uint64_t dropped;                    // Discarded by LOG_FULL_DROP
+    uint64_t writes;                     // write() batches to the log file
+    uint64_t bytes_written;
+    uint64_t rotations;
+    uint64_t records;                    // Binary records accepted
+    uint64_t records_dropped;
+} LoggerStats;
+
+// Defaults: LOG_RING_DEFAULT_BYTES rings, drop when full, rotate at
+// LOG_DEFAULT_MAX_FILE_BYTES keeping LOG_DEFAULT_MAX_FILES, echo and
+// text on, no binary log
+void logger_default_config(LoggerConfig* config);
+
+// Open the log files and start the flusher. Returns 0 on success, -1 if
+// a file can't be opened (lines then go to stdout synchronously).
+int init_logger_config(const char* log_file_path, const LoggerConfig* config);
+void init_logger(const char* log_file_path);
+
+// Flush what every thread has logged so far, stop the flusher and close
+// the file
+void close_logger();
+
+// Format: [2025-11-09 07:17:10] [NM] [192.168.1.100:5001] [user1] READ test.txt - SUCCESS
+void log_message(const char* component, const char* ip, int port,
+                 const char* username, const char* operation,
+                 const char* details, const char* result);
+
+// Append a record to the binary log (no-op without one). A zero
+// timestamp is filled in with the current time.
+void log_request(const LogRecord* record);
+
+// Whether records are being kept, so callers can skip building them
+bool logger_binary_enabled(void);
+
+// Open a binary request log for reading, positioned at the first record.
+// Returns NULL if the file can't be read or isn't a log of this version.
+FILE* log_open_binary(const char* path);
+
+// Write out everything logged so far before returning
+void logger_flush(void);
+
+void logger_get_stats(LoggerStats* stats);
+
+#endif // LOGGER_H
@@ -0,0 +1,414 @@
+#include "metrics.h"
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+typedef struct {
+    uint64_t count;
+    uint64_t errors;
+    uint64_t sum_us;
+    uint64_t max_us;
+    uint64_t buckets[METRICS_BUCKETS];
+} MetricCounters;
+
+// Written only by the thread that owns it; a shard left by an exited
+// thread keeps its counts and is handed to the next new thread
+typedef struct MetricShard {
+    MetricCounters metrics[METRIC_COUNT];
+    bool in_use;                         // Guarded by g_metrics.mutex
+    struct MetricShard* next;
+} MetricShard;
+
+static struct {
+    pthread_mutex_t mutex;               // Shard list and ownership
+    MetricShard* shards;
+    pthread_key_t shard_key;
+
+    // HTTP exposition
+    pthread_t server_thread;
+    int server_fd;
+    bool serving;
+    char prefix[32];
+    MetricsExtraFn extra_fn;             // Guarded by mutex
+    void* extra_arg;
+} g_metrics = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .server_fd = -1,
+};
+
+static pthread_once_t shard_key_once = PTHREAD_ONCE_INIT;
+static __thread MetricShard* t_shard;
+
+/* ===============================================
+ * NAMES
+ * =============================================== */
+
+static const char* const metric_names[METRIC_COUNT] = {
+    [METRIC_READ] = "READ",
+    [METRIC_WRITE] = "WRITE",
+    [METRIC_CREATE] = "CREATE",
+    [METRIC_DELETE] = "DELETE",
+    [METRIC_STREAM] = "STREAM",
+    [METRIC_EXEC] = "EXEC",
+    [METRIC_INFO] = "INFO",
+    [METRIC_COPY] = "COPY",
+    [METRIC_CHECKPOINT] = "CHECKPOINT",
+    [METRIC_OTHER] = "OTHER",
+    [METRIC_LOCK_WAIT] = "LOCK_WAIT",
+    [METRIC_DISK_READ] = "DISK_READ",
+    [METRIC_DISK_WRITE] = "DISK_WRITE",
+};
+
+MetricId metric_from_command(const char* command) {
+    if (!command) return METRIC_OTHER;
+    if (strcmp(command, "ETIRW") == 0) return METRIC_WRITE;
+    if (strcmp(command, "VIEWCHECKPOINT") == 0 || strcmp(command, "REVERT") == 0 ||
+        strcmp(command, "LISTCHECKPOINTS") == 0) {
+        return METRIC_CHECKPOINT;
+    }
+    for (int id = 0; id < METRIC_OTHER; id++) {
+        if (strcmp(command, metric_names[id]) == 0) return (MetricId)id;
+    }
+    return METRIC_OTHER;
+}
+
+const char* metric_name(MetricId id) {
+    return id >= 0 && id < METRIC_COUNT ? metric_names[id] : "OTHER";
+}
+
+uint64_t metrics_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+/* ===============================================
+ * HISTOGRAM BUCKETS
+ * =============================================== */
+
+static int bucket_index(uint64_t value) {
+    if (value > UINT32_MAX) value = UINT32_MAX;
+    if (value < 2 * METRICS_SUB_BUCKETS) return (int)value;
+
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - METRICS_SUB_BUCKET_BITS;
+    return (msb - METRICS_SUB_BUCKET_BITS + 1) * METRICS_SUB_BUCKETS +
+           (int)(value >> shift) - METRICS_SUB_BUCKETS;
+}
+
+// Largest value that lands in the bucket
+static uint64_t bucket_upper(int index) {
+    if (index < 2 * METRICS_SUB_BUCKETS) return (uint64_t)index;
+
+    int shift = index / METRICS_SUB_BUCKETS - 1;
+    uint64_t sub = (uint64_t)(index % METRICS_SUB_BUCKETS + METRICS_SUB_BUCKETS);
+    return ((sub + 1) << shift) - 1;
+}
+
+/* ===============================================
+ * SHARDS
+ * =============================================== */
+
+static void release_shard(void* arg) {
+    MetricShard* shard = (MetricShard*)arg;
+    pthread_mutex_lock(&g_metrics.mutex);
+    shard->in_use = false;
+    pthread_mutex_unlock(&g_metrics.mutex);
+}
+
+static void create_shard_key(void) {
+    pthread_key_create(&g_metrics.shard_key, release_shard);
+}
+
+// First record from this thread: reuse a shard from an exited thread or
+// add a new one
+static MetricShard* attach_shard(void) {
+    pthread_once(&shard_key_once, create_shard_key);
+
+    pthread_mutex_lock(&g_metrics.mutex);
+    MetricShard* shard = g_metrics.shards;
+    while (shard && shard->in_use) shard = shard->next;
+    if (!shard) {
+        shard = calloc(1, sizeof(MetricShard));
+        if (!shard) {
+            pthread_mutex_unlock(&g_metrics.mutex);
+            return NULL;
+        }
+        shard->next = g_metrics.shards;
+        g_metrics.shards = shard;
+    }
+    shard->in_use = true;
+    pthread_mutex_unlock(&g_metrics.mutex);
+
+    pthread_setspecific(g_metrics.shard_key, shard);
+    t_shard = shard;
+    return shard;
+}
+
+// Single writer: a plain load and store, atomic only so readers never
+// see a torn value
+static inline void bump(uint64_t* counter, uint64_t n) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+void metrics_record(MetricId id, uint64_t latency_us, bool error) {
+    if (id < 0 || id >= METRIC_COUNT) return;
+    MetricShard* shard = t_shard ? t_shard : attach_shard();
+    if (!shard) return;
+
+    MetricCounters* m = &shard->metrics[id];
+    bump(&m->count, 1);
+    if (error) bump(&m->errors, 1);
+    bump(&m->sum_us, latency_us);
+    bump(&m->buckets[bucket_index(latency_us)], 1);
+    if (latency_us > __atomic_load_n(&m->max_us, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&m->max_us, latency_us, __ATOMIC_RELAXED);
+    }
+}
+
+/* ===============================================
+ * READING
+ * =============================================== */
+
+static uint64_t percentile(const uint64_t* buckets, uint64_t count, uint64_t max_us,
+                           double fraction) {
+    if (count == 0) return 0;
+    uint64_t rank = (uint64_t)((double)count * fraction + 0.999999);
+    if (rank == 0) rank = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < METRICS_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            uint64_t upper = bucket_upper(i);
+            return upper < max_us ? upper : max_us;
+        }
+    }
+    return max_us;
+}
+
+void metrics_get(MetricId id, MetricSummary* summary) {
+    if (!summary) return;
+    memset(summary, 0, sizeof(MetricSummary));
+    if (id < 0 || id >= METRIC_COUNT) return;
+
+    uint64_t* buckets = calloc(METRICS_BUCKETS, sizeof(uint64_t));
+    if (!buckets) return;
+
+    pthread_mutex_lock(&g_metrics.mutex);
+    for (MetricShard* shard = g_metrics.shards; shard; shard = shard->next) {
+        MetricCounters* m = &shard->metrics[id];
+        summary->count += __atomic_load_n(&m->count, __ATOMIC_RELAXED);
+        summary->errors += __atomic_load_n(&m->errors, __ATOMIC_RELAXED);
+        summary->sum_us += __atomic_load_n(&m->sum_us, __ATOMIC_RELAXED);
+        uint64_t max_us = __atomic_load_n(&m->max_us, __ATOMIC_RELAXED);
+        if (max_us > summary->max_us) summary->max_us = max_us;
+        for (int i = 0; i < METRICS_BUCKETS; i++) {
+            buckets[i] += __atomic_load_n(&m->buckets[i], __ATOMIC_RELAXED);
+        }
+    }
+    pthread_mutex_unlock(&g_metrics.mutex);
+
+    // Counts are read one by one while threads record; rank against the
+    // histogram's own total so percentiles stay consistent
+    uint64_t total = 0;
+    for (int i = 0; i < METRICS_BUCKETS; i++) total += buckets[i];
+    summary->p50_us = percentile(buckets, total, summary->max_us, 0.50);
+    summary->p90_us = percentile(buckets, total, summary->max_us, 0.90);
+    summary->p99_us = percentile(buckets, total, summary->max_us, 0.99);
+    summary->p999_us = percentile(buckets, total, summary->max_us, 0.999);
+    free(buckets);
+}
+
+/* ===============================================
+ * FORMATS
+ * =============================================== */
+
+int metrics_format_stats(char* buf, size_t len) {
+    if (!buf || len == 0) return 0;
+
+    size_t used = 0;
+    buf[0] = '\0';
+    for (int id = 0; id < METRIC_COUNT && used < len; id++) {
+        MetricSummary s;
+        metrics_get((MetricId)id, &s);
+        int n = snprintf(buf + used, len - used,
+                         "%s:count=%llu errors=%llu mean_us=%llu p50_us=%llu p90_us=%llu "
+                         "p99_us=%llu p999_us=%llu max_us=%llu\n",
+                         metric_names[id], (unsigned long long)s.count,
+                         (unsigned long long)s.errors,
+                         (unsigned long long)(s.count ? s.sum_us / s.count : 0),
+                         (unsigned long long)s.p50_us, (unsigned long long)s.p90_us,
+                         (unsigned long long)s.p99_us, (unsigned long long)s.p999_us,
+                         (unsigned long long)s.max_us);
+        if (n < 0) break;
+        used += (size_t)n;
+    }
+    return (int)(used < len ? used : len - 1);
+}
+
+int metrics_format_exposition(const char* prefix, char* buf, size_t len) {
+    if (!buf || len == 0) return 0;
+    if (!prefix) prefix = "docs";
+
+    size_t used = 0;
+#define EMIT(...) do { \
+        int n_ = snprintf(buf + used, used < len ? len - used : 0, __VA_ARGS__); \
+        if (n_ > 0) used += (size_t)n_; \
+    } while (0)
+
+    EMIT("# HELP %s_latency_us Operation latency in microseconds\n", prefix);
+    EMIT("# TYPE %s_latency_us summary\n", prefix);
+    MetricSummary summaries[METRIC_COUNT];
+    char names[METRIC_COUNT][16];
+    for (int id = 0; id < METRIC_COUNT; id++) {
+        metrics_get((MetricId)id, &summaries[id]);
+        size_t i = 0;
+        for (; metric_names[id][i] && i < sizeof(names[id]) - 1; i++) {
+            char c = metric_names[id][i];
+            names[id][i] = (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+        }
+        names[id][i] = '\0';
+
+        MetricSummary* s = &summaries[id];
+        EMIT("%s_latency_us{op=\"%s\",quantile=\"0.5\"} %llu\n", prefix, names[id],
+             (unsigned long long)s->p50_us);
+        EMIT("%s_latency_us{op=\"%s\",quantile=\"0.9\"} %llu\n", prefix, names[id],
+             (unsigned long long)s->p90_us);
+        EMIT("%s_latency_us{op=\"%s\",quantile=\"0.99\"} %llu\n", prefix, names[id],
+             (unsigned long long)s->p99_us);
+        EMIT("%s_latency_us{op=\"%s\",quantile=\"0.999\"} %llu\n", prefix, names[id],
+             (unsigned long long)s->p999_us);
+        EMIT("%s_latency_us_sum{op=\"%s\"} %llu\n", prefix, names[id],
+             (unsigned long long)s->sum_us);
+        EMIT("%s_latency_us_count{op=\"%s\"} %llu\n", prefix, names[id],
+             (unsigned long long)s->count);
+    }
+
+    EMIT("# HELP %s_errors_total Operations that failed\n", prefix);
+    EMIT("# TYPE %s_errors_total counter\n", prefix);
+    for (int id = 0; id < METRIC_COUNT; id++) {
+        EMIT("%s_errors_total{op=\"%s\"} %llu\n", prefix, names[id],
+             (unsigned long long)summaries[id].errors);
+    }
+#undef EMIT
+
+    pthread_mutex_lock(&g_metrics.mutex);
+    MetricsExtraFn extra_fn = g_metrics.extra_fn;
+    void* extra_arg = g_metrics.extra_arg;
+    pthread_mutex_unlock(&g_metrics.mutex);
+    if (extra_fn && used < len) {
+        int n = extra_fn(prefix, buf + used, len - used, extra_arg);
+        if (n > 0) used += (size_t)n;
+    }
+
+    return (int)(used < len ? used : len - 1);
+}
+
+void metrics_set_extra(MetricsExtraFn fn, void* arg) {
+    pthread_mutex_lock(&g_metrics.mutex);
+    g_metrics.extra_fn = fn;
+    g_metrics.extra_arg = arg;
+    pthread_mutex_unlock(&g_metrics.mutex);
+}
+
+/* ===============================================
+ * HTTP EXPOSITION
+ * =============================================== */
+
+static void send_fully(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+}
+
+// Any request gets the exposition; scrapers only ever GET one path
+static void serve_scrape(int fd) {
+    struct timeval tv = { 1, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    char request[1024];
+    if (recv(fd, request, sizeof(request), 0) <= 0) return;
+
+    char* body = malloc(METRICS_TEXT_MAX);
+    if (!body) return;
+    int body_len = metrics_format_exposition(g_metrics.prefix, body, METRICS_TEXT_MAX);
+
+    char header[160];
+    int header_len = snprintf(header, sizeof(header),
+                              "HTTP/1.0 200 OK\r\n"
+                              "Content-Type: text/plain; version=0.0.4\r\n"
+                              "Content-Length: %d\r\n"
+                              "Connection: close\r\n\r\n", body_len);
+    send_fully(fd, header, (size_t)header_len);
+    send_fully(fd, body, (size_t)body_len);
+    free(body);
+}
+
+static void* metrics_server_main(void* arg) {
+    (void)arg;
+    while (__atomic_load_n(&g_metrics.serving, __ATOMIC_ACQUIRE)) {
+        struct pollfd pfd = { .fd = g_metrics.server_fd, .events = POLLIN };
+        if (poll(&pfd, 1, 500) <= 0) continue;
+
+        int fd = accept(g_metrics.server_fd, NULL, NULL);
+        if (fd < 0) continue;
+        serve_scrape(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+int metrics_serve_start(const char* prefix, int port) {
+    if (g_metrics.server_fd >= 0 || port <= 0) return -1;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    // Local scrapers only; nothing here is meant for the network
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((uint16_t)port);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    snprintf(g_metrics.prefix, sizeof(g_metrics.prefix), "%s", prefix ? prefix : "docs");
+    g_metrics.server_fd = fd;
+    __atomic_store_n(&g_metrics.serving, true, __ATOMIC_RELEASE);
+    if (pthread_create(&g_metrics.server_thread, NULL, metrics_server_main, NULL) != 0) {
+        __atomic_store_n(&g_metrics.serving, false, __ATOMIC_RELEASE);
+        close(fd);
+        g_metrics.server_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+void metrics_serve_stop(void) {
+    if (g_metrics.server_fd < 0) return;
+
+    __atomic_store_n(&g_metrics.serving, false, __ATOMIC_RELEASE);
+    pthread_join(g_metrics.server_thread, NULL);
+    close(g_metrics.server_fd);
+    g_metrics.server_fd = -1;
+}
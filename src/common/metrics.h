@@ -0,0 +1,78 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Latency histograms and counters per operation. Each thread records
+// into its own shard without locking; readers sum the shards. Histograms
+// are log-linear (HDR-style): exact below 32us, then 16 buckets per
+// power of two, so any percentile is within ~6% of the true value.
+#define METRICS_SUB_BUCKET_BITS 4
+#define METRICS_SUB_BUCKETS (1 << METRICS_SUB_BUCKET_BITS)
+#define METRICS_BUCKETS ((32 - METRICS_SUB_BUCKET_BITS + 1) * METRICS_SUB_BUCKETS) // Up to 2^32 us
+#define METRICS_TEXT_MAX (16 * 1024)    // Fits every format below
+
+typedef enum {
+    METRIC_READ = 0,
+    METRIC_WRITE,
+    METRIC_CREATE,
+    METRIC_DELETE,
+    METRIC_STREAM,
+    METRIC_EXEC,
+    METRIC_INFO,
+    METRIC_COPY,
+    METRIC_CHECKPOINT,                   // CHECKPOINT, VIEWCHECKPOINT, REVERT, LISTCHECKPOINTS
+    METRIC_OTHER,                        // Any other client command
+    METRIC_LOCK_WAIT,                    // Queued for a sentence lock
+    METRIC_DISK_READ,                    // One I/O batch
+    METRIC_DISK_WRITE,                   // One I/O batch with a write, fsync or rename
+    METRIC_COUNT
+} MetricId;
+
+typedef struct {
+    uint64_t count;
+    uint64_t errors;
+    uint64_t sum_us;
+    uint64_t max_us;
+    uint64_t p50_us;
+    uint64_t p90_us;
+    uint64_t p99_us;
+    uint64_t p999_us;
+} MetricSummary;
+
+// Protocol command to metric ("ETIRW" is WRITE, checkpoint commands
+// share METRIC_CHECKPOINT, unknown names are METRIC_OTHER)
+MetricId metric_from_command(const char* command);
+const char* metric_name(MetricId id);
+
+// Monotonic clock for timing what gets recorded
+uint64_t metrics_now_us(void);
+
+// Record one timed operation in the calling thread's shard
+void metrics_record(MetricId id, uint64_t latency_us, bool error);
+
+// Sum every shard; percentiles are bucket upper bounds capped at the max
+void metrics_get(MetricId id, MetricSummary* summary);
+
+// One line per metric: "READ:count=.. errors=.. mean_us=.. p50_us=.. ..."
+// Returns the length written
+int metrics_format_stats(char* buf, size_t len);
+
+// Prometheus text exposition, metric names prefixed with prefix ("ss")
+int metrics_format_exposition(const char* prefix, char* buf, size_t len);
+
+// Extra exposition lines appended after the latency families, for a
+// component's own gauges and counters. fn is called from the scrape
+// thread and returns the length written; NULL removes it.
+typedef int (*MetricsExtraFn)(const char* prefix, char* buf, size_t len, void* arg);
+void metrics_set_extra(MetricsExtraFn fn, void* arg);
+
+// Serve the exposition over HTTP on 127.0.0.1:port from a background
+// thread, for a local scraper. Returns 0 on success, -1 if the port
+// can't be bound.
+int metrics_serve_start(const char* prefix, int port);
+void metrics_serve_stop(void);
+
+#endif // METRICS_H
@@ -5,6 +5,10 @@
 #include "../common/utils.h"
 #include "../common/error_codes.h"
 #include "../common/logger.h"
+#include "../common/hash_utils.h"
+#include "../common/metrics.h"
+#include "../common/trace.h"
+#include "../common/compress.h"
 
 void test_string_utilities() {
     printf("\n=== Testing String Utilities ===\n");
@@ -124,16 +128,248 @@ void test_logger() {
     
     close_logger();
     
-    // Check log file exists
+    // Check log file exists and the flusher wrote both lines
     assert(file_exists("/tmp/test_utils.log") == true);
     printf("Log file created successfully\n");
+    FILE* fp = fopen("/tmp/test_utils.log", "r");
+    char line[LOG_LINE_MAX];
+    int lines = 0;
+    while (fp && fgets(line, sizeof(line), fp)) lines++;
+    if (fp) fclose(fp);
+    assert(lines == 2);
+    
+    // Test size-based rotation keeps the previous file
+    LoggerConfig config;
+    logger_default_config(&config);
+    config.max_file_bytes = 256;
+    config.max_files = 1;
+    config.echo = false;
+    assert(init_logger_config("/tmp/test_utils.log", &config) == 0);
+    for (int i = 0; i < 20; i++) {
+        log_message("TEST", "127.0.0.1", 5000, "testuser", "READ", "test.txt", "SUCCESS");
+        logger_flush();
+    }
+    LoggerStats stats;
+    logger_get_stats(&stats);
+    close_logger();
+    assert(stats.rotations > 0 && stats.dropped == 0);
+    assert(file_exists("/tmp/test_utils.log.1") == true);
+    printf("Log rotation test: PASSED\n");
+    
+    // Test the binary request log: header, then one fixed-size record each
+    logger_default_config(&config);
+    config.echo = false;
+    config.text = false;
+    config.binary_path = "/tmp/test_utils.bin";
+    unlink("/tmp/test_utils.bin");
+    assert(init_logger_config("/tmp/test_utils.log", &config) == 0);
+    assert(logger_binary_enabled() == true);
+    LogRecord record;
+    memset(&record, 0, sizeof(record));
+    record.component = LOG_COMP_SS;
+    record.op = (uint8_t)log_op_from_name("ETIRW");
+    record.latency_us = 42;
+    log_request(&record);
+    close_logger();
+    
+    fp = fopen("/tmp/test_utils.bin", "rb");
+    assert(fp != NULL);
+    LogFileHeader header;
+    assert(fread(&header, sizeof(header), 1, fp) == 1);
+    assert(memcmp(header.magic, LOG_BINARY_MAGIC, sizeof(header.magic)) == 0);
+    assert(header.record_size == sizeof(LogRecord));
+    assert(fread(&record, sizeof(record), 1, fp) == 1);
+    fclose(fp);
+    assert(record.op == LOG_OP_WRITE && record.latency_us == 42 && record.timestamp_ns != 0);
+    assert(strcmp(log_op_name(LOG_OP_WRITE), "WRITE") == 0);
+    printf("Binary request log test: PASSED\n");
     
     // Cleanup
     unlink("/tmp/test_utils.log");
+    unlink("/tmp/test_utils.log.1");
+    unlink("/tmp/test_utils.bin");
     
     printf("✅ Logger: ALL TESTS PASSED\n");
 }
 
+void test_hash_utilities() {
+    printf("\n=== Testing Hash Utilities ===\n");
+    
+    // Test sha256 against the FIPS 180-2 "abc" vector
+    uint8_t digest[SHA256_DIGEST_LEN];
+    char hex[SHA256_HEX_LEN];
+    sha256("abc", 3, digest);
+    hex_encode(digest, sizeof(digest), hex);
+    printf("sha256(abc) = %s\n", hex);
+    assert(strcmp(hex, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad") == 0);
+    
+    // Test incremental updates match a one-shot hash
+    const char* text = "The quick brown fox jumps over the lazy dog. Then it naps!";
+    uint8_t incremental[SHA256_DIGEST_LEN];
+    Sha256Context ctx;
+    sha256_init(&ctx);
+    for (size_t i = 0; i < strlen(text); i += 7) {
+        size_t n = strlen(text) - i < 7 ? strlen(text) - i : 7;
+        sha256_update(&ctx, text + i, n);
+    }
+    sha256_final(&ctx, incremental);
+    sha256(text, strlen(text), digest);
+    assert(memcmp(digest, incremental, SHA256_DIGEST_LEN) == 0);
+    printf("sha256 incremental test: PASSED\n");
+    
+    // Test hex round trip
+    uint8_t decoded[SHA256_DIGEST_LEN];
+    assert(hex_decode(hex, decoded, sizeof(decoded)) == 0);
+    sha256("abc", 3, digest);
+    assert(memcmp(decoded, digest, SHA256_DIGEST_LEN) == 0);
+    assert(hex_decode("xyz", decoded, sizeof(decoded)) == -1);
+    printf("hex round trip test: PASSED\n");
+    
+    // Test crc32c against the standard check value, one-shot and chained
+    assert(crc32c(0, "123456789", 9) == 0xe3069283);
+    uint32_t crc = crc32c(0, text, 13);
+    crc = crc32c(crc, text + 13, strlen(text) - 13);
+    assert(crc == crc32c(0, text, strlen(text)));
+    assert(crc32c(0, "", 0) == 0);
+    printf("crc32c test: PASSED\n");
+    
+    printf("✅ Hash utilities: ALL TESTS PASSED\n");
+}
+
+void test_compression() {
+    printf("\n=== Testing Compression ===\n");
+    
+    // Payloads: repetitive text and a pseudo-random (incompressible) run
+    size_t max_len = 2 * COMPRESS_FRAME_SIZE + 100;
+    char* text = malloc(max_len);
+    char* noise = malloc(max_len);
+    size_t cap = compress_frames_bound(max_len);
+    char* packed = malloc(cap);
+    char* out = malloc(max_len);
+    assert(text && noise && packed && out);
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < max_len; i++) {
+        text[i] = "The quick brown fox. "[i % 21];
+        seed = seed * 1103515245 + 12345;
+        noise[i] = (char)(seed >> 16);
+    }
+    
+    // Test block round trips, including input that doesn't compress
+    size_t n = compress_block(text, 10000, packed, compress_bound(10000));
+    assert(n > 0 && n < 10000);
+    assert(decompress_block(packed, n, out, 10000) == 10000);
+    assert(memcmp(out, text, 10000) == 0);
+    n = compress_block(noise, 10000, packed, compress_bound(10000));
+    assert(n > 0 && n <= compress_bound(10000));
+    assert(decompress_block(packed, n, out, 10000) == 10000);
+    assert(memcmp(out, noise, 10000) == 0);
+    assert(compress_block(noise, 10000, packed, 100) == 0);
+    printf("Block round trip test: PASSED\n");
+    
+    // Test frame round trips: empty, incompressible (stored raw), exactly
+    // one frame, and one byte over a frame boundary
+    assert(compress_frames(text, 0, packed, cap) == 0);
+    assert(decompress_frames(packed, 0, out, 0) == 0);
+    n = compress_frames(noise, 5000, packed, cap);
+    assert(n == sizeof(CompressFrameHeader) + 5000);
+    assert(decompress_frames(packed, n, out, 5000) == 5000);
+    assert(memcmp(out, noise, 5000) == 0);
+    size_t lens[] = { COMPRESS_FRAME_SIZE, COMPRESS_FRAME_SIZE + 1, max_len };
+    for (size_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+        n = compress_frames(text, lens[i], packed, cap);
+        assert(n > 0 && n < lens[i]);
+        assert(decompress_frames(packed, n, out, lens[i]) == (long)lens[i]);
+        assert(memcmp(out, text, lens[i]) == 0);
+    }
+    printf("Frame round trip test: PASSED\n");
+    
+    // Test corrupt and truncated frames are rejected
+    n = compress_frames(text, COMPRESS_FRAME_SIZE, packed, cap);
+    packed[n / 2] ^= 0x01;
+    assert(decompress_frames(packed, n, out, COMPRESS_FRAME_SIZE) == -1);
+    packed[n / 2] ^= 0x01;
+    CompressFrameHeader header;
+    memcpy(&header, packed, sizeof(header));
+    header.crc ^= 1;
+    memcpy(packed, &header, sizeof(header));
+    assert(decompress_frames(packed, n, out, COMPRESS_FRAME_SIZE) == -1);
+    header.crc ^= 1;
+    memcpy(packed, &header, sizeof(header));
+    assert(decompress_frames(packed, n, out, COMPRESS_FRAME_SIZE) == COMPRESS_FRAME_SIZE);
+    assert(decompress_frames(packed, n - 1, out, COMPRESS_FRAME_SIZE) == -1);
+    assert(decompress_frames(packed, sizeof(header) - 1, out, COMPRESS_FRAME_SIZE) == -1);
+    assert(decompress_frames(packed, n, out, COMPRESS_FRAME_SIZE - 1) == -1);
+    printf("Corrupt frame test: PASSED\n");
+    
+    free(text);
+    free(noise);
+    free(packed);
+    free(out);
+    
+    printf("✅ Compression: ALL TESTS PASSED\n");
+}
+
+void test_metrics() {
+    printf("\n=== Testing Metrics ===\n");
+    
+    // Test percentiles over 1..1000us stay within a bucket of the truth
+    for (uint64_t us = 1; us <= 1000; us++) {
+        metrics_record(METRIC_READ, us, us % 100 == 0);
+    }
+    MetricSummary s;
+    metrics_get(METRIC_READ, &s);
+    printf("READ p50=%llu p99=%llu max=%llu\n", (unsigned long long)s.p50_us,
+           (unsigned long long)s.p99_us, (unsigned long long)s.max_us);
+    assert(s.count == 1000 && s.errors == 10 && s.max_us == 1000);
+    assert(s.p50_us >= 500 && s.p50_us < 500 + 500 / METRICS_SUB_BUCKETS);
+    assert(s.p99_us >= 990 && s.p99_us <= 1000);
+    printf("Histogram percentile test: PASSED\n");
+    
+    // Test command names map onto metrics and show up in STATS text
+    assert(metric_from_command("ETIRW") == METRIC_WRITE);
+    assert(metric_from_command("REVERT") == METRIC_CHECKPOINT);
+    assert(metric_from_command("NOPE") == METRIC_OTHER);
+    char text[METRICS_TEXT_MAX];
+    metrics_format_stats(text, sizeof(text));
+    assert(strstr(text, "READ:count=1000 errors=10") != NULL);
+    metrics_format_exposition("ss", text, sizeof(text));
+    assert(strstr(text, "ss_latency_us_count{op=\"read\"} 1000") != NULL);
+    printf("Stats format test: PASSED\n");
+    
+    printf("✅ Metrics: ALL TESTS PASSED\n");
+}
+
+void test_trace() {
+    printf("\n=== Testing Trace IDs ===\n");
+    
+    // Test a token survives formatting and parsing from request data
+    uint64_t id = trace_new_id();
+    assert(id != 0 && trace_new_id() != id);
+    char token[TRACE_TOKEN_LEN + 1];
+    trace_format(id, token, sizeof(token));
+    assert(strlen(token) == TRACE_TOKEN_LEN);
+    char data[64];
+    snprintf(data, sizeof(data), "Connect to SS at 10.0.0.2:9001 %s", token);
+    uint64_t parsed = 0;
+    assert(trace_parse(data, &parsed) == true && parsed == id);
+    assert(trace_parse("TRACE=xyz", &parsed) == false);
+    printf("Trace token round trip: PASSED\n");
+    
+    // Test stage time is only collected inside a request
+    trace_add_stage(TRACE_STAGE_DISK, 5);
+    trace_begin(id);
+    trace_add_stage(TRACE_STAGE_DISK, 7);
+    trace_add_stage(TRACE_STAGE_LOCK_WAIT, 3);
+    assert(trace_current_id() == id);
+    TraceSpan span;
+    trace_end(&span);
+    assert(span.trace_id == id && span.stage_us[TRACE_STAGE_DISK] == 7);
+    assert(span.stage_us[TRACE_STAGE_LOCK_WAIT] == 3 && trace_current_id() == 0);
+    printf("Trace stage test: PASSED\n");
+    
+    printf("✅ Trace IDs: ALL TESTS PASSED\n");
+}
+
 void test_network_utilities() {
     printf("\n=== Testing Network Utilities ===\n");
     
@@ -156,6 +392,10 @@ int main() {
     test_time_utilities();
     test_error_codes();
     test_logger();
+    test_hash_utilities();
+    test_compression();
+    test_metrics();
+    test_trace();
     test_network_utilities();
     
     printf("\n");
@@ -0,0 +1,78 @@
+#include "trace.h"
+#include "hash_utils.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    bool active;
+    TraceSpan span;
+} TraceContext;
+
+static __thread TraceContext t_trace;
+static __thread uint64_t t_id_state;
+
+uint64_t trace_new_id(void) {
+    // Per-thread counter mixed with a seed from the clock and the thread
+    if (t_id_state == 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        t_id_state = hash_mix64((uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec) ^
+                     hash_mix64((uint64_t)pthread_self());
+    }
+    uint64_t id;
+    do {
+        t_id_state += 0x9e3779b97f4a7c15ULL;
+        id = hash_mix64(t_id_state);
+    } while (id == 0);
+    return id;
+}
+
+bool trace_parse(const char* text, uint64_t* id) {
+    if (!text || !id) return false;
+
+    for (const char* token = strstr(text, TRACE_TOKEN); token;
+         token = strstr(token + 1, TRACE_TOKEN)) {
+        const char* hex = token + strlen(TRACE_TOKEN);
+        uint64_t value = 0;
+        int digits = 0;
+        for (; digits < 16; digits++) {
+            char c = hex[digits];
+            int nibble = (c >= '0' && c <= '9') ? c - '0'
+                       : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+                       : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+            if (nibble < 0) break;
+            value = (value << 4) | (uint64_t)nibble;
+        }
+        if (digits > 0 && value != 0) {
+            *id = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+void trace_format(uint64_t id, char* buf, size_t len) {
+    snprintf(buf, len, TRACE_TOKEN "%016llx", (unsigned long long)id);
+}
+
+void trace_begin(uint64_t trace_id) {
+    memset(&t_trace, 0, sizeof(t_trace));
+    t_trace.active = true;
+    t_trace.span.trace_id = trace_id;
+}
+
+void trace_end(TraceSpan* span) {
+    if (span) *span = t_trace.span;
+    memset(&t_trace, 0, sizeof(t_trace));
+}
+
+uint64_t trace_current_id(void) {
+    return t_trace.active ? t_trace.span.trace_id : 0;
+}
+
+void trace_add_stage(TraceStage stage, uint64_t us) {
+    if (!t_trace.active || stage < 0 || stage >= TRACE_STAGE_COUNT) return;
+    t_trace.span.stage_us[stage] += us;
+}
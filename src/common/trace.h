@@ -0,0 +1,49 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Request tracing. A trace ID is created by the client (or by the NM
+// when the client sent none), returned in NM routing responses and
+// passed on to the SS, so every hop's request log record carries it.
+// On the wire it is the token "TRACE=<16 hex digits>": anywhere in an NM
+// request's data, and as a prefix of an SS request line.
+#define TRACE_TOKEN "TRACE="
+#define TRACE_TOKEN_LEN 22               // "TRACE=" + 16 hex digits
+
+typedef enum {
+    TRACE_STAGE_LOCK_WAIT = 0,
+    TRACE_STAGE_DISK,
+    TRACE_STAGE_COUNT
+} TraceStage;
+
+// What one hop spent in each stage of the request it just finished
+typedef struct {
+    uint64_t trace_id;
+    uint64_t stage_us[TRACE_STAGE_COUNT];
+} TraceSpan;
+
+// A new random, nonzero trace ID
+uint64_t trace_new_id(void);
+
+// Parse the first TRACE= token in text. Returns true and sets *id if
+// one is found.
+bool trace_parse(const char* text, uint64_t* id);
+
+// Write the token for id (TRACE_TOKEN_LEN + 1 bytes with the NUL)
+void trace_format(uint64_t id, char* buf, size_t len);
+
+// The calling thread starts / finishes serving a request. Stage time
+// added in between (by lock waits and disk I/O further down the call
+// stack) is collected for that request; outside a request it is ignored.
+void trace_begin(uint64_t trace_id);
+void trace_end(TraceSpan* span);
+
+// ID of the request the calling thread is serving, 0 if none
+uint64_t trace_current_id(void);
+
+void trace_add_stage(TraceStage stage, uint64_t us);
+
+#endif // TRACE_H
@@ -10,6 +10,8 @@
 #include <ctype.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/sendfile.h>
+#include <poll.h>
 #include <time.h>
 #include <errno.h>
 #include <libgen.h>
@@ -141,6 +143,93 @@ int recv_all(int sockfd, void* data, size_t len) {
     return total_received;
 }
 
+// Copy-based path for descriptors sendfile() can't handle
+static long long send_file_range_copy(int sockfd, int fd, off_t offset, size_t len) {
+    char buffer[65536];
+    size_t total_sent = 0;
+    
+    while (total_sent < len) {
+        size_t want = len - total_sent;
+        if (want > sizeof(buffer)) want = sizeof(buffer);
+        
+        ssize_t n = pread(fd, buffer, want, offset + (off_t)total_sent);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("send_file_range read failed");
+            return -1;
+        }
+        if (n == 0) break;  // File shorter than requested
+        
+        if (send_all(sockfd, buffer, (size_t)n) < 0) return -1;
+        total_sent += (size_t)n;
+    }
+    
+    return (long long)total_sent;
+}
+
+// Waits for a non-blocking socket to drain, bounded by its SO_SNDTIMEO (or
+// SEND_DRAIN_TIMEOUT_MS when none is set). A blocking socket only reports
+// EAGAIN once SO_SNDTIMEO has expired, so that fails right away.
+// Returns 0 when writable, -1 with errno = ETIMEDOUT otherwise.
+#define SEND_DRAIN_TIMEOUT_MS 30000
+
+static int wait_socket_writable(int sockfd) {
+    int flags = fcntl(sockfd, F_GETFL, 0);
+    if (flags >= 0 && !(flags & O_NONBLOCK)) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+    
+    int timeout_ms = SEND_DRAIN_TIMEOUT_MS;
+    struct timeval tv;
+    socklen_t tv_len = sizeof(tv);
+    if (getsockopt(sockfd, SOL_SOCKET, SO_SNDTIMEO, &tv, &tv_len) == 0 &&
+        (tv.tv_sec > 0 || tv.tv_usec > 0)) {
+        timeout_ms = (int)(tv.tv_sec * 1000 + (tv.tv_usec + 999) / 1000);
+    }
+    
+    struct pollfd pfd = { .fd = sockfd, .events = POLLOUT };
+    int ready;
+    do {
+        ready = poll(&pfd, 1, timeout_ms);
+    } while (ready < 0 && errno == EINTR);
+    if (ready <= 0) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+    return 0;
+}
+
+// Send len bytes of a file starting at offset (zero-copy via sendfile).
+// Does not move the file offset. Returns bytes sent (less than len only if
+// the file is shorter), -1 on error or if the peer stops reading.
+long long send_file_range(int sockfd, int fd, off_t offset, size_t len) {
+    size_t total_sent = 0;
+    off_t pos = offset;
+    
+    while (total_sent < len) {
+        ssize_t sent = sendfile(sockfd, fd, &pos, len - total_sent);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // Non-blocking socket: wait (bounded) until it drains
+                if (wait_socket_writable(sockfd) == 0) continue;
+                perror("send_file_range timed out");
+                return -1;
+            }
+            if ((errno == EINVAL || errno == ENOSYS) && total_sent == 0) {
+                return send_file_range_copy(sockfd, fd, offset, len);
+            }
+            perror("send_file_range failed");
+            return -1;
+        }
+        if (sent == 0) break;  // End of file
+        total_sent += (size_t)sent;
+    }
+    
+    return (long long)total_sent;
+}
+
 // ======================== Socket Configuration ========================
 
 int set_socket_timeout(int sockfd, int seconds) {
@@ -420,6 +509,13 @@ long long current_timestamp_ms() {
     return (long long)tv.tv_sec * 1000LL + tv.tv_usec / 1000LL;
 }
 
+// Unaffected by wall-clock adjustments; use for deadlines and durations
+long long monotonic_timestamp_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000LL + ts.tv_nsec / 1000000LL;
+}
+
 void format_timestamp(char* buffer, size_t len) {
     time_t now = time(NULL);
     struct tm* tm_info = localtime(&now);
@@ -4,6 +4,7 @@
 #include <stddef.h>
 #include <stdbool.h>
 #include <sys/socket.h>
+#include <sys/types.h>
 
 // Socket utilities
 int create_server_socket(int port);
@@ -12,6 +13,7 @@ int send_message(int sockfd, const void* data, size_t len);
 int recv_message(int sockfd, void* data, size_t len);
 int send_all(int sockfd, const void* data, size_t len);
 int recv_all(int sockfd, void* data, size_t len);
+long long send_file_range(int sockfd, int fd, off_t offset, size_t len);
 
 // Socket configuration
 int set_socket_timeout(int sockfd, int seconds);
@@ -37,6 +39,7 @@ bool copy_file(const char* src, const char* dst);
 
 // Time utilities
 long long current_timestamp_ms();
+long long monotonic_timestamp_ms();
 void format_timestamp(char* buffer, size_t len);
 
 #endif // UTILS_H
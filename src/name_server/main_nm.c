@@ -8,6 +8,9 @@
 #include "../common/protocol.h"
 #include "../common/error_codes.h"
 #include "../common/logger.h"
+#include "../common/metrics.h"
+#include "../common/trace.h"
+#include "../common/hash_utils.h"
 #include "../common/utils.h"
 
 // Global state for signal handling
@@ -41,19 +44,42 @@ int handle_client_request(NameServerState* state, int client_fd) {
     printf("Request from '%s': cmd=%d, filename='%s'\n", 
            client->username, req.cmd, req.filename);
     
-    // Route based on command
+    // Trace the request under the client's ID (a leading TRACE= token, so
+    // file content in req.data is never mistaken for one), or start one that
+    // the routing response hands back for the SS hop
+    uint64_t trace_id = 0;
+    char token[TRACE_TOKEN_LEN + 1];
+    snprintf(token, sizeof(token), "%.*s", TRACE_TOKEN_LEN, req.data);
+    if (strncmp(token, TRACE_TOKEN, strlen(TRACE_TOKEN)) != 0 ||
+        !trace_parse(token, &trace_id)) {
+        trace_id = trace_new_id();
+    }
+    trace_begin(trace_id);
+    
+    // Route based on command; routing time is recorded per command
+    uint64_t start = metrics_now_us();
+    MetricId metric = METRIC_OTHER;
+    int result = 0;
     switch (req.cmd) {
         case CMD_READ:
-            return route_read_request(state, client_fd, req.filename);
+            metric = METRIC_READ;
+            result = route_read_request(state, client_fd, req.filename);
+            break;
             
         case CMD_WRITE:
-            return route_write_request(state, client_fd, req.filename, req.sentence_index);
+            metric = METRIC_WRITE;
+            result = route_write_request(state, client_fd, req.filename, req.sentence_index);
+            break;
             
         case CMD_CREATE:
-            return route_create_request(state, client_fd, req.filename, client->username);
+            metric = METRIC_CREATE;
+            result = route_create_request(state, client_fd, req.filename, client->username);
+            break;
             
         case CMD_DELETE:
-            return route_delete_request(state, client_fd, req.filename);
+            metric = METRIC_DELETE;
+            result = route_delete_request(state, client_fd, req.filename);
+            break;
             
         case CMD_VIEW:
         case CMD_INFO:
@@ -65,11 +91,15 @@ int handle_client_request(NameServerState* state, int client_fd) {
         case CMD_EXEC:
             // Will implement these in next phase
             {
+                if (req.cmd == CMD_INFO) metric = METRIC_INFO;
+                if (req.cmd == CMD_STREAM) metric = METRIC_STREAM;
+                if (req.cmd == CMD_EXEC) metric = METRIC_EXEC;
                 Response resp;
                 resp.status_code = ERR_INVALID_COMMAND;
                 snprintf(resp.message, sizeof(resp.message), 
                         "Command %d not yet implemented", req.cmd);
                 send_all(client_fd, &resp, sizeof(resp));
+                result = ERR_INVALID_COMMAND;
             }
             break;
             
@@ -80,11 +110,28 @@ int handle_client_request(NameServerState* state, int client_fd) {
                 strncpy(resp.message, get_error_message(ERR_INVALID_COMMAND), 
                        sizeof(resp.message) - 1);
                 send_all(client_fd, &resp, sizeof(resp));
+                result = ERR_INVALID_COMMAND;
             }
             break;
     }
     
-    return 0;
+    uint64_t elapsed = metrics_now_us() - start;
+    metrics_record(metric, elapsed, result != 0);
+    trace_end(NULL);
+    
+    if (logger_binary_enabled()) {
+        LogRecord record;
+        memset(&record, 0, sizeof(record));
+        record.component = LOG_COMP_NM;
+        record.op = (uint8_t)log_op_from_name(metric_name(metric));
+        record.user_id = fnv1a_64(client->username, strlen(client->username));
+        record.file_id = fnv1a_64(req.filename, strnlen(req.filename, sizeof(req.filename)));
+        record.trace_id = trace_id;
+        record.latency_us = elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed;
+        record.status = (uint16_t)result;
+        log_request(&record);
+    }
+    return result;
 }
 
 void run_server_loop(NameServerState* state) {
@@ -164,6 +211,28 @@ void run_server_loop(NameServerState* state) {
                 } else {
                     close(new_fd);
                 }
+            } else if (starts_with(ident_req.data, "ADMIN_STATS")) {
+                // One-shot admin query: latency per command as text, then close
+                char* stats = malloc(METRICS_TEXT_MAX);
+                if (stats) {
+                    memcpy(stats, "SUCCESS\n", 8);
+                    int len = 8 + metrics_format_stats(stats + 8, METRICS_TEXT_MAX - 8);
+                    send_all(new_fd, stats, (size_t)len);
+                    free(stats);
+                }
+                close(new_fd);
+            } else if (starts_with(ident_req.data, "ADMIN_REPL")) {
+                // One-shot admin query (format: "ADMIN_REPL <ss_id>"): the
+                // SS's replication status and per-replica lag, then close
+                char status[8192];
+                int ss_id = -1;
+                if (sscanf(ident_req.data, "ADMIN_REPL %d", &ss_id) == 1 &&
+                    query_replica_lag(state, ss_id, status, sizeof(status)) == SUCCESS) {
+                    send_all(new_fd, status, strlen(status));
+                } else {
+                    send_all(new_fd, "ERROR:SS_UNAVAILABLE\n", 21);
+                }
+                close(new_fd);
             } else {
                 fprintf(stderr, "Unknown connection type\n");
                 close(new_fd);
@@ -229,7 +298,24 @@ int main(int argc, char* argv[]) {
     signal(SIGTERM, signal_handler);
     
     // Initialize logger
-    init_logger("logs/name_server.log");
+    // NM_LOG_FORMAT=text (default), binary or both; binary request logs
+    // from the NM and the storage servers are joined by tools/trace_assemble
+    LoggerConfig log_config;
+    logger_default_config(&log_config);
+    const char* log_format = getenv("NM_LOG_FORMAT");
+    if (log_format && strcmp(log_format, "binary") == 0) {
+        log_config.text = false;
+        log_config.binary_path = "logs/name_server.bin";
+    } else if (log_format && strcmp(log_format, "both") == 0) {
+        log_config.binary_path = "logs/name_server.bin";
+    }
+    init_logger_config("logs/name_server.log", &log_config);
+    
+    // NM_METRICS_PORT serves routing latency on localhost for a scraper
+    const char* metrics_port = getenv("NM_METRICS_PORT");
+    if (metrics_port && metrics_serve_start("nm", atoi(metrics_port)) < 0) {
+        fprintf(stderr, "Metrics endpoint on port %s unavailable\n", metrics_port);
+    }
     
     // Initialize Name Server
     if (nm_init(&g_state) < 0) {
@@ -252,6 +338,7 @@ int main(int argc, char* argv[]) {
     
     // Cleanup
     nm_cleanup(&g_state);
+    metrics_serve_stop();
     close_logger();
     
     printf("\nName Server shut down gracefully\n");
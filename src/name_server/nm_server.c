@@ -3,6 +3,7 @@
 #include "../common/error_codes.h"
 #include "../common/logger.h"
 #include "../common/utils.h"
+#include "../common/trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -202,6 +203,38 @@ StorageServer* find_ss_for_file(NameServerState* state, const char* filename) {
     return find_storage_server(state, file->ss_id);
 }
 
+// Asks the SS over its client port, so the reply can't be mixed up with
+// heartbeats on the registration socket
+int query_replica_lag(NameServerState* state, int ss_id, char* out, size_t out_size) {
+    if (!out || out_size == 0) return ERR_INVALID_OPERATION;
+    out[0] = '\0';
+    
+    StorageServer* ss = find_storage_server(state, ss_id);
+    if (!ss) return ERR_SS_UNAVAILABLE;
+    
+    int sockfd = connect_to_server(ss->ip, ss->client_port);
+    if (sockfd < 0) return ERR_SS_UNAVAILABLE;
+    set_socket_timeout(sockfd, 5);
+    
+    size_t len = 0;
+    int result = send_all(sockfd, "REPL_STATUS\n", 12) < 0 ? ERR_SS_UNAVAILABLE : SUCCESS;
+    while (result == SUCCESS && len + 1 < out_size) {
+        ssize_t n = recv(sockfd, out + len, out_size - len - 1, 0);
+        if (n <= 0) {
+            result = ERR_SS_UNAVAILABLE;
+            break;
+        }
+        len += (size_t)n;
+        out[len] = '\0';
+        if (strstr(out, "END\n")) break;
+    }
+    close(sockfd);
+    
+    log_message("NM", ss->ip, ss->client_port, "system", "REPL_STATUS", "Replica lag query",
+                result == SUCCESS ? "SUCCESS" : "ERROR");
+    return result;
+}
+
 void update_ss_heartbeat(NameServerState* state, int ss_id) {
     StorageServer* ss = find_storage_server(state, ss_id);
     if (ss) {
@@ -490,7 +523,11 @@ int route_read_request(NameServerState* state, int client_fd, const char* filena
     resp.status_code = SUCCESS;
     strncpy(resp.ss_ip, ss->ip, sizeof(resp.ss_ip) - 1);
     resp.ss_port = ss->client_port;
-    snprintf(resp.message, sizeof(resp.message), "Connect to SS at %s:%d", ss->ip, ss->client_port);
+    // The client passes the trace on to the SS with its request
+    char trace[TRACE_TOKEN_LEN + 1];
+    trace_format(trace_current_id(), trace, sizeof(trace));
+    snprintf(resp.message, sizeof(resp.message), "Connect to SS at %s:%d %s", ss->ip,
+             ss->client_port, trace);
     send_all(client_fd, &resp, sizeof(resp));
     
     log_message("NM", client->ip, client->port, client->username, 
@@ -532,7 +569,11 @@ int route_write_request(NameServerState* state, int client_fd, const char* filen
     resp.status_code = SUCCESS;
     strncpy(resp.ss_ip, ss->ip, sizeof(resp.ss_ip) - 1);
     resp.ss_port = ss->client_port;
-    snprintf(resp.message, sizeof(resp.message), "Connect to SS at %s:%d", ss->ip, ss->client_port);
+    // The client passes the trace on to the SS with its request
+    char trace[TRACE_TOKEN_LEN + 1];
+    trace_format(trace_current_id(), trace, sizeof(trace));
+    snprintf(resp.message, sizeof(resp.message), "Connect to SS at %s:%d %s", ss->ip,
+             ss->client_port, trace);
     send_all(client_fd, &resp, sizeof(resp));
     
     log_message("NM", client->ip, client->port, client->username, 
@@ -3,6 +3,7 @@
 
 #include <pthread.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <time.h>
 
 #define MAX_STORAGE_SERVERS 10
@@ -97,6 +98,7 @@ int handle_ss_message(NameServerState* state, int ss_id);
 StorageServer* find_storage_server(NameServerState* state, int ss_id);
 StorageServer* find_ss_for_file(NameServerState* state, const char* filename);
 void update_ss_heartbeat(NameServerState* state, int ss_id);
+int query_replica_lag(NameServerState* state, int ss_id, char* out, size_t out_size);
 
 // Client Management
 int register_client(NameServerState* state, int client_fd, const char* username);
@@ -1,6 +1,9 @@
 #include "ss_server.h"
+#include "ss_conn.h"
+#include "ss_io.h"
 #include "../common/utils.h"
 #include "../common/logger.h"
+#include "../common/metrics.h"
 #include "../common/error_codes.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -13,6 +16,7 @@
 #include <arpa/inet.h>
 
 static StorageServerState g_state;
+static ConnServer g_conn;
 static volatile sig_atomic_t keep_running = 1;
 
 void signal_handler(int signum) {
@@ -23,13 +27,15 @@ void signal_handler(int signum) {
 
 int main(int argc, char* argv[]) {
     if (argc < 7) {
-        printf("Usage: %s SS_ID BASE_PATH NM_IP NM_PORT CLIENT_PORT SS_PORT\n", argv[0]);
-        printf("Example: %s 1 ./data/ss1 127.0.0.1 8000 9001 9101\n", argv[0]);
+        printf("Usage: %s SS_ID BASE_PATH NM_IP NM_PORT CLIENT_PORT SS_PORT [REPLICA_IP:SS_PORT ...]\n",
+               argv[0]);
+        printf("Example: %s 1 ./data/ss1 127.0.0.1 8000 9001 9101 127.0.0.1:9102\n", argv[0]);
         return 1;
     }
     
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
+    signal(SIGPIPE, SIG_IGN);  // Peers (clients, replicas) may vanish mid-send
     
     int ss_id = atoi(argv[1]);
     int nm_port = atoi(argv[4]);
@@ -38,19 +44,60 @@ int main(int argc, char* argv[]) {
     
     printf("\nInitializing Storage Server %d...\n", ss_id);
     
+    // SS_LOG_FORMAT=text (default), binary or both; the binary request
+    // log is read with tools/log_query
+    char log_path[64];
+    char bin_path[64];
+    snprintf(log_path, sizeof(log_path), "logs/storage_server_%d.log", ss_id);
+    snprintf(bin_path, sizeof(bin_path), "logs/storage_server_%d.bin", ss_id);
+    const char* log_format = getenv("SS_LOG_FORMAT");
+    LoggerConfig log_config;
+    logger_default_config(&log_config);
+    if (log_format && strcmp(log_format, "binary") == 0) {
+        log_config.text = false;
+        log_config.binary_path = bin_path;
+    } else if (log_format && strcmp(log_format, "both") == 0) {
+        log_config.binary_path = bin_path;
+    }
+    init_logger_config(log_path, &log_config);
+    
+    // SS_METRICS_PORT serves latency metrics on localhost for a scraper
+    const char* metrics_port = getenv("SS_METRICS_PORT");
+    if (metrics_port && metrics_serve_start("ss", atoi(metrics_port)) < 0) {
+        fprintf(stderr, "Metrics endpoint on port %s unavailable\n", metrics_port);
+    }
+    
     if (ss_init(&g_state, ss_id, argv[2], argv[3], nm_port, client_port, ss_port) < 0) {
         fprintf(stderr, "Failed to initialize storage server\n");
         return 1;
     }
+    metrics_set_extra(lock_table_format_exposition, &g_state.lock_table);
+    
+    ss_io_init(SS_IO_BACKEND_URING);
+    printf("Storage I/O backend: %s\n", ss_io_backend_name());
     
     printf("Scanning files from %s...\n", argv[2]);
     int file_count = scan_and_register_files(&g_state);
     printf("Registered %d files\n", file_count);
+    sentence_indexer_start(&g_state.indexer);
+    cold_freezer_start(&g_state.freezer);
+    
+    // Replicas come from the command line
+    for (int i = 7; i < argc; i++) {
+        char ip[16];
+        int port;
+        if (sscanf(argv[i], "%15[^:]:%d", ip, &port) != 2 ||
+            repl_add_replica(&g_state.replication, ip, port) < 0) {
+            fprintf(stderr, "Ignoring replica '%s'\n", argv[i]);
+        }
+    }
+    repl_start(&g_state.replication);
     
     printf("Connecting to Name Server at %s:%d...\n", argv[3], nm_port);
     if (register_with_name_server(&g_state) < 0) {
         fprintf(stderr, "Failed to register with Name Server\n");
         ss_cleanup(&g_state);
+        ss_io_shutdown();
         return 1;
     }
     
@@ -62,22 +109,28 @@ int main(int argc, char* argv[]) {
     printf("  Client Port: %d\n", client_port);
     printf("  SS Port: %d\n", ss_port);
     printf("  Files: %d\n", file_count);
+    printf("  Replicas: %d\n", g_state.replication.replica_count);
     printf("  Base Path: %s\n", argv[2]);
     printf("========================================\n\n");
     printf("Press Ctrl+C to stop...\n");
     
     pthread_create(&g_state.heartbeat_thread, NULL, heartbeat_thread_func, &g_state);
+    chunk_store_start_gc(&g_state.chunk_store);
+    lock_table_start_reaper(&g_state.lock_table);
+    stream_engine_start(&g_state.stream_engine, STREAM_DEFAULT_LOOPS);
     
-    // Simple event loop
+    // Client and SS connections are served by the worker pool
+    if (conn_server_start(&g_conn, &g_state, 0) < 0) {
+        fprintf(stderr, "Failed to start connection server\n");
+        g_state.running = false;
+    }
+    
+    // Main loop only watches the Name Server link
     fd_set read_set;
-    int max_fd = g_state.client_listen_socket;
-    if (g_state.ss_listen_socket > max_fd) max_fd = g_state.ss_listen_socket;
-    if (g_state.nm_socket > max_fd) max_fd = g_state.nm_socket;
+    int max_fd = g_state.nm_socket;
     
     while (keep_running && g_state.running) {
         FD_ZERO(&read_set);
-        FD_SET(g_state.client_listen_socket, &read_set);
-        FD_SET(g_state.ss_listen_socket, &read_set);
         FD_SET(g_state.nm_socket, &read_set);
         
         struct timeval timeout = {1, 0};
@@ -90,29 +143,6 @@ int main(int argc, char* argv[]) {
         
         if (activity == 0) continue; // Timeout
         
-        // Handle incoming connections (basic handling for now)
-        if (FD_ISSET(g_state.client_listen_socket, &read_set)) {
-            struct sockaddr_in addr;
-            socklen_t len = sizeof(addr);
-            int client_fd = accept(g_state.client_listen_socket, (struct sockaddr*)&addr, &len);
-            if (client_fd >= 0) {
-                printf("Client connected from %s:%d\n", 
-                       inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
-                close(client_fd); // TODO: Handle requests
-            }
-        }
-        
-        if (FD_ISSET(g_state.ss_listen_socket, &read_set)) {
-            struct sockaddr_in addr;
-            socklen_t len = sizeof(addr);
-            int ss_fd = accept(g_state.ss_listen_socket, (struct sockaddr*)&addr, &len);
-            if (ss_fd >= 0) {
-                printf("SS connected from %s:%d\n", 
-                       inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
-                close(ss_fd); // TODO: Handle SS requests
-            }
-        }
-        
         if (FD_ISSET(g_state.nm_socket, &read_set)) {
             char buffer[1024];
             int n = recv(g_state.nm_socket, buffer, sizeof(buffer) - 1, 0);
@@ -128,8 +158,12 @@ int main(int argc, char* argv[]) {
     
     printf("\nShutting down...\n");
     g_state.running = false;
+    conn_server_stop(&g_conn);
     pthread_join(g_state.heartbeat_thread, NULL);
+    metrics_serve_stop(); // Scrapes read the lock table
     ss_cleanup(&g_state);
+    ss_io_shutdown();
+    close_logger();
     
     printf("Storage Server shutdown complete\n");
     return 0;
@@ -0,0 +1,365 @@
+#include "ss_cache.h"
+#include "../common/hash_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ===============================================
+ * FREQUENCY SKETCH
+ * =============================================== */
+
+// Frequency is tracked per file, not per version, so a popular document
+// stays popular across its commits
+static size_t sketch_slot(uint64_t file_id, int row) {
+    return hash_mix64(file_id + (uint64_t)(row + 1) * 0x9e3779b97f4a7c15ULL) &
+           (CACHE_SKETCH_WIDTH - 1);
+}
+
+// Caller holds cache->mutex
+static void sketch_increment(ContentCache* cache, uint64_t file_id) {
+    for (int row = 0; row < CACHE_SKETCH_DEPTH; row++) {
+        uint8_t* counter = &cache->sketch[row][sketch_slot(file_id, row)];
+        if (*counter < CACHE_SKETCH_MAX) (*counter)++;
+    }
+
+    // Halve every counter periodically so old popularity fades
+    if (++cache->sketch_samples >= CACHE_SKETCH_WIDTH * 10) {
+        for (int row = 0; row < CACHE_SKETCH_DEPTH; row++) {
+            for (size_t i = 0; i < CACHE_SKETCH_WIDTH; i++) {
+                cache->sketch[row][i] >>= 1;
+            }
+        }
+        cache->sketch_samples /= 2;
+    }
+}
+
+// Caller holds cache->mutex
+static int sketch_frequency(const ContentCache* cache, uint64_t file_id) {
+    int freq = CACHE_SKETCH_MAX;
+    for (int row = 0; row < CACHE_SKETCH_DEPTH; row++) {
+        int count = cache->sketch[row][sketch_slot(file_id, row)];
+        if (count < freq) freq = count;
+    }
+    return freq;
+}
+
+/* ===============================================
+ * LISTS AND ENTRIES
+ * =============================================== */
+
+static size_t cache_bucket(uint64_t file_id) {
+    return hash_mix64(file_id) % CONTENT_CACHE_BUCKETS;
+}
+
+static CacheList* region_list(ContentCache* cache, CacheRegion region) {
+    switch (region) {
+        case CACHE_REGION_WINDOW: return &cache->window;
+        case CACHE_REGION_PROBATION: return &cache->probation;
+        case CACHE_REGION_PROTECTED: return &cache->protected_list;
+        default: return NULL;
+    }
+}
+
+static void list_remove(CacheList* list, CachedContent* content) {
+    if (content->prev) content->prev->next = content->next;
+    else list->head = content->next;
+    if (content->next) content->next->prev = content->prev;
+    else list->tail = content->prev;
+    content->prev = content->next = NULL;
+    list->bytes -= content->size;
+}
+
+static void list_push_front(CacheList* list, CachedContent* content) {
+    content->prev = NULL;
+    content->next = list->head;
+    if (list->head) list->head->prev = content;
+    else list->tail = content;
+    list->head = content;
+    list->bytes += content->size;
+}
+
+static void move_to_region(ContentCache* cache, CachedContent* content, CacheRegion region) {
+    CacheList* from = region_list(cache, content->region);
+    if (from) list_remove(from, content);
+    content->region = region;
+    list_push_front(region_list(cache, region), content);
+}
+
+static void free_content(CachedContent* content) {
+    free(content->data);
+    free(content->sentence_start);
+    free(content->sentence_len);
+    free(content);
+}
+
+// Sentence rules match count_sentences: a sentence starts at the first
+// non-blank byte and ends at . ! or ?; trailing text is a final sentence
+static int index_sentences(CachedContent* content) {
+    size_t capacity = 0;
+    bool in_sentence = false;
+    size_t start = 0;
+
+    for (size_t i = 0; i <= content->size; i++) {
+        bool at_end = i == content->size;
+        char ch = at_end ? '\0' : content->data[i];
+
+        if (!at_end && !in_sentence && ch != ' ' && ch != '\t' && ch != '\n') {
+            in_sentence = true;
+            start = i;
+        }
+
+        bool closes = in_sentence && (at_end || ch == '.' || ch == '!' || ch == '?');
+        if (!closes) continue;
+
+        if ((size_t)content->sentence_count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            size_t* starts = realloc(content->sentence_start, capacity * sizeof(size_t));
+            size_t* lens = starts ? realloc(content->sentence_len, capacity * sizeof(size_t)) : NULL;
+            if (starts) content->sentence_start = starts;
+            if (!starts || !lens) return -1;
+            content->sentence_len = lens;
+        }
+        content->sentence_start[content->sentence_count] = start;
+        content->sentence_len[content->sentence_count] = (at_end ? i : i + 1) - start;
+        content->sentence_count++;
+        in_sentence = false;
+    }
+
+    return 0;
+}
+
+// Caller holds cache->mutex; the entry stops being findable and is freed
+// once its last reader releases it
+static void drop_resident(ContentCache* cache, CachedContent* content) {
+    CacheList* list = region_list(cache, content->region);
+    if (list) list_remove(list, content);
+    content->region = CACHE_REGION_NONE;
+
+    CachedContent** link = &cache->buckets[cache_bucket(content->file_id)];
+    while (*link && *link != content) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) *link = content->hash_next;
+    content->hash_next = NULL;
+
+    if (content->refcount == 0) free_content(content);
+}
+
+// Caller holds cache->mutex. Moves overflow from the window into the main
+// region, letting each candidate in only if it is used more often than
+// every entry it displaces.
+static void drain_window(ContentCache* cache) {
+    size_t main_capacity = cache->capacity - cache->window_capacity;
+
+    while (cache->window.bytes > cache->window_capacity && cache->window.tail) {
+        CachedContent* candidate = cache->window.tail;
+        int candidate_freq = sketch_frequency(cache, candidate->file_id);
+        bool admit = true;
+
+        while (cache->probation.bytes + cache->protected_list.bytes + candidate->size >
+               main_capacity) {
+            CachedContent* victim = cache->probation.tail ? cache->probation.tail
+                                                          : cache->protected_list.tail;
+            if (!victim) break;
+            if (candidate_freq <= sketch_frequency(cache, victim->file_id)) {
+                admit = false;
+                break;
+            }
+            drop_resident(cache, victim);
+            cache->stats.evictions++;
+        }
+
+        if (admit) {
+            move_to_region(cache, candidate, CACHE_REGION_PROBATION);
+            cache->stats.admitted++;
+        } else {
+            drop_resident(cache, candidate);
+            cache->stats.rejected++;
+        }
+    }
+}
+
+// Caller holds cache->mutex
+static void record_hit(ContentCache* cache, CachedContent* content) {
+    switch (content->region) {
+        case CACHE_REGION_WINDOW:
+        case CACHE_REGION_PROTECTED:
+            move_to_region(cache, content, content->region);
+            break;
+        case CACHE_REGION_PROBATION:
+            // Second hit in the main region: protect it, demoting the
+            // protected segment's oldest entries back to probation
+            move_to_region(cache, content, CACHE_REGION_PROTECTED);
+            while (cache->protected_list.bytes > cache->protected_capacity &&
+                   cache->protected_list.tail != content) {
+                move_to_region(cache, cache->protected_list.tail, CACHE_REGION_PROBATION);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/* ===============================================
+ * PUBLIC API
+ * =============================================== */
+
+void content_cache_init(ContentCache* cache, size_t capacity) {
+    memset(cache, 0, sizeof(ContentCache));
+    pthread_mutex_init(&cache->mutex, NULL);
+
+    cache->capacity = capacity ? capacity : CONTENT_CACHE_DEFAULT_BYTES;
+    cache->window_capacity = cache->capacity * CONTENT_CACHE_WINDOW_PERCENT / 100;
+    cache->protected_capacity =
+        (cache->capacity - cache->window_capacity) * CONTENT_CACHE_PROTECTED_PERCENT / 100;
+    cache->max_entry = cache->capacity / 8;
+}
+
+void content_cache_destroy(ContentCache* cache) {
+    pthread_mutex_lock(&cache->mutex);
+    for (int b = 0; b < CONTENT_CACHE_BUCKETS; b++) {
+        CachedContent* content = cache->buckets[b];
+        while (content) {
+            CachedContent* next = content->hash_next;
+            free_content(content);
+            content = next;
+        }
+        cache->buckets[b] = NULL;
+    }
+    memset(&cache->window, 0, sizeof(CacheList));
+    memset(&cache->probation, 0, sizeof(CacheList));
+    memset(&cache->protected_list, 0, sizeof(CacheList));
+    pthread_mutex_unlock(&cache->mutex);
+
+    pthread_mutex_destroy(&cache->mutex);
+}
+
+bool content_cache_accepts(const ContentCache* cache, size_t size) {
+    return cache && size <= cache->max_entry;
+}
+
+CachedContent* content_cache_get(ContentCache* cache, uint64_t file_id, uint64_t version) {
+    if (!cache) return NULL;
+
+    pthread_mutex_lock(&cache->mutex);
+    sketch_increment(cache, file_id);
+
+    CachedContent* content = cache->buckets[cache_bucket(file_id)];
+    while (content && !(content->file_id == file_id && content->version == version)) {
+        content = content->hash_next;
+    }
+
+    if (content) {
+        content->refcount++;
+        record_hit(cache, content);
+        cache->stats.hits++;
+    } else {
+        cache->stats.misses++;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+
+    return content;
+}
+
+CachedContent* content_cache_put(ContentCache* cache, uint64_t file_id, uint64_t version,
+                                 char* data, size_t size) {
+    if (!cache || !data) {
+        free(data);
+        return NULL;
+    }
+
+    CachedContent* content = calloc(1, sizeof(CachedContent));
+    if (!content) {
+        free(data);
+        return NULL;
+    }
+    content->file_id = file_id;
+    content->version = version;
+    content->data = data;
+    content->size = size;
+    content->refcount = 1;
+    content->region = CACHE_REGION_NONE;
+
+    // Index before taking the lock
+    if (index_sentences(content) < 0) {
+        free_content(content);
+        return NULL;
+    }
+
+    if (size > cache->max_entry) {
+        return content;  // Private copy, freed on release
+    }
+
+    pthread_mutex_lock(&cache->mutex);
+
+    size_t bucket = cache_bucket(file_id);
+    for (CachedContent* existing = cache->buckets[bucket]; existing;
+         existing = existing->hash_next) {
+        if (existing->file_id == file_id && existing->version == version) {
+            // A racing loader got here first
+            existing->refcount++;
+            pthread_mutex_unlock(&cache->mutex);
+            free_content(content);
+            return existing;
+        }
+    }
+
+    content->hash_next = cache->buckets[bucket];
+    cache->buckets[bucket] = content;
+    move_to_region(cache, content, CACHE_REGION_WINDOW);
+    drain_window(cache);
+
+    pthread_mutex_unlock(&cache->mutex);
+
+    return content;
+}
+
+void content_cache_release(ContentCache* cache, CachedContent* content) {
+    if (!cache || !content) return;
+
+    pthread_mutex_lock(&cache->mutex);
+    bool free_now = --content->refcount == 0 && content->region == CACHE_REGION_NONE;
+    pthread_mutex_unlock(&cache->mutex);
+
+    if (free_now) free_content(content);
+}
+
+void content_cache_invalidate(ContentCache* cache, uint64_t file_id, uint64_t keep_version) {
+    if (!cache) return;
+
+    pthread_mutex_lock(&cache->mutex);
+    CachedContent* content = cache->buckets[cache_bucket(file_id)];
+    while (content) {
+        CachedContent* next = content->hash_next;
+        if (content->file_id == file_id &&
+            (keep_version == 0 || content->version < keep_version)) {
+            drop_resident(cache, content);
+            cache->stats.invalidations++;
+        }
+        content = next;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+int cached_sentence(const CachedContent* content, int sentence_idx,
+                    const char** start, size_t* len) {
+    if (!content || sentence_idx < 0 || sentence_idx >= content->sentence_count) {
+        return -1;
+    }
+    *start = content->data + content->sentence_start[sentence_idx];
+    *len = content->sentence_len[sentence_idx];
+    return 0;
+}
+
+void content_cache_get_stats(ContentCache* cache, CacheStats* stats) {
+    if (!cache || !stats) return;
+
+    pthread_mutex_lock(&cache->mutex);
+    *stats = cache->stats;
+    stats->bytes = cache->window.bytes + cache->probation.bytes + cache->protected_list.bytes;
+    stats->entries = 0;
+    for (CachedContent* c = cache->window.head; c; c = c->next) stats->entries++;
+    for (CachedContent* c = cache->probation.head; c; c = c->next) stats->entries++;
+    for (CachedContent* c = cache->protected_list.head; c; c = c->next) stats->entries++;
+    pthread_mutex_unlock(&cache->mutex);
+}
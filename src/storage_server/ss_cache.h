@@ -0,0 +1,158 @@
+#ifndef SS_CACHE_H
+#define SS_CACHE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CONTENT_CACHE_DEFAULT_BYTES (64 * 1024 * 1024)
+#define CONTENT_CACHE_BUCKETS 4096
+#define CONTENT_CACHE_WINDOW_PERCENT 1       // Admission window share of capacity
+#define CONTENT_CACHE_PROTECTED_PERCENT 80   // Protected share of the main region
+#define CACHE_SKETCH_DEPTH 4
+#define CACHE_SKETCH_WIDTH 4096              // Counters per row (power of two)
+#define CACHE_SKETCH_MAX 15                  // Saturating 4-bit counters
+
+typedef enum {
+    CACHE_REGION_NONE = 0,                   // Not resident (evicted or never admitted)
+    CACHE_REGION_WINDOW,
+    CACHE_REGION_PROBATION,
+    CACHE_REGION_PROTECTED
+} CacheRegion;
+
+/**
+ * Cached Content
+ * One version of a file held in memory with its sentence boundaries.
+ * Immutable once published; readers hold a reference while they use it,
+ * so eviction never frees content out from under a send.
+ */
+typedef struct CachedContent {
+    uint64_t file_id;
+    uint64_t version;
+    char* data;                      // NUL-terminated copy of the file
+    size_t size;
+    size_t* sentence_start;
+    size_t* sentence_len;
+    int sentence_count;
+
+    int refcount;                    // Guarded by the cache mutex
+    CacheRegion region;
+    struct CachedContent* prev;      // LRU list of its region
+    struct CachedContent* next;
+    struct CachedContent* hash_next;
+} CachedContent;
+
+typedef struct {
+    CachedContent* head;             // Most recently used
+    CachedContent* tail;             // Eviction end
+    size_t bytes;
+} CacheList;
+
+/**
+ * Cache Statistics
+ */
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t admitted;               // Window candidates that entered the main region
+    uint64_t rejected;               // Candidates that lost to the main region's victim
+    uint64_t evictions;
+    uint64_t invalidations;
+    size_t bytes;
+    int entries;
+} CacheStats;
+
+/**
+ * Content Cache
+ * W-TinyLFU: new entries land in a small LRU window; when they fall out
+ * of it they only enter the segmented-LRU main region if a count-min
+ * sketch says they are used more often than the entry they would evict.
+ * Capacity is counted in content bytes.
+ */
+typedef struct ContentCache {
+    pthread_mutex_t mutex;
+    CachedContent* buckets[CONTENT_CACHE_BUCKETS];
+    CacheList window;
+    CacheList probation;
+    CacheList protected_list;
+
+    size_t capacity;
+    size_t window_capacity;
+    size_t protected_capacity;
+    size_t max_entry;                // Larger files are never cached
+
+    uint8_t sketch[CACHE_SKETCH_DEPTH][CACHE_SKETCH_WIDTH];
+    uint32_t sketch_samples;         // Accesses since the last aging pass
+
+    CacheStats stats;
+} ContentCache;
+
+/**
+ * Initialize / destroy the cache
+ * @param cache Content cache
+ * @param capacity Content bytes to keep (0 picks CONTENT_CACHE_DEFAULT_BYTES)
+ */
+void content_cache_init(ContentCache* cache, size_t capacity);
+void content_cache_destroy(ContentCache* cache);
+
+/**
+ * Look up one version of a file
+ * Every lookup counts towards the file's admission frequency.
+ * @param cache Content cache
+ * @param file_id File ID
+ * @param version File version
+ * @return Referenced content (release with content_cache_release), NULL on miss
+ */
+CachedContent* content_cache_get(ContentCache* cache, uint64_t file_id, uint64_t version);
+
+/**
+ * Add one version of a file
+ * Takes ownership of data (malloc'd, size + 1 bytes, NUL-terminated). The
+ * entry is returned referenced whether or not it is admitted; an entry
+ * that is not kept is freed on its last release.
+ * @param cache Content cache
+ * @param file_id File ID
+ * @param version File version
+ * @param data File content
+ * @param size Content length
+ * @return Referenced content, NULL on allocation failure (data is freed)
+ */
+CachedContent* content_cache_put(ContentCache* cache, uint64_t file_id, uint64_t version,
+                                 char* data, size_t size);
+
+/**
+ * Drop a reference taken with content_cache_get / content_cache_put
+ */
+void content_cache_release(ContentCache* cache, CachedContent* content);
+
+/**
+ * Drop every cached version of a file older than keep_version
+ * @param cache Content cache
+ * @param file_id File ID
+ * @param keep_version Versions >= this stay (0 drops all)
+ */
+void content_cache_invalidate(ContentCache* cache, uint64_t file_id, uint64_t keep_version);
+
+/**
+ * Whether a file of this size would be considered for caching
+ */
+bool content_cache_accepts(const ContentCache* cache, size_t size);
+
+/**
+ * Locate a sentence in cached content
+ * @param content Cached content
+ * @param sentence_idx Sentence index (0-based)
+ * @param start Output: first byte of the sentence
+ * @param len Output: sentence length
+ * @return 0 on success, -1 if out of range
+ */
+int cached_sentence(const CachedContent* content, int sentence_idx,
+                    const char** start, size_t* len);
+
+/**
+ * Snapshot cache statistics
+ */
+void content_cache_get_stats(ContentCache* cache, CacheStats* stats);
+
+#endif // SS_CACHE_H
@@ -0,0 +1,167 @@
+#ifndef SS_CHUNK_STORE_H
+#define SS_CHUNK_STORE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+#include "../common/hash_utils.h"
+
+#define CHUNK_STORE_DIR ".checkpoints"   // Lives under the SS base path
+#define CHUNK_STORE_PATH_LEN 512
+
+// Content-defined chunking parameters (gear hash, ~8 KB average chunk)
+#define CHUNK_MIN_SIZE 2048
+#define CHUNK_AVG_SIZE 8192
+#define CHUNK_MAX_SIZE 65536
+
+#define CHUNK_GC_INTERVAL_SEC 300        // Background sweep period
+#define CHUNK_GC_GRACE_SEC 600           // Never collect chunks younger than this
+
+/**
+ * Chunk Hash
+ * SHA-256 of the chunk content; also the chunk's on-disk name
+ */
+typedef struct {
+    uint8_t bytes[SHA256_DIGEST_LEN];
+} ChunkHash;
+
+/**
+ * Checkpoint Info
+ * Header of a checkpoint manifest (used for listing)
+ */
+typedef struct {
+    char tag[128];
+    time_t created_at;
+    long size;
+    int chunk_count;
+} CheckpointInfo;
+
+/**
+ * Chunk Store
+ * Content-addressed store of file chunks. A checkpoint is a manifest
+ * listing chunk hashes, so identical chunks are stored only once.
+ *
+ * Layout under <base_path>/.checkpoints:
+ *   chunks/<first 2 hex>/<64 hex>     - chunk content
+ *   manifests/<filepath>/<tag>        - checkpoint manifests
+ */
+typedef struct {
+    char root[CHUNK_STORE_PATH_LEN];
+    pthread_rwlock_t gc_lock;        // Readers: checkpoint writers. Writer: GC sweep
+    pthread_mutex_t gc_mutex;        // Protects gc_running and gc_cond
+    pthread_cond_t gc_cond;
+    pthread_t gc_thread;
+    bool gc_running;
+    bool gc_started;
+
+    // Statistics
+    long chunks_written;
+    long chunks_deduped;
+    long chunks_collected;
+} ChunkStore;
+
+/**
+ * Callback invoked for each chunk when reading a checkpoint back
+ * @return 0 to continue, -1 to abort
+ */
+typedef int (*ChunkVisitor)(const void* data, size_t len, void* arg);
+
+/**
+ * Initialize the chunk store under a storage server base path
+ * @param store Chunk store
+ * @param base_path SS base directory
+ * @return 0 on success, -1 on failure
+ */
+int chunk_store_init(ChunkStore* store, const char* base_path);
+
+/**
+ * Release resources held by the chunk store (stops GC if running)
+ * @param store Chunk store
+ */
+void chunk_store_destroy(ChunkStore* store);
+
+/**
+ * Find the length of the next content-defined chunk
+ * @param data Data to split
+ * @param len Bytes available
+ * @return Length of the chunk starting at data
+ */
+size_t chunk_next_boundary(const uint8_t* data, size_t len);
+
+/**
+ * Save a checkpoint of a file
+ * Only chunks not already present in the store are written. The content
+ * is read from src_fd (not its offset), which should pin one version of
+ * the file so a concurrent commit can't change it mid-chunking.
+ * @param store Chunk store
+ * @param filepath Relative filepath (manifest namespace)
+ * @param tag Checkpoint tag
+ * @param src_fd Open descriptor on the content to checkpoint
+ * @param src_size Content size
+ * @param new_chunks Optional out: number of chunks actually written
+ * @return 0 on success, error code on failure
+ */
+int chunk_store_create_checkpoint(ChunkStore* store, const char* filepath,
+                                  const char* tag, int src_fd, off_t src_size,
+                                  int* new_chunks);
+
+/**
+ * Stream the content of a checkpoint chunk by chunk
+ * @param store Chunk store
+ * @param filepath Relative filepath
+ * @param tag Checkpoint tag
+ * @param visitor Called for every chunk in order
+ * @param arg Passed to visitor
+ * @param total_size Optional out: checkpoint size in bytes (set before first visit)
+ * @return 0 on success, error code on failure
+ */
+int chunk_store_read_checkpoint(ChunkStore* store, const char* filepath,
+                                const char* tag, ChunkVisitor visitor,
+                                void* arg, long* total_size);
+
+/**
+ * Materialize a checkpoint into dest_path (atomic rename)
+ * @param store Chunk store
+ * @param filepath Relative filepath
+ * @param tag Checkpoint tag
+ * @param dest_path Full path to replace
+ * @return 0 on success, error code on failure
+ */
+int chunk_store_restore_checkpoint(ChunkStore* store, const char* filepath,
+                                   const char* tag, const char* dest_path);
+
+/**
+ * List checkpoints of a file
+ * @param store Chunk store
+ * @param filepath Relative filepath
+ * @param infos Out: malloc'd array (caller frees)
+ * @param count Out: number of checkpoints
+ * @return 0 on success, -1 on failure
+ */
+int chunk_store_list_checkpoints(ChunkStore* store, const char* filepath,
+                                 CheckpointInfo** infos, int* count);
+
+/**
+ * Drop all checkpoint manifests of a file (chunks are left to the GC)
+ * @param store Chunk store
+ * @param filepath Relative filepath
+ */
+void chunk_store_drop_file(ChunkStore* store, const char* filepath);
+
+/**
+ * Run one mark-and-sweep pass over the store
+ * @param store Chunk store
+ * @return Number of chunks collected, -1 on error
+ */
+int chunk_store_collect_garbage(ChunkStore* store);
+
+/**
+ * Start/stop the background garbage collector thread
+ */
+int chunk_store_start_gc(ChunkStore* store);
+void chunk_store_stop_gc(ChunkStore* store);
+
+#endif // SS_CHUNK_STORE_H
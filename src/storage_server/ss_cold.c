@@ -0,0 +1,523 @@
+#define _GNU_SOURCE
+#include "ss_cold.h"
+#include "ss_server.h"
+#include "ss_io.h"
+#include "../common/compress.h"
+#include "../common/hash_utils.h"
+#include "../common/logger.h"
+#include "../common/utils.h"
+#include "../common/error_codes.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* ===============================================
+ * READING
+ * =============================================== */
+
+static uint32_t header_crc(const ColdHeader* header) {
+    return crc32c(0, header, offsetof(ColdHeader, header_crc));
+}
+
+static int read_header(int fd, ColdHeader* header) {
+    if (ss_io_pread_all(fd, header, sizeof(ColdHeader), 0) != (ssize_t)sizeof(ColdHeader)) {
+        return -1;
+    }
+    if (memcmp(header->magic, COLD_MAGIC, sizeof(header->magic)) != 0 ||
+        header->format != COLD_FORMAT || header->block_size == 0 ||
+        header->block_size > COMPRESS_MAX_INPUT || header->header_crc != header_crc(header) ||
+        header->block_count != (header->raw_size + header->block_size - 1) / header->block_size) {
+        return -1;
+    }
+    return 0;
+}
+
+bool cold_file_detect(int fd, off_t* raw_size) {
+    ColdHeader header;
+    if (read_header(fd, &header) < 0) return false;
+    if (raw_size) *raw_size = (off_t)header.raw_size;
+    return true;
+}
+
+int cold_file_open(ColdFile* cold, int fd) {
+    memset(cold, 0, sizeof(ColdFile));
+    cold->fd = fd;
+    cold->block_no = -1;
+
+    struct stat st;
+    if (read_header(fd, &cold->header) < 0 || fstat(fd, &st) < 0) {
+        cold_file_close(cold);
+        return -1;
+    }
+
+    size_t index_size = (size_t)cold->header.block_count * sizeof(ColdBlock);
+    cold->index = malloc(index_size ? index_size : 1);
+    cold->block = malloc(cold->header.block_size);
+    cold->stored = malloc(cold->header.block_size);
+    if (!cold->index || !cold->block || !cold->stored ||
+        ss_io_pread_all(fd, cold->index, index_size, sizeof(ColdHeader)) != (ssize_t)index_size ||
+        crc32c(0, cold->index, index_size) != cold->header.index_crc) {
+        cold_file_close(cold);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < cold->header.block_count; i++) {
+        const ColdBlock* block = &cold->index[i];
+        if (block->stored_len > cold->header.block_size ||
+            block->offset + block->stored_len > (uint64_t)st.st_size) {
+            cold_file_close(cold);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void cold_file_close(ColdFile* cold) {
+    if (cold->fd >= 0) close(cold->fd);
+    cold->fd = -1;
+    free(cold->index);
+    free(cold->block);
+    free(cold->stored);
+    cold->index = NULL;
+    cold->block = NULL;
+    cold->stored = NULL;
+}
+
+static size_t block_raw_len(const ColdHeader* header, uint64_t block_no) {
+    uint64_t start = block_no * header->block_size;
+    uint64_t left = header->raw_size - start;
+    return left < header->block_size ? (size_t)left : header->block_size;
+}
+
+static int load_block(ColdFile* cold, uint64_t block_no) {
+    if ((long)block_no == cold->block_no) return 0;
+
+    const ColdBlock* block = &cold->index[block_no];
+    size_t raw_len = block_raw_len(&cold->header, block_no);
+    if (ss_io_pread_all(cold->fd, cold->stored, block->stored_len,
+                        (off_t)block->offset) != (ssize_t)block->stored_len ||
+        crc32c(0, cold->stored, block->stored_len) != block->crc) {
+        return -1;
+    }
+
+    if (block->stored_len == raw_len) {
+        memcpy(cold->block, cold->stored, raw_len);
+    } else if (decompress_block(cold->stored, block->stored_len, cold->block, raw_len) < 0) {
+        return -1;
+    }
+    cold->block_no = (long)block_no;
+    return 0;
+}
+
+ssize_t cold_file_pread(ColdFile* cold, void* buf, size_t len, off_t offset) {
+    if (!cold || !cold->index || offset < 0) return -1;
+    if ((uint64_t)offset >= cold->header.raw_size) return 0;
+
+    uint64_t left = cold->header.raw_size - (uint64_t)offset;
+    if (len > left) len = (size_t)left;
+
+    size_t done = 0;
+    while (done < len) {
+        uint64_t pos = (uint64_t)offset + done;
+        uint64_t block_no = pos / cold->header.block_size;
+        if (load_block(cold, block_no) < 0) return -1;
+
+        size_t in_block = (size_t)(pos % cold->header.block_size);
+        size_t take = block_raw_len(&cold->header, block_no) - in_block;
+        if (take > len - done) take = len - done;
+        memcpy((char*)buf + done, cold->block + in_block, take);
+        done += take;
+    }
+    return (ssize_t)done;
+}
+
+long long cold_file_send_frames(ColdFile* cold, int sock) {
+    if (!cold || !cold->index || cold->header.block_size != COMPRESS_FRAME_SIZE) return -1;
+
+    long long sent = 0;
+    for (uint64_t i = 0; i < cold->header.block_count; i++) {
+        const ColdBlock* block = &cold->index[i];
+        CompressFrameHeader frame;
+        frame.raw_len = (uint32_t)block_raw_len(&cold->header, i);
+        frame.stored_len = block->stored_len;
+        frame.crc = block->crc;
+        if (send_all(sock, &frame, sizeof(frame)) < 0 ||
+            send_file_range(sock, cold->fd, (off_t)block->offset,
+                            block->stored_len) != (long long)block->stored_len) {
+            return -1;
+        }
+        sent += (long long)(sizeof(frame) + block->stored_len);
+    }
+    return sent;
+}
+
+// Anonymous file to expand into, beside path when it's large
+static int anonymous_file(const char* path, uint64_t size) {
+    if (size > COLD_MEMFD_MAX) {
+        char dir[MAX_PATH_LEN];
+        snprintf(dir, sizeof(dir), "%s", path);
+        char* slash = strrchr(dir, '/');
+        if (slash) *slash = '\0';
+        int fd = open(slash ? dir : ".", O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+        if (fd >= 0) return fd;
+    }
+    return memfd_create("ss-cold", MFD_CLOEXEC);
+}
+
+int cold_open_content(int fd, const char* path, off_t* size, bool* was_cold) {
+    if (was_cold) *was_cold = false;
+
+    off_t raw_size;
+    if (!cold_file_detect(fd, &raw_size)) {
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            close(fd);
+            return -1;
+        }
+        *size = st.st_size;
+        return fd;
+    }
+
+    ColdFile cold;
+    if (cold_file_open(&cold, fd) < 0) return -1;
+
+    int out = anonymous_file(path, cold.header.raw_size);
+    int result = out >= 0 ? 0 : -1;
+    for (uint64_t i = 0; result == 0 && i < cold.header.block_count; i++) {
+        if (load_block(&cold, i) < 0 ||
+            ss_io_pwrite_all(out, cold.block, block_raw_len(&cold.header, i),
+                             (off_t)(i * cold.header.block_size)) < 0) {
+            result = -1;
+        }
+    }
+    cold_file_close(&cold);
+
+    if (result < 0) {
+        if (out >= 0) close(out);
+        return -1;
+    }
+    *size = raw_size;
+    if (was_cold) *was_cold = true;
+    return out;
+}
+
+// fopencookie stream over a cold file
+typedef struct {
+    ColdFile cold;
+    off_t pos;
+} ColdStream;
+
+static ssize_t cold_stream_read(void* cookie, char* buf, size_t size) {
+    ColdStream* stream = (ColdStream*)cookie;
+    ssize_t n = cold_file_pread(&stream->cold, buf, size, stream->pos);
+    if (n > 0) stream->pos += n;
+    return n;
+}
+
+static int cold_stream_close(void* cookie) {
+    ColdStream* stream = (ColdStream*)cookie;
+    cold_file_close(&stream->cold);
+    free(stream);
+    return 0;
+}
+
+FILE* cold_fopen(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    if (!cold_file_detect(fd, NULL)) {
+        FILE* fp = fdopen(fd, "r");
+        if (!fp) close(fd);
+        return fp;
+    }
+
+    ColdStream* stream = calloc(1, sizeof(ColdStream));
+    if (!stream) {
+        close(fd);
+        return NULL;
+    }
+    if (cold_file_open(&stream->cold, fd) < 0) {
+        free(stream);
+        return NULL;
+    }
+    cookie_io_functions_t io = { .read = cold_stream_read, .close = cold_stream_close };
+    FILE* fp = fopencookie(stream, "r", io);
+    if (!fp) cold_stream_close(stream);
+    return fp;
+}
+
+int cold_content_size(const char* path, off_t* size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    int result = 0;
+    if (!cold_file_detect(fd, size)) {
+        if (fstat(fd, &st) < 0) result = -1;
+        else *size = st.st_size;
+    }
+    close(fd);
+    return result;
+}
+
+/* ===============================================
+ * FREEZING
+ * =============================================== */
+
+// Replaces path with what fd holds, keeping the modification time
+static int replace_keeping_mtime(const char* path, const char* tmp_path, int tmp_fd,
+                                 const struct stat* original) {
+    struct timespec times[2] = { original->st_atim, original->st_mtim };
+    if (fchmod(tmp_fd, original->st_mode & 07777) < 0 || futimens(tmp_fd, times) < 0 ||
+        ss_io_write_and_sync(tmp_fd, NULL, 0) < 0 || ss_io_rename(tmp_path, path) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Writes the cold form of src_fd's size bytes to out_fd; returns the
+// file size written, -1 on error
+static off_t write_cold_file(int src_fd, uint64_t size, int out_fd) {
+    ColdHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COLD_MAGIC, sizeof(header.magic));
+    header.format = COLD_FORMAT;
+    header.block_size = COLD_BLOCK_SIZE;
+    header.raw_size = size;
+    header.block_count = (uint32_t)((size + COLD_BLOCK_SIZE - 1) / COLD_BLOCK_SIZE);
+
+    size_t index_size = (size_t)header.block_count * sizeof(ColdBlock);
+    ColdBlock* index = calloc(header.block_count ? header.block_count : 1, sizeof(ColdBlock));
+    int raw_slot = -1;
+    char* raw = COLD_BLOCK_SIZE <= SS_IO_FIXED_BUFFER_SIZE ? ss_io_buffer_get(&raw_slot) : NULL;
+    if (!raw) raw = malloc(COLD_BLOCK_SIZE);
+    size_t bound = compress_bound(COLD_BLOCK_SIZE);
+    char* packed = malloc(bound);
+    off_t pos = (off_t)(sizeof(ColdHeader) + index_size);
+    int result = index && raw && packed ? 0 : -1;
+
+    for (uint32_t i = 0; result == 0 && i < header.block_count; i++) {
+        size_t raw_len = block_raw_len(&header, i);
+        if (ss_io_pread_all(src_fd, raw, raw_len, (off_t)i * COLD_BLOCK_SIZE) != (ssize_t)raw_len) {
+            result = -1;
+            break;
+        }
+        header.raw_crc = crc32c(header.raw_crc, raw, raw_len);
+
+        // Blocks that don't shrink are stored as they are
+        size_t packed_len = compress_block(raw, raw_len, packed, bound);
+        const char* stored = packed;
+        if (packed_len == 0 || packed_len >= raw_len) {
+            stored = raw;
+            packed_len = raw_len;
+        }
+        index[i].offset = (uint64_t)pos;
+        index[i].stored_len = (uint32_t)packed_len;
+        index[i].crc = crc32c(0, stored, packed_len);
+        if (ss_io_pwrite_all(out_fd, stored, packed_len, pos) < 0) result = -1;
+        pos += (off_t)packed_len;
+    }
+
+    if (result == 0) {
+        header.index_crc = crc32c(0, index, index_size);
+        header.header_crc = header_crc(&header);
+        if (ss_io_pwrite_all(out_fd, index, index_size, sizeof(ColdHeader)) < 0 ||
+            ss_io_pwrite_all(out_fd, &header, sizeof(header), 0) < 0) {
+            result = -1;
+        }
+    }
+
+    free(index);
+    if (raw_slot >= 0) ss_io_buffer_put(raw_slot);
+    else free(raw);
+    free(packed);
+    return result < 0 ? -1 : pos;
+}
+
+int cold_freeze_file(ColdFreezer* freezer, FileEntry* entry) {
+    if (!freezer || !entry || entry->is_directory || entry->removed) return 0;
+
+    StorageServerState* state = freezer->state;
+    FileSnapshot snap;
+    if (open_file_snapshot(state, entry, &snap) != ERR_SUCCESS) return -1;
+
+    // Already cold, or nothing worth compressing
+    struct stat st;
+    if (snap.cold || snap.size == 0 || fstat(snap.fd, &st) < 0) {
+        close_file_snapshot(&snap);
+        return 0;
+    }
+
+    char tmp_path[MAX_PATH_LEN + 32];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.cold.XXXXXX", entry->full_path);
+    int tmp_fd = mkstemp(tmp_path);
+    if (tmp_fd < 0) {
+        close_file_snapshot(&snap);
+        return -1;
+    }
+
+    off_t stored_size = write_cold_file(snap.fd, (uint64_t)snap.size, tmp_fd);
+    close_file_snapshot(&snap);
+
+    int result = 0;
+    if (stored_size < 0) {
+        result = -1;
+    } else if (stored_size <= snap.size - snap.size * COLD_MIN_SAVINGS_PCT / 100) {
+        // Swap it in only if nobody committed meanwhile
+        pthread_mutex_t* commit_mutex = registry_commit_mutex(&state->registry, entry);
+        pthread_mutex_lock(commit_mutex);
+        if (!entry->removed && entry->version == snap.version) {
+            if (replace_keeping_mtime(entry->full_path, tmp_path, tmp_fd, &st) == 0) {
+                entry->file_size = stored_size;
+                struct stat cold_st;
+                if (fstat(tmp_fd, &cold_st) == 0) {
+                    __atomic_store_n(&entry->inode, cold_st.st_ino, __ATOMIC_RELEASE);
+                }
+                // Same version, new inode: let go of the raw one
+                fd_cache_invalidate(&state->fd_cache, entry->file_id, snap.version + 1);
+                result = 1;
+            } else {
+                result = -1;
+            }
+        }
+        pthread_mutex_unlock(commit_mutex);
+    }
+    close(tmp_fd);
+    if (result != 1) unlink(tmp_path);
+
+    if (result == 1) {
+        pthread_mutex_lock(&freezer->mutex);
+        freezer->frozen++;
+        freezer->bytes_before += (uint64_t)snap.size;
+        freezer->bytes_after += (uint64_t)stored_size;
+        pthread_mutex_unlock(&freezer->mutex);
+
+        char log_msg[MAX_PATH_LEN + 64];
+        snprintf(log_msg, sizeof(log_msg), "%s - %lld -> %lld bytes", entry->filepath,
+                 (long long)snap.size, (long long)stored_size);
+        log_message("SS", "0.0.0.0", state->client_port, "system", "FREEZE", log_msg,
+                   "SUCCESS");
+    }
+    return result;
+}
+
+typedef struct {
+    FileEntry** entries;
+    size_t count;
+    size_t capacity;
+    time_t cutoff;
+} CandidateList;
+
+static bool collect_candidate(FileEntry* entry, void* arg) {
+    CandidateList* list = (CandidateList*)arg;
+    uint64_t version = __atomic_load_n(&entry->version, __ATOMIC_ACQUIRE);
+    if (entry->is_directory || entry->modified_at > list->cutoff ||
+        entry->cold_checked == version) {
+        return true;
+    }
+
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 256;
+        FileEntry** entries = realloc(list->entries, capacity * sizeof(FileEntry*));
+        if (!entries) return false;
+        list->entries = entries;
+        list->capacity = capacity;
+    }
+    file_entry_acquire(entry);
+    list->entries[list->count++] = entry;
+    return true;
+}
+
+int cold_freezer_pass(ColdFreezer* freezer) {
+    if (!freezer) return 0;
+
+    CandidateList list = {0};
+    list.cutoff = time(NULL) - freezer->min_age_sec;
+    registry_foreach(&freezer->state->registry, collect_candidate, &list);
+
+    // The thread's passes end early at shutdown
+    bool stopping = false;
+    int frozen = 0;
+    for (size_t i = 0; i < list.count; i++) {
+        FileEntry* entry = list.entries[i];
+        if (freezer->started && !freezer->running) stopping = true;
+        if (!stopping) {
+            // Each version is looked at once, frozen or not
+            uint64_t version = __atomic_load_n(&entry->version, __ATOMIC_ACQUIRE);
+            if (cold_freeze_file(freezer, entry) == 1) frozen++;
+            entry->cold_checked = version;
+        }
+        file_entry_release(entry);
+    }
+    free(list.entries);
+
+    // Frozen files have new stats; save them so a restart trusts them
+    if (frozen > 0) meta_store_save(&freezer->state->meta_store, freezer->state);
+    return frozen;
+}
+
+static void* freezer_thread_func(void* arg) {
+    ColdFreezer* freezer = (ColdFreezer*)arg;
+
+    pthread_mutex_lock(&freezer->mutex);
+    while (freezer->running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += COLD_SCAN_INTERVAL_SEC;
+
+        pthread_cond_timedwait(&freezer->cond, &freezer->mutex, &deadline);
+        if (!freezer->running) break;
+
+        pthread_mutex_unlock(&freezer->mutex);
+        cold_freezer_pass(freezer);
+        pthread_mutex_lock(&freezer->mutex);
+    }
+    pthread_mutex_unlock(&freezer->mutex);
+
+    return NULL;
+}
+
+void cold_freezer_init(ColdFreezer* freezer, StorageServerState* state, int min_age_sec) {
+    memset(freezer, 0, sizeof(ColdFreezer));
+    pthread_mutex_init(&freezer->mutex, NULL);
+    pthread_cond_init(&freezer->cond, NULL);
+    freezer->state = state;
+    freezer->min_age_sec = min_age_sec;
+}
+
+void cold_freezer_destroy(ColdFreezer* freezer) {
+    cold_freezer_stop(freezer);
+    pthread_mutex_destroy(&freezer->mutex);
+    pthread_cond_destroy(&freezer->cond);
+}
+
+int cold_freezer_start(ColdFreezer* freezer) {
+    if (!freezer) return -1;
+
+    pthread_mutex_lock(&freezer->mutex);
+    freezer->running = true;
+    pthread_mutex_unlock(&freezer->mutex);
+
+    if (pthread_create(&freezer->thread, NULL, freezer_thread_func, freezer) != 0) {
+        freezer->running = false;
+        return -1;
+    }
+    freezer->started = true;
+    return 0;
+}
+
+void cold_freezer_stop(ColdFreezer* freezer) {
+    if (!freezer || !freezer->started) return;
+
+    pthread_mutex_lock(&freezer->mutex);
+    freezer->running = false;
+    pthread_cond_signal(&freezer->cond);
+    pthread_mutex_unlock(&freezer->mutex);
+
+    pthread_join(freezer->thread, NULL);
+    freezer->started = false;
+}
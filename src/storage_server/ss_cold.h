@@ -0,0 +1,169 @@
+#ifndef SS_COLD_H
+#define SS_COLD_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#define COLD_MAGIC "\x89SSCOLD\n"        // 8 bytes; can't start a text document
+#define COLD_FORMAT 1
+#define COLD_BLOCK_SIZE (64 * 1024)
+#define COLD_FREEZE_AGE_SEC (24 * 3600)  // Files not written for this long are compressed
+#define COLD_SCAN_INTERVAL_SEC 600
+#define COLD_MIN_SAVINGS_PCT 10          // Keep files raw unless this much is saved
+#define COLD_MEMFD_MAX (16 * 1024 * 1024) // Larger files are expanded on disk, not in memory
+
+typedef struct StorageServerState StorageServerState;
+struct FileEntry;
+
+/**
+ * Cold File Header
+ * A cold file holds its content as independently compressed blocks of
+ * COLD_BLOCK_SIZE (LZ4 block format), located through an index that
+ * follows the header, so any byte range can be read by expanding only
+ * the blocks it covers.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t format;
+    uint32_t block_size;
+    uint64_t raw_size;               // Content size
+    uint32_t raw_crc;                // CRC32C of the content
+    uint32_t block_count;
+    uint32_t index_crc;              // CRC32C of the index
+    uint32_t header_crc;             // Over the fields above
+} ColdHeader;
+
+/**
+ * Cold Block Index Entry
+ * A block stored as long as its content is kept uncompressed.
+ */
+typedef struct {
+    uint64_t offset;                 // Position of the stored block in the file
+    uint32_t stored_len;
+    uint32_t crc;                    // CRC32C of the stored bytes
+} ColdBlock;
+
+/**
+ * Cold File
+ * An open cold file: header and index in memory, blocks read on demand.
+ * The most recently expanded block is kept for sequential readers.
+ */
+typedef struct {
+    int fd;                          // Owned
+    ColdHeader header;
+    ColdBlock* index;
+    char* block;                     // Last expanded block
+    long block_no;                   // Its number, -1 if none
+    char* stored;                    // Read buffer for stored blocks
+} ColdFile;
+
+/**
+ * Check whether an open file is in cold format
+ * @param fd Open file
+ * @param raw_size Content size if cold (output, may be NULL)
+ * @return true if cold
+ */
+bool cold_file_detect(int fd, off_t* raw_size);
+
+/**
+ * Open a cold file (takes ownership of fd, also on failure)
+ * @return 0 on success, -1 if fd isn't a valid cold file
+ */
+int cold_file_open(ColdFile* cold, int fd);
+void cold_file_close(ColdFile* cold);
+
+/**
+ * Read content bytes, expanding only the blocks the range covers
+ * @return Bytes read (short at end of content), -1 on error or corruption
+ */
+ssize_t cold_file_pread(ColdFile* cold, void* buf, size_t len, off_t offset);
+
+/**
+ * Send the content as wire frames (see compress.h) straight from the
+ * stored blocks, without expanding or recompressing them
+ * The receiver checks each frame's CRC.
+ * @param cold Open cold file
+ * @param sock Socket
+ * @return Bytes sent, -1 on error
+ */
+long long cold_file_send_frames(ColdFile* cold, int sock);
+
+/**
+ * Turn an open descriptor into one that reads the content
+ * Raw files are returned as is. Cold files are expanded into an anonymous
+ * file (in memory when small, otherwise unlinked beside path) and fd is
+ * closed.
+ * @param fd Open file (consumed)
+ * @param path Path of the file (where large files are expanded)
+ * @param size Content size (output)
+ * @param was_cold Set when the file was cold (output, may be NULL)
+ * @return Descriptor, -1 on error
+ */
+int cold_open_content(int fd, const char* path, off_t* size, bool* was_cold);
+
+/**
+ * fopen(path, "r") that reads the content of cold files
+ * @return Stream, NULL on error
+ */
+FILE* cold_fopen(const char* path);
+
+/**
+ * Content size of a file, cold or raw
+ * @return 0 on success, -1 on error
+ */
+int cold_content_size(const char* path, off_t* size);
+
+/**
+ * Freezer
+ * Background thread that compresses files not written for min_age_sec.
+ * Freezing doesn't change a file's content or version: a commit writes
+ * the file raw again, and readers see the same bytes either way.
+ */
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    StorageServerState* state;
+    pthread_t thread;
+    bool running;
+    bool started;
+    int min_age_sec;
+
+    // Statistics
+    uint64_t frozen;                 // Files compressed
+    uint64_t bytes_before;
+    uint64_t bytes_after;
+} ColdFreezer;
+
+/**
+ * Initialize / destroy the freezer
+ * Destroy stops the thread.
+ */
+void cold_freezer_init(ColdFreezer* freezer, StorageServerState* state, int min_age_sec);
+void cold_freezer_destroy(ColdFreezer* freezer);
+
+/**
+ * Start / stop the background thread
+ * @return 0 on success, -1 on error
+ */
+int cold_freezer_start(ColdFreezer* freezer);
+void cold_freezer_stop(ColdFreezer* freezer);
+
+/**
+ * Compress every eligible file now
+ * @return Number of files frozen
+ */
+int cold_freezer_pass(ColdFreezer* freezer);
+
+/**
+ * Compress one file if it's raw and compresses well enough
+ * @param freezer Freezer (statistics)
+ * @param entry Registered file
+ * @return 1 if frozen, 0 if left alone, -1 on error
+ */
+int cold_freeze_file(ColdFreezer* freezer, struct FileEntry* entry);
+
+#endif // SS_COLD_H
@@ -0,0 +1,668 @@
+#include "ss_conn.h"
+#include "ss_server.h"
+#include "ss_transfer.h"
+#include "../common/utils.h"
+#include "../common/logger.h"
+#include "../common/error_codes.h"
+#include "../common/hash_utils.h"
+#include "../common/metrics.h"
+#include "../common/trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+/* ===============================================
+ * SESSION LIFECYCLE
+ * =============================================== */
+
+static void arm_session(ConnServer* server, ClientSession* session) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    ev.data.ptr = session;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, session->fd, &ev);
+}
+
+static void close_session(ConnServer* server, ClientSession* session) {
+    // Locks are keyed by fd, so drop them before the fd can be reused
+    if (session->write) write_session_abort(server->state, session->write);
+    release_all_locks_for_client(server->state, session->fd);
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, session->fd, NULL);
+    close(session->fd);
+
+    pthread_mutex_lock(&server->sessions_mutex);
+    if (session->prev) {
+        session->prev->next = session->next;
+    } else {
+        server->sessions = session->next;
+    }
+    if (session->next) session->next->prev = session->prev;
+    server->session_count--;
+    pthread_mutex_unlock(&server->sessions_mutex);
+
+    free(session);
+}
+
+static void accept_connections(ConnServer* server, int listen_fd, bool is_peer_ss) {
+    for (;;) {
+        struct sockaddr_in addr;
+        socklen_t len = sizeof(addr);
+        int fd = accept(listen_fd, (struct sockaddr*)&addr, &len);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("accept");
+            break;
+        }
+
+        ClientSession* session = calloc(1, sizeof(ClientSession));
+        if (!session) {
+            close(fd);
+            continue;
+        }
+        session->fd = fd;
+        session->is_peer_ss = is_peer_ss;
+        session->server = server;
+        inet_ntop(AF_INET, &addr.sin_addr, session->peer_ip, sizeof(session->peer_ip));
+        session->peer_port = ntohs(addr.sin_port);
+
+        // Requests are small lines; replies go out as soon as they're written
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        struct timeval tv = { CONN_SEND_TIMEOUT_SEC, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        if (is_peer_ss) {
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        }
+
+        pthread_mutex_lock(&server->sessions_mutex);
+        session->next = server->sessions;
+        if (server->sessions) server->sessions->prev = session;
+        server->sessions = session;
+        server->session_count++;
+        server->accepted++;
+        pthread_mutex_unlock(&server->sessions_mutex);
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+        ev.data.ptr = session;
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close_session(server, session);
+        }
+    }
+}
+
+/* ===============================================
+ * REQUEST DISPATCH
+ * =============================================== */
+
+static void send_status(int fd, int result) {
+    switch (result) {
+        case ERR_SUCCESS:
+            send_all(fd, "SUCCESS\n", 8);
+            break;
+        case ERR_FILE_NOT_FOUND:
+            send_all(fd, "ERROR:FILE_NOT_FOUND\n", 21);
+            break;
+        case ERR_FILE_EXISTS:
+            send_all(fd, "ERROR:FILE_EXISTS\n", 18);
+            break;
+        case ERR_FILE_LOCKED:
+            send_all(fd, "ERROR:FILE_LOCKED\n", 18);
+            break;
+        case ERR_CONNECTION_FAILED:
+            send_all(fd, "ERROR:CONNECTION_FAILED\n", 24);
+            break;
+        case ERR_UNAUTHORIZED_ACCESS:
+            send_all(fd, "ERROR:UNAUTHORIZED_ACCESS\n", 26);
+            break;
+        default:
+            send_all(fd, "ERROR:OPERATION_FAILED\n", 23);
+            break;
+    }
+}
+
+// Records a finished request in the latency metrics and, if one is open,
+// the binary request log
+static void request_done(ClientSession* session, const char* cmd, uint64_t file_id,
+                         const TraceSpan* span, uint64_t start_us, int status, size_t bytes) {
+    uint64_t elapsed = metrics_now_us() - start_us;
+    metrics_record(metric_from_command(cmd), elapsed, status != ERR_SUCCESS);
+    if (!logger_binary_enabled()) return;
+
+    LogRecord record;
+    memset(&record, 0, sizeof(record));
+    record.component = LOG_COMP_SS;
+    record.op = (uint8_t)log_op_from_name(cmd);
+    record.user_id = session->user_id;
+    record.file_id = file_id;
+    record.trace_id = span->trace_id;
+    record.latency_us = elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed;
+    record.lock_wait_us = (uint32_t)span->stage_us[TRACE_STAGE_LOCK_WAIT];
+    record.disk_us = (uint32_t)span->stage_us[TRACE_STAGE_DISK];
+    record.status = (uint16_t)status;
+    record.bytes = bytes > UINT32_MAX ? UINT32_MAX : (uint32_t)bytes;
+    log_request(&record);
+}
+
+static void conn_stream_done(int client_fd, int status, void* arg) {
+    (void)client_fd;
+    ClientSession* session = (ClientSession*)arg;
+    ConnServer* server = session->server;
+    TraceSpan span;
+    memset(&span, 0, sizeof(span));
+    span.trace_id = session->stream_trace_id;
+    request_done(session, "STREAM", session->stream_file_id, &span, session->stream_start_us,
+                 status, 0);
+
+    // Hand the session back to a worker through the ready queue
+    pthread_mutex_lock(&server->sessions_mutex);
+    session->streaming = false;
+    session->closing = (status != ERR_SUCCESS);
+    session->ready_next = server->ready_head;
+    server->ready_head = session;
+    pthread_mutex_unlock(&server->sessions_mutex);
+
+    uint64_t one = 1;
+    if (write(server->wake_fd, &one, sizeof(one)) < 0) {
+        perror("eventfd write");
+    }
+}
+
+// Runs a request on one file, filling in what the request log records
+// Returns 1 to keep the session, 0 to close it, 2 if it is streaming
+// Creating, deleting, copying and reverting files is for the NM, which
+// checks ownership and access first, and for peer storage servers; the NM
+// is recognised by the address it was configured with
+static bool session_may_manage_files(StorageServerState* state, ClientSession* session) {
+    return session->is_peer_ss || strcmp(session->peer_ip, state->nm_ip) == 0;
+}
+
+static int dispatch_file_request(ConnServer* server, ClientSession* session, char* cmd,
+                                 char* path, char* save, int* status, size_t* bytes) {
+    StorageServerState* state = server->state;
+    int fd = session->fd;
+
+    if ((strcmp(cmd, "CREATE") == 0 || strcmp(cmd, "DELETE") == 0 ||
+         strcmp(cmd, "COPY") == 0 || strcmp(cmd, "REVERT") == 0) &&
+        !session_may_manage_files(state, session)) {
+        *status = ERR_UNAUTHORIZED_ACCESS;
+        send_status(fd, *status);
+        return 1;
+    }
+
+    if (strcmp(cmd, "READ") == 0) {
+        // A failed body send leaves the stream unframed; drop the session
+        *status = handle_read_request(state, fd, path, session->codec, bytes);
+        return *status == ERR_CONNECTION_FAILED ? 0 : 1;
+    }
+    if (strcmp(cmd, "WRITE") == 0) {
+        // "WRITE <file> <sentence> [WAIT=<ms>] [content]"
+        char* idx = strtok_r(NULL, " ", &save);
+        char* content = save;
+        if (!idx) {
+            send_all(fd, "ERROR:INVALID_ARGS\n", 19);
+            *status = ERR_INVALID_OPERATION;
+            return 1;
+        }
+        int wait_ms = -1;
+        if (content && strncmp(content, "WAIT=", 5) == 0) {
+            char* end = NULL;
+            long value = strtol(content + 5, &end, 10);
+            if (end == content + 5 || value < 0 || (*end != ' ' && *end != '\0')) {
+                send_all(fd, "ERROR:INVALID_ARGS\n", 19);
+                *status = ERR_INVALID_OPERATION;
+                return 1;
+            }
+            wait_ms = value > LOCK_WAIT_MAX_MS ? LOCK_WAIT_MAX_MS : (int)value;
+            content = *end == ' ' ? end + 1 : end;
+        }
+        // Without content, a session of word inserts ending with ETIRW
+        if (!content || *content == '\0') {
+            if (session->write) {
+                send_all(fd, "ERROR:WRITE_IN_PROGRESS\n", 24);
+                *status = ERR_INVALID_OPERATION;
+            } else {
+                session->write = handle_write_begin(state, fd, path, atoi(idx), wait_ms);
+                if (!session->write) *status = ERR_FILE_LOCKED;
+            }
+            return 1;
+        }
+        *bytes = strlen(content);
+        *status = handle_write_request(state, fd, path, atoi(idx), content, wait_ms);
+        return 1;
+    }
+    if (strcmp(cmd, "INFO") == 0) {
+        *status = handle_info_request(state, fd, path);
+        return 1;
+    }
+    if (strcmp(cmd, "STREAM") == 0) {
+        session->streaming = true;
+        *status = handle_stream_request(state, fd, path, conn_stream_done, session);
+        if (*status == ERR_SUCCESS) return 2;
+        session->streaming = false;
+        return 1;
+    }
+    if (strcmp(cmd, "CREATE") == 0) {
+        *status = handle_create_request(state, path);
+        send_status(fd, *status);
+        return 1;
+    }
+    if (strcmp(cmd, "DELETE") == 0) {
+        *status = handle_delete_request(state, path);
+        send_status(fd, *status);
+        return 1;
+    }
+    if (strcmp(cmd, "COPY") == 0) {
+        char* ip = strtok_r(NULL, " ", &save);
+        char* port = strtok_r(NULL, " ", &save);
+        if (!ip || !port) {
+            send_all(fd, "ERROR:INVALID_ARGS\n", 19);
+            *status = ERR_INVALID_OPERATION;
+            return 1;
+        }
+        *status = handle_copy_request(state, path, ip, atoi(port));
+        send_status(fd, *status);
+        return 1;
+    }
+    if (strcmp(cmd, "LISTCHECKPOINTS") == 0) {
+        *status = handle_listcheckpoints_request(state, fd, path);
+        return 1;
+    }
+
+    char* tag = strtok_r(NULL, " ", &save);
+    if (strcmp(cmd, "CHECKPOINT") == 0 || strcmp(cmd, "VIEWCHECKPOINT") == 0 ||
+        strcmp(cmd, "REVERT") == 0) {
+        if (!tag) {
+            send_all(fd, "ERROR:INVALID_ARGS\n", 19);
+            *status = ERR_INVALID_OPERATION;
+        } else if (cmd[0] == 'C') {
+            *status = handle_checkpoint_request(state, fd, path, tag);
+        } else if (cmd[0] == 'V') {
+            *status = handle_viewcheckpoint_request(state, fd, path, tag);
+        } else {
+            *status = handle_revert_request(state, fd, path, tag);
+        }
+        return 1;
+    }
+
+    send_all(fd, "ERROR:UNKNOWN_COMMAND\n", 22);
+    *status = ERR_INVALID_OPERATION;
+    return 1;
+}
+
+int conn_dispatch_line(ConnServer* server, ClientSession* session, char* line) {
+    StorageServerState* state = server->state;
+    int fd = session->fd;
+
+    size_t len = strlen(line);
+    if (len > 0 && line[len - 1] == '\r') line[--len] = '\0';
+    if (len == 0) return 1;
+
+    // "TRACE=<id> " ahead of a request carries the client's trace ID
+    uint64_t trace_id = 0;
+    if (strncmp(line, TRACE_TOKEN, strlen(TRACE_TOKEN)) == 0) {
+        char* rest = strchr(line, ' ');
+        trace_parse(line, &trace_id);
+        if (!rest) return 1;
+        line = rest + 1;
+        if (*line == '\0') return 1;
+    }
+
+    // Replication stream from a primary SS; the connection stays open
+    if (session->is_peer_ss && strncmp(line, "REPL_", 5) == 0) {
+        return repl_handle_peer_line(&state->replication, fd, line, session->inbuf,
+                                     &session->inlen) < 0 ? 0 : 1;
+    }
+
+    // Chunked file transfer from another SS; one file per connection
+    if (session->is_peer_ss && strncmp(line, "COPY_BEGIN ", 11) == 0) {
+        transfer_receive(state, fd, line, session->inbuf, &session->inlen);
+        return 0;
+    }
+
+    // Lines of an open WRITE session: "<word_index> <content>" or pipelined
+    // "OP <seq> ..." edits, SYNC, and "ETIRW" to commit
+    if (session->write && strncmp(line, "OP ", 3) == 0) {
+        handle_write_op(state, session->write, line);
+        return 1;
+    }
+    if (session->write && strcmp(line, "SYNC") == 0) {
+        handle_write_sync(session->write);
+        return 1;
+    }
+    if (session->write && (strcmp(line, "ETIRW") == 0 || line[0] == '-' ||
+                           (line[0] >= '0' && line[0] <= '9'))) {
+        if (line[0] == 'E') {
+            uint64_t file_id = ss_file_id(session->write->filepath);
+            size_t bytes = session->write->edit.len;
+            uint64_t start = metrics_now_us();
+            trace_begin(trace_id ? trace_id : session->write_trace_id);
+            int status = handle_write_end(state, session->write);
+            session->write = NULL;
+            TraceSpan span;
+            trace_end(&span);
+            request_done(session, "ETIRW", file_id, &span, start, status, bytes);
+        } else if (handle_write_edit(state, session->write, line) == ERR_FILE_LOCKED) {
+            write_session_abort(state, session->write);
+            session->write = NULL;
+        }
+        return 1;
+    }
+
+    // WRITE keeps everything after the sentence index verbatim
+    char* save = NULL;
+    char* cmd = strtok_r(line, " ", &save);
+    if (!cmd) return 1;
+    char* path = strtok_r(NULL, " ", &save);
+
+    session->requests++;
+    pthread_mutex_lock(&server->sessions_mutex);
+    server->requests++;
+    pthread_mutex_unlock(&server->sessions_mutex);
+
+    if (strcmp(cmd, "PING") == 0) {
+        send_all(fd, "PONG\n", 5);
+        return 1;
+    }
+    if (strcmp(cmd, "QUIT") == 0) {
+        return 0;
+    }
+    if (strcmp(cmd, "HELLO") == 0) {
+        // HELLO COMPRESS=lz4,zstd: the first offered codec we implement;
+        // USER=<name> tags this session's requests in the request log
+        session->codec = COMPRESS_NONE;
+        for (char* opt = path; opt; opt = strtok_r(NULL, " ", &save)) {
+            if (strncmp(opt, "COMPRESS=", 9) == 0) session->codec = compress_negotiate(opt + 9);
+            if (strncmp(opt, "USER=", 5) == 0) session->user_id = fnv1a_64(opt + 5, strlen(opt + 5));
+        }
+        char reply[64];
+        int len = snprintf(reply, sizeof(reply), "SUCCESS\nCOMPRESS:%s\n",
+                           compress_codec_name(session->codec));
+        send_all(fd, reply, (size_t)len);
+        return 1;
+    }
+    if (strcmp(cmd, "STATS") == 0) {
+        // Latency per operation since startup, one metric per line, then
+        // the lock table's counters
+        char* reply = malloc(METRICS_TEXT_MAX);
+        if (!reply) {
+            send_all(fd, "ERROR:OPERATION_FAILED\n", 23);
+            return 1;
+        }
+        memcpy(reply, "SUCCESS\n", 8);
+        int len = 8 + metrics_format_stats(reply + 8, METRICS_TEXT_MAX - 8);
+        len += lock_table_format_stats(&state->lock_table, reply + len,
+                                       METRICS_TEXT_MAX - (size_t)len);
+        send_all(fd, reply, (size_t)len);
+        free(reply);
+        return 1;
+    }
+    if (strcmp(cmd, "COMPRESS_STATS") == 0) {
+        CompressStats* stats = &state->wire_stats;
+        unsigned long long raw = __atomic_load_n(&stats->raw_bytes, __ATOMIC_RELAXED);
+        unsigned long long wire = __atomic_load_n(&stats->wire_bytes, __ATOMIC_RELAXED);
+        char reply[256];
+        int len = snprintf(reply, sizeof(reply),
+                           "SUCCESS\nPAYLOADS:%llu\nPASSTHROUGH:%llu\nRAW_BYTES:%llu\n"
+                           "WIRE_BYTES:%llu\nSAVED_BYTES:%llu\n",
+                           (unsigned long long)__atomic_load_n(&stats->payloads, __ATOMIC_RELAXED),
+                           (unsigned long long)__atomic_load_n(&stats->passthrough, __ATOMIC_RELAXED),
+                           raw, wire, raw > wire ? raw - wire : 0ULL);
+        send_all(fd, reply, (size_t)len);
+        return 1;
+    }
+    if (strcmp(cmd, "REPL_STATUS") == 0) {
+        char status[1024];
+        int len = repl_format_status(&state->replication, status, sizeof(status));
+        send_all(fd, status, (size_t)len);
+        return 1;
+    }
+
+    if (!is_safe_filepath(path)) {
+        send_all(fd, "ERROR:INVALID_PATH\n", 19);
+        return 1;
+    }
+
+    int status = ERR_SUCCESS;
+    size_t bytes = 0;
+    uint64_t file_id = ss_file_id(path);
+    bool in_write = session->write != NULL;
+    uint64_t start = metrics_now_us();
+    trace_begin(trace_id);
+    int rc = dispatch_file_request(server, session, cmd, path, save, &status, &bytes);
+    TraceSpan span;
+    trace_end(&span);
+    if (!in_write && session->write) session->write_trace_id = trace_id;
+    if (rc == 2) {
+        // Timed until the stream engine reports the end
+        session->stream_file_id = file_id;
+        session->stream_trace_id = trace_id;
+        session->stream_start_us = start;
+        return rc;
+    }
+    request_done(session, cmd, file_id, &span, start, status, bytes);
+    return rc;
+}
+
+// Runs every complete line in the input buffer
+// Returns 1 to keep the session, 0 to close it, 2 if it is streaming
+static int process_input(ConnServer* server, ClientSession* session) {
+    for (;;) {
+        char* newline = memchr(session->inbuf, '\n', session->inlen);
+        if (!newline) break;
+
+        size_t line_len = (size_t)(newline - session->inbuf);
+        char line[CONN_LINE_MAX];
+        memcpy(line, session->inbuf, line_len);
+        line[line_len] = '\0';
+
+        // Shift first so handlers that consume raw input see only what follows
+        session->inlen -= line_len + 1;
+        memmove(session->inbuf, newline + 1, session->inlen);
+
+        int rc = conn_dispatch_line(server, session, line);
+        if (rc != 1) return rc;
+    }
+
+    if (session->inlen == sizeof(session->inbuf)) {
+        send_all(session->fd, "ERROR:LINE_TOO_LONG\n", 20);
+        return 0;
+    }
+    return 1;
+}
+
+static void handle_readable(ConnServer* server, ClientSession* session) {
+    for (;;) {
+        size_t space = sizeof(session->inbuf) - session->inlen;
+        ssize_t n = recv(session->fd, session->inbuf + session->inlen, space, MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            close_session(server, session);
+            return;
+        }
+        if (n == 0) {
+            close_session(server, session);
+            return;
+        }
+
+        session->inlen += (size_t)n;
+        int rc = process_input(server, session);
+        if (rc == 0) {
+            close_session(server, session);
+            return;
+        }
+        if (rc == 2) return;  // The stream engine calls back when done
+    }
+
+    arm_session(server, session);
+}
+
+static void drain_ready_queue(ConnServer* server) {
+    uint64_t count;
+    if (read(server->wake_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        perror("eventfd read");
+    }
+
+    pthread_mutex_lock(&server->sessions_mutex);
+    ClientSession* ready = server->ready_head;
+    server->ready_head = NULL;
+    pthread_mutex_unlock(&server->sessions_mutex);
+
+    while (ready) {
+        ClientSession* session = ready;
+        ready = ready->ready_next;
+
+        if (session->closing) {
+            close_session(server, session);
+            continue;
+        }
+
+        // Requests pipelined behind the STREAM may already be buffered
+        int rc = process_input(server, session);
+        if (rc == 0) {
+            close_session(server, session);
+        } else if (rc == 1) {
+            arm_session(server, session);
+        }
+    }
+}
+
+/* ===============================================
+ * WORKERS
+ * =============================================== */
+
+static void* conn_worker_func(void* arg) {
+    ConnServer* server = (ConnServer*)arg;
+    struct epoll_event events[CONN_MAX_EVENTS];
+
+    while (server->running) {
+        int n = epoll_wait(server->epoll_fd, events, CONN_MAX_EVENTS, 1000);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < n && server->running; i++) {
+            void* tag = events[i].data.ptr;
+
+            if (tag == &server->wake_fd) {
+                drain_ready_queue(server);
+            } else if (tag == &server->client_listen_fd || tag == &server->ss_listen_fd) {
+                int listen_fd = *(int*)tag;
+                accept_connections(server, listen_fd, tag == &server->ss_listen_fd);
+
+                struct epoll_event ev;
+                memset(&ev, 0, sizeof(ev));
+                ev.events = EPOLLIN | EPOLLONESHOT;
+                ev.data.ptr = tag;
+                epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, listen_fd, &ev);
+            } else {
+                handle_readable(server, (ClientSession*)tag);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+int conn_server_start(ConnServer* server, StorageServerState* state, int workers) {
+    if (!server || !state) return -1;
+
+    memset(server, 0, sizeof(ConnServer));
+    server->state = state;
+    server->client_listen_fd = state->client_listen_socket;
+    server->ss_listen_fd = state->ss_listen_socket;
+    pthread_mutex_init(&server->sessions_mutex, NULL);
+
+    server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    server->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (server->epoll_fd < 0 || server->wake_fd < 0) {
+        perror("conn_server_start");
+        if (server->epoll_fd >= 0) close(server->epoll_fd);
+        if (server->wake_fd >= 0) close(server->wake_fd);
+        return -1;
+    }
+
+    set_socket_nonblocking(server->client_listen_fd);
+    set_socket_nonblocking(server->ss_listen_fd);
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = &server->client_listen_fd;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->client_listen_fd, &ev);
+    ev.data.ptr = &server->ss_listen_fd;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->ss_listen_fd, &ev);
+
+    // Level-triggered on purpose: shutdown must wake every worker
+    ev.events = EPOLLIN;
+    ev.data.ptr = &server->wake_fd;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->wake_fd, &ev);
+
+    if (workers <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = (int)(cpus > 0 ? cpus : 1) * CONN_WORKERS_PER_CPU;
+        if (workers < CONN_MIN_WORKERS) workers = CONN_MIN_WORKERS;
+    }
+    if (workers > CONN_MAX_WORKERS) workers = CONN_MAX_WORKERS;
+
+    server->running = true;
+    for (int i = 0; i < workers; i++) {
+        if (pthread_create(&server->workers[i], NULL, conn_worker_func, server) != 0) {
+            break;
+        }
+        server->worker_count++;
+    }
+
+    if (server->worker_count == 0) {
+        server->running = false;
+        close(server->epoll_fd);
+        close(server->wake_fd);
+        return -1;
+    }
+
+    char log_msg[128];
+    snprintf(log_msg, sizeof(log_msg), "CONN_SERVER - %d workers", server->worker_count);
+    log_message("SS", "0.0.0.0", state->client_port, "system", "INIT", log_msg, "SUCCESS");
+
+    return 0;
+}
+
+void conn_server_stop(ConnServer* server) {
+    if (!server || server->worker_count == 0) return;
+
+    server->running = false;
+    uint64_t one = 1;
+    if (write(server->wake_fd, &one, sizeof(one)) < 0) {
+        perror("eventfd write");
+    }
+
+    for (int i = 0; i < server->worker_count; i++) {
+        pthread_join(server->workers[i], NULL);
+    }
+    server->worker_count = 0;
+
+    // Streaming sessions come back through the ready queue once aborted
+    stream_engine_stop(&server->state->stream_engine);
+
+    while (server->sessions) {
+        close_session(server, server->sessions);
+    }
+    server->ready_head = NULL;
+
+    close(server->epoll_fd);
+    close(server->wake_fd);
+    pthread_mutex_destroy(&server->sessions_mutex);
+}
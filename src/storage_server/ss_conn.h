@@ -0,0 +1,98 @@
+#ifndef SS_CONN_H
+#define SS_CONN_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../common/compress.h"
+
+#define CONN_MAX_WORKERS 128
+#define CONN_MIN_WORKERS 8
+#define CONN_WORKERS_PER_CPU 4           // Workers may block on lock waits
+#define CONN_MAX_EVENTS 64
+#define CONN_LINE_MAX 8192               // Longest request line
+#define CONN_SEND_TIMEOUT_SEC 30         // Stuck clients can't pin a worker
+
+typedef struct StorageServerState StorageServerState;
+
+/**
+ * Client Session
+ * One per accepted connection; persists across requests (keep-alive).
+ * A session is only ever handled by one worker at a time: it is armed
+ * in epoll with EPOLLONESHOT and re-armed after its lines are processed.
+ */
+typedef struct ClientSession {
+    int fd;
+    bool is_peer_ss;                 // Accepted on the SS-to-SS port
+    char peer_ip[16];
+    int peer_port;
+    char inbuf[CONN_LINE_MAX];       // Bytes received but not yet parsed
+    size_t inlen;
+    bool streaming;                  // Owned by the stream engine right now
+    uint64_t stream_file_id;         // STREAM being timed
+    uint64_t stream_trace_id;
+    uint64_t stream_start_us;
+    bool closing;                    // Stream ended badly; close when dequeued
+    CompressCodec codec;             // Negotiated by HELLO; none until then
+    uint64_t user_id;                // HELLO USER=<name> hashed; 0 if not given
+    struct WriteSession* write;      // Open WRITE session (sentence locked), or NULL
+    uint64_t write_trace_id;         // Trace of the WRITE that opened it
+    struct ConnServer* server;
+    uint64_t requests;
+    struct ClientSession* prev;      // All-sessions list (for shutdown)
+    struct ClientSession* next;
+    struct ClientSession* ready_next; // Ready queue after a stream ends
+} ClientSession;
+
+/**
+ * Connection Server
+ * Shared epoll set watched by a pool of workers; listening sockets are
+ * drained by whichever worker wakes for them
+ */
+typedef struct ConnServer {
+    StorageServerState* state;
+    int epoll_fd;
+    int wake_fd;                     // eventfd: shutdown and ready queue
+    int client_listen_fd;
+    int ss_listen_fd;
+
+    pthread_t workers[CONN_MAX_WORKERS];
+    int worker_count;
+    volatile bool running;
+
+    pthread_mutex_t sessions_mutex;  // Guards the session list and ready queue
+    ClientSession* sessions;
+    ClientSession* ready_head;
+    int session_count;
+
+    uint64_t accepted;               // Guarded by sessions_mutex
+    uint64_t requests;
+} ConnServer;
+
+/**
+ * Start serving the state's client and SS listening sockets
+ * @param server Connection server
+ * @param state Storage server state
+ * @param workers Worker threads (0 picks CONN_WORKERS_PER_CPU per CPU)
+ * @return 0 on success, -1 on error
+ */
+int conn_server_start(ConnServer* server, StorageServerState* state, int workers);
+
+/**
+ * Stop the workers and close every session (releasing its locks)
+ * @param server Connection server
+ */
+void conn_server_stop(ConnServer* server);
+
+/**
+ * Execute one request line for a session
+ * Exposed so the dispatcher can be driven without sockets in tests.
+ * @param server Connection server
+ * @param session Client session
+ * @param line Request line without the trailing newline
+ * @return 1 to keep the session, 0 to close it, 2 if handed to the stream engine
+ */
+int conn_dispatch_line(ConnServer* server, ClientSession* session, char* line);
+
+#endif // SS_CONN_H
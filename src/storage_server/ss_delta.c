@@ -0,0 +1,286 @@
+#include "ss_delta.h"
+#include "../common/hash_utils.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ===============================================
+ * SIGNATURES
+ * =============================================== */
+
+// rsync's checksum: a is the byte sum, b the sum of the running a values,
+// both mod 2^16, so a window can slide one byte in O(1)
+static uint32_t weak_checksum(const unsigned char* data, size_t len, uint32_t* a_out,
+                              uint32_t* b_out) {
+    uint32_t a = 0, b = 0;
+    for (size_t i = 0; i < len; i++) {
+        a += data[i];
+        b += a;
+    }
+    *a_out = a & 0xffff;
+    *b_out = b & 0xffff;
+    return *a_out | (*b_out << 16);
+}
+
+uint32_t delta_block_size(size_t basis_size) {
+    uint32_t block = DELTA_MIN_BLOCK;
+    while (block < DELTA_MAX_BLOCK && (uint64_t)block * block < basis_size) block *= 2;
+    return block;
+}
+
+char* delta_signatures(const char* basis, size_t basis_len, size_t* out_len) {
+    if (!basis && basis_len > 0) return NULL;
+
+    uint32_t block_size = delta_block_size(basis_len);
+    size_t block_count = basis_len / block_size;
+    size_t len = sizeof(DeltaSigHeader) + block_count * sizeof(DeltaBlockSig);
+    char* out = malloc(len);
+    if (!out) return NULL;
+
+    DeltaSigHeader* header = (DeltaSigHeader*)out;
+    header->magic = DELTA_SIG_MAGIC;
+    header->block_size = block_size;
+    header->basis_size = basis_len;
+    header->basis_crc = crc32c(0, basis, basis_len);
+    header->block_count = (uint32_t)block_count;
+
+    DeltaBlockSig* sigs = (DeltaBlockSig*)(header + 1);
+    for (size_t i = 0; i < block_count; i++) {
+        const char* block = basis + i * block_size;
+        uint32_t a, b;
+        sigs[i].weak = weak_checksum((const unsigned char*)block, block_size, &a, &b);
+        sigs[i].reserved = 0;
+        sigs[i].strong = fnv1a_64(block, block_size);
+    }
+
+    *out_len = len;
+    return out;
+}
+
+/* ===============================================
+ * ENCODING
+ * =============================================== */
+
+typedef struct {
+    char* data;
+    size_t len;
+    size_t capacity;
+} DeltaBuffer;
+
+static int buffer_append(DeltaBuffer* buf, const void* data, size_t len) {
+    if (buf->len + len > buf->capacity) {
+        size_t capacity = buf->capacity ? buf->capacity : 4096;
+        while (capacity < buf->len + len) capacity *= 2;
+        char* grown = realloc(buf->data, capacity);
+        if (!grown) return -1;
+        buf->data = grown;
+        buf->capacity = capacity;
+    }
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    return 0;
+}
+
+static int emit_literal(DeltaBuffer* buf, const char* data, size_t len) {
+    while (len > 0) {
+        uint32_t part = len > UINT32_MAX ? UINT32_MAX : (uint32_t)len;
+        if (buffer_append(buf, "L", 1) < 0 || buffer_append(buf, &part, 4) < 0 ||
+            buffer_append(buf, data, part) < 0) {
+            return -1;
+        }
+        data += part;
+        len -= part;
+    }
+    return 0;
+}
+
+static int emit_blocks(DeltaBuffer* buf, uint32_t first, uint32_t count) {
+    if (count == 0) return 0;
+    if (buffer_append(buf, "B", 1) < 0 || buffer_append(buf, &first, 4) < 0 ||
+        buffer_append(buf, &count, 4) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static const DeltaSigHeader* parse_signatures(const char* sigs, size_t sigs_len) {
+    if (!sigs || sigs_len < sizeof(DeltaSigHeader)) return NULL;
+    const DeltaSigHeader* header = (const DeltaSigHeader*)sigs;
+    if (header->magic != DELTA_SIG_MAGIC || header->block_size < DELTA_MIN_BLOCK ||
+        header->block_size > DELTA_MAX_BLOCK ||
+        sigs_len != sizeof(DeltaSigHeader) + (size_t)header->block_count * sizeof(DeltaBlockSig) ||
+        (uint64_t)header->block_count * header->block_size > header->basis_size) {
+        return NULL;
+    }
+    return header;
+}
+
+char* delta_encode(const char* sigs, size_t sigs_len, const char* target,
+                   size_t target_len, size_t* out_len) {
+    const DeltaSigHeader* sig_header = parse_signatures(sigs, sigs_len);
+    if (!sig_header || (!target && target_len > 0)) return NULL;
+
+    const DeltaBlockSig* blocks = (const DeltaBlockSig*)(sig_header + 1);
+    size_t block_count = sig_header->block_count;
+    size_t block_size = sig_header->block_size;
+
+    // Weak checksum -> block index + 1, open addressing
+    size_t slot_count = 16;
+    while (slot_count < block_count * 2) slot_count *= 2;
+    uint32_t* slots = calloc(slot_count, sizeof(uint32_t));
+    if (!slots) return NULL;
+    for (size_t i = 0; i < block_count; i++) {
+        size_t slot = hash_mix64(blocks[i].weak) & (slot_count - 1);
+        while (slots[slot]) slot = (slot + 1) & (slot_count - 1);
+        slots[slot] = (uint32_t)i + 1;
+    }
+
+    DeltaBuffer buf = {0};
+    DeltaHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = DELTA_MAGIC;
+    header.block_size = (uint32_t)block_size;
+    header.basis_size = sig_header->basis_size;
+    header.basis_crc = sig_header->basis_crc;
+    header.target_crc = crc32c(0, target, target_len);
+    header.target_size = target_len;
+    int result = buffer_append(&buf, &header, sizeof(header));
+
+    const unsigned char* data = (const unsigned char*)target;
+    size_t literal_start = 0;
+    uint32_t run_first = 0, run_count = 0;
+    size_t pos = 0;
+    uint32_t a = 0, b = 0;
+    bool have_window = false;
+
+    while (result == 0 && block_count > 0 && pos + block_size <= target_len) {
+        if (!have_window) {
+            weak_checksum(data + pos, block_size, &a, &b);
+            have_window = true;
+        }
+        uint32_t weak = a | (b << 16);
+
+        long match = -1;
+        uint64_t strong = 0;
+        bool strong_done = false;
+        for (size_t slot = hash_mix64(weak) & (slot_count - 1); slots[slot];
+             slot = (slot + 1) & (slot_count - 1)) {
+            const DeltaBlockSig* sig = &blocks[slots[slot] - 1];
+            if (sig->weak != weak) continue;
+            if (!strong_done) {
+                strong = fnv1a_64(data + pos, block_size);
+                strong_done = true;
+            }
+            if (sig->strong == strong) {
+                match = (long)(slots[slot] - 1);
+                // Prefer the block that extends the current run
+                if (run_count > 0 && (uint32_t)match == run_first + run_count) break;
+            }
+        }
+
+        if (match >= 0) {
+            if (literal_start < pos) {
+                if (emit_blocks(&buf, run_first, run_count) < 0 ||
+                    emit_literal(&buf, target + literal_start, pos - literal_start) < 0) {
+                    result = -1;
+                }
+                run_count = 0;
+            }
+            if (run_count > 0 && (uint32_t)match == run_first + run_count) {
+                run_count++;
+            } else {
+                if (emit_blocks(&buf, run_first, run_count) < 0) result = -1;
+                run_first = (uint32_t)match;
+                run_count = 1;
+            }
+            pos += block_size;
+            literal_start = pos;
+            have_window = false;
+            continue;
+        }
+
+        // Slide one byte
+        if (pos + block_size < target_len) {
+            uint32_t out_byte = data[pos], in_byte = data[pos + block_size];
+            a = (a - out_byte + in_byte) & 0xffff;
+            b = (b - (uint32_t)(block_size * out_byte) + a) & 0xffff;
+        }
+        pos++;
+    }
+
+    if (result == 0 &&
+        (emit_blocks(&buf, run_first, run_count) < 0 ||
+         (literal_start < target_len &&
+          emit_literal(&buf, target + literal_start, target_len - literal_start) < 0))) {
+        result = -1;
+    }
+
+    free(slots);
+    if (result < 0) {
+        free(buf.data);
+        return NULL;
+    }
+    *out_len = buf.len;
+    return buf.data;
+}
+
+/* ===============================================
+ * APPLYING
+ * =============================================== */
+
+char* delta_apply(const char* basis, size_t basis_len, const char* delta,
+                  size_t delta_len, size_t* out_len) {
+    if (!delta || delta_len < sizeof(DeltaHeader)) return NULL;
+
+    DeltaHeader header;
+    memcpy(&header, delta, sizeof(header));
+    if (header.magic != DELTA_MAGIC || header.basis_size != basis_len ||
+        header.block_size < DELTA_MIN_BLOCK || header.block_size > DELTA_MAX_BLOCK ||
+        header.target_size > SIZE_MAX - 1 ||
+        header.basis_crc != crc32c(0, basis, basis_len)) {
+        return NULL;
+    }
+
+    size_t target_size = (size_t)header.target_size;
+    char* out = malloc(target_size + 1);
+    if (!out) return NULL;
+
+    size_t block_count = basis_len / header.block_size;
+    size_t pos = sizeof(DeltaHeader);
+    size_t written = 0;
+    bool ok = true;
+    while (ok && pos < delta_len) {
+        char tag = delta[pos++];
+        uint32_t x, y;
+        if (tag == 'L' && delta_len - pos >= 4) {
+            memcpy(&x, delta + pos, 4);
+            pos += 4;
+            ok = x <= delta_len - pos && x <= target_size - written;
+            if (ok) {
+                memcpy(out + written, delta + pos, x);
+                pos += x;
+                written += x;
+            }
+        } else if (tag == 'B' && delta_len - pos >= 8) {
+            memcpy(&x, delta + pos, 4);
+            memcpy(&y, delta + pos + 4, 4);
+            pos += 8;
+            size_t bytes = (size_t)y * header.block_size;
+            ok = (uint64_t)x + y <= block_count && bytes <= target_size - written;
+            if (ok) {
+                memcpy(out + written, basis + (size_t)x * header.block_size, bytes);
+                written += bytes;
+            }
+        } else {
+            ok = false;
+        }
+    }
+
+    if (!ok || written != target_size || crc32c(0, out, written) != header.target_crc) {
+        free(out);
+        return NULL;
+    }
+    out[written] = '\0';
+    *out_len = written;
+    return out;
+}
@@ -0,0 +1,96 @@
+#ifndef SS_DELTA_H
+#define SS_DELTA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DELTA_SIG_MAGIC 0x47535353       // "SSSG"
+#define DELTA_MAGIC 0x4c445353           // "SSDL"
+#define DELTA_MIN_BLOCK 256
+#define DELTA_MAX_BLOCK (64 * 1024)
+
+/*
+ * rsync-style delta sync
+ *
+ * The side holding an old copy (the basis) describes it as per-block
+ * signatures; the side holding the new copy (the target) scans it with a
+ * rolling checksum and answers with a delta of block references into the
+ * basis plus literal bytes for everything else. Blocks and deltas are
+ * flat native-endian buffers, like the metadata sidecar.
+ */
+
+/**
+ * Signature Block Header
+ * Followed by block_count DeltaBlockSig entries. The final partial block
+ * of the basis, if any, has no signature and is never referenced.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t block_size;
+    uint64_t basis_size;
+    uint32_t basis_crc;              // CRC32C of the whole basis
+    uint32_t block_count;
+} DeltaSigHeader;
+
+typedef struct {
+    uint32_t weak;                   // Rolling checksum (Adler-style)
+    uint32_t reserved;
+    uint64_t strong;                 // FNV-1a 64 of the block
+} DeltaBlockSig;
+
+/**
+ * Delta Header
+ * Followed by operations, each a one-byte tag and native u32 fields:
+ *   'L' <len> <len bytes>       literal data
+ *   'B' <first> <count>         count basis blocks starting at first
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t block_size;
+    uint64_t basis_size;
+    uint32_t basis_crc;              // Basis the delta was computed against
+    uint32_t target_crc;
+    uint64_t target_size;
+} DeltaHeader;
+
+/**
+ * Block size for a basis of the given size (about its square root)
+ */
+uint32_t delta_block_size(size_t basis_size);
+
+/**
+ * Compute the signature block of a basis
+ * @param basis Basis content
+ * @param basis_len Basis length
+ * @param out_len Signature block length (output)
+ * @return Signature block (caller frees), NULL on error
+ */
+char* delta_signatures(const char* basis, size_t basis_len, size_t* out_len);
+
+/**
+ * Compute a delta turning the signed basis into target
+ * @param sigs Signature block from delta_signatures
+ * @param sigs_len Signature block length
+ * @param target New content
+ * @param target_len New content length
+ * @param out_len Delta length (output)
+ * @return Delta (caller frees), NULL if the signatures are malformed
+ */
+char* delta_encode(const char* sigs, size_t sigs_len, const char* target,
+                   size_t target_len, size_t* out_len);
+
+/**
+ * Rebuild the target from the basis and a delta
+ * Fails unless the basis is the one the delta was computed against and
+ * the result matches the target's checksum.
+ * @param basis Basis content
+ * @param basis_len Basis length
+ * @param delta Delta from delta_encode
+ * @param delta_len Delta length
+ * @param out_len Target length (output)
+ * @return Target content, NUL-terminated (caller frees), NULL on error
+ */
+char* delta_apply(const char* basis, size_t basis_len, const char* delta,
+                  size_t delta_len, size_t* out_len);
+
+#endif // SS_DELTA_H
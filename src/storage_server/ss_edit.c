@@ -0,0 +1,126 @@
+#include "ss_edit.h"
+#include "../common/error_codes.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool is_word_separator(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static int reserve_text(SentenceEdit* edit, size_t len) {
+    if (len + 1 <= edit->capacity) return 0;
+    size_t capacity = edit->capacity ? edit->capacity : 256;
+    while (capacity < len + 1) capacity *= 2;
+    char* text = realloc(edit->text, capacity);
+    if (!text) return -1;
+    edit->text = text;
+    edit->capacity = capacity;
+    return 0;
+}
+
+static int reserve_words(SentenceEdit* edit, size_t count) {
+    if (count <= edit->word_capacity) return 0;
+    size_t capacity = edit->word_capacity ? edit->word_capacity : 32;
+    while (capacity < count) capacity *= 2;
+    size_t* offsets = realloc(edit->word_offset, capacity * sizeof(size_t));
+    if (!offsets) return -1;
+    edit->word_offset = offsets;
+    edit->word_capacity = capacity;
+    return 0;
+}
+
+// Word starts in data[0..len), written to out (NULL to only count)
+static size_t scan_words(const char* data, size_t len, size_t base, size_t* out) {
+    size_t count = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (!is_word_separator(data[i]) && (i == 0 || is_word_separator(data[i - 1]))) {
+            if (out) out[count] = base + i;
+            count++;
+        }
+    }
+    return count;
+}
+
+int sentence_edit_init(SentenceEdit* edit, const char* sentence, size_t len) {
+    memset(edit, 0, sizeof(SentenceEdit));
+    size_t words = scan_words(sentence, len, 0, NULL);
+    if (reserve_text(edit, len) < 0 || reserve_words(edit, words) < 0) {
+        sentence_edit_free(edit);
+        return -1;
+    }
+    memcpy(edit->text, sentence, len);
+    edit->text[len] = '\0';
+    edit->len = len;
+    edit->word_count = scan_words(sentence, len, 0, edit->word_offset);
+    return 0;
+}
+
+void sentence_edit_free(SentenceEdit* edit) {
+    free(edit->text);
+    free(edit->word_offset);
+    memset(edit, 0, sizeof(SentenceEdit));
+}
+
+int sentence_edit_insert(SentenceEdit* edit, size_t word_index, const char* content,
+                         size_t len) {
+    if (word_index > edit->word_count) return ERR_WORD_OUT_OF_RANGE;
+    if (len == 0) return ERR_SUCCESS;
+
+    // Before an existing word the content is followed by a space; at the
+    // end it is preceded by one
+    bool at_end = word_index == edit->word_count;
+    size_t pos = at_end ? edit->len : edit->word_offset[word_index];
+    bool space_before = at_end && edit->len > 0 && !is_word_separator(edit->text[edit->len - 1]);
+    bool space_after = !at_end;
+    size_t inserted = len + (space_before ? 1 : 0) + (space_after ? 1 : 0);
+    size_t new_words = scan_words(content, len, 0, NULL);
+
+    if (edit->len + inserted > SENTENCE_EDIT_MAX_BYTES ||
+        reserve_text(edit, edit->len + inserted) < 0 ||
+        reserve_words(edit, edit->word_count + new_words) < 0) {
+        return ERR_INVALID_OPERATION;
+    }
+
+    memmove(edit->text + pos + inserted, edit->text + pos, edit->len - pos + 1);
+    char* out = edit->text + pos;
+    if (space_before) *out++ = ' ';
+    memcpy(out, content, len);
+    if (space_after) out[len] = ' ';
+    edit->len += inserted;
+
+    // Shift the words after the insert, then slot the new ones in
+    size_t* offsets = edit->word_offset;
+    for (size_t i = word_index; i < edit->word_count; i++) offsets[i] += inserted;
+    memmove(offsets + word_index + new_words, offsets + word_index,
+            (edit->word_count - word_index) * sizeof(size_t));
+    scan_words(content, len, pos + (space_before ? 1 : 0), offsets + word_index);
+    edit->word_count += new_words;
+    return ERR_SUCCESS;
+}
+
+int sentence_edit_delete(SentenceEdit* edit, size_t word_index, size_t count) {
+    if (count == 0 || word_index >= edit->word_count ||
+        count > edit->word_count - word_index) {
+        return ERR_WORD_OUT_OF_RANGE;
+    }
+
+    // Words before the end take the spacing after them; the last words
+    // take the spacing before them instead
+    size_t last = word_index + count;
+    size_t start = edit->word_offset[word_index];
+    size_t end = last < edit->word_count ? edit->word_offset[last] : edit->len;
+    if (last == edit->word_count) {
+        while (start > 0 && is_word_separator(edit->text[start - 1])) start--;
+    }
+
+    size_t removed = end - start;
+    memmove(edit->text + start, edit->text + end, edit->len - end + 1);
+    edit->len -= removed;
+
+    size_t* offsets = edit->word_offset;
+    for (size_t i = last; i < edit->word_count; i++) offsets[i] -= removed;
+    memmove(offsets + word_index, offsets + last, (edit->word_count - last) * sizeof(size_t));
+    edit->word_count -= count;
+    return ERR_SUCCESS;
+}
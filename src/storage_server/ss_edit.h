@@ -0,0 +1,62 @@
+#ifndef SS_EDIT_H
+#define SS_EDIT_H
+
+#include <stddef.h>
+
+#define SENTENCE_EDIT_MAX_BYTES (1024 * 1024)   // Largest text one WRITE session may build
+
+/**
+ * Sentence Edit
+ * The sentence a WRITE session holds locked, edited in memory. Word
+ * starts are kept as offsets into the text, so an insert shifts the
+ * offsets after it instead of re-tokenizing the sentence, and the file
+ * is written once when the session ends. Inserted content may add
+ * sentence delimiters; word indices keep counting across the whole
+ * edited text, which the file splits into sentences when committed.
+ */
+typedef struct {
+    char* text;                      // NUL-terminated
+    size_t len;
+    size_t capacity;
+    size_t* word_offset;             // Start of each word in text
+    size_t word_count;
+    size_t word_capacity;
+} SentenceEdit;
+
+/**
+ * Start editing a sentence
+ * @param edit Edit to initialize
+ * @param sentence Current sentence text (may be empty for a new sentence)
+ * @param len Its length
+ * @return 0 on success, -1 on allocation failure
+ */
+int sentence_edit_init(SentenceEdit* edit, const char* sentence, size_t len);
+
+/**
+ * Free an edit's buffers
+ */
+void sentence_edit_free(SentenceEdit* edit);
+
+/**
+ * Insert content before word word_index (word_count appends)
+ * @param edit Edit
+ * @param word_index Word position, 0..word_count
+ * @param content Words to insert
+ * @param len Content length
+ * @return ERR_SUCCESS, ERR_WORD_OUT_OF_RANGE, or ERR_INVALID_OPERATION if
+ *         the text would exceed SENTENCE_EDIT_MAX_BYTES
+ */
+int sentence_edit_insert(SentenceEdit* edit, size_t word_index, const char* content,
+                         size_t len);
+
+/**
+ * Remove count words starting at word_index, with the spacing that
+ * separated them from the rest of the text
+ * @param edit Edit
+ * @param word_index First word to remove
+ * @param count Number of words (at least 1)
+ * @return ERR_SUCCESS, or ERR_WORD_OUT_OF_RANGE if the range isn't in the text
+ */
+int sentence_edit_delete(SentenceEdit* edit, size_t word_index, size_t count);
+
+#endif // SS_EDIT_H
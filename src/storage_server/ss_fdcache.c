@@ -0,0 +1,198 @@
+#include "ss_fdcache.h"
+#include "ss_io.h"
+#include "../common/hash_utils.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* ===============================================
+ * LIST AND TABLE HELPERS
+ * =============================================== */
+
+static size_t fd_bucket(uint64_t file_id) {
+    return hash_mix64(file_id) % FD_CACHE_BUCKETS;
+}
+
+// Caller holds cache->mutex
+static void lru_unlink(FdCache* cache, CachedFd* entry) {
+    if (entry->prev) entry->prev->next = entry->next;
+    else cache->head = entry->next;
+    if (entry->next) entry->next->prev = entry->prev;
+    else cache->tail = entry->prev;
+    entry->prev = entry->next = NULL;
+}
+
+// Caller holds cache->mutex
+static void lru_push_front(FdCache* cache, CachedFd* entry) {
+    entry->prev = NULL;
+    entry->next = cache->head;
+    if (cache->head) cache->head->prev = entry;
+    cache->head = entry;
+    if (!cache->tail) cache->tail = entry;
+}
+
+// Caller holds cache->mutex. Takes the entry out of the table; returns
+// true if nobody holds it, so the caller closes it after unlocking.
+static bool drop_resident(FdCache* cache, CachedFd* entry) {
+    CachedFd** link = &cache->buckets[fd_bucket(entry->file_id)];
+    while (*link && *link != entry) link = &(*link)->hash_next;
+    if (*link) *link = entry->hash_next;
+    entry->hash_next = NULL;
+
+    lru_unlink(cache, entry);
+    entry->resident = false;
+    cache->count--;
+    return entry->refcount == 0;
+}
+
+static void close_entries(CachedFd* list) {
+    while (list) {
+        CachedFd* next = list->hash_next;
+        ss_io_unregister_file(list->io_slot);
+        close(list->fd);
+        free(list);
+        list = next;
+    }
+}
+
+/* ===============================================
+ * CACHE
+ * =============================================== */
+
+void fd_cache_init(FdCache* cache, int capacity) {
+    memset(cache, 0, sizeof(FdCache));
+    pthread_mutex_init(&cache->mutex, NULL);
+    cache->capacity = capacity > 0 ? capacity : FD_CACHE_DEFAULT_ENTRIES;
+}
+
+void fd_cache_destroy(FdCache* cache) {
+    if (!cache) return;
+
+    CachedFd* idle = NULL;
+    pthread_mutex_lock(&cache->mutex);
+    while (cache->head) {
+        CachedFd* entry = cache->head;
+        if (drop_resident(cache, entry)) {
+            entry->hash_next = idle;
+            idle = entry;
+        }
+    }
+    pthread_mutex_unlock(&cache->mutex);
+
+    close_entries(idle);
+    pthread_mutex_destroy(&cache->mutex);
+}
+
+CachedFd* fd_cache_get(FdCache* cache, uint64_t file_id, uint64_t version) {
+    if (!cache) return NULL;
+
+    pthread_mutex_lock(&cache->mutex);
+    CachedFd* entry = cache->buckets[fd_bucket(file_id)];
+    while (entry && (entry->file_id != file_id || entry->version != version)) {
+        entry = entry->hash_next;
+    }
+    if (entry) {
+        entry->refcount++;
+        lru_unlink(cache, entry);
+        lru_push_front(cache, entry);
+        cache->stats.hits++;
+    } else {
+        cache->stats.misses++;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+
+    return entry;
+}
+
+CachedFd* fd_cache_put(FdCache* cache, uint64_t file_id, uint64_t version, int fd,
+                       off_t size) {
+    if (!cache || fd < 0) return NULL;
+
+    CachedFd* entry = calloc(1, sizeof(CachedFd));
+    if (!entry) return NULL;
+    entry->file_id = file_id;
+    entry->version = version;
+    entry->fd = fd;
+    entry->size = size;
+    entry->refcount = 1;
+    entry->resident = true;
+    entry->io_slot = ss_io_register_file(fd);   // Cached descriptors are read often
+
+    CachedFd* evicted = NULL;
+    pthread_mutex_lock(&cache->mutex);
+
+    // Another reader may have opened the same version meanwhile
+    size_t bucket = fd_bucket(file_id);
+    for (CachedFd* existing = cache->buckets[bucket]; existing;
+         existing = existing->hash_next) {
+        if (existing->file_id == file_id && existing->version == version) {
+            existing->refcount++;
+            pthread_mutex_unlock(&cache->mutex);
+            ss_io_unregister_file(entry->io_slot);
+            close(fd);
+            free(entry);
+            return existing;
+        }
+    }
+
+    entry->hash_next = cache->buckets[bucket];
+    cache->buckets[bucket] = entry;
+    lru_push_front(cache, entry);
+    cache->count++;
+
+    // Entries in use leave the table too; their last release closes them
+    while (cache->count > cache->capacity) {
+        CachedFd* victim = cache->tail;
+        if (drop_resident(cache, victim)) {
+            victim->hash_next = evicted;
+            evicted = victim;
+        }
+        cache->stats.evictions++;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+
+    close_entries(evicted);
+    return entry;
+}
+
+void fd_cache_release(FdCache* cache, CachedFd* entry) {
+    if (!cache || !entry) return;
+
+    pthread_mutex_lock(&cache->mutex);
+    bool close_now = --entry->refcount == 0 && !entry->resident;
+    pthread_mutex_unlock(&cache->mutex);
+
+    if (close_now) close_entries(entry);
+}
+
+void fd_cache_invalidate(FdCache* cache, uint64_t file_id, uint64_t keep_version) {
+    if (!cache) return;
+
+    CachedFd* idle = NULL;
+    pthread_mutex_lock(&cache->mutex);
+    CachedFd* entry = cache->buckets[fd_bucket(file_id)];
+    while (entry) {
+        CachedFd* next = entry->hash_next;
+        if (entry->file_id == file_id &&
+            (keep_version == 0 || entry->version < keep_version)) {
+            if (drop_resident(cache, entry)) {
+                entry->hash_next = idle;
+                idle = entry;
+            }
+            cache->stats.invalidations++;
+        }
+        entry = next;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+
+    close_entries(idle);
+}
+
+void fd_cache_get_stats(FdCache* cache, FdCacheStats* stats) {
+    if (!cache || !stats) return;
+
+    pthread_mutex_lock(&cache->mutex);
+    *stats = cache->stats;
+    stats->entries = cache->count;
+    pthread_mutex_unlock(&cache->mutex);
+}
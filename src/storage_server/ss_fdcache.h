@@ -0,0 +1,113 @@
+#ifndef SS_FDCACHE_H
+#define SS_FDCACHE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define FD_CACHE_DEFAULT_ENTRIES 256     // Descriptors kept open when idle
+#define FD_CACHE_BUCKETS 1024
+
+/**
+ * Cached Descriptor
+ * A read-only descriptor on one version of a file. Commits replace files
+ * by rename, so a descriptor keeps reading the version it was opened on
+ * for as long as it stays open. Holders read it with pread only; nothing
+ * may move its file offset.
+ */
+typedef struct CachedFd {
+    uint64_t file_id;
+    uint64_t version;
+    int fd;
+    off_t size;
+    int io_slot;                     // Fixed file table slot (ss_io), -1 if none
+
+    int refcount;                    // Guarded by the cache mutex
+    bool resident;                   // In the table; closed on last release once not
+    struct CachedFd* prev;           // LRU list
+    struct CachedFd* next;
+    struct CachedFd* hash_next;
+} CachedFd;
+
+/**
+ * Descriptor Cache Statistics
+ */
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t invalidations;
+    int entries;
+} FdCacheStats;
+
+/**
+ * Descriptor Cache
+ * Bounded LRU of open descriptors keyed by (file ID, version), so hot
+ * files are read without resolving their path again. Entries dropped
+ * while in use (evicted, or invalidated by a commit or DELETE) stay open
+ * until their last holder releases them.
+ */
+typedef struct FdCache {
+    pthread_mutex_t mutex;
+    CachedFd* buckets[FD_CACHE_BUCKETS];
+    CachedFd* head;                  // Most recently used
+    CachedFd* tail;                  // Eviction end
+    int count;
+    int capacity;
+    FdCacheStats stats;
+} FdCache;
+
+/**
+ * Initialize / destroy the cache
+ * Destroy closes the idle descriptors; ones still held are closed by
+ * their last release.
+ * @param cache Descriptor cache
+ * @param capacity Entries to keep (0 picks FD_CACHE_DEFAULT_ENTRIES)
+ */
+void fd_cache_init(FdCache* cache, int capacity);
+void fd_cache_destroy(FdCache* cache);
+
+/**
+ * Look up a descriptor on one version of a file
+ * @param cache Descriptor cache
+ * @param file_id File ID
+ * @param version File version
+ * @return Referenced entry (release with fd_cache_release), NULL on miss
+ */
+CachedFd* fd_cache_get(FdCache* cache, uint64_t file_id, uint64_t version);
+
+/**
+ * Add a descriptor the caller opened on one version of a file
+ * Takes ownership of fd. If the version is already cached, the existing
+ * entry is returned and fd is closed.
+ * @param cache Descriptor cache
+ * @param file_id File ID
+ * @param version Version fd was opened on
+ * @param fd Open descriptor
+ * @param size File size
+ * @return Referenced entry, NULL on allocation failure (fd stays the caller's)
+ */
+CachedFd* fd_cache_put(FdCache* cache, uint64_t file_id, uint64_t version, int fd,
+                       off_t size);
+
+/**
+ * Drop a reference taken with fd_cache_get / fd_cache_put
+ */
+void fd_cache_release(FdCache* cache, CachedFd* entry);
+
+/**
+ * Drop every cached version of a file older than keep_version
+ * @param cache Descriptor cache
+ * @param file_id File ID
+ * @param keep_version Versions >= this stay (0 drops all)
+ */
+void fd_cache_invalidate(FdCache* cache, uint64_t file_id, uint64_t keep_version);
+
+/**
+ * Snapshot cache statistics
+ */
+void fd_cache_get_stats(FdCache* cache, FdCacheStats* stats);
+
+#endif // SS_FDCACHE_H
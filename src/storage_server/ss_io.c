@@ -0,0 +1,816 @@
+#include "ss_io.h"
+#include "../common/logger.h"
+#include "../common/metrics.h"
+#include "../common/trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+/**
+ * Batch
+ * Completion rendezvous for one ss_io_submit call
+ */
+typedef struct SsIoBatch {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int remaining;
+} SsIoBatch;
+
+/**
+ * io_uring state (raw syscalls; no liburing dependency)
+ */
+typedef struct {
+    int ring_fd;
+    unsigned sq_entries;
+    unsigned cq_entries;
+    void* sq_ptr;
+    void* cq_ptr;
+    size_t sq_size;
+    size_t cq_size;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+
+    pthread_mutex_t sq_mutex;       // Serializes SQ producers
+    pthread_cond_t space_cond;      // Signalled as completions free CQ room
+    unsigned inflight;
+    pthread_t reaper;
+    bool files_registered;
+    bool buffers_registered;
+} UringState;
+
+/**
+ * Thread pool state
+ */
+typedef struct {
+    pthread_t threads[SS_IO_POOL_THREADS];
+    int thread_count;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    SsIoRequest* queue_head;        // Chain heads, linked through queue_next
+    SsIoRequest* queue_tail;
+    bool stopping;
+} PoolState;
+
+static struct {
+    SsIoBackend backend;
+    UringState uring;
+    PoolState pool;
+
+    // Registered buffers (plain memory for the thread pool)
+    char* buffer_mem;
+    pthread_mutex_t buffer_mutex;
+    int free_buffers[SS_IO_FIXED_BUFFERS];
+    int free_buffer_count;
+
+    // Registered files: slot -> fd, and fd -> slot + 1 (0 if none)
+    pthread_mutex_t file_mutex;
+    int fixed_fds[SS_IO_FIXED_FILES];
+    uint16_t fd_slots[SS_IO_FIXED_FD_LIMIT];
+} g_io = { .backend = SS_IO_BACKEND_SYNC };
+
+/* ===============================================
+ * SYNCHRONOUS EXECUTION
+ * =============================================== */
+
+static int resolve_fd(const SsIoRequest* req) {
+    if (req->file_index >= 0 && req->file_index < SS_IO_FIXED_FILES) {
+        return g_io.fixed_fds[req->file_index];
+    }
+    return req->fd;
+}
+
+static long exec_sync(const SsIoRequest* req) {
+    int fd = resolve_fd(req);
+    ssize_t n;
+
+    switch (req->op) {
+        case SS_IO_OP_READ:
+            do { n = pread(fd, req->buf, req->len, req->offset); } while (n < 0 && errno == EINTR);
+            return n < 0 ? -errno : n;
+        case SS_IO_OP_WRITE:
+            do { n = pwrite(fd, req->buf, req->len, req->offset); } while (n < 0 && errno == EINTR);
+            return n < 0 ? -errno : n;
+        case SS_IO_OP_FSYNC:
+            return fsync(fd) < 0 ? -errno : 0;
+        case SS_IO_OP_RENAME:
+            return rename(req->path, req->new_path) < 0 ? -errno : 0;
+    }
+    return -EINVAL;
+}
+
+// Runs a link chain in order; a failure cancels the rest of the chain
+static void exec_chain_sync(SsIoRequest* req) {
+    bool cancelled = false;
+    while (req) {
+        req->result = cancelled ? -ECANCELED : exec_sync(req);
+        if (req->result < 0) cancelled = true;
+        req = req->chain_next;
+    }
+}
+
+static void complete_request(SsIoRequest* req, long result) {
+    SsIoBatch* batch = req->batch;
+    req->result = result;
+
+    pthread_mutex_lock(&batch->mutex);
+    if (--batch->remaining == 0) {
+        pthread_cond_signal(&batch->cond);
+    }
+    pthread_mutex_unlock(&batch->mutex);
+}
+
+/* ===============================================
+ * IO_URING BACKEND
+ * =============================================== */
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params* p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void fill_sqe(struct io_uring_sqe* sqe, const SsIoRequest* req) {
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = (uint64_t)(uintptr_t)req;
+
+    bool fixed_file = req->file_index >= 0 && g_io.uring.files_registered;
+    sqe->fd = fixed_file ? req->file_index : req->fd;
+    if (fixed_file) sqe->flags |= IOSQE_FIXED_FILE;
+    if (req->link_next) sqe->flags |= IOSQE_IO_LINK;
+
+    bool fixed_buf = req->buf_index >= 0 && g_io.uring.buffers_registered;
+
+    switch (req->op) {
+        case SS_IO_OP_READ:
+        case SS_IO_OP_WRITE:
+            if (fixed_buf) {
+                sqe->opcode = req->op == SS_IO_OP_READ ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+                sqe->buf_index = (uint16_t)req->buf_index;
+            } else {
+                sqe->opcode = req->op == SS_IO_OP_READ ? IORING_OP_READ : IORING_OP_WRITE;
+            }
+            sqe->addr = (uint64_t)(uintptr_t)req->buf;
+            sqe->len = (uint32_t)req->len;
+            sqe->off = (uint64_t)req->offset;
+            break;
+        case SS_IO_OP_FSYNC:
+            sqe->opcode = IORING_OP_FSYNC;
+            break;
+        case SS_IO_OP_RENAME:
+            sqe->opcode = IORING_OP_RENAMEAT;
+            sqe->fd = AT_FDCWD;
+            sqe->flags &= (uint8_t)~IOSQE_FIXED_FILE;
+            sqe->addr = (uint64_t)(uintptr_t)req->path;
+            sqe->len = (uint32_t)AT_FDCWD;
+            sqe->addr2 = (uint64_t)(uintptr_t)req->new_path;
+            break;
+    }
+}
+
+// Queues count SQEs and submits them with a single io_uring_enter. Returns
+// how many the kernel consumed; on failure the rest are withdrawn from the
+// ring again, so only the consumed ones will ever complete
+static int uring_submit(SsIoRequest* reqs, int count) {
+    UringState* u = &g_io.uring;
+
+    pthread_mutex_lock(&u->sq_mutex);
+
+    // Never let completions outrun the CQ ring
+    while (u->inflight + (unsigned)count > u->cq_entries) {
+        pthread_cond_wait(&u->space_cond, &u->sq_mutex);
+    }
+
+    unsigned tail = *u->sq_tail;
+    for (int i = 0; i < count; i++) {
+        unsigned index = tail & *u->sq_mask;
+        fill_sqe(&u->sqes[index], &reqs[i]);
+        u->sq_array[index] = index;
+        tail++;
+    }
+    __atomic_store_n(u->sq_tail, tail, __ATOMIC_RELEASE);
+    u->inflight += (unsigned)count;
+
+    unsigned remaining = (unsigned)count;
+    while (remaining > 0) {
+        int submitted = sys_io_uring_enter(u->ring_fd, remaining, 0, 0);
+        if (submitted < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+            break;
+        }
+        remaining -= (unsigned)submitted;
+    }
+
+    if (remaining > 0) {
+        // Without SQPOLL the kernel only reads the SQ inside io_uring_enter,
+        // which we serialize, so moving the tail back to its head is safe
+        __atomic_store_n(u->sq_tail, __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE),
+                         __ATOMIC_RELEASE);
+        u->inflight -= remaining;
+        pthread_cond_broadcast(&u->space_cond);
+    }
+
+    pthread_mutex_unlock(&u->sq_mutex);
+    return count - (int)remaining;
+}
+
+static void* uring_reaper_func(void* arg) {
+    (void)arg;
+    UringState* u = &g_io.uring;
+    bool stopping = false;
+
+    while (!stopping) {
+        int rc = sys_io_uring_enter(u->ring_fd, 0, 1, IORING_ENTER_GETEVENTS);
+        if (rc < 0 && errno != EINTR) {
+            perror("io_uring_enter");
+            break;
+        }
+
+        unsigned head = *u->cq_head;
+        unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+        unsigned reaped = 0;
+
+        while (head != tail) {
+            struct io_uring_cqe* cqe = &u->cqes[head & *u->cq_mask];
+            SsIoRequest* req = (SsIoRequest*)(uintptr_t)cqe->user_data;
+            if (req) {
+                complete_request(req, cqe->res);
+            } else {
+                stopping = true;  // Shutdown NOP
+            }
+            head++;
+            reaped++;
+        }
+        __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+
+        if (reaped > 0) {
+            pthread_mutex_lock(&u->sq_mutex);
+            u->inflight -= reaped;
+            pthread_cond_broadcast(&u->space_cond);
+            pthread_mutex_unlock(&u->sq_mutex);
+        }
+    }
+
+    return NULL;
+}
+
+static void uring_unmap(UringState* u) {
+    if (u->sqes) munmap(u->sqes, u->sqes_size);
+    if (u->cq_ptr && u->cq_ptr != u->sq_ptr) munmap(u->cq_ptr, u->cq_size);
+    if (u->sq_ptr) munmap(u->sq_ptr, u->sq_size);
+    if (u->ring_fd >= 0) close(u->ring_fd);
+    memset(u, 0, sizeof(*u));
+    u->ring_fd = -1;
+}
+
+// Kernels before 5.6 lack IORING_OP_READ/WRITE (and the probe itself), and
+// RENAMEAT needs 5.11; the ring is only worth using if it runs every op we
+// issue, otherwise the thread pool takes over
+static bool uring_supports_ops(int ring_fd) {
+    static const unsigned needed[] = {
+        IORING_OP_READ, IORING_OP_WRITE, IORING_OP_READ_FIXED, IORING_OP_WRITE_FIXED,
+        IORING_OP_FSYNC, IORING_OP_RENAMEAT,
+    };
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = calloc(1, size);
+    if (!probe) return false;
+
+    bool supported = sys_io_uring_register(ring_fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    for (size_t i = 0; supported && i < sizeof(needed) / sizeof(needed[0]); i++) {
+        supported = needed[i] <= probe->last_op &&
+                    (probe->ops[needed[i]].flags & IO_URING_OP_SUPPORTED) != 0;
+    }
+    free(probe);
+    return supported;
+}
+
+static int uring_start(void) {
+    UringState* u = &g_io.uring;
+    memset(u, 0, sizeof(*u));
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    u->ring_fd = sys_io_uring_setup(SS_IO_QUEUE_DEPTH, &params);
+    if (u->ring_fd < 0) {
+        u->ring_fd = -1;
+        return -1;
+    }
+
+    u->sq_entries = params.sq_entries;
+    u->cq_entries = params.cq_entries;
+    u->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    u->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        if (u->cq_size > u->sq_size) u->sq_size = u->cq_size;
+        u->cq_size = u->sq_size;
+    }
+
+    u->sq_ptr = mmap(NULL, u->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     u->ring_fd, IORING_OFF_SQ_RING);
+    if (u->sq_ptr == MAP_FAILED) {
+        u->sq_ptr = NULL;
+        uring_unmap(u);
+        return -1;
+    }
+
+    if (single_mmap) {
+        u->cq_ptr = u->sq_ptr;
+    } else {
+        u->cq_ptr = mmap(NULL, u->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         u->ring_fd, IORING_OFF_CQ_RING);
+        if (u->cq_ptr == MAP_FAILED) {
+            u->cq_ptr = NULL;
+            uring_unmap(u);
+            return -1;
+        }
+    }
+
+    u->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   u->ring_fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) {
+        u->sqes = NULL;
+        uring_unmap(u);
+        return -1;
+    }
+
+    char* sq = (char*)u->sq_ptr;
+    char* cq = (char*)u->cq_ptr;
+    u->sq_head = (unsigned*)(sq + params.sq_off.head);
+    u->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    u->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    u->sq_array = (unsigned*)(sq + params.sq_off.array);
+    u->cq_head = (unsigned*)(cq + params.cq_off.head);
+    u->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    u->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    if (!uring_supports_ops(u->ring_fd)) {
+        uring_unmap(u);
+        return -1;
+    }
+
+    // Registered buffers and a sparse file table; both are optional
+    struct iovec iov[SS_IO_FIXED_BUFFERS];
+    for (int i = 0; i < SS_IO_FIXED_BUFFERS; i++) {
+        iov[i].iov_base = g_io.buffer_mem + (size_t)i * SS_IO_FIXED_BUFFER_SIZE;
+        iov[i].iov_len = SS_IO_FIXED_BUFFER_SIZE;
+    }
+    u->buffers_registered =
+        sys_io_uring_register(u->ring_fd, IORING_REGISTER_BUFFERS, iov, SS_IO_FIXED_BUFFERS) == 0;
+    u->files_registered =
+        sys_io_uring_register(u->ring_fd, IORING_REGISTER_FILES, g_io.fixed_fds,
+                              SS_IO_FIXED_FILES) == 0;
+
+    pthread_mutex_init(&u->sq_mutex, NULL);
+    pthread_cond_init(&u->space_cond, NULL);
+
+    if (pthread_create(&u->reaper, NULL, uring_reaper_func, NULL) != 0) {
+        pthread_mutex_destroy(&u->sq_mutex);
+        pthread_cond_destroy(&u->space_cond);
+        uring_unmap(u);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void uring_stop(void) {
+    UringState* u = &g_io.uring;
+
+    // A NOP with no request behind it tells the reaper to exit
+    pthread_mutex_lock(&u->sq_mutex);
+    unsigned tail = *u->sq_tail;
+    unsigned index = tail & *u->sq_mask;
+    memset(&u->sqes[index], 0, sizeof(struct io_uring_sqe));
+    u->sqes[index].opcode = IORING_OP_NOP;
+    u->sq_array[index] = index;
+    __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    while (sys_io_uring_enter(u->ring_fd, 1, 0, 0) < 0 && errno == EINTR) {}
+    pthread_mutex_unlock(&u->sq_mutex);
+
+    pthread_join(u->reaper, NULL);
+    pthread_mutex_destroy(&u->sq_mutex);
+    pthread_cond_destroy(&u->space_cond);
+    uring_unmap(u);
+}
+
+/* ===============================================
+ * THREAD POOL BACKEND
+ * =============================================== */
+
+static void* pool_worker_func(void* arg) {
+    (void)arg;
+    PoolState* pool = &g_io.pool;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (!pool->queue_head && !pool->stopping) {
+            pthread_cond_wait(&pool->cond, &pool->mutex);
+        }
+        if (!pool->queue_head) break;
+
+        SsIoRequest* chain = pool->queue_head;
+        pool->queue_head = chain->queue_next;
+        if (!pool->queue_head) pool->queue_tail = NULL;
+        pthread_mutex_unlock(&pool->mutex);
+
+        exec_chain_sync(chain);
+        for (SsIoRequest* req = chain; req; ) {
+            SsIoRequest* next = req->chain_next;
+            complete_request(req, req->result);
+            req = next;
+        }
+
+        pthread_mutex_lock(&pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+static int pool_start(void) {
+    PoolState* pool = &g_io.pool;
+    memset(pool, 0, sizeof(*pool));
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    for (int i = 0; i < SS_IO_POOL_THREADS; i++) {
+        if (pthread_create(&pool->threads[i], NULL, pool_worker_func, NULL) != 0) break;
+        pool->thread_count++;
+    }
+    return pool->thread_count > 0 ? 0 : -1;
+}
+
+static void pool_stop(void) {
+    PoolState* pool = &g_io.pool;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (int i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->cond);
+    pool->thread_count = 0;
+}
+
+static void pool_enqueue(SsIoRequest* chain) {
+    PoolState* pool = &g_io.pool;
+
+    pthread_mutex_lock(&pool->mutex);
+    chain->queue_next = NULL;
+    if (pool->queue_tail) {
+        pool->queue_tail->queue_next = chain;
+    } else {
+        pool->queue_head = chain;
+    }
+    pool->queue_tail = chain;
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+/* ===============================================
+ * PUBLIC API
+ * =============================================== */
+
+SsIoBackend ss_io_init(SsIoBackend preferred) {
+    if (g_io.backend != SS_IO_BACKEND_SYNC) return g_io.backend;
+
+    pthread_mutex_init(&g_io.buffer_mutex, NULL);
+    pthread_mutex_init(&g_io.file_mutex, NULL);
+
+    for (int i = 0; i < SS_IO_FIXED_FILES; i++) {
+        g_io.fixed_fds[i] = -1;
+    }
+
+    g_io.buffer_mem = aligned_alloc(4096, (size_t)SS_IO_FIXED_BUFFERS * SS_IO_FIXED_BUFFER_SIZE);
+    g_io.free_buffer_count = 0;
+    if (g_io.buffer_mem) {
+        for (int i = SS_IO_FIXED_BUFFERS - 1; i >= 0; i--) {
+            g_io.free_buffers[g_io.free_buffer_count++] = i;
+        }
+    }
+
+    SsIoBackend selected = SS_IO_BACKEND_SYNC;
+    if (preferred == SS_IO_BACKEND_URING && g_io.buffer_mem && uring_start() == 0) {
+        selected = SS_IO_BACKEND_URING;
+    } else if (pool_start() == 0) {
+        selected = SS_IO_BACKEND_THREADPOOL;
+    }
+    g_io.backend = selected;
+
+    char log_msg[128];
+    snprintf(log_msg, sizeof(log_msg), "IO_BACKEND - %s", ss_io_backend_name());
+    log_message("SS", "0.0.0.0", 0, "system", "INIT", log_msg, "SUCCESS");
+
+    return selected;
+}
+
+void ss_io_shutdown(void) {
+    SsIoBackend backend = g_io.backend;
+    if (backend == SS_IO_BACKEND_SYNC) return;
+
+    g_io.backend = SS_IO_BACKEND_SYNC;
+    if (backend == SS_IO_BACKEND_URING) {
+        uring_stop();
+    } else {
+        pool_stop();
+    }
+
+    free(g_io.buffer_mem);
+    g_io.buffer_mem = NULL;
+    g_io.free_buffer_count = 0;
+    memset(g_io.fd_slots, 0, sizeof(g_io.fd_slots));
+    pthread_mutex_destroy(&g_io.buffer_mutex);
+    pthread_mutex_destroy(&g_io.file_mutex);
+}
+
+const char* ss_io_backend_name(void) {
+    switch (g_io.backend) {
+        case SS_IO_BACKEND_URING: return "io_uring";
+        case SS_IO_BACKEND_THREADPOOL: return "threadpool";
+        default: return "sync";
+    }
+}
+
+// Slot of the registered buffer holding all of [buf, buf + len), or -1
+static int registered_buffer(const void* buf, size_t len) {
+    const char* mem = g_io.buffer_mem;
+    const char* p = (const char*)buf;
+    if (!mem || !p || p < mem || p >= mem + (size_t)SS_IO_FIXED_BUFFERS * SS_IO_FIXED_BUFFER_SIZE) {
+        return -1;
+    }
+    size_t offset = (size_t)(p - mem);
+    if (offset % SS_IO_FIXED_BUFFER_SIZE + len > SS_IO_FIXED_BUFFER_SIZE) return -1;
+    return (int)(offset / SS_IO_FIXED_BUFFER_SIZE);
+}
+
+// A descriptor stays registered while it is open, so its holder may
+// look it up without the file mutex
+static int registered_file(int fd) {
+    if (fd < 0 || fd >= SS_IO_FIXED_FD_LIMIT) return -1;
+    return (int)__atomic_load_n(&g_io.fd_slots[fd], __ATOMIC_ACQUIRE) - 1;
+}
+
+void ss_io_prep(SsIoRequest* req, SsIoOp op, int fd, void* buf, size_t len, off_t offset) {
+    memset(req, 0, sizeof(*req));
+    req->op = op;
+    req->fd = fd;
+    req->buf = buf;
+    req->len = len;
+    req->offset = offset;
+    req->buf_index = op == SS_IO_OP_READ || op == SS_IO_OP_WRITE ? registered_buffer(buf, len)
+                                                                 : -1;
+    req->file_index = registered_file(fd);
+}
+
+int ss_io_submit(SsIoRequest* reqs, int count) {
+    if (!reqs || count <= 0) return 0;
+
+    // Link chains
+    uint64_t start = metrics_now_us();
+    bool writes = false;
+    for (int i = 0; i < count; i++) {
+        reqs[i].chain_next = (reqs[i].link_next && i + 1 < count) ? &reqs[i + 1] : NULL;
+        reqs[i].result = 0;
+        if (reqs[i].op != SS_IO_OP_READ) writes = true;
+    }
+
+    SsIoBackend backend = g_io.backend;
+    if (backend == SS_IO_BACKEND_URING && (unsigned)count > g_io.uring.sq_entries) {
+        backend = SS_IO_BACKEND_SYNC;
+    }
+
+    if (backend == SS_IO_BACKEND_SYNC) {
+        for (int i = 0; i < count; i++) {
+            if (i == 0 || !reqs[i - 1].link_next) exec_chain_sync(&reqs[i]);
+        }
+    } else {
+        SsIoBatch batch;
+        pthread_mutex_init(&batch.mutex, NULL);
+        pthread_cond_init(&batch.cond, NULL);
+        batch.remaining = count;
+        for (int i = 0; i < count; i++) {
+            reqs[i].batch = &batch;
+        }
+
+        int submitted = count;
+        if (backend == SS_IO_BACKEND_URING) {
+            submitted = uring_submit(reqs, count);
+        } else {
+            for (int i = 0; i < count; i++) {
+                if (i == 0 || !reqs[i - 1].link_next) pool_enqueue(&reqs[i]);
+            }
+        }
+
+        // Requests the ring never took fail; the rest still reference the
+        // batch, so wait for every one of them before it goes out of scope
+        pthread_mutex_lock(&batch.mutex);
+        for (int i = submitted; i < count; i++) reqs[i].result = -EIO;
+        batch.remaining -= count - submitted;
+        while (batch.remaining > 0) {
+            pthread_cond_wait(&batch.cond, &batch.mutex);
+        }
+        pthread_mutex_unlock(&batch.mutex);
+
+        pthread_mutex_destroy(&batch.mutex);
+        pthread_cond_destroy(&batch.cond);
+    }
+
+    bool failed = false;
+    for (int i = 0; i < count; i++) {
+        if (reqs[i].result < 0) failed = true;
+    }
+    uint64_t elapsed = metrics_now_us() - start;
+    metrics_record(writes ? METRIC_DISK_WRITE : METRIC_DISK_READ, elapsed, failed);
+    trace_add_stage(TRACE_STAGE_DISK, elapsed);
+    return failed ? -1 : 0;
+}
+
+ssize_t ss_io_pread_all(int fd, void* buf, size_t len, off_t offset) {
+    size_t done = 0;
+    while (done < len) {
+        SsIoRequest req;
+        ss_io_prep(&req, SS_IO_OP_READ, fd, (char*)buf + done, len - done, offset + (off_t)done);
+        if (ss_io_submit(&req, 1) < 0) {
+            errno = (int)-req.result;
+            return -1;
+        }
+        if (req.result == 0) break;  // EOF
+        done += (size_t)req.result;
+    }
+    return (ssize_t)done;
+}
+
+ssize_t ss_io_pwrite_all(int fd, const void* buf, size_t len, off_t offset) {
+    size_t done = 0;
+    while (done < len) {
+        SsIoRequest req;
+        ss_io_prep(&req, SS_IO_OP_WRITE, fd, (char*)buf + done, len - done, offset + (off_t)done);
+        if (ss_io_submit(&req, 1) < 0) {
+            errno = (int)-req.result;
+            return -1;
+        }
+        if (req.result == 0) {
+            errno = EIO;
+            return -1;
+        }
+        done += (size_t)req.result;
+    }
+    return (ssize_t)done;
+}
+
+int ss_io_write_and_sync(int fd, const void* buf, size_t len) {
+    SsIoRequest reqs[2];
+    int count = 0;
+
+    // Common case: one linked write+fsync submission
+    if (len > 0) {
+        ss_io_prep(&reqs[count], SS_IO_OP_WRITE, fd, (void*)buf, len, 0);
+        reqs[count++].link_next = true;
+    }
+    ss_io_prep(&reqs[count++], SS_IO_OP_FSYNC, fd, NULL, 0, 0);
+
+    if (ss_io_submit(reqs, count) == 0) {
+        return 0;
+    }
+
+    if (len == 0 || reqs[0].result < 0) {
+        errno = (int)-reqs[0].result;
+        return -1;
+    }
+    size_t written = (size_t)reqs[0].result;
+    if (written == len) {
+        errno = (int)-reqs[1].result;  // The fsync itself failed
+        return -1;
+    }
+
+    // A short write breaks the link: finish the write, then sync
+    if (ss_io_pwrite_all(fd, (const char*)buf + written, len - written, (off_t)written) < 0) {
+        return -1;
+    }
+    ss_io_prep(&reqs[1], SS_IO_OP_FSYNC, fd, NULL, 0, 0);
+    if (ss_io_submit(&reqs[1], 1) < 0) {
+        errno = (int)-reqs[1].result;
+        return -1;
+    }
+    return 0;
+}
+
+int ss_io_rename(const char* old_path, const char* new_path) {
+    SsIoRequest req;
+    ss_io_prep(&req, SS_IO_OP_RENAME, -1, NULL, 0, 0);
+    req.path = old_path;
+    req.new_path = new_path;
+
+    if (ss_io_submit(&req, 1) == 0) return 0;
+
+    // Kernels that predate IORING_OP_RENAMEAT reject the opcode
+    if (req.result == -EINVAL && g_io.backend == SS_IO_BACKEND_URING) {
+        return rename(old_path, new_path);
+    }
+    errno = (int)-req.result;
+    return -1;
+}
+
+void* ss_io_buffer_get(int* index) {
+    if (!index || g_io.backend == SS_IO_BACKEND_SYNC || !g_io.buffer_mem) return NULL;
+
+    // Holders may keep one for a whole network transfer, so never wait
+    pthread_mutex_lock(&g_io.buffer_mutex);
+    int slot = g_io.free_buffer_count > 0 ? g_io.free_buffers[--g_io.free_buffer_count] : -1;
+    pthread_mutex_unlock(&g_io.buffer_mutex);
+    if (slot < 0) return NULL;
+
+    *index = slot;
+    return g_io.buffer_mem + (size_t)slot * SS_IO_FIXED_BUFFER_SIZE;
+}
+
+void ss_io_buffer_put(int index) {
+    if (index < 0 || index >= SS_IO_FIXED_BUFFERS) return;
+
+    pthread_mutex_lock(&g_io.buffer_mutex);
+    g_io.free_buffers[g_io.free_buffer_count++] = index;
+    pthread_mutex_unlock(&g_io.buffer_mutex);
+}
+
+int ss_io_register_file(int fd) {
+    if (fd < 0 || fd >= SS_IO_FIXED_FD_LIMIT || g_io.backend == SS_IO_BACKEND_SYNC) return -1;
+
+    pthread_mutex_lock(&g_io.file_mutex);
+    int slot = -1;
+    for (int i = 0; i < SS_IO_FIXED_FILES; i++) {
+        if (g_io.fixed_fds[i] < 0) {
+            slot = i;
+            break;
+        }
+    }
+
+    if (slot >= 0 && g_io.backend == SS_IO_BACKEND_URING && g_io.uring.files_registered) {
+        struct io_uring_files_update update;
+        memset(&update, 0, sizeof(update));
+        update.offset = (uint32_t)slot;
+        update.fds = (uint64_t)(uintptr_t)&fd;
+        if (sys_io_uring_register(g_io.uring.ring_fd, IORING_REGISTER_FILES_UPDATE,
+                                  &update, 1) != 1) {
+            slot = -1;
+        }
+    }
+    if (slot >= 0) {
+        g_io.fixed_fds[slot] = fd;
+        __atomic_store_n(&g_io.fd_slots[fd], (uint16_t)(slot + 1), __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&g_io.file_mutex);
+
+    return slot;
+}
+
+void ss_io_unregister_file(int slot) {
+    if (slot < 0 || slot >= SS_IO_FIXED_FILES || g_io.backend == SS_IO_BACKEND_SYNC) return;
+
+    pthread_mutex_lock(&g_io.file_mutex);
+    int fd = g_io.fixed_fds[slot];
+    if (fd < 0) {
+        pthread_mutex_unlock(&g_io.file_mutex);
+        return;
+    }
+    __atomic_store_n(&g_io.fd_slots[fd], 0, __ATOMIC_RELEASE);
+    if (g_io.backend == SS_IO_BACKEND_URING && g_io.uring.files_registered) {
+        int none = -1;
+        struct io_uring_files_update update;
+        memset(&update, 0, sizeof(update));
+        update.offset = (uint32_t)slot;
+        update.fds = (uint64_t)(uintptr_t)&none;
+        sys_io_uring_register(g_io.uring.ring_fd, IORING_REGISTER_FILES_UPDATE, &update, 1);
+    }
+    g_io.fixed_fds[slot] = -1;
+    pthread_mutex_unlock(&g_io.file_mutex);
+}
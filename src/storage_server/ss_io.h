@@ -0,0 +1,134 @@
+#ifndef SS_IO_H
+#define SS_IO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define SS_IO_QUEUE_DEPTH 256            // io_uring submission queue entries
+#define SS_IO_POOL_THREADS 8             // Fallback backend workers
+#define SS_IO_FIXED_BUFFERS 32           // Registered buffers
+#define SS_IO_FIXED_BUFFER_SIZE 65536
+#define SS_IO_FIXED_FILES 256            // Registered file table slots
+#define SS_IO_FIXED_FD_LIMIT 16384       // Only descriptors below this are registered
+
+/**
+ * I/O Backend
+ * SYNC runs requests on the calling thread; it is what every call uses
+ * before ss_io_init (and in tools/tests that never call it).
+ */
+typedef enum {
+    SS_IO_BACKEND_SYNC = 0,
+    SS_IO_BACKEND_URING,
+    SS_IO_BACKEND_THREADPOOL
+} SsIoBackend;
+
+typedef enum {
+    SS_IO_OP_READ = 0,
+    SS_IO_OP_WRITE,
+    SS_IO_OP_FSYNC,
+    SS_IO_OP_RENAME
+} SsIoOp;
+
+struct SsIoBatch;
+
+/**
+ * I/O Request
+ * Filled in by the caller; result holds bytes transferred (or 0) on
+ * success and -errno on failure once the batch returns
+ */
+typedef struct SsIoRequest {
+    SsIoOp op;
+    int fd;                     // Ignored when file_index >= 0
+    void* buf;
+    size_t len;
+    off_t offset;
+    const char* path;           // RENAME source
+    const char* new_path;       // RENAME target
+    int buf_index;              // Registered buffer slot, -1 if none
+    int file_index;             // Registered file slot, -1 if none
+    bool link_next;             // Next request starts only after this one succeeds
+    long result;
+
+    // Internal
+    struct SsIoBatch* batch;
+    struct SsIoRequest* chain_next; // Rest of this link chain
+    struct SsIoRequest* queue_next; // Thread pool queue (chain heads only)
+} SsIoRequest;
+
+/**
+ * Start the I/O backend
+ * io_uring is probed first when preferred; kernels without it (or with it
+ * disabled) get the thread pool.
+ * @param preferred SS_IO_BACKEND_URING or SS_IO_BACKEND_THREADPOOL
+ * @return Backend actually selected
+ */
+SsIoBackend ss_io_init(SsIoBackend preferred);
+
+/**
+ * Stop the backend; later calls run synchronously
+ */
+void ss_io_shutdown(void);
+
+/**
+ * Name of the active backend ("io_uring", "threadpool" or "sync")
+ */
+const char* ss_io_backend_name(void);
+
+/**
+ * Submit a batch and wait for all of it
+ * Requests from many callers are in flight together; within one batch
+ * only link_next chains are ordered.
+ * @param reqs Requests
+ * @param count Number of requests
+ * @return 0 if every request succeeded, -1 otherwise (see each result)
+ */
+int ss_io_submit(SsIoRequest* reqs, int count);
+
+/**
+ * Initialize a request
+ * A buf inside one registered buffer and an fd in the fixed file table
+ * are used as such (READ_FIXED / WRITE_FIXED, IOSQE_FIXED_FILE on io_uring).
+ */
+void ss_io_prep(SsIoRequest* req, SsIoOp op, int fd, void* buf, size_t len, off_t offset);
+
+/**
+ * Single-request helpers (full transfers; short reads only at EOF)
+ * @return Bytes transferred, or -1 with errno set
+ */
+ssize_t ss_io_pread_all(int fd, void* buf, size_t len, off_t offset);
+ssize_t ss_io_pwrite_all(int fd, const void* buf, size_t len, off_t offset);
+
+/**
+ * Write a whole buffer and fsync it as one linked submission
+ * @return 0 on success, -1 with errno set
+ */
+int ss_io_write_and_sync(int fd, const void* buf, size_t len);
+
+/**
+ * rename(2) through the backend
+ * @return 0 on success, -1 with errno set
+ */
+int ss_io_rename(const char* old_path, const char* new_path);
+
+/**
+ * Borrow / return a registered buffer (SS_IO_FIXED_BUFFER_SIZE bytes)
+ * Reads and writes through it skip pinning its pages per request.
+ * @param index Output slot, for ss_io_buffer_put
+ * @return Buffer, NULL if all are in use or the backend has no pool
+ *         (the caller then uses its own memory)
+ */
+void* ss_io_buffer_get(int* index);
+void ss_io_buffer_put(int index);
+
+/**
+ * Register / unregister a descriptor in the fixed file table
+ * Requests on it then skip the per-request file lookup. The descriptor
+ * must be unregistered before it is closed.
+ * @return Slot, -1 if the table is full or unsupported
+ */
+int ss_io_register_file(int fd);
+void ss_io_unregister_file(int slot);
+
+#endif // SS_IO_H
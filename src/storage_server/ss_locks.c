@@ -0,0 +1,840 @@
+#include "ss_server.h"
+#include "ss_locks.h"
+#include "../common/hash_utils.h"
+#include "../common/utils.h"
+#include "../common/logger.h"
+#include "../common/error_codes.h"
+#include "../common/metrics.h"
+#include "../common/trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+/* ===============================================
+ * TABLE HELPERS
+ * =============================================== */
+
+uint64_t ss_file_id(const char* filepath) {
+    return fnv1a_64(filepath, strlen(filepath));
+}
+
+static LockStripe* stripe_for(LockTable* table, uint64_t file_id) {
+    return &table->stripes[hash_mix64(file_id) % LOCK_STRIPES];
+}
+
+static SentenceLock** bucket_for(LockStripe* stripe, uint64_t file_id, int sentence_idx) {
+    uint64_t key = hash_mix64(file_id ^ ((uint64_t)(uint32_t)sentence_idx * 0x9e3779b97f4a7c15ULL));
+    return &stripe->buckets[key % LOCK_BUCKETS_PER_STRIPE];
+}
+
+static ClientLockStripe* client_stripe_for(LockTable* table, int client_fd) {
+    return &table->client_stripes[(unsigned)client_fd % CLIENT_LOCK_STRIPES];
+}
+
+// Caller holds stripe->mutex
+static SentenceLock* find_lock(LockStripe* stripe, uint64_t file_id, int sentence_idx) {
+    SentenceLock* lock = *bucket_for(stripe, file_id, sentence_idx);
+    while (lock) {
+        if (lock->file_id == file_id && lock->sentence_idx == sentence_idx) {
+            return lock;
+        }
+        lock = lock->next;
+    }
+    return NULL;
+}
+
+// Caller holds stripe->mutex
+static void adjust_file_count(LockStripe* stripe, uint64_t file_id, int delta) {
+    FileLockCount** slot = &stripe->files[hash_mix64(file_id) % LOCK_FILE_BUCKETS_PER_STRIPE];
+    FileLockCount* fc = *slot;
+    FileLockCount* prev = NULL;
+
+    while (fc && fc->file_id != file_id) {
+        prev = fc;
+        fc = fc->next;
+    }
+
+    if (!fc) {
+        if (delta <= 0) return;
+        fc = calloc(1, sizeof(FileLockCount));
+        if (!fc) return;
+        fc->file_id = file_id;
+        fc->next = *slot;
+        *slot = fc;
+    }
+
+    fc->count += delta;
+    if (fc->count <= 0) {
+        if (prev) {
+            prev->next = fc->next;
+        } else {
+            *slot = fc->next;
+        }
+        free(fc);
+    }
+}
+
+// Caller holds stripe->mutex; unlinks and frees the lock once nobody holds
+// or waits for it
+static void drop_lock_if_unused(LockStripe* stripe, SentenceLock* lock) {
+    if (lock->writer_fd >= 0 || lock->read_count > 0 || lock->wait_head) return;
+
+    SentenceLock** link = bucket_for(stripe, lock->file_id, lock->sentence_idx);
+    while (*link && *link != lock) {
+        link = &(*link)->next;
+    }
+    if (*link) *link = lock->next;
+
+    adjust_file_count(stripe, lock->file_id, -1);
+    free(lock);
+}
+
+// Caller holds stripe->mutex
+static SentenceLock* create_lock(LockStripe* stripe, uint64_t file_id, int sentence_idx) {
+    SentenceLock* lock = calloc(1, sizeof(SentenceLock));
+    if (!lock) return NULL;
+
+    lock->file_id = file_id;
+    lock->sentence_idx = sentence_idx;
+    lock->writer_fd = -1;
+    lock->read_count = 0;
+    lock->acquired_at = time(NULL);
+
+    SentenceLock** bucket = bucket_for(stripe, file_id, sentence_idx);
+    lock->next = *bucket;
+    *bucket = lock;
+
+    adjust_file_count(stripe, file_id, 1);
+    return lock;
+}
+
+/* ===============================================
+ * WAIT QUEUES
+ * =============================================== */
+
+static bool lock_is_grantable(const SentenceLock* lock, bool is_write) {
+    if (is_write) {
+        return lock->writer_fd < 0 && lock->read_count == 0;
+    }
+    return lock->writer_fd < 0;
+}
+
+// Caller holds stripe->mutex. Hands the lock to waiters from the head of
+// the queue: one writer, or every reader up to the next queued writer.
+static void grant_waiters(SentenceLock* lock) {
+    while (lock->wait_head) {
+        LockWaiter* waiter = lock->wait_head;
+        if (!lock_is_grantable(lock, waiter->is_write)) break;
+
+        if (waiter->is_write) {
+            lock->writer_fd = waiter->client_fd;
+            lock->acquired_at = time(NULL);
+        } else {
+            lock->read_count++;
+        }
+
+        lock->wait_head = waiter->next;
+        if (!lock->wait_head) lock->wait_tail = NULL;
+        waiter->granted = true;
+        pthread_cond_signal(&waiter->cond);
+
+        if (waiter->is_write) break;
+    }
+}
+
+// Caller holds stripe->mutex
+static void remove_waiter(SentenceLock* lock, LockWaiter* waiter) {
+    LockWaiter* prev = NULL;
+    LockWaiter* cur = lock->wait_head;
+    while (cur && cur != waiter) {
+        prev = cur;
+        cur = cur->next;
+    }
+    if (!cur) return;
+
+    if (prev) {
+        prev->next = cur->next;
+    } else {
+        lock->wait_head = cur->next;
+    }
+    if (lock->wait_tail == cur) lock->wait_tail = prev;
+}
+
+/* ===============================================
+ * LEASES
+ * =============================================== */
+
+static uint64_t lease_tick(long long ms) {
+    // Round up so a lease never fires before its deadline
+    return (uint64_t)((ms + LOCK_REAPER_TICK_MS - 1) / LOCK_REAPER_TICK_MS);
+}
+
+// Caller holds the client stripe mutex (client stripe -> lease_mutex order)
+static void schedule_lease(LockTable* table, int client_fd, HeldLock* held) {
+    LeaseTimer* timer = calloc(1, sizeof(LeaseTimer));
+    if (!timer) return;
+
+    timer->file_id = held->file_id;
+    timer->sentence_idx = held->sentence_idx;
+    timer->client_fd = client_fd;
+
+    pthread_mutex_lock(&table->lease_mutex);
+    timer->lease_id = ++table->next_lease_id;
+    held->lease_id = timer->lease_id;
+    timer_wheel_add(&table->lease_wheel, &timer->node, lease_tick(held->lease_expires_ms));
+    pthread_mutex_unlock(&table->lease_mutex);
+}
+
+static void record_hold_time(LockTable* table, const HeldLock* held, bool reclaimed) {
+    long long held_ms = monotonic_timestamp_ms() - held->acquired_ms;
+    if (held_ms < 0) held_ms = 0;
+
+    pthread_mutex_lock(&table->lease_mutex);
+    if (reclaimed) {
+        table->locks_reclaimed++;
+    } else {
+        table->locks_released++;
+    }
+    table->total_hold_ms += (uint64_t)held_ms;
+    pthread_mutex_unlock(&table->lease_mutex);
+}
+
+/* ===============================================
+ * PER-CLIENT HELD LOCKS
+ * =============================================== */
+
+static void record_held_lock(LockTable* table, int client_fd, uint64_t file_id,
+                             int sentence_idx, bool is_write) {
+    ClientLockStripe* cs = client_stripe_for(table, client_fd);
+    pthread_mutex_lock(&cs->mutex);
+
+    ClientLocks* client = cs->clients;
+    while (client && client->client_fd != client_fd) {
+        client = client->next;
+    }
+    if (!client) {
+        client = calloc(1, sizeof(ClientLocks));
+        if (!client) {
+            pthread_mutex_unlock(&cs->mutex);
+            return;
+        }
+        client->client_fd = client_fd;
+        client->next = cs->clients;
+        cs->clients = client;
+    }
+
+    long long now = monotonic_timestamp_ms();
+
+    HeldLock* held = client->held;
+    while (held) {
+        if (held->file_id == file_id && held->sentence_idx == sentence_idx &&
+            held->is_write_lock == is_write) {
+            // Re-entrant read: the existing timer picks up the new deadline
+            held->count++;
+            held->lease_expires_ms = now + LOCK_LEASE_MS;
+            pthread_mutex_unlock(&cs->mutex);
+            return;
+        }
+        held = held->next;
+    }
+
+    held = calloc(1, sizeof(HeldLock));
+    if (held) {
+        held->file_id = file_id;
+        held->sentence_idx = sentence_idx;
+        held->is_write_lock = is_write;
+        held->count = 1;
+        held->acquired_ms = now;
+        held->lease_expires_ms = now + LOCK_LEASE_MS;
+        held->next = client->held;
+        client->held = held;
+        schedule_lease(table, client_fd, held);
+    }
+
+    pthread_mutex_unlock(&cs->mutex);
+}
+
+// Removes one acquisition from the client's list
+// Returns 1 for a write lock, 0 for a read lock, -1 if the client holds none
+static int forget_held_lock(LockTable* table, int client_fd, uint64_t file_id,
+                            int sentence_idx) {
+    ClientLockStripe* cs = client_stripe_for(table, client_fd);
+    pthread_mutex_lock(&cs->mutex);
+
+    ClientLocks* client = cs->clients;
+    ClientLocks* prev_client = NULL;
+    while (client && client->client_fd != client_fd) {
+        prev_client = client;
+        client = client->next;
+    }
+    if (!client) {
+        pthread_mutex_unlock(&cs->mutex);
+        return -1;
+    }
+
+    int result = -1;
+    HeldLock** link = &client->held;
+    while (*link) {
+        HeldLock* held = *link;
+        if (held->file_id == file_id && held->sentence_idx == sentence_idx) {
+            result = held->is_write_lock ? 1 : 0;
+            if (--held->count == 0) {
+                // Its lease timer is left in the wheel and freed when it fires
+                *link = held->next;
+                record_hold_time(table, held, false);
+                free(held);
+            }
+            break;
+        }
+        link = &held->next;
+    }
+
+    if (!client->held) {
+        if (prev_client) {
+            prev_client->next = client->next;
+        } else {
+            cs->clients = client->next;
+        }
+        free(client);
+    }
+
+    pthread_mutex_unlock(&cs->mutex);
+    return result;
+}
+
+/* ===============================================
+ * INITIALIZATION
+ * =============================================== */
+
+void lock_table_init(LockTable* table) {
+    memset(table, 0, sizeof(LockTable));
+    for (int i = 0; i < LOCK_STRIPES; i++) {
+        pthread_mutex_init(&table->stripes[i].mutex, NULL);
+    }
+    for (int i = 0; i < CLIENT_LOCK_STRIPES; i++) {
+        pthread_mutex_init(&table->client_stripes[i].mutex, NULL);
+    }
+
+    timer_wheel_init(&table->lease_wheel, lease_tick(monotonic_timestamp_ms()));
+    pthread_mutex_init(&table->lease_mutex, NULL);
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&table->reaper_cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&table->reaper_mutex, NULL);
+}
+
+void lock_table_destroy(LockTable* table) {
+    lock_table_stop_reaper(table);
+
+    for (int i = 0; i < LOCK_STRIPES; i++) {
+        LockStripe* stripe = &table->stripes[i];
+        pthread_mutex_lock(&stripe->mutex);
+        for (int b = 0; b < LOCK_BUCKETS_PER_STRIPE; b++) {
+            SentenceLock* lock = stripe->buckets[b];
+            while (lock) {
+                SentenceLock* next = lock->next;
+                free(lock);
+                lock = next;
+            }
+            stripe->buckets[b] = NULL;
+        }
+        for (int b = 0; b < LOCK_FILE_BUCKETS_PER_STRIPE; b++) {
+            FileLockCount* fc = stripe->files[b];
+            while (fc) {
+                FileLockCount* next = fc->next;
+                free(fc);
+                fc = next;
+            }
+            stripe->files[b] = NULL;
+        }
+        pthread_mutex_unlock(&stripe->mutex);
+        pthread_mutex_destroy(&stripe->mutex);
+    }
+
+    for (int i = 0; i < CLIENT_LOCK_STRIPES; i++) {
+        ClientLockStripe* cs = &table->client_stripes[i];
+        pthread_mutex_lock(&cs->mutex);
+        ClientLocks* client = cs->clients;
+        while (client) {
+            ClientLocks* next = client->next;
+            HeldLock* held = client->held;
+            while (held) {
+                HeldLock* next_held = held->next;
+                free(held);
+                held = next_held;
+            }
+            free(client);
+            client = next;
+        }
+        cs->clients = NULL;
+        pthread_mutex_unlock(&cs->mutex);
+        pthread_mutex_destroy(&cs->mutex);
+    }
+
+    // Every pending LeaseTimer is owned by the wheel
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            TimerNode* head = &table->lease_wheel.slots[level][slot];
+            TimerNode* node = head->next;
+            while (node != head) {
+                TimerNode* next = node->next;
+                free(node);
+                node = next;
+            }
+        }
+    }
+    timer_wheel_init(&table->lease_wheel, 0);
+
+    pthread_mutex_destroy(&table->lease_mutex);
+    pthread_mutex_destroy(&table->reaper_mutex);
+    pthread_cond_destroy(&table->reaper_cond);
+}
+
+/* ===============================================
+ * LOCKING MECHANISMS
+ * =============================================== */
+
+// Shared acquisition path for read and write locks
+static int acquire_lock(StorageServerState* state, const char* filepath,
+                        int sentence_idx, int client_fd, bool is_write,
+                        int timeout_ms) {
+    if (!state || !filepath) return ERR_INVALID_OPERATION;
+
+    uint64_t file_id = ss_file_id(filepath);
+    LockStripe* stripe = stripe_for(&state->lock_table, file_id);
+
+    pthread_mutex_lock(&stripe->mutex);
+
+    SentenceLock* lock = find_lock(stripe, file_id, sentence_idx);
+    if (!lock) {
+        lock = create_lock(stripe, file_id, sentence_idx);
+        if (!lock) {
+            pthread_mutex_unlock(&stripe->mutex);
+            return ERR_INVALID_OPERATION;
+        }
+    }
+
+    // Only take the lock directly when nobody is queued; otherwise a
+    // stream of readers could keep a waiting writer out forever
+    if (!lock->wait_head && lock_is_grantable(lock, is_write)) {
+        if (is_write) {
+            lock->writer_fd = client_fd;
+            lock->acquired_at = time(NULL);
+        } else {
+            lock->read_count++;
+        }
+        pthread_mutex_unlock(&stripe->mutex);
+
+        record_held_lock(&state->lock_table, client_fd, file_id, sentence_idx, is_write);
+        return ERR_SUCCESS;
+    }
+
+    if (timeout_ms == LOCK_WAIT_NONE) {
+        drop_lock_if_unused(stripe, lock);
+        pthread_mutex_unlock(&stripe->mutex);
+        return ERR_FILE_LOCKED;
+    }
+
+    LockWaiter waiter;
+    memset(&waiter, 0, sizeof(waiter));
+    waiter.client_fd = client_fd;
+    waiter.is_write = is_write;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&waiter.cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (lock->wait_tail) {
+        lock->wait_tail->next = &waiter;
+    } else {
+        lock->wait_head = &waiter;
+    }
+    lock->wait_tail = &waiter;
+
+    struct timespec deadline;
+    if (timeout_ms > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    uint64_t wait_start = metrics_now_us();
+    while (!waiter.granted) {
+        int rc = (timeout_ms > 0)
+            ? pthread_cond_timedwait(&waiter.cond, &stripe->mutex, &deadline)
+            : pthread_cond_wait(&waiter.cond, &stripe->mutex);
+        if (rc == ETIMEDOUT && !waiter.granted) break;
+    }
+
+    int result = ERR_SUCCESS;
+    if (!waiter.granted) {
+        // Leaving the queue may unblock readers that were behind us
+        remove_waiter(lock, &waiter);
+        grant_waiters(lock);
+        drop_lock_if_unused(stripe, lock);
+        result = ERR_FILE_LOCKED;
+    }
+
+    pthread_mutex_unlock(&stripe->mutex);
+    pthread_cond_destroy(&waiter.cond);
+    uint64_t waited = metrics_now_us() - wait_start;
+    metrics_record(METRIC_LOCK_WAIT, waited, result != ERR_SUCCESS);
+    trace_add_stage(TRACE_STAGE_LOCK_WAIT, waited);
+
+    if (result == ERR_SUCCESS) {
+        record_held_lock(&state->lock_table, client_fd, file_id, sentence_idx, is_write);
+    }
+    return result;
+}
+
+int acquire_read_lock(StorageServerState* state, const char* filepath,
+                      int sentence_idx, int client_fd) {
+    return acquire_lock(state, filepath, sentence_idx, client_fd, false, LOCK_WAIT_NONE);
+}
+
+int acquire_write_lock(StorageServerState* state, const char* filepath,
+                       int sentence_idx, int client_fd) {
+    return acquire_lock(state, filepath, sentence_idx, client_fd, true, LOCK_WAIT_NONE);
+}
+
+int acquire_read_lock_timed(StorageServerState* state, const char* filepath,
+                            int sentence_idx, int client_fd, int timeout_ms) {
+    return acquire_lock(state, filepath, sentence_idx, client_fd, false, timeout_ms);
+}
+
+int acquire_write_lock_timed(StorageServerState* state, const char* filepath,
+                             int sentence_idx, int client_fd, int timeout_ms) {
+    return acquire_lock(state, filepath, sentence_idx, client_fd, true, timeout_ms);
+}
+
+// Undo one acquisition of a lock in the table
+static void unlock_in_table(LockTable* table, uint64_t file_id, int sentence_idx,
+                            bool is_write, int count) {
+    LockStripe* stripe = stripe_for(table, file_id);
+    pthread_mutex_lock(&stripe->mutex);
+
+    SentenceLock* lock = find_lock(stripe, file_id, sentence_idx);
+    if (lock) {
+        if (is_write) {
+            lock->writer_fd = -1;
+        } else {
+            lock->read_count -= count;
+            if (lock->read_count < 0) lock->read_count = 0;
+        }
+        grant_waiters(lock);
+        drop_lock_if_unused(stripe, lock);
+    }
+
+    pthread_mutex_unlock(&stripe->mutex);
+}
+
+int release_lock(StorageServerState* state, const char* filepath,
+                 int sentence_idx, int client_fd) {
+    if (!state || !filepath) return ERR_INVALID_OPERATION;
+
+    uint64_t file_id = ss_file_id(filepath);
+
+    // The client's own list says which kind of lock it holds
+    int kind = forget_held_lock(&state->lock_table, client_fd, file_id, sentence_idx);
+    if (kind < 0) {
+        return ERR_INVALID_OPERATION;
+    }
+
+    unlock_in_table(&state->lock_table, file_id, sentence_idx, kind == 1, 1);
+    return ERR_SUCCESS;
+}
+
+int release_all_locks_for_client(StorageServerState* state, int client_fd) {
+    if (!state) return 0;
+
+    // Detach the client's list first; table stripes are taken afterwards so
+    // the two mutex families are never held together
+    ClientLockStripe* cs = client_stripe_for(&state->lock_table, client_fd);
+    pthread_mutex_lock(&cs->mutex);
+
+    ClientLocks* client = cs->clients;
+    ClientLocks* prev = NULL;
+    while (client && client->client_fd != client_fd) {
+        prev = client;
+        client = client->next;
+    }
+    if (client) {
+        if (prev) {
+            prev->next = client->next;
+        } else {
+            cs->clients = client->next;
+        }
+    }
+
+    pthread_mutex_unlock(&cs->mutex);
+
+    if (!client) return 0;
+
+    int count = 0;
+    HeldLock* held = client->held;
+    while (held) {
+        HeldLock* next = held->next;
+        unlock_in_table(&state->lock_table, held->file_id, held->sentence_idx,
+                        held->is_write_lock, held->count);
+        record_hold_time(&state->lock_table, held, false);
+        free(held);
+        count++;
+        held = next;
+    }
+    free(client);
+
+    return count;
+}
+
+bool is_file_locked(StorageServerState* state, const char* filepath) {
+    if (!state || !filepath) return false;
+
+    uint64_t file_id = ss_file_id(filepath);
+    LockStripe* stripe = stripe_for(&state->lock_table, file_id);
+
+    pthread_mutex_lock(&stripe->mutex);
+
+    bool locked = false;
+    FileLockCount* fc = stripe->files[hash_mix64(file_id) % LOCK_FILE_BUCKETS_PER_STRIPE];
+    while (fc) {
+        if (fc->file_id == file_id) {
+            locked = fc->count > 0;
+            break;
+        }
+        fc = fc->next;
+    }
+
+    pthread_mutex_unlock(&stripe->mutex);
+    return locked;
+}
+
+bool is_sentence_locked(StorageServerState* state, const char* filepath,
+                        int sentence_idx) {
+    if (!state || !filepath) return false;
+
+    uint64_t file_id = ss_file_id(filepath);
+    LockStripe* stripe = stripe_for(&state->lock_table, file_id);
+
+    pthread_mutex_lock(&stripe->mutex);
+    bool locked = find_lock(stripe, file_id, sentence_idx) != NULL;
+    pthread_mutex_unlock(&stripe->mutex);
+
+    return locked;
+}
+
+int renew_lock_lease(StorageServerState* state, const char* filepath,
+                     int sentence_idx, int client_fd) {
+    if (!state || !filepath) return ERR_INVALID_OPERATION;
+
+    uint64_t file_id = ss_file_id(filepath);
+    ClientLockStripe* cs = client_stripe_for(&state->lock_table, client_fd);
+    pthread_mutex_lock(&cs->mutex);
+
+    int result = ERR_INVALID_OPERATION;
+    ClientLocks* client = cs->clients;
+    while (client && client->client_fd != client_fd) {
+        client = client->next;
+    }
+    if (client) {
+        long long expires = monotonic_timestamp_ms() + LOCK_LEASE_MS;
+        for (HeldLock* held = client->held; held; held = held->next) {
+            if (held->file_id == file_id && held->sentence_idx == sentence_idx) {
+                // The reaper reschedules the timer when it sees the new deadline
+                held->lease_expires_ms = expires;
+                result = ERR_SUCCESS;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&cs->mutex);
+    return result;
+}
+
+/* ===============================================
+ * LEASE REAPER
+ * =============================================== */
+
+int lock_table_reap(LockTable* table, long long now_ms) {
+    if (!table) return 0;
+
+    pthread_mutex_lock(&table->lease_mutex);
+    TimerNode* expired = timer_wheel_advance(&table->lease_wheel, lease_tick(now_ms));
+    pthread_mutex_unlock(&table->lease_mutex);
+
+    int reclaimed = 0;
+    while (expired) {
+        TimerNode* next_node = expired->next;
+        LeaseTimer* timer = (LeaseTimer*)expired;
+        expired = next_node;
+
+        ClientLockStripe* cs = client_stripe_for(table, timer->client_fd);
+        pthread_mutex_lock(&cs->mutex);
+
+        ClientLocks* client = cs->clients;
+        ClientLocks* prev_client = NULL;
+        while (client && client->client_fd != timer->client_fd) {
+            prev_client = client;
+            client = client->next;
+        }
+
+        HeldLock** link = client ? &client->held : NULL;
+        while (link && *link && (*link)->lease_id != timer->lease_id) {
+            link = &(*link)->next;
+        }
+
+        if (!link || !*link) {
+            // Released (or re-acquired under a new lease) since scheduling
+            pthread_mutex_unlock(&cs->mutex);
+            free(timer);
+            continue;
+        }
+
+        HeldLock* held = *link;
+        if (held->lease_expires_ms > now_ms) {
+            // Renewed: wait for the new deadline
+            pthread_mutex_lock(&table->lease_mutex);
+            timer_wheel_add(&table->lease_wheel, &timer->node,
+                            lease_tick(held->lease_expires_ms));
+            pthread_mutex_unlock(&table->lease_mutex);
+            pthread_mutex_unlock(&cs->mutex);
+            continue;
+        }
+
+        *link = held->next;
+        if (!client->held) {
+            if (prev_client) {
+                prev_client->next = client->next;
+            } else {
+                cs->clients = client->next;
+            }
+            free(client);
+        }
+        pthread_mutex_unlock(&cs->mutex);
+
+        unlock_in_table(table, held->file_id, held->sentence_idx,
+                        held->is_write_lock, held->count);
+        record_hold_time(table, held, true);
+
+        char log_msg[128];
+        snprintf(log_msg, sizeof(log_msg),
+                 "LEASE_EXPIRED - %s lock on sentence %d reclaimed from client %d",
+                 held->is_write_lock ? "write" : "read", held->sentence_idx,
+                 timer->client_fd);
+        log_message("SS", "0.0.0.0", 0, "system", "LOCK_REAPER", log_msg, "SUCCESS");
+
+        free(held);
+        free(timer);
+        reclaimed++;
+    }
+
+    return reclaimed;
+}
+
+static void* lock_reaper_thread_func(void* arg) {
+    LockTable* table = (LockTable*)arg;
+
+    pthread_mutex_lock(&table->reaper_mutex);
+    while (table->reaper_running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_nsec += (long)LOCK_REAPER_TICK_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        pthread_cond_timedwait(&table->reaper_cond, &table->reaper_mutex, &deadline);
+        if (!table->reaper_running) break;
+
+        pthread_mutex_unlock(&table->reaper_mutex);
+        lock_table_reap(table, monotonic_timestamp_ms());
+        pthread_mutex_lock(&table->reaper_mutex);
+    }
+    pthread_mutex_unlock(&table->reaper_mutex);
+
+    return NULL;
+}
+
+int lock_table_start_reaper(LockTable* table) {
+    if (!table) return -1;
+
+    pthread_mutex_lock(&table->reaper_mutex);
+    table->reaper_running = true;
+    pthread_mutex_unlock(&table->reaper_mutex);
+
+    if (pthread_create(&table->reaper_thread, NULL, lock_reaper_thread_func, table) != 0) {
+        table->reaper_running = false;
+        return -1;
+    }
+    table->reaper_started = true;
+    return 0;
+}
+
+void lock_table_stop_reaper(LockTable* table) {
+    if (!table || !table->reaper_started) return;
+
+    pthread_mutex_lock(&table->reaper_mutex);
+    table->reaper_running = false;
+    pthread_cond_signal(&table->reaper_cond);
+    pthread_mutex_unlock(&table->reaper_mutex);
+
+    pthread_join(table->reaper_thread, NULL);
+    table->reaper_started = false;
+}
+
+void lock_table_get_stats(LockTable* table, LockStats* stats) {
+    if (!table || !stats) return;
+
+    pthread_mutex_lock(&table->lease_mutex);
+    stats->locks_released = table->locks_released;
+    stats->locks_reclaimed = table->locks_reclaimed;
+    stats->total_hold_ms = table->total_hold_ms;
+    uint64_t finished = table->locks_released + table->locks_reclaimed;
+    stats->avg_hold_ms = finished ? table->total_hold_ms / finished : 0;
+    stats->leases_pending = table->lease_wheel.count;
+    pthread_mutex_unlock(&table->lease_mutex);
+}
+
+int lock_table_format_stats(LockTable* table, char* buf, size_t len) {
+    LockStats stats = {0};
+    lock_table_get_stats(table, &stats);
+    int n = snprintf(buf, len, "LOCKS:released=%llu reclaimed=%llu avg_hold_ms=%llu leases_pending=%zu\n",
+                     (unsigned long long)stats.locks_released,
+                     (unsigned long long)stats.locks_reclaimed,
+                     (unsigned long long)stats.avg_hold_ms, stats.leases_pending);
+    if (n < 0 || len == 0) return 0;
+    return (size_t)n < len ? n : (int)len - 1;
+}
+
+int lock_table_format_exposition(const char* prefix, char* buf, size_t len, void* table) {
+    LockStats stats = {0};
+    lock_table_get_stats(table, &stats);
+    int n = snprintf(buf, len,
+                     "# HELP %s_locks_total Sentence locks that ended, by how\n"
+                     "# TYPE %s_locks_total counter\n"
+                     "%s_locks_total{end=\"released\"} %llu\n"
+                     "%s_locks_total{end=\"reclaimed\"} %llu\n"
+                     "# HELP %s_lock_hold_ms_total Time sentence locks were held\n"
+                     "# TYPE %s_lock_hold_ms_total counter\n"
+                     "%s_lock_hold_ms_total %llu\n"
+                     "# HELP %s_lock_leases Lock leases waiting to expire\n"
+                     "# TYPE %s_lock_leases gauge\n"
+                     "%s_lock_leases %zu\n",
+                     prefix, prefix, prefix, (unsigned long long)stats.locks_released,
+                     prefix, (unsigned long long)stats.locks_reclaimed,
+                     prefix, prefix, prefix, (unsigned long long)stats.total_hold_ms,
+                     prefix, prefix, prefix, stats.leases_pending);
+    if (n < 0 || len == 0) return 0;
+    return (size_t)n < len ? n : (int)len - 1;
+}
@@ -0,0 +1,204 @@
+#ifndef SS_LOCKS_H
+#define SS_LOCKS_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "ss_timer_wheel.h"
+
+#define LOCK_STRIPES 64                  // Independent mutexes (by file ID)
+#define LOCK_BUCKETS_PER_STRIPE 64       // Sentence lock chains per stripe
+#define LOCK_FILE_BUCKETS_PER_STRIPE 16  // Per-file lock counters per stripe
+#define CLIENT_LOCK_STRIPES 64           // Held-lock lists (by client fd)
+
+#define LOCK_WAIT_NONE 0                 // Fail immediately if locked
+#define LOCK_WAIT_FOREVER -1             // Block until granted
+#define LOCK_WAIT_DEFAULT_MS 5000        // Used when the client gives no deadline
+#define LOCK_WAIT_MAX_MS 60000           // Upper bound on client-specified waits
+
+#define LOCK_LEASE_MS 30000              // Lease length; renewed by active writers
+#define LOCK_REAPER_TICK_MS 100          // Lease wheel granularity
+
+/**
+ * Lock Waiter
+ * Queued acquisition request; lives on the waiting thread's stack.
+ * Waiters are granted strictly in FIFO order.
+ */
+typedef struct LockWaiter {
+    pthread_cond_t cond;        // Signalled when granted
+    int client_fd;
+    bool is_write;
+    bool granted;
+    struct LockWaiter* next;
+} LockWaiter;
+
+/**
+ * Sentence Lock Structure
+ * One entry per locked (file, sentence) pair in the lock table
+ */
+typedef struct SentenceLock {
+    uint64_t file_id;           // Hash of the file path
+    int sentence_idx;           // Which sentence is locked
+    int writer_fd;              // Client holding the write lock, -1 if none
+    int read_count;             // Number of read locks held
+    time_t acquired_at;         // When lock was acquired
+    LockWaiter* wait_head;      // FIFO of blocked acquirers
+    LockWaiter* wait_tail;
+    struct SentenceLock* next;  // Bucket chain
+} SentenceLock;
+
+/**
+ * File Lock Count
+ * Number of sentence locks held on a file (answers is_file_locked in O(1))
+ */
+typedef struct FileLockCount {
+    uint64_t file_id;
+    int count;
+    struct FileLockCount* next;
+} FileLockCount;
+
+/**
+ * Lock Stripe
+ * All locks of one file hash to the same stripe, so unrelated files
+ * never contend on the same mutex
+ */
+typedef struct {
+    pthread_mutex_t mutex;
+    SentenceLock* buckets[LOCK_BUCKETS_PER_STRIPE];
+    FileLockCount* files[LOCK_FILE_BUCKETS_PER_STRIPE];
+} LockStripe;
+
+/**
+ * Held Lock
+ * Entry in a client's list of locks, used to release everything on disconnect
+ */
+typedef struct HeldLock {
+    uint64_t file_id;
+    int sentence_idx;
+    bool is_write_lock;
+    int count;                  // Re-entrant read acquisitions
+    long long acquired_ms;      // Monotonic time of first acquisition
+    long long lease_expires_ms; // Monotonic deadline; pushed out on renewal
+    uint64_t lease_id;          // Matches the LeaseTimer guarding this hold
+    struct HeldLock* next;
+} HeldLock;
+
+typedef struct ClientLocks {
+    int client_fd;
+    HeldLock* held;
+    struct ClientLocks* next;
+} ClientLocks;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    ClientLocks* clients;
+} ClientLockStripe;
+
+/**
+ * Lease Timer
+ * Wheel entry for one held lock. Releases don't touch the wheel: a timer
+ * whose lease_id no longer matches a held lock is simply freed when it
+ * fires, and one whose lease was renewed is rescheduled.
+ */
+typedef struct {
+    TimerNode node;
+    uint64_t file_id;
+    int sentence_idx;
+    int client_fd;
+    uint64_t lease_id;
+} LeaseTimer;
+
+/**
+ * Lock Statistics
+ */
+typedef struct {
+    uint64_t locks_released;    // Released by their holder
+    uint64_t locks_reclaimed;   // Taken back after the lease expired
+    uint64_t total_hold_ms;     // Across released and reclaimed locks
+    uint64_t avg_hold_ms;
+    size_t leases_pending;      // Timers currently in the wheel
+} LockStats;
+
+/**
+ * Lock Table
+ * Sentence locks hashed by (file ID, sentence index) with striped mutexes,
+ * plus a per-client index of held locks and a lease wheel reaped by a
+ * background thread
+ */
+typedef struct {
+    LockStripe stripes[LOCK_STRIPES];
+    ClientLockStripe client_stripes[CLIENT_LOCK_STRIPES];
+
+    TimerWheel lease_wheel;
+    pthread_mutex_t lease_mutex;    // Guards the wheel, next_lease_id and stats
+    uint64_t next_lease_id;
+    uint64_t locks_released;
+    uint64_t locks_reclaimed;
+    uint64_t total_hold_ms;
+
+    pthread_t reaper_thread;
+    pthread_mutex_t reaper_mutex;
+    pthread_cond_t reaper_cond;
+    bool reaper_running;
+    bool reaper_started;
+} LockTable;
+
+/**
+ * Initialize / destroy the lock table (destroy stops the reaper)
+ */
+void lock_table_init(LockTable* table);
+void lock_table_destroy(LockTable* table);
+
+/**
+ * Start / stop the lease reaper thread
+ * @param table Lock table
+ * @return 0 on success, -1 on error
+ */
+int lock_table_start_reaper(LockTable* table);
+void lock_table_stop_reaper(LockTable* table);
+
+/**
+ * Reclaim every lock whose lease ran out by the given time
+ * (one reaper tick; exposed for tests)
+ * @param table Lock table
+ * @param now_ms Monotonic time in milliseconds
+ * @return Number of locks reclaimed
+ */
+int lock_table_reap(LockTable* table, long long now_ms);
+
+/**
+ * Snapshot lock statistics
+ * @param table Lock table
+ * @param stats Output statistics
+ */
+void lock_table_get_stats(LockTable* table, LockStats* stats);
+
+/**
+ * Format lock statistics as one STATS line
+ * ("LOCKS:released=.. reclaimed=.. avg_hold_ms=.. leases_pending=..")
+ * @param table Lock table
+ * @param buf Output buffer
+ * @param len Buffer size
+ * @return Length written
+ */
+int lock_table_format_stats(LockTable* table, char* buf, size_t len);
+
+/**
+ * Format lock statistics for the metrics exposition (a MetricsExtraFn)
+ * @param prefix Metric name prefix
+ * @param buf Output buffer
+ * @param len Buffer size
+ * @param table Lock table
+ * @return Length written
+ */
+int lock_table_format_exposition(const char* prefix, char* buf, size_t len, void* table);
+
+/**
+ * Compute the file ID used as the lock key for a relative path
+ * @param filepath Relative filepath
+ * @return 64-bit file ID
+ */
+uint64_t ss_file_id(const char* filepath);
+
+#endif // SS_LOCKS_H
@@ -0,0 +1,285 @@
+#include "ss_meta.h"
+#include "ss_server.h"
+#include "ss_io.h"
+#include "../common/hash_utils.h"
+#include "../common/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#define META_ALIGN(n) (((n) + 7) & ~(size_t)7)
+
+/* ===============================================
+ * LOADING
+ * =============================================== */
+
+static const char* record_path(const MetaRecord* record) {
+    return (const char*)(record + 1);
+}
+
+static int64_t stat_mtime_ns(const struct stat* st) {
+    return (int64_t)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+}
+
+static uint32_t header_crc(const MetaHeader* header) {
+    return crc32c(0, header, offsetof(MetaHeader, header_crc));
+}
+
+static void index_insert(MetaStore* store, const MetaRecord* record) {
+    size_t offset = (const char*)record - (const char*)store->map;
+    size_t slot = fnv1a_64(record_path(record), record->path_len) & store->slot_mask;
+    while (store->slots[slot]) {
+        slot = (slot + 1) & store->slot_mask;
+    }
+    store->slots[slot] = (uint32_t)offset + 1;
+}
+
+// Checks the header, checksum and record bounds; returns the record
+// count, -1 if the file can't be trusted
+static long validate_map(const void* map, size_t size) {
+    if (size < sizeof(MetaHeader) || size > UINT32_MAX) return -1;
+
+    const MetaHeader* header = (const MetaHeader*)map;
+    if (header->magic != META_STORE_MAGIC || header->format != META_STORE_FORMAT ||
+        header->header_crc != header_crc(header) ||
+        header->body_size != size - sizeof(MetaHeader)) {
+        return -1;
+    }
+
+    const char* body = (const char*)map + sizeof(MetaHeader);
+    if (crc32c(0, body, header->body_size) != header->body_crc) return -1;
+
+    size_t pos = 0;
+    uint64_t count = 0;
+    while (pos < header->body_size) {
+        if (header->body_size - pos < sizeof(MetaRecord)) return -1;
+        const MetaRecord* record = (const MetaRecord*)(body + pos);
+        if (record->record_size != META_ALIGN(sizeof(MetaRecord) + record->path_len) ||
+            record->record_size > header->body_size - pos) {
+            return -1;
+        }
+        pos += record->record_size;
+        count++;
+    }
+
+    return count == header->record_count ? (long)count : -1;
+}
+
+size_t meta_store_open(MetaStore* store, const char* base_path) {
+    memset(store, 0, sizeof(MetaStore));
+    pthread_mutex_init(&store->save_mutex, NULL);
+    snprintf(store->path, sizeof(store->path), "%s/%s", base_path, META_STORE_FILE);
+
+    int fd = open(store->path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return 0;
+
+    long count = validate_map(map, (size_t)st.st_size);
+    if (count < 0) {
+        munmap(map, (size_t)st.st_size);
+        log_message("SS", "0.0.0.0", 0, "system", "META_LOAD",
+                   "Ignoring corrupt metadata sidecar", "ERROR");
+        return 0;
+    }
+
+    size_t slot_count = 16;
+    while (slot_count < (size_t)count * 2) slot_count *= 2;
+    store->slots = calloc(slot_count, sizeof(uint32_t));
+    if (!store->slots) {
+        munmap(map, (size_t)st.st_size);
+        return 0;
+    }
+    store->slot_mask = slot_count - 1;
+    store->map = map;
+    store->map_size = (size_t)st.st_size;
+    store->record_count = (size_t)count;
+
+    const char* body = (const char*)map + sizeof(MetaHeader);
+    size_t body_size = store->map_size - sizeof(MetaHeader);
+    for (size_t pos = 0; pos < body_size; ) {
+        const MetaRecord* record = (const MetaRecord*)(body + pos);
+        index_insert(store, record);
+        pos += record->record_size;
+    }
+
+    return store->record_count;
+}
+
+void meta_store_close(MetaStore* store) {
+    if (store->map) munmap(store->map, store->map_size);
+    free(store->slots);
+    store->map = NULL;
+    store->slots = NULL;
+    store->record_count = 0;
+    pthread_mutex_destroy(&store->save_mutex);
+}
+
+const MetaRecord* meta_store_find(MetaStore* store, const char* filepath,
+                                  const struct stat* st) {
+    if (!store || !store->map || !filepath || !st) return NULL;
+
+    size_t path_len = strlen(filepath);
+    size_t slot = fnv1a_64(filepath, path_len) & store->slot_mask;
+    while (store->slots[slot]) {
+        const MetaRecord* record =
+            (const MetaRecord*)((const char*)store->map + store->slots[slot] - 1);
+        if (record->path_len == path_len &&
+            memcmp(record_path(record), filepath, path_len) == 0) {
+            if (record->inode == (uint64_t)st->st_ino && record->size == st->st_size &&
+                record->mtime_ns == stat_mtime_ns(st) && record->sentence_count >= 0) {
+                __atomic_add_fetch(&store->hits, 1, __ATOMIC_RELAXED);
+                return record;
+            }
+            __atomic_add_fetch(&store->stale, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+        slot = (slot + 1) & store->slot_mask;
+    }
+    return NULL;
+}
+
+/* ===============================================
+ * SAVING
+ * =============================================== */
+
+typedef struct {
+    FileEntry** entries;
+    size_t count;
+    size_t capacity;
+} EntryList;
+
+static bool collect_entry(FileEntry* entry, void* arg) {
+    EntryList* list = (EntryList*)arg;
+    if (entry->is_directory) return true;
+
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 1024;
+        FileEntry** entries = realloc(list->entries, capacity * sizeof(FileEntry*));
+        if (!entries) return false;
+        list->entries = entries;
+        list->capacity = capacity;
+    }
+    file_entry_acquire(entry);
+    list->entries[list->count++] = entry;
+    return true;
+}
+
+// Appends one record to buf (grown as needed); 0 if the entry has nothing
+// trustworthy to save
+static int append_record(StorageServerState* state, FileEntry* entry,
+                         char** buf, size_t* size, size_t* capacity) {
+    MetaRecord record;
+    memset(&record, 0, sizeof(record));
+
+    // Under the commit mutex the stats, count and file on disk agree
+    pthread_mutex_t* commit_mutex = registry_commit_mutex(&state->registry, entry);
+    pthread_mutex_lock(commit_mutex);
+    struct stat st;
+    bool usable = !entry->removed && entry->sentence_count >= 0 &&
+                  stat(entry->full_path, &st) == 0 &&
+                  st.st_size == entry->file_size && st.st_mtime == entry->modified_at;
+    if (usable) {
+        record.inode = (uint64_t)st.st_ino;
+        record.mtime_ns = stat_mtime_ns(&st);
+        record.size = st.st_size;
+        record.version = entry->version;
+        record.sentence_count = entry->sentence_count;
+        record.repl_source = entry->repl_source;
+    }
+    pthread_mutex_unlock(commit_mutex);
+    if (!usable) return 0;
+
+    record.path_len = (uint32_t)strlen(entry->filepath);
+    record.record_size = (uint32_t)META_ALIGN(sizeof(MetaRecord) + record.path_len);
+
+    if (*size + record.record_size > *capacity) {
+        size_t new_capacity = *capacity ? *capacity * 2 : 65536;
+        while (new_capacity < *size + record.record_size) new_capacity *= 2;
+        char* grown = realloc(*buf, new_capacity);
+        if (!grown) return -1;
+        *buf = grown;
+        *capacity = new_capacity;
+    }
+
+    char* out = *buf + *size;
+    memcpy(out, &record, sizeof(record));
+    memcpy(out + sizeof(record), entry->filepath, record.path_len);
+    memset(out + sizeof(record) + record.path_len, 0,
+           record.record_size - sizeof(record) - record.path_len);
+    *size += record.record_size;
+    return 1;
+}
+
+int meta_store_save(MetaStore* store, StorageServerState* state) {
+    if (!store || !state) return -1;
+
+    EntryList list = {0};
+    registry_foreach(&state->registry, collect_entry, &list);
+
+    // Room for the header up front; records follow
+    char* buf = calloc(1, sizeof(MetaHeader));
+    size_t size = sizeof(MetaHeader);
+    size_t capacity = buf ? sizeof(MetaHeader) : 0;
+    uint64_t records = 0;
+    int result = buf ? 0 : -1;
+
+    for (size_t i = 0; i < list.count; i++) {
+        if (result == 0) {
+            int added = append_record(state, list.entries[i], &buf, &size, &capacity);
+            if (added < 0) result = -1;
+            else records += added;
+        }
+        file_entry_release(list.entries[i]);
+    }
+    free(list.entries);
+
+    if (result < 0) {
+        free(buf);
+        return -1;
+    }
+
+    MetaHeader* header = (MetaHeader*)buf;
+    header->magic = META_STORE_MAGIC;
+    header->format = META_STORE_FORMAT;
+    header->record_count = records;
+    header->body_size = size - sizeof(MetaHeader);
+    header->body_crc = crc32c(0, buf + sizeof(MetaHeader), header->body_size);
+    header->header_crc = header_crc(header);
+
+    // Same write-beside-and-rename as document commits, so a crash leaves
+    // either the old sidecar or the new one
+    pthread_mutex_lock(&store->save_mutex);
+    char tmp_path[sizeof(store->path) + 16];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", store->path);
+    int fd = mkstemp(tmp_path);
+    if (fd < 0) {
+        result = -1;
+    } else {
+        if (ss_io_write_and_sync(fd, buf, size) < 0) result = -1;
+        close(fd);
+        if (result == 0 && ss_io_rename(tmp_path, store->path) < 0) result = -1;
+        if (result < 0) unlink(tmp_path);
+    }
+    pthread_mutex_unlock(&store->save_mutex);
+    free(buf);
+
+    char log_msg[128];
+    snprintf(log_msg, sizeof(log_msg), "META_SAVE - %llu records",
+             (unsigned long long)records);
+    log_message("SS", "0.0.0.0", state->client_port, "system", "META_SAVE", log_msg,
+               result < 0 ? "ERROR" : "SUCCESS");
+
+    return result < 0 ? -1 : (int)records;
+}
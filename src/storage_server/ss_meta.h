@@ -0,0 +1,101 @@
+#ifndef SS_META_H
+#define SS_META_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#define META_STORE_FILE ".ssmeta"        // Lives under the SS base path
+#define META_STORE_MAGIC 0x444d5353      // "SSMD"
+#define META_STORE_FORMAT 1
+
+typedef struct StorageServerState StorageServerState;
+
+/**
+ * Metadata File Header
+ * Fixed header of the sidecar. The body (all records) is covered by
+ * body_crc and the header itself by header_crc, both CRC32C.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t format;
+    uint64_t record_count;
+    uint64_t body_size;
+    uint32_t body_crc;
+    uint32_t header_crc;             // Over the fields above
+} MetaHeader;
+
+/**
+ * Metadata Record
+ * Stats of one regular file as of the last save, followed by its relative
+ * path (not NUL-terminated) and padding to 8 bytes. A record only applies
+ * while the file's inode, mtime and size still match.
+ */
+typedef struct {
+    uint32_t record_size;            // Whole record including path and padding
+    uint32_t path_len;
+    uint64_t inode;
+    int64_t mtime_ns;
+    int64_t size;
+    uint64_t version;                // Entry version when saved
+    int32_t sentence_count;
+    int32_t repl_source;             // Entry's replication source (0: local)
+} MetaRecord;
+
+/**
+ * Metadata Store
+ * Read-only view of the sidecar saved by the previous run, mapped at
+ * startup and indexed by path so the scan can take stats from it instead
+ * of reading file content. Saving writes a fresh file and renames it over
+ * the old one; the mapping stays valid until meta_store_close.
+ */
+typedef struct {
+    char path[512];
+    void* map;                       // Whole file, NULL if none or invalid
+    size_t map_size;
+    uint32_t* slots;                 // Open addressing: record offset + 1, 0 = empty
+    size_t slot_mask;
+    size_t record_count;
+
+    pthread_mutex_t save_mutex;      // One save at a time
+
+    // Statistics
+    uint64_t hits;                   // Scan entries served from the sidecar
+    uint64_t stale;                  // Records that no longer matched the file
+} MetaStore;
+
+/**
+ * Open the sidecar under a base path
+ * A missing, truncated or corrupt file leaves the store empty.
+ * @param store Metadata store
+ * @param base_path SS base directory
+ * @return Number of records loaded (0 if none)
+ */
+size_t meta_store_open(MetaStore* store, const char* base_path);
+
+/**
+ * Unmap the sidecar and free the index
+ */
+void meta_store_close(MetaStore* store);
+
+/**
+ * Find the saved record for a file, if it still describes it
+ * @param store Metadata store
+ * @param filepath Relative filepath
+ * @param st Current stat of the file
+ * @return Record, NULL if missing or stale
+ */
+const MetaRecord* meta_store_find(MetaStore* store, const char* filepath,
+                                  const struct stat* st);
+
+/**
+ * Write the stats of every registered file whose sentence count is known
+ * @param store Metadata store
+ * @param state Storage server state (registry source)
+ * @return Number of records written, -1 on error
+ */
+int meta_store_save(MetaStore* store, StorageServerState* state);
+
+#endif // SS_META_H
@@ -0,0 +1,220 @@
+#include "ss_registry.h"
+#include "ss_locks.h"
+#include "../common/hash_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ===============================================
+ * TABLE HELPERS
+ * =============================================== */
+
+static size_t bucket_index(const FileRegistry* registry, uint64_t file_id) {
+    return hash_mix64(file_id) & (registry->bucket_count - 1);
+}
+
+// Caller holds the write lock. Failure to grow just leaves longer chains.
+static void grow_buckets(FileRegistry* registry) {
+    size_t new_count = registry->bucket_count * 2;
+    FileEntry** new_buckets = calloc(new_count, sizeof(FileEntry*));
+    if (!new_buckets) return;
+
+    for (size_t b = 0; b < registry->bucket_count; b++) {
+        FileEntry* entry = registry->buckets[b];
+        while (entry) {
+            FileEntry* next = entry->hash_next;
+            size_t index = hash_mix64(entry->file_id) & (new_count - 1);
+            entry->hash_next = new_buckets[index];
+            new_buckets[index] = entry;
+            entry = next;
+        }
+    }
+
+    free(registry->buckets);
+    registry->buckets = new_buckets;
+    registry->bucket_count = new_count;
+}
+
+// Caller holds the lock
+static FileEntry* find_entry(FileRegistry* registry, uint64_t file_id, const char* filepath) {
+    FileEntry* entry = registry->buckets[bucket_index(registry, file_id)];
+    while (entry) {
+        if (entry->file_id == file_id && strcmp(entry->filepath, filepath) == 0) {
+            return entry;
+        }
+        entry = entry->hash_next;
+    }
+    return NULL;
+}
+
+/* ===============================================
+ * REGISTRY
+ * =============================================== */
+
+int registry_init(FileRegistry* registry) {
+    memset(registry, 0, sizeof(FileRegistry));
+
+    registry->bucket_count = REGISTRY_INITIAL_BUCKETS;
+    registry->buckets = calloc(registry->bucket_count, sizeof(FileEntry*));
+    if (!registry->buckets) return -1;
+
+    pthread_rwlock_init(&registry->lock, NULL);
+    for (int i = 0; i < FILE_COMMIT_STRIPES; i++) {
+        pthread_mutex_init(&registry->commit_mutexes[i], NULL);
+    }
+    return 0;
+}
+
+void registry_destroy(FileRegistry* registry) {
+    if (!registry->buckets) return;
+
+    pthread_rwlock_wrlock(&registry->lock);
+    for (size_t b = 0; b < registry->bucket_count; b++) {
+        FileEntry* entry = registry->buckets[b];
+        while (entry) {
+            FileEntry* next = entry->hash_next;
+            entry->removed = true;
+            entry->hash_next = NULL;
+            file_entry_release(entry);
+            entry = next;
+        }
+    }
+    free(registry->buckets);
+    registry->buckets = NULL;
+    registry->count = 0;
+    pthread_rwlock_unlock(&registry->lock);
+
+    pthread_rwlock_destroy(&registry->lock);
+    for (int i = 0; i < FILE_COMMIT_STRIPES; i++) {
+        pthread_mutex_destroy(&registry->commit_mutexes[i]);
+    }
+}
+
+FileEntry* registry_new_entry(const char* base_path, const char* filepath, bool is_directory) {
+    if (!base_path || !filepath) return NULL;
+
+    size_t base_len = strlen(base_path);
+    size_t path_len = strlen(filepath);
+
+    // One allocation: the entry, then "<base>/<filepath>"
+    FileEntry* entry = malloc(sizeof(FileEntry) + base_len + 1 + path_len + 1);
+    if (!entry) return NULL;
+    memset(entry, 0, sizeof(FileEntry));
+
+    memcpy(entry->full_path, base_path, base_len);
+    entry->full_path[base_len] = '/';
+    memcpy(entry->full_path + base_len + 1, filepath, path_len + 1);
+    entry->filepath = entry->full_path + base_len + 1;
+
+    entry->file_id = ss_file_id(filepath);
+    entry->is_directory = is_directory;
+    entry->version = 1;
+    entry->refcount = 1;
+    return entry;
+}
+
+FileEntry* registry_insert(FileRegistry* registry, FileEntry* entry) {
+    if (!registry || !entry) return NULL;
+
+    pthread_rwlock_wrlock(&registry->lock);
+
+    FileEntry* existing = find_entry(registry, entry->file_id, entry->filepath);
+    if (existing) {
+        file_entry_acquire(existing);
+        pthread_rwlock_unlock(&registry->lock);
+        free(entry);
+        return existing;
+    }
+
+    if (registry->count >= registry->bucket_count) {
+        grow_buckets(registry);
+    }
+
+    // The registry's own reference
+    file_entry_acquire(entry);
+    size_t index = bucket_index(registry, entry->file_id);
+    entry->hash_next = registry->buckets[index];
+    registry->buckets[index] = entry;
+    registry->count++;
+
+    pthread_rwlock_unlock(&registry->lock);
+    return entry;
+}
+
+FileEntry* registry_lookup(FileRegistry* registry, const char* filepath) {
+    if (!registry || !filepath) return NULL;
+
+    uint64_t file_id = ss_file_id(filepath);
+
+    pthread_rwlock_rdlock(&registry->lock);
+    FileEntry* entry = find_entry(registry, file_id, filepath);
+    if (entry) file_entry_acquire(entry);
+    pthread_rwlock_unlock(&registry->lock);
+
+    return entry;
+}
+
+bool registry_remove(FileRegistry* registry, FileEntry* entry) {
+    if (!registry || !entry) return false;
+
+    pthread_rwlock_wrlock(&registry->lock);
+    if (entry->removed) {
+        pthread_rwlock_unlock(&registry->lock);
+        return false;
+    }
+
+    FileEntry** link = &registry->buckets[bucket_index(registry, entry->file_id)];
+    while (*link && *link != entry) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) *link = entry->hash_next;
+    entry->hash_next = NULL;
+    entry->removed = true;
+    registry->count--;
+    pthread_rwlock_unlock(&registry->lock);
+
+    file_entry_release(entry);  // The registry's reference
+    return true;
+}
+
+void file_entry_acquire(FileEntry* entry) {
+    __atomic_add_fetch(&entry->refcount, 1, __ATOMIC_RELAXED);
+}
+
+void file_entry_release(FileEntry* entry) {
+    if (!entry) return;
+    if (__atomic_sub_fetch(&entry->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+        free(entry);
+    }
+}
+
+size_t registry_count(FileRegistry* registry) {
+    pthread_rwlock_rdlock(&registry->lock);
+    size_t count = registry->count;
+    pthread_rwlock_unlock(&registry->lock);
+    return count;
+}
+
+size_t registry_foreach(FileRegistry* registry, bool (*fn)(FileEntry* entry, void* arg),
+                        void* arg) {
+    size_t visited = 0;
+
+    pthread_rwlock_rdlock(&registry->lock);
+    for (size_t b = 0; b < registry->bucket_count; b++) {
+        for (FileEntry* entry = registry->buckets[b]; entry; entry = entry->hash_next) {
+            visited++;
+            if (!fn(entry, arg)) {
+                pthread_rwlock_unlock(&registry->lock);
+                return visited;
+            }
+        }
+    }
+    pthread_rwlock_unlock(&registry->lock);
+
+    return visited;
+}
+
+pthread_mutex_t* registry_commit_mutex(FileRegistry* registry, const FileEntry* entry) {
+    return &registry->commit_mutexes[hash_mix64(entry->file_id ^ 0x5bd1e995ULL) %
+                                     FILE_COMMIT_STRIPES];
+}
@@ -0,0 +1,118 @@
+#ifndef SS_REGISTRY_H
+#define SS_REGISTRY_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+#define REGISTRY_INITIAL_BUCKETS 1024    // Power of two; doubles with the file count
+#define FILE_COMMIT_STRIPES 256          // Commit mutexes shared by hash of file ID
+
+/**
+ * File Entry Structure
+ * Represents a file stored on this storage server. Entries are allocated
+ * individually and never move; lookups return a counted reference, so an
+ * entry stays valid for its holder even after the file is deleted.
+ */
+typedef struct FileEntry {
+    struct FileEntry* hash_next;     // Registry bucket chain
+    const char* filepath;            // Relative path (points into full_path)
+    uint64_t file_id;                // Hash of filepath (lock table key)
+    off_t file_size;                 // File size in bytes
+    time_t created_at;               // Creation timestamp
+    time_t modified_at;              // Last modification timestamp
+    uint64_t version;                // Bumped on every committed change
+    ino_t inode;                     // Inode holding version (set after the bump)
+    int sentence_count;              // Number of sentences in file
+    uint64_t cold_checked;           // Version the freezer last looked at
+    int repl_source;                 // SS ID of the primary it came from, 0 if local
+    int refcount;                    // Registry's reference + holders (atomic)
+    bool is_directory;               // true if directory
+    bool removed;                    // Unlinked from the registry
+    char full_path[];                // Absolute path on disk, stored inline
+} FileEntry;
+
+/**
+ * File Registry
+ * Hash index from relative path to entry. Lookups share the read lock;
+ * inserts, removals and growth take it exclusively.
+ */
+typedef struct FileRegistry {
+    pthread_rwlock_t lock;
+    FileEntry** buckets;
+    size_t bucket_count;
+    size_t count;
+    pthread_mutex_t commit_mutexes[FILE_COMMIT_STRIPES];
+} FileRegistry;
+
+/**
+ * Initialize / destroy the registry
+ * Destroy drops the registry's references; entries still held elsewhere
+ * are freed by their last release.
+ * @return 0 on success, -1 on error
+ */
+int registry_init(FileRegistry* registry);
+void registry_destroy(FileRegistry* registry);
+
+/**
+ * Allocate an unpublished entry (refcount 1, version 1, no stats filled in)
+ * @param base_path Storage base directory
+ * @param filepath Relative path
+ * @param is_directory Whether it's a directory
+ * @return Entry, NULL on allocation failure
+ */
+FileEntry* registry_new_entry(const char* base_path, const char* filepath, bool is_directory);
+
+/**
+ * Publish an entry from registry_new_entry
+ * The caller's reference is kept. If the path is already registered the
+ * new entry is freed and the existing one returned instead.
+ * @param registry File registry
+ * @param entry New entry
+ * @return Referenced entry for the path
+ */
+FileEntry* registry_insert(FileRegistry* registry, FileEntry* entry);
+
+/**
+ * Find an entry by relative path
+ * @return Referenced entry (release with file_entry_release), NULL if not found
+ */
+FileEntry* registry_lookup(FileRegistry* registry, const char* filepath);
+
+/**
+ * Unlink an entry so later lookups miss it
+ * Holders keep their references.
+ * @return true if this call removed it
+ */
+bool registry_remove(FileRegistry* registry, FileEntry* entry);
+
+/**
+ * Take / drop a reference on an entry
+ */
+void file_entry_acquire(FileEntry* entry);
+void file_entry_release(FileEntry* entry);
+
+/**
+ * Number of registered entries
+ */
+size_t registry_count(FileRegistry* registry);
+
+/**
+ * Visit registered entries under the read lock
+ * @param registry File registry
+ * @param fn Called per entry; return false to stop
+ * @param arg Callback argument
+ * @return Number of entries visited
+ */
+size_t registry_foreach(FileRegistry* registry, bool (*fn)(FileEntry* entry, void* arg),
+                        void* arg);
+
+/**
+ * Mutex that serializes commits to an entry's file (shared by stripe)
+ */
+pthread_mutex_t* registry_commit_mutex(FileRegistry* registry, const FileEntry* entry);
+
+#endif // SS_REGISTRY_H
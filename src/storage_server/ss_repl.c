@@ -0,0 +1,1190 @@
+#include "ss_repl.h"
+#include "ss_server.h"
+#include "ss_io.h"
+#include "ss_delta.h"
+#include "../common/compress.h"
+#include "../common/utils.h"
+#include "../common/logger.h"
+#include "../common/error_codes.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+/* ===============================================
+ * LOG
+ * =============================================== */
+
+static ReplRecord* ring_slot(Replication* repl, uint64_t lsn) {
+    return &repl->ring[lsn % REPL_LOG_CAPACITY];
+}
+
+// Caller holds repl->mutex
+static void drop_oldest(Replication* repl) {
+    ReplRecord* record = ring_slot(repl, repl->first_lsn);
+    free(record->path);
+    record->path = NULL;
+    repl->first_lsn++;
+}
+
+// Caller holds repl->mutex. Frees records every replica has applied.
+static void trim_acknowledged(Replication* repl) {
+    uint64_t min_acked = repl->head_lsn;
+    for (int i = 0; i < repl->replica_count; i++) {
+        if (repl->replicas[i].acked_lsn < min_acked) {
+            min_acked = repl->replicas[i].acked_lsn;
+        }
+    }
+    while (repl->first_lsn <= min_acked && repl->first_lsn <= repl->head_lsn) {
+        drop_oldest(repl);
+    }
+}
+
+int repl_init(Replication* repl, StorageServerState* state) {
+    memset(repl, 0, sizeof(Replication));
+    repl->ring = calloc(REPL_LOG_CAPACITY, sizeof(ReplRecord));
+    if (!repl->ring) return -1;
+
+    pthread_mutex_init(&repl->mutex, NULL);
+    pthread_cond_init(&repl->cond, NULL);
+    repl->state = state;
+    repl->first_lsn = 1;
+    repl->epoch = (uint64_t)current_timestamp_ms();
+    for (int i = 0; i < REPL_MAX_REPLICAS; i++) {
+        repl->replicas[i].fd = -1;
+    }
+    return 0;
+}
+
+void repl_destroy(Replication* repl) {
+    if (!repl->ring) return;
+
+    repl_stop(repl);
+
+    while (repl->first_lsn <= repl->head_lsn) {
+        drop_oldest(repl);
+    }
+    free(repl->ring);
+    repl->ring = NULL;
+
+    pthread_mutex_destroy(&repl->mutex);
+    pthread_cond_destroy(&repl->cond);
+}
+
+uint64_t repl_log_append(Replication* repl, ReplOp op, const char* filepath) {
+    if (!repl || !repl->ring || !filepath) return 0;
+
+    pthread_mutex_lock(&repl->mutex);
+    if (repl->replica_count == 0) {
+        pthread_mutex_unlock(&repl->mutex);
+        return 0;
+    }
+
+    char* path = strdup(filepath);
+    if (!path) {
+        pthread_mutex_unlock(&repl->mutex);
+        return 0;
+    }
+
+    // Full: the slowest replica will need a snapshot instead
+    if (repl->head_lsn - repl->first_lsn + 1 >= REPL_LOG_CAPACITY) {
+        drop_oldest(repl);
+    }
+
+    uint64_t lsn = ++repl->head_lsn;
+    ReplRecord* record = ring_slot(repl, lsn);
+    record->lsn = lsn;
+    record->op = (char)op;
+    record->path = path;
+
+    pthread_cond_broadcast(&repl->cond);
+    pthread_mutex_unlock(&repl->mutex);
+
+    return lsn;
+}
+
+/* ===============================================
+ * SHIPPING (PRIMARY SIDE)
+ * =============================================== */
+
+typedef struct {
+    char* data;
+    size_t len;
+    size_t capacity;
+} ReplBuffer;
+
+static int buffer_reserve(ReplBuffer* buf, size_t extra) {
+    if (buf->len + extra <= buf->capacity) return 0;
+    size_t capacity = buf->capacity ? buf->capacity : 65536;
+    while (capacity < buf->len + extra) capacity *= 2;
+    char* data = realloc(buf->data, capacity);
+    if (!data) return -1;
+    buf->data = data;
+    buf->capacity = capacity;
+    return 0;
+}
+
+// Whole current content of a registered file, NUL-terminated (caller
+// frees); NULL if missing or too large to replicate
+static char* read_file_content(StorageServerState* state, const char* path, size_t* len) {
+    FileEntry* entry = find_file(state, path);
+    if (!entry || entry->is_directory) {
+        file_entry_release(entry);
+        return NULL;
+    }
+    FileSnapshot snap;
+    int result = open_file_snapshot(state, entry, &snap);
+    file_entry_release(entry);
+    if (result != ERR_SUCCESS) return NULL;
+
+    char* data = (size_t)snap.size <= REPL_RECORD_MAX_BYTES ? malloc((size_t)snap.size + 1) : NULL;
+    ssize_t got = data ? ss_io_pread_all(snap.fd, data, (size_t)snap.size, 0) : -1;
+    close_file_snapshot(&snap);
+    if (got < 0) {
+        free(data);
+        return NULL;
+    }
+    data[got] = '\0';
+    *len = (size_t)got;
+    return data;
+}
+
+// Appends "<op> <size> <path>\n<data>"; WRITE records carry the file's
+// current content. Returns 0 if the record was skipped (file gone).
+static int encode_record(Replication* repl, char op, const char* path, ReplBuffer* buf) {
+    FileSnapshot snap;
+    snap.fd = -1;
+    snap.size = 0;
+
+    if (op == REPL_OP_WRITE) {
+        FileEntry* entry = find_file(repl->state, path);
+        if (!entry || entry->is_directory) {
+            file_entry_release(entry);
+            return 0;
+        }
+        int result = open_file_snapshot(repl->state, entry, &snap);
+        file_entry_release(entry);
+        if (result != ERR_SUCCESS) return 0;
+        if ((size_t)snap.size > REPL_RECORD_MAX_BYTES) {
+            close_file_snapshot(&snap);
+            return 0;
+        }
+    }
+
+    char header[MAX_PATH_LEN + 64];
+    int header_len = snprintf(header, sizeof(header), "%c %ld %s\n", op, (long)snap.size, path);
+    if (buffer_reserve(buf, (size_t)header_len + (size_t)snap.size) < 0) {
+        if (snap.fd >= 0) close_file_snapshot(&snap);
+        return -1;
+    }
+    memcpy(buf->data + buf->len, header, (size_t)header_len);
+
+    if (snap.fd >= 0) {
+        ssize_t got = ss_io_pread_all(snap.fd, buf->data + buf->len + header_len,
+                                      (size_t)snap.size, 0);
+        close_file_snapshot(&snap);
+        if (got != (ssize_t)snap.size) return 0;
+    }
+
+    buf->len += (size_t)header_len + (size_t)snap.size;
+    return 1;
+}
+
+// Appends a DELTA record against the replica's copy, described by sigs.
+// Returns 0 when a plain WRITE is as small or the file is gone.
+static int encode_delta_record(ReplReplica* replica, const char* path, const char* sigs,
+                               size_t sigs_len, ReplBuffer* buf) {
+    size_t content_len;
+    char* content = read_file_content(replica->repl->state, path, &content_len);
+    if (!content) return 0;
+
+    size_t delta_len = 0;
+    char* delta = delta_encode(sigs, sigs_len, content, content_len, &delta_len);
+    free(content);
+    if (!delta || delta_len >= content_len) {
+        free(delta);
+        return 0;
+    }
+
+    char header[MAX_PATH_LEN + 64];
+    int header_len = snprintf(header, sizeof(header), "%c %zu %s\n", REPL_OP_DELTA,
+                              delta_len, path);
+    if (buffer_reserve(buf, (size_t)header_len + delta_len) < 0) {
+        free(delta);
+        return -1;
+    }
+    memcpy(buf->data + buf->len, header, (size_t)header_len);
+    memcpy(buf->data + buf->len + header_len, delta, delta_len);
+    buf->len += (size_t)header_len + delta_len;
+    free(delta);
+
+    pthread_mutex_lock(&replica->repl->mutex);
+    replica->delta_files++;
+    replica->delta_saved += content_len - delta_len;
+    pthread_mutex_unlock(&replica->repl->mutex);
+    return 1;
+}
+
+// send_all without SIGPIPE: a replica going away is routine
+static int send_to_replica(int fd, const void* data, size_t len) {
+    const char* p = (const char*)data;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int connect_replica(ReplReplica* replica) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(replica->port);
+    if (inet_pton(AF_INET, replica->ip, &addr.sin_addr) <= 0 ||
+        connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct timeval tv = { REPL_ACK_TIMEOUT_SEC, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+// Reads one short reply line, giving up after timeout_ms or on shutdown
+static int read_reply_line(Replication* repl, int fd, char* line, size_t size, int timeout_ms) {
+    size_t len = 0;
+    while (len + 1 < size) {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        int ready = poll(&pfd, 1, timeout_ms < 1000 ? timeout_ms : 1000);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready < 0) return -1;
+        if (ready == 0) {
+            timeout_ms -= 1000;
+            if (timeout_ms <= 0 || !repl->running) return -1;
+            continue;
+        }
+
+        ssize_t n = recv(fd, line + len, 1, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        if (line[len] == '\n') {
+            line[len] = '\0';
+            return (int)len;
+        }
+        len++;
+    }
+    return -1;
+}
+
+// Returns -2 when the replica rejected the batch, -1 on other failures
+static int read_ack(Replication* repl, int fd, uint64_t* lsn) {
+    char line[128];
+    unsigned long long value;
+    if (read_reply_line(repl, fd, line, sizeof(line), REPL_ACK_TIMEOUT_SEC * 1000) < 0) {
+        return -1;
+    }
+    if (sscanf(line, "REPL_ACK %llu", &value) != 1) {
+        return strncmp(line, "REPL_ERROR", 10) == 0 ? -2 : -1;
+    }
+    *lsn = value;
+    return 0;
+}
+
+// Large batches go to replicas that negotiated it as LZ4 frames:
+// "REPL_BATCH ... <bytes> lz4 <framed bytes>"
+static int send_batch(ReplReplica* replica, uint64_t last_lsn, int count, const ReplBuffer* buf) {
+    Replication* repl = replica->repl;
+
+    const char* payload = buf->data;
+    size_t payload_len = buf->len;
+    char* frames = NULL;
+    if (replica->compress && buf->len >= COMPRESS_MIN_PAYLOAD) {
+        size_t cap = compress_frames_bound(buf->len);
+        frames = malloc(cap);
+        size_t framed = frames ? compress_frames(buf->data, buf->len, frames, cap) : 0;
+        if (framed > 0 && framed < buf->len) {
+            payload = frames;
+            payload_len = framed;
+        }
+    }
+
+    char header[192];
+    int header_len = snprintf(header, sizeof(header), "REPL_BATCH %d %llu %llu %d %zu",
+                              repl->state->ss_id, (unsigned long long)repl->epoch,
+                              (unsigned long long)last_lsn, count, buf->len);
+    if (payload != buf->data) {
+        header_len += snprintf(header + header_len, sizeof(header) - (size_t)header_len,
+                               " lz4 %zu", payload_len);
+    }
+    header[header_len++] = '\n';
+    int rc = send_to_replica(replica->fd, header, (size_t)header_len);
+    if (rc == 0 && payload_len > 0) rc = send_to_replica(replica->fd, payload, payload_len);
+    free(frames);
+    if (rc < 0) return -1;
+    if (payload != buf->data) {
+        compress_stats_add(&repl->state->wire_stats, buf->len, payload_len, false);
+    }
+
+    pthread_mutex_lock(&repl->mutex);
+    replica->batches_sent++;
+    replica->bytes_sent += (uint64_t)header_len + payload_len;
+    replica->compress_saved += buf->len - payload_len;
+    if (last_lsn > replica->sent_lsn) replica->sent_lsn = last_lsn;
+    pthread_mutex_unlock(&repl->mutex);
+    return 0;
+}
+
+static void record_ack(ReplReplica* replica, uint64_t lsn) {
+    Replication* repl = replica->repl;
+    pthread_mutex_lock(&repl->mutex);
+    if (lsn > replica->acked_lsn) replica->acked_lsn = lsn;
+    trim_acknowledged(repl);
+    pthread_mutex_unlock(&repl->mutex);
+}
+
+typedef struct {
+    char** paths;
+    size_t count;
+    size_t capacity;
+} PathList;
+
+static bool collect_path(FileEntry* entry, void* arg) {
+    PathList* list = (PathList*)arg;
+    if (entry->is_directory) return true;
+
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 256;
+        char** paths = realloc(list->paths, capacity * sizeof(char*));
+        if (!paths) return false;
+        list->paths = paths;
+        list->capacity = capacity;
+    }
+    list->paths[list->count] = strdup(entry->filepath);
+    if (list->paths[list->count]) list->count++;
+    return true;
+}
+
+typedef struct {
+    char* data;                      // Signature block, NULL if the replica has no copy
+    size_t len;
+} ReplSignature;
+
+static void free_signatures(ReplSignature* sigs, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        free(sigs[i].data);
+        sigs[i].data = NULL;
+    }
+}
+
+// Asks the replica for signatures of its copies of paths:
+//   REPL_SIGREQ <count> <bytes>\n<path>\n...  ->  REPL_SIGS <bytes>\n
+// followed by "SIG <len>\n<block>" or "NONE\n" per path, in order
+static int request_signatures(ReplReplica* replica, char** paths, size_t count,
+                              ReplSignature* sigs) {
+    Replication* repl = replica->repl;
+
+    ReplBuffer req = {0};
+    for (size_t i = 0; i < count; i++) {
+        size_t path_len = strlen(paths[i]);
+        if (buffer_reserve(&req, path_len + 1) < 0) {
+            free(req.data);
+            return -1;
+        }
+        memcpy(req.data + req.len, paths[i], path_len);
+        req.data[req.len + path_len] = '\n';
+        req.len += path_len + 1;
+    }
+
+    char line[128];
+    int line_len = snprintf(line, sizeof(line), "REPL_SIGREQ %zu %zu\n", count, req.len);
+    int result = send_to_replica(replica->fd, line, (size_t)line_len) < 0 ||
+                 send_to_replica(replica->fd, req.data, req.len) < 0 ? -1 : 0;
+    free(req.data);
+
+    size_t bytes;
+    if (result < 0 ||
+        read_reply_line(repl, replica->fd, line, sizeof(line), REPL_ACK_TIMEOUT_SEC * 1000) < 0 ||
+        sscanf(line, "REPL_SIGS %zu", &bytes) != 1 ||
+        bytes > REPL_SIGS_MAX_BYTES) {
+        return -1;
+    }
+    char* reply = malloc(bytes + 1);
+    if (!reply || recv_all(replica->fd, reply, bytes) < 0) {
+        free(reply);
+        return -1;
+    }
+    reply[bytes] = '\0';
+
+    // Each block is copied out so its fields are aligned
+    size_t pos = 0;
+    for (size_t i = 0; i < count && result == 0; i++) {
+        const char* newline = memchr(reply + pos, '\n', bytes - pos);
+        size_t sig_len;
+        if (!newline) {
+            result = -1;
+        } else if (strncmp(reply + pos, "NONE\n", 5) == 0) {
+            pos += 5;
+        } else if (sscanf(reply + pos, "SIG %zu", &sig_len) == 1 &&
+                   sig_len <= bytes - (size_t)(newline + 1 - reply)) {
+            pos = (size_t)(newline + 1 - reply);
+            sigs[i].data = malloc(sig_len ? sig_len : 1);
+            if (!sigs[i].data) {
+                result = -1;
+            } else {
+                memcpy(sigs[i].data, reply + pos, sig_len);
+                sigs[i].len = sig_len;
+                pos += sig_len;
+            }
+        } else {
+            result = -1;
+        }
+    }
+    free(reply);
+    if (result < 0) free_signatures(sigs, count);
+    return result;
+}
+
+// Sends our whole file list so the replica deletes the files it got from
+// us that we no longer have (their DELETE records may be gone from the log):
+//   REPL_PRUNE <src_id> <count> <bytes>\n<path>\n...  ->  REPL_PRUNED <deleted>\n
+static int send_prune(ReplReplica* replica, const PathList* list) {
+    Replication* repl = replica->repl;
+
+    ReplBuffer req = {0};
+    for (size_t i = 0; i < list->count; i++) {
+        size_t path_len = strlen(list->paths[i]);
+        if (buffer_reserve(&req, path_len + 1) < 0) {
+            free(req.data);
+            return -1;
+        }
+        memcpy(req.data + req.len, list->paths[i], path_len);
+        req.data[req.len + path_len] = '\n';
+        req.len += path_len + 1;
+    }
+    if (req.len > REPL_LIST_MAX_BYTES) {
+        // Too many files to list; stale copies stay on the replica
+        free(req.data);
+        log_message("SS", replica->ip, replica->port, "system", "REPL",
+                    "REPL_PRUNE - file list too large", "ERROR");
+        return 0;
+    }
+
+    char line[128];
+    int line_len = snprintf(line, sizeof(line), "REPL_PRUNE %d %zu %zu\n", repl->state->ss_id,
+                            list->count, req.len);
+    int result = send_to_replica(replica->fd, line, (size_t)line_len) < 0 ||
+                 (req.len > 0 && send_to_replica(replica->fd, req.data, req.len) < 0) ? -1 : 0;
+    free(req.data);
+
+    unsigned long long deleted;
+    if (result < 0 ||
+        read_reply_line(repl, replica->fd, line, sizeof(line), REPL_ACK_TIMEOUT_SEC * 1000) < 0 ||
+        sscanf(line, "REPL_PRUNED %llu", &deleted) != 1) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&repl->mutex);
+    replica->pruned += deleted;
+    pthread_mutex_unlock(&repl->mutex);
+    return 0;
+}
+
+// Prunes the replica, then sends every registered file, one acknowledged
+// batch at a time: as a delta where the replica holds an older copy,
+// otherwise as a WRITE. The final batch marks the replica as caught up to
+// snapshot_lsn. A rejected batch holding deltas makes the next snapshot
+// send only WRITEs, since the same deltas would fail again.
+static int send_snapshot(ReplReplica* replica, uint64_t snapshot_lsn) {
+    Replication* repl = replica->repl;
+
+    PathList list = {0};
+    registry_foreach(&repl->state->registry, collect_path, &list);
+
+    bool use_deltas = !replica->delta_failed;
+    replica->delta_failed = false;
+
+    int result = send_prune(replica, &list);
+    ReplBuffer buf = {0};
+    ReplSignature sigs[REPL_BATCH_MAX_RECORDS];
+    memset(sigs, 0, sizeof(sigs));
+    size_t group_start = 0, group_end = 0;
+    size_t i = 0;
+    while (result == 0) {
+        // Signatures for the next group of files
+        if (use_deltas && i == group_end && i < list.count) {
+            free_signatures(sigs, group_end - group_start);
+            group_start = i;
+            group_end = list.count - i < REPL_BATCH_MAX_RECORDS ? list.count
+                                                                : i + REPL_BATCH_MAX_RECORDS;
+            if (request_signatures(replica, list.paths + group_start,
+                                   group_end - group_start, sigs) < 0) {
+                group_end = group_start;
+                result = -1;
+                break;
+            }
+        }
+
+        buf.len = 0;
+        int count = 0, deltas = 0;
+        size_t batch_end = use_deltas ? group_end : list.count;
+        while (i < batch_end && buf.len < REPL_BATCH_MAX_BYTES) {
+            ReplSignature* sig = use_deltas ? &sigs[i - group_start] : NULL;
+            int added = sig && sig->data ? encode_delta_record(replica, list.paths[i], sig->data,
+                                                               sig->len, &buf) : 0;
+            if (added > 0) {
+                deltas++;
+            } else if (added == 0) {
+                added = encode_record(repl, REPL_OP_WRITE, list.paths[i], &buf);
+            }
+            i++;
+            if (added < 0) {
+                result = -1;
+                break;
+            }
+            count += added;
+        }
+        if (result < 0) break;
+
+        uint64_t acked;
+        uint64_t last_lsn = i < list.count ? replica->acked_lsn : snapshot_lsn;
+        int acked_rc = send_batch(replica, last_lsn, count, &buf) < 0 ? -1
+                     : read_ack(repl, replica->fd, &acked);
+        if (acked_rc < 0) {
+            if (acked_rc == -2 && deltas > 0) replica->delta_failed = true;
+            result = -1;
+            break;
+        }
+        record_ack(replica, acked);
+        if (i >= list.count || !repl->running) break;
+    }
+
+    free_signatures(sigs, group_end - group_start);
+    for (size_t j = 0; j < list.count; j++) free(list.paths[j]);
+    free(list.paths);
+    free(buf.data);
+    return result;
+}
+
+// Handshake: the replica answers with the last LSN it applied from this
+// log, or 0 if it has never seen this epoch
+static int open_stream(ReplReplica* replica) {
+    Replication* repl = replica->repl;
+
+    replica->fd = connect_replica(replica);
+    if (replica->fd < 0) return -1;
+
+    // Offers LZ4 batches; replicas that don't know the option ignore it
+    // and answer without one
+    char hello[96];
+    int len = snprintf(hello, sizeof(hello), "REPL_HELLO %d %llu COMPRESS=lz4\n",
+                       repl->state->ss_id, (unsigned long long)repl->epoch);
+    char line[128];
+    char codec[16] = "";
+    unsigned long long applied = 0;
+    if (send_to_replica(replica->fd, hello, (size_t)len) < 0 ||
+        read_reply_line(repl, replica->fd, line, sizeof(line),
+                        REPL_ACK_TIMEOUT_SEC * 1000) < 0 ||
+        sscanf(line, "REPL_ACK %llu %15s", &applied, codec) < 1) {
+        close(replica->fd);
+        replica->fd = -1;
+        return -1;
+    }
+    replica->compress = strcmp(codec, "COMPRESS=lz4") == 0;
+
+    pthread_mutex_lock(&repl->mutex);
+    bool needs_snapshot = applied == 0 || applied + 1 < repl->first_lsn ||
+                          applied > repl->head_lsn;
+    uint64_t snapshot_lsn = repl->head_lsn;
+    replica->connected = true;
+    replica->acked_lsn = needs_snapshot ? 0 : applied;
+    replica->sent_lsn = replica->acked_lsn;
+    if (needs_snapshot) replica->resyncs++;
+    pthread_mutex_unlock(&repl->mutex);
+
+    if (needs_snapshot && send_snapshot(replica, snapshot_lsn) < 0) {
+        close(replica->fd);
+        replica->fd = -1;
+        return -1;
+    }
+
+    char log_msg[128];
+    snprintf(log_msg, sizeof(log_msg), "REPL_CONNECT - acked=%llu snapshot=%d",
+             (unsigned long long)replica->acked_lsn, needs_snapshot);
+    log_message("SS", replica->ip, replica->port, "system", "REPL", log_msg, "SUCCESS");
+    return 0;
+}
+
+static void close_stream(ReplReplica* replica) {
+    Replication* repl = replica->repl;
+    if (replica->fd >= 0) close(replica->fd);
+    replica->fd = -1;
+
+    pthread_mutex_lock(&repl->mutex);
+    replica->connected = false;
+    pthread_mutex_unlock(&repl->mutex);
+}
+
+// Timed wait on repl->cond; caller holds repl->mutex
+static void wait_for_records(Replication* repl, int timeout_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&repl->cond, &repl->mutex, &deadline);
+}
+
+// Builds the next batch from the log starting at *next. Returns the
+// number of log records it covers (0 if the log has nothing new), -1 if
+// the replica fell behind the log and needs a snapshot. *count is the
+// number of records actually encoded; superseded writes and files that
+// are already gone cover their LSN without sending anything.
+static int build_batch(ReplReplica* replica, uint64_t* next, uint64_t* last_lsn,
+                       int* count, ReplBuffer* buf) {
+    Replication* repl = replica->repl;
+    ReplRecord batch[REPL_BATCH_MAX_RECORDS];
+    int taken = 0;
+
+    pthread_mutex_lock(&repl->mutex);
+    if (*next < repl->first_lsn) {
+        pthread_mutex_unlock(&repl->mutex);
+        return -1;
+    }
+    while (*next + taken <= repl->head_lsn && taken < REPL_BATCH_MAX_RECORDS) {
+        ReplRecord* record = ring_slot(repl, *next + taken);
+        batch[taken].lsn = record->lsn;
+        batch[taken].op = record->op;
+        batch[taken].path = strdup(record->path);
+        if (!batch[taken].path) break;
+        taken++;
+    }
+    pthread_mutex_unlock(&repl->mutex);
+
+    buf->len = 0;
+    *count = 0;
+    int covered = 0;
+    int result = 0;
+    for (int i = 0; i < taken && result == 0; i++) {
+        if (buf->len >= REPL_BATCH_MAX_BYTES) break;  // The rest goes next time
+
+        // A later record for the same file in this batch decides its state
+        bool superseded = false;
+        if (batch[i].op == REPL_OP_WRITE) {
+            for (int j = i + 1; j < taken && !superseded; j++) {
+                superseded = strcmp(batch[j].path, batch[i].path) == 0;
+            }
+        }
+        if (!superseded) {
+            int added = encode_record(repl, batch[i].op, batch[i].path, buf);
+            if (added < 0) {
+                result = -1;
+                break;
+            }
+            *count += added;
+        }
+        *last_lsn = batch[i].lsn;
+        covered++;
+    }
+    for (int i = 0; i < taken; i++) free(batch[i].path);
+
+    if (result < 0) return -1;
+    if (covered > 0) *next = *last_lsn + 1;
+    return covered;
+}
+
+static void* shipper_thread_func(void* arg) {
+    ReplReplica* replica = (ReplReplica*)arg;
+    Replication* repl = replica->repl;
+
+    uint64_t next = 0;
+    uint64_t inflight[REPL_WINDOW_BATCHES];
+    int inflight_count = 0;
+    ReplBuffer buf = {0};
+
+    while (repl->running) {
+        if (replica->fd < 0) {
+            if (open_stream(replica) < 0) {
+                pthread_mutex_lock(&repl->mutex);
+                if (repl->running) wait_for_records(repl, REPL_RETRY_MS);
+                pthread_mutex_unlock(&repl->mutex);
+                continue;
+            }
+            next = replica->acked_lsn + 1;
+            inflight_count = 0;
+        }
+
+        // Fill the window, then wait for the oldest batch's ACK
+        if (inflight_count < REPL_WINDOW_BATCHES) {
+            uint64_t last_lsn = 0;
+            int count = 0;
+            int covered = build_batch(replica, &next, &last_lsn, &count, &buf);
+            if (covered < 0) {
+                // Fell behind the log (or out of memory): start over
+                close_stream(replica);
+                continue;
+            }
+            if (covered > 0) {
+                if (send_batch(replica, last_lsn, count, &buf) < 0) {
+                    close_stream(replica);
+                    continue;
+                }
+                inflight[inflight_count++] = last_lsn;
+                continue;
+            }
+        }
+
+        if (inflight_count == 0) {
+            pthread_mutex_lock(&repl->mutex);
+            if (repl->running && next > repl->head_lsn) wait_for_records(repl, 1000);
+            pthread_mutex_unlock(&repl->mutex);
+            continue;
+        }
+
+        uint64_t acked;
+        if (read_ack(repl, replica->fd, &acked) < 0 || acked != inflight[0]) {
+            close_stream(replica);
+            continue;
+        }
+        record_ack(replica, acked);
+        memmove(inflight, inflight + 1, (size_t)(--inflight_count) * sizeof(uint64_t));
+    }
+
+    if (replica->fd >= 0) close_stream(replica);
+    free(buf.data);
+    return NULL;
+}
+
+static int start_shipper(ReplReplica* replica) {
+    if (pthread_create(&replica->thread, NULL, shipper_thread_func, replica) != 0) {
+        return -1;
+    }
+    replica->started = true;
+    return 0;
+}
+
+int repl_add_replica(Replication* repl, const char* ip, int port) {
+    if (!repl || !ip || port <= 0) return -1;
+
+    pthread_mutex_lock(&repl->mutex);
+    for (int i = 0; i < repl->replica_count; i++) {
+        if (repl->replicas[i].port == port && strcmp(repl->replicas[i].ip, ip) == 0) {
+            pthread_mutex_unlock(&repl->mutex);
+            return -1;
+        }
+    }
+    if (repl->replica_count >= REPL_MAX_REPLICAS) {
+        pthread_mutex_unlock(&repl->mutex);
+        return -1;
+    }
+
+    ReplReplica* replica = &repl->replicas[repl->replica_count];
+    memset(replica, 0, sizeof(ReplReplica));
+    strncpy(replica->ip, ip, sizeof(replica->ip) - 1);
+    replica->port = port;
+    replica->repl = repl;
+    replica->fd = -1;
+    repl->replica_count++;
+
+    int result = repl->running ? start_shipper(replica) : 0;
+    pthread_mutex_unlock(&repl->mutex);
+
+    log_message("SS", ip, port, "system", "REPL", "REPLICA_ADD",
+               result == 0 ? "SUCCESS" : "ERROR");
+    return result;
+}
+
+int repl_start(Replication* repl) {
+    if (!repl) return -1;
+
+    pthread_mutex_lock(&repl->mutex);
+    repl->running = true;
+    for (int i = 0; i < repl->replica_count; i++) {
+        if (!repl->replicas[i].started) start_shipper(&repl->replicas[i]);
+    }
+    pthread_mutex_unlock(&repl->mutex);
+    return 0;
+}
+
+void repl_stop(Replication* repl) {
+    if (!repl) return;
+
+    pthread_mutex_lock(&repl->mutex);
+    repl->running = false;
+    pthread_cond_broadcast(&repl->cond);
+    int count = repl->replica_count;
+    pthread_mutex_unlock(&repl->mutex);
+
+    for (int i = 0; i < count; i++) {
+        ReplReplica* replica = &repl->replicas[i];
+        if (!replica->started) continue;
+        pthread_join(replica->thread, NULL);
+        replica->started = false;
+    }
+}
+
+/* ===============================================
+ * APPLYING (REPLICA SIDE)
+ * =============================================== */
+
+// Caller holds repl->mutex
+static ReplSource* find_source(Replication* repl, int src_id, bool create) {
+    for (int i = 0; i < repl->source_count; i++) {
+        if (repl->sources[i].src_id == src_id) return &repl->sources[i];
+    }
+    if (!create || repl->source_count >= REPL_MAX_SOURCES) return NULL;
+
+    ReplSource* source = &repl->sources[repl->source_count++];
+    memset(source, 0, sizeof(ReplSource));
+    source->src_id = src_id;
+    return source;
+}
+
+// Buffered session input first, then the socket
+static int read_payload(int fd, char* out, size_t len, char* inbuf, size_t* inlen) {
+    size_t from_buffer = *inlen < len ? *inlen : len;
+    memcpy(out, inbuf, from_buffer);
+    *inlen -= from_buffer;
+    memmove(inbuf, inbuf + from_buffer, *inlen);
+
+    if (len > from_buffer && recv_all(fd, out + from_buffer, len - from_buffer) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static int apply_batch(Replication* repl, int src_id, const char* data, size_t len,
+                       int count) {
+    size_t pos = 0;
+    for (int i = 0; i < count; i++) {
+        const char* newline = memchr(data + pos, '\n', len - pos);
+        if (!newline) return -1;
+
+        char header[MAX_PATH_LEN + 64];
+        size_t header_len = (size_t)(newline - (data + pos));
+        if (header_len >= sizeof(header)) return -1;
+        memcpy(header, data + pos, header_len);
+        header[header_len] = '\0';
+        pos += header_len + 1;
+
+        char op;
+        long size;
+        int path_offset = 0;
+        if (sscanf(header, "%c %ld %n", &op, &size, &path_offset) != 2 || path_offset == 0 ||
+            size < 0 || (size_t)size > len - pos) {
+            return -1;
+        }
+        const char* path = header + path_offset;
+        if (!is_safe_filepath(path)) return -1;
+
+        int result;
+        if (op == REPL_OP_DELTA) {
+            // Fails if our copy is not the one the primary diffed against;
+            // the primary's next snapshot then sends whole files
+            size_t basis_len = 0, target_len = 0;
+            char* basis = read_file_content(repl->state, path, &basis_len);
+            char* target = basis ? delta_apply(basis, basis_len, data + pos, (size_t)size,
+                                               &target_len) : NULL;
+            free(basis);
+            result = target ? apply_replicated_op(repl->state, src_id, REPL_OP_WRITE, path,
+                                                  target, target_len) : ERR_INVALID_OPERATION;
+            free(target);
+        } else {
+            result = apply_replicated_op(repl->state, src_id, op, path, data + pos,
+                                         (size_t)size);
+        }
+        if (result != ERR_SUCCESS) return -1;
+        pos += (size_t)size;
+    }
+    return pos == len ? 0 : -1;
+}
+
+static int handle_batch(Replication* repl, int fd, const char* line, char* inbuf, size_t* inlen) {
+    int src_id, count;
+    unsigned long long epoch, last_lsn;
+    size_t bytes, framed = 0;
+    char codec[8] = "";
+    int fields = sscanf(line, "REPL_BATCH %d %llu %llu %d %zu %7s %zu", &src_id, &epoch,
+                        &last_lsn, &count, &bytes, codec, &framed);
+    if ((fields != 5 && (fields != 7 || strcmp(codec, "lz4") != 0 ||
+                         framed > compress_frames_bound(bytes))) ||
+        count < 0 || bytes > REPL_BATCH_MAX_BYTES + REPL_RECORD_MAX_BYTES) {
+        send_all(fd, "REPL_ERROR\n", 11);
+        return -1;
+    }
+
+    char* data = malloc(bytes + 1);
+    char* frames = fields == 7 ? malloc(framed ? framed : 1) : NULL;
+    if (!data || (fields == 7 && !frames) ||
+        read_payload(fd, fields == 7 ? frames : data, fields == 7 ? framed : bytes,
+                     inbuf, inlen) < 0) {
+        free(data);
+        free(frames);
+        return -1;
+    }
+    if (frames) {
+        long expanded = decompress_frames(frames, framed, data, bytes);
+        free(frames);
+        if (expanded < 0) {
+            free(data);
+            log_message("SS", "peer", fd, "system", "REPL", "REPL_DECOMPRESS", "ERROR");
+            send_all(fd, "REPL_ERROR\n", 11);
+            return -1;
+        }
+    }
+
+    int result = apply_batch(repl, src_id, data, bytes, count);
+    free(data);
+    if (result < 0) {
+        log_message("SS", "peer", fd, "system", "REPL", "REPL_APPLY", "ERROR");
+        send_all(fd, "REPL_ERROR\n", 11);
+        return -1;
+    }
+
+    pthread_mutex_lock(&repl->mutex);
+    ReplSource* source = find_source(repl, src_id, true);
+    if (source) {
+        if (source->epoch != epoch) {
+            source->epoch = epoch;
+            source->applied_lsn = 0;
+        }
+        if (last_lsn > source->applied_lsn) source->applied_lsn = last_lsn;
+    }
+    pthread_mutex_unlock(&repl->mutex);
+
+    char ack[64];
+    int len = snprintf(ack, sizeof(ack), "REPL_ACK %llu\n", last_lsn);
+    return send_all(fd, ack, (size_t)len) < 0 ? -1 : 0;
+}
+
+// Signatures of our copies of the requested files, for a snapshot
+static int handle_sigreq(Replication* repl, int fd, const char* line, char* inbuf,
+                         size_t* inlen) {
+    size_t count, bytes;
+    if (sscanf(line, "REPL_SIGREQ %zu %zu", &count, &bytes) != 2 ||
+        count > REPL_BATCH_MAX_RECORDS || bytes > REPL_BATCH_MAX_RECORDS * MAX_PATH_LEN) {
+        send_all(fd, "REPL_ERROR\n", 11);
+        return -1;
+    }
+
+    char* paths = malloc(bytes + 1);
+    if (!paths || read_payload(fd, paths, bytes, inbuf, inlen) < 0) {
+        free(paths);
+        return -1;
+    }
+    paths[bytes] = '\0';
+
+    ReplBuffer reply = {0};
+    int result = 0;
+    char* path = paths;
+    for (size_t i = 0; i < count && result == 0; i++) {
+        char* newline = strchr(path, '\n');
+        if (!newline) {
+            result = -1;
+            break;
+        }
+        *newline = '\0';
+
+        size_t content_len = 0, sig_len = 0;
+        char* content = is_safe_filepath(path) ? read_file_content(repl->state, path,
+                                                                   &content_len) : NULL;
+        char* sig = content ? delta_signatures(content, content_len, &sig_len) : NULL;
+        free(content);
+
+        char header[64];
+        int header_len = sig ? snprintf(header, sizeof(header), "SIG %zu\n", sig_len)
+                             : snprintf(header, sizeof(header), "NONE\n");
+        if (buffer_reserve(&reply, (size_t)header_len + sig_len) < 0) {
+            result = -1;
+        } else {
+            memcpy(reply.data + reply.len, header, (size_t)header_len);
+            if (sig) memcpy(reply.data + reply.len + header_len, sig, sig_len);
+            reply.len += (size_t)header_len + sig_len;
+        }
+        free(sig);
+        path = newline + 1;
+    }
+    free(paths);
+
+    if (result == 0) {
+        char head[64];
+        int head_len = snprintf(head, sizeof(head), "REPL_SIGS %zu\n", reply.len);
+        if (send_all(fd, head, (size_t)head_len) < 0 ||
+            (reply.len > 0 && send_all(fd, reply.data, reply.len) < 0)) {
+            result = -1;
+        }
+    } else {
+        send_all(fd, "REPL_ERROR\n", 11);
+    }
+    free(reply.data);
+    return result < 0 ? -1 : 0;
+}
+
+typedef struct {
+    PathList list;
+    int src_id;
+} SourcePaths;
+
+static bool collect_source_path(FileEntry* entry, void* arg) {
+    SourcePaths* source = (SourcePaths*)arg;
+    if (entry->repl_source != source->src_id) return true;
+    return collect_path(entry, &source->list);
+}
+
+static int compare_paths(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Deletes the files we got from a primary that are not in its file list
+static int handle_prune(Replication* repl, int fd, const char* line, char* inbuf,
+                        size_t* inlen) {
+    int src_id;
+    size_t count, bytes;
+    if (sscanf(line, "REPL_PRUNE %d %zu %zu", &src_id, &count, &bytes) != 3 || src_id <= 0 ||
+        bytes > REPL_LIST_MAX_BYTES || count > bytes / 2) {
+        send_all(fd, "REPL_ERROR\n", 11);
+        return -1;
+    }
+
+    char* data = malloc(bytes + 1);
+    char** names = malloc((count ? count : 1) * sizeof(char*));
+    if (!data || !names || read_payload(fd, data, bytes, inbuf, inlen) < 0) {
+        free(data);
+        free(names);
+        return -1;
+    }
+    data[bytes] = '\0';
+
+    int result = 0;
+    char* path = data;
+    for (size_t i = 0; i < count; i++) {
+        char* newline = strchr(path, '\n');
+        if (!newline) {
+            result = -1;
+            break;
+        }
+        *newline = '\0';
+        names[i] = path;
+        path = newline + 1;
+    }
+
+    unsigned long long deleted = 0;
+    if (result == 0) {
+        qsort(names, count, sizeof(char*), compare_paths);
+
+        SourcePaths held = { {0}, src_id };
+        registry_foreach(&repl->state->registry, collect_source_path, &held);
+        for (size_t i = 0; i < held.list.count; i++) {
+            char* name = held.list.paths[i];
+            if (!bsearch(&name, names, count, sizeof(char*), compare_paths) &&
+                apply_replicated_op(repl->state, src_id, REPL_OP_DELETE, name, NULL,
+                                    0) == ERR_SUCCESS) {
+                deleted++;
+            }
+            free(name);
+        }
+        free(held.list.paths);
+    }
+    free(names);
+    free(data);
+
+    if (result < 0) {
+        send_all(fd, "REPL_ERROR\n", 11);
+        return -1;
+    }
+    if (deleted > 0) {
+        char log_msg[64];
+        snprintf(log_msg, sizeof(log_msg), "REPL_PRUNE - src=%d deleted=%llu", src_id, deleted);
+        log_message("SS", "peer", fd, "system", "REPL", log_msg, "SUCCESS");
+    }
+
+    char reply[64];
+    int len = snprintf(reply, sizeof(reply), "REPL_PRUNED %llu\n", deleted);
+    return send_all(fd, reply, (size_t)len) < 0 ? -1 : 0;
+}
+
+int repl_handle_peer_line(Replication* repl, int fd, const char* line,
+                          char* inbuf, size_t* inlen) {
+    if (!repl || !line) return -1;
+
+    if (strncmp(line, "REPL_BATCH ", 11) == 0) {
+        return handle_batch(repl, fd, line, inbuf, inlen);
+    }
+    if (strncmp(line, "REPL_SIGREQ ", 12) == 0) {
+        return handle_sigreq(repl, fd, line, inbuf, inlen);
+    }
+    if (strncmp(line, "REPL_PRUNE ", 11) == 0) {
+        return handle_prune(repl, fd, line, inbuf, inlen);
+    }
+
+    int src_id;
+    unsigned long long epoch;
+    char options[64] = "";
+    if (sscanf(line, "REPL_HELLO %d %llu %63s", &src_id, &epoch, options) >= 2) {
+        pthread_mutex_lock(&repl->mutex);
+        ReplSource* source = find_source(repl, src_id, false);
+        uint64_t applied = source && source->epoch == epoch ? source->applied_lsn : 0;
+        pthread_mutex_unlock(&repl->mutex);
+
+        bool lz4 = strncmp(options, "COMPRESS=", 9) == 0 &&
+                   compress_negotiate(options + 9) == COMPRESS_LZ4;
+        char ack[64];
+        int len = snprintf(ack, sizeof(ack), "REPL_ACK %llu%s\n", (unsigned long long)applied,
+                           lz4 ? " COMPRESS=lz4" : "");
+        return send_all(fd, ack, (size_t)len) < 0 ? -1 : 0;
+    }
+
+    send_all(fd, "REPL_ERROR\n", 11);
+    return -1;
+}
+
+/* ===============================================
+ * STATUS
+ * =============================================== */
+
+int repl_format_status(Replication* repl, char* buf, size_t size) {
+    if (!repl || !buf || size == 0) return 0;
+
+    pthread_mutex_lock(&repl->mutex);
+    int len = snprintf(buf, size, "SUCCESS\nHEAD_LSN:%llu\nREPLICAS:%d\n",
+                       (unsigned long long)repl->head_lsn, repl->replica_count);
+    for (int i = 0; i < repl->replica_count && len < (int)size; i++) {
+        ReplReplica* replica = &repl->replicas[i];
+        len += snprintf(buf + len, size - (size_t)len,
+                        "REPLICA:%s:%d CONNECTED:%d ACKED:%llu LAG:%llu SENT:%llu RESYNCS:%llu "
+                        "DELTA_FILES:%llu DELTA_SAVED:%llu COMPRESS_SAVED:%llu PRUNED:%llu\n",
+                        replica->ip, replica->port, replica->connected,
+                        (unsigned long long)replica->acked_lsn,
+                        (unsigned long long)(repl->head_lsn - replica->acked_lsn),
+                        (unsigned long long)replica->sent_lsn,
+                        (unsigned long long)replica->resyncs,
+                        (unsigned long long)replica->delta_files,
+                        (unsigned long long)replica->delta_saved,
+                        (unsigned long long)replica->compress_saved,
+                        (unsigned long long)replica->pruned);
+    }
+    if (len < (int)size) {
+        len += snprintf(buf + len, size - (size_t)len, "END\n");
+    }
+    pthread_mutex_unlock(&repl->mutex);
+
+    return len < (int)size ? len : (int)size - 1;
+}
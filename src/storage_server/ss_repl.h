@@ -0,0 +1,175 @@
+#ifndef SS_REPL_H
+#define SS_REPL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define REPL_MAX_REPLICAS 4
+#define REPL_MAX_SOURCES 16              // Primaries a replica tracks progress for
+#define REPL_LOG_CAPACITY 65536          // Records kept for lagging replicas
+#define REPL_BATCH_MAX_RECORDS 256
+#define REPL_BATCH_MAX_BYTES (1024 * 1024)
+#define REPL_RECORD_MAX_BYTES (64 * 1024 * 1024)
+#define REPL_SIGS_MAX_BYTES (64 * 1024 * 1024)   // One REPL_SIGS reply
+#define REPL_LIST_MAX_BYTES (64 * 1024 * 1024)   // One REPL_PRUNE file list
+#define REPL_WINDOW_BATCHES 4            // Unacknowledged batches per replica
+#define REPL_RETRY_MS 2000               // Reconnect delay after a failure
+#define REPL_ACK_TIMEOUT_SEC 30
+
+typedef struct StorageServerState StorageServerState;
+
+/**
+ * Replicated operations
+ * A WRITE record means "the file changed": the shipper sends whatever the
+ * file holds when the record goes out, so later writes to the same file
+ * in one batch collapse into one transfer. DELTA records only appear in
+ * snapshots: a WRITE sent as an ss_delta patch against the replica's copy.
+ */
+typedef enum {
+    REPL_OP_CREATE = 'C',
+    REPL_OP_WRITE = 'W',
+    REPL_OP_DELETE = 'D',
+    REPL_OP_DELTA = 'P'
+} ReplOp;
+
+/**
+ * Replication Log Record
+ */
+typedef struct {
+    uint64_t lsn;                    // Log sequence number, from 1
+    char op;                         // ReplOp
+    char* path;                      // Relative filepath (owned)
+} ReplRecord;
+
+struct Replication;
+
+/**
+ * Replica
+ * One outgoing stream to a replica SS, driven by its own shipper thread
+ * over a persistent connection to the replica's SS port.
+ */
+typedef struct {
+    char ip[16];
+    int port;
+    struct Replication* repl;
+    pthread_t thread;
+    bool started;
+    int fd;                          // -1 while disconnected
+    bool compress;                   // Replica takes LZ4-framed batches
+    bool delta_failed;               // Replica rejected a snapshot delta; next one sends WRITEs
+
+    // Guarded by the replication mutex
+    bool connected;
+    uint64_t acked_lsn;              // Highest LSN the replica applied
+    uint64_t sent_lsn;               // Highest LSN sent
+    uint64_t batches_sent;
+    uint64_t bytes_sent;
+    uint64_t resyncs;                // Full snapshots sent
+    uint64_t delta_files;            // Snapshot files sent as deltas
+    uint64_t delta_saved;            // Bytes those deltas saved over full content
+    uint64_t pruned;                 // Replica files snapshots deleted
+    uint64_t compress_saved;         // Bytes batch compression saved
+} ReplReplica;
+
+/**
+ * Source progress (replica side)
+ * Last LSN applied from a primary. The epoch changes each time the
+ * primary restarts and its LSNs begin again.
+ */
+typedef struct {
+    int src_id;
+    uint64_t epoch;
+    uint64_t applied_lsn;
+} ReplSource;
+
+/**
+ * Replication
+ * Ordered log of committed changes (CREATE, WRITE, DELETE) shipped
+ * asynchronously to every replica. Appending never waits on replicas;
+ * records are dropped once every replica acknowledged them, or when the
+ * log is full, in which case a replica that falls behind the oldest
+ * record gets a full snapshot on its next connection. A snapshot first
+ * sends the primary's file list (REPL_PRUNE), so the replica deletes the
+ * files it got from this primary that are gone, then asks for block
+ * signatures of the copies it already holds (REPL_SIGREQ) and sends
+ * changed files as deltas against them. Batches
+ * of COMPRESS_MIN_PAYLOAD bytes or more travel as LZ4 frames to replicas
+ * that accepted COMPRESS=lz4 in the handshake.
+ */
+typedef struct Replication {
+    StorageServerState* state;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;             // New records, shutdown
+    bool running;
+
+    ReplRecord* ring;                // Records first_lsn..head_lsn
+    uint64_t first_lsn;
+    uint64_t head_lsn;               // Last assigned LSN, 0 if none
+    uint64_t epoch;                  // Start time of this log (ms)
+
+    ReplReplica replicas[REPL_MAX_REPLICAS];
+    int replica_count;
+
+    ReplSource sources[REPL_MAX_SOURCES];
+    int source_count;
+} Replication;
+
+/**
+ * Initialize / destroy replication state
+ * Destroy stops the shippers and frees the log.
+ * @return 0 on success, -1 on error
+ */
+int repl_init(Replication* repl, StorageServerState* state);
+void repl_destroy(Replication* repl);
+
+/**
+ * Add a replica; its shipper starts now if replication is running
+ * @param repl Replication state
+ * @param ip Replica IP address
+ * @param port Replica SS port
+ * @return 0 on success, -1 if full or already present
+ */
+int repl_add_replica(Replication* repl, const char* ip, int port);
+
+/**
+ * Start / stop the shipper threads
+ */
+int repl_start(Replication* repl);
+void repl_stop(Replication* repl);
+
+/**
+ * Append a committed operation to the log
+ * Does nothing when no replica is configured.
+ * @param repl Replication state
+ * @param op Operation
+ * @param filepath Relative filepath
+ * @return Assigned LSN, 0 if not logged
+ */
+uint64_t repl_log_append(Replication* repl, ReplOp op, const char* filepath);
+
+/**
+ * Handle a REPL_* line from a peer SS (replica side)
+ * Batch payloads are taken from the session's buffered input first and
+ * then read from the socket; whatever follows stays buffered.
+ * @param repl Replication state
+ * @param fd Peer connection
+ * @param line Request line
+ * @param inbuf Session input buffer
+ * @param inlen Bytes buffered (updated)
+ * @return 0 to keep the connection, -1 to close it
+ */
+int repl_handle_peer_line(Replication* repl, int fd, const char* line,
+                          char* inbuf, size_t* inlen);
+
+/**
+ * Format replication status (log head and per-replica lag)
+ * @param repl Replication state
+ * @param buf Output buffer
+ * @param size Buffer size
+ * @return Length written
+ */
+int repl_format_status(Replication* repl, char* buf, size_t size);
+
+#endif // SS_REPL_H
@@ -0,0 +1,362 @@
+#include "ss_scan.h"
+#include "ss_server.h"
+#include "../common/utils.h"
+#include "../common/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+// Record layout returned by getdents64(2)
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/* ===============================================
+ * SENTENCE INDEXER
+ * =============================================== */
+
+static void* indexer_thread_func(void* arg) {
+    SentenceIndexer* indexer = (SentenceIndexer*)arg;
+    size_t unsaved = 0;
+
+    pthread_mutex_lock(&indexer->mutex);
+    while (indexer->running) {
+        if (indexer->pending_count == 0) {
+            // Caught up: persist the new counts so a restart skips them
+            if (unsaved > 0) {
+                unsaved = 0;
+                pthread_mutex_unlock(&indexer->mutex);
+                meta_store_save(&indexer->state->meta_store, indexer->state);
+                pthread_mutex_lock(&indexer->mutex);
+                continue;
+            }
+            pthread_cond_wait(&indexer->cond, &indexer->mutex);
+            continue;
+        }
+
+        FileEntry* entry = indexer->pending[--indexer->pending_count];
+        pthread_mutex_unlock(&indexer->mutex);
+
+        // Deleted files and ones a request already counted are skipped
+        if (!entry->removed && __atomic_load_n(&entry->sentence_count, __ATOMIC_ACQUIRE) < 0) {
+            file_sentence_count(indexer->state, entry);
+            unsaved++;
+        }
+        file_entry_release(entry);
+
+        pthread_mutex_lock(&indexer->mutex);
+        indexer->indexed++;
+    }
+    pthread_mutex_unlock(&indexer->mutex);
+
+    return NULL;
+}
+
+void sentence_indexer_init(SentenceIndexer* indexer, StorageServerState* state) {
+    memset(indexer, 0, sizeof(SentenceIndexer));
+    pthread_mutex_init(&indexer->mutex, NULL);
+    pthread_cond_init(&indexer->cond, NULL);
+    indexer->state = state;
+}
+
+void sentence_indexer_destroy(SentenceIndexer* indexer) {
+    sentence_indexer_stop(indexer);
+
+    for (size_t i = 0; i < indexer->pending_count; i++) {
+        file_entry_release(indexer->pending[i]);
+    }
+    free(indexer->pending);
+    indexer->pending = NULL;
+    indexer->pending_count = 0;
+    indexer->pending_capacity = 0;
+
+    pthread_mutex_destroy(&indexer->mutex);
+    pthread_cond_destroy(&indexer->cond);
+}
+
+int sentence_indexer_start(SentenceIndexer* indexer) {
+    if (!indexer) return -1;
+
+    pthread_mutex_lock(&indexer->mutex);
+    indexer->running = true;
+    pthread_mutex_unlock(&indexer->mutex);
+
+    if (pthread_create(&indexer->thread, NULL, indexer_thread_func, indexer) != 0) {
+        indexer->running = false;
+        return -1;
+    }
+    indexer->started = true;
+    return 0;
+}
+
+void sentence_indexer_stop(SentenceIndexer* indexer) {
+    if (!indexer || !indexer->started) return;
+
+    pthread_mutex_lock(&indexer->mutex);
+    indexer->running = false;
+    pthread_cond_signal(&indexer->cond);
+    pthread_mutex_unlock(&indexer->mutex);
+
+    pthread_join(indexer->thread, NULL);
+    indexer->started = false;
+}
+
+int sentence_indexer_enqueue(SentenceIndexer* indexer, FileEntry* entry) {
+    if (!indexer || !entry) return -1;
+
+    pthread_mutex_lock(&indexer->mutex);
+    if (indexer->pending_count == indexer->pending_capacity) {
+        size_t capacity = indexer->pending_capacity ? indexer->pending_capacity * 2 : 1024;
+        FileEntry** pending = realloc(indexer->pending, capacity * sizeof(FileEntry*));
+        if (!pending) {
+            pthread_mutex_unlock(&indexer->mutex);
+            return -1;
+        }
+        indexer->pending = pending;
+        indexer->pending_capacity = capacity;
+    }
+
+    file_entry_acquire(entry);
+    indexer->pending[indexer->pending_count++] = entry;
+    pthread_cond_signal(&indexer->cond);
+    pthread_mutex_unlock(&indexer->mutex);
+
+    return 0;
+}
+
+/* ===============================================
+ * PARALLEL TREE SCAN
+ * =============================================== */
+
+typedef struct ScanDir {
+    struct ScanDir* next;
+    char relpath[];                  // "" for the base directory
+} ScanDir;
+
+typedef struct {
+    StorageServerState* state;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    ScanDir* pending;                // Directories not yet read (LIFO)
+    int active;                      // Workers reading a directory
+    int registered;
+    bool root_failed;
+} ScanJob;
+
+// Caller holds job->mutex
+static int push_dir(ScanJob* job, const char* relpath) {
+    size_t len = strlen(relpath);
+    ScanDir* dir = malloc(sizeof(ScanDir) + len + 1);
+    if (!dir) return -1;
+    memcpy(dir->relpath, relpath, len + 1);
+
+    dir->next = job->pending;
+    job->pending = dir;
+    pthread_cond_signal(&job->cond);
+    return 0;
+}
+
+// Temp files a crash can leave next to a file: "<name><suffix>XXXXXX" from
+// the atomic write, freeze and revert paths
+static bool is_temp_name(const char* name) {
+    static const char* const suffixes[] = { ".write.", ".cold.", ".revert." };
+    size_t len = strlen(name);
+
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++) {
+        size_t suffix_len = strlen(suffixes[i]);
+        if (len > suffix_len + 6 &&
+            strncmp(name + len - 6 - suffix_len, suffixes[i], suffix_len) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void register_scanned(ScanJob* job, const char* relpath, const struct stat* st) {
+    StorageServerState* state = job->state;
+    bool is_dir = S_ISDIR(st->st_mode);
+
+    FileEntry* entry = registry_new_entry(state->base_path, relpath, is_dir);
+    if (!entry) return;
+
+    entry->file_size = st->st_size;
+    entry->created_at = st->st_ctime;
+    entry->modified_at = st->st_mtime;
+    entry->inode = st->st_ino;
+    entry->sentence_count = is_dir ? 0 : -1;  // Counted lazily
+
+    // Unchanged since the last save: no need to read it at all
+    const MetaRecord* saved = is_dir ? NULL : meta_store_find(&state->meta_store, relpath, st);
+    if (saved) {
+        entry->sentence_count = saved->sentence_count;
+        entry->repl_source = saved->repl_source;
+        if (saved->version > 0) entry->version = saved->version;
+    }
+
+    FileEntry* registered = registry_insert(&state->registry, entry);
+    if (registered == entry && !is_dir) {
+        if (entry->sentence_count < 0) sentence_indexer_enqueue(&state->indexer, entry);
+
+        pthread_mutex_lock(&job->mutex);
+        job->registered++;
+        pthread_mutex_unlock(&job->mutex);
+    }
+    file_entry_release(registered);
+}
+
+static void scan_directory(ScanJob* job, const char* relpath) {
+    StorageServerState* state = job->state;
+
+    char dir_path[MAX_PATH_LEN];
+    int path_len = relpath[0]
+        ? snprintf(dir_path, sizeof(dir_path), "%s/%s", state->base_path, relpath)
+        : snprintf(dir_path, sizeof(dir_path), "%s", state->base_path);
+
+    // A truncated path would name some other directory
+    int dir_fd = path_len >= 0 && (size_t)path_len < sizeof(dir_path)
+        ? open(dir_path, O_RDONLY | O_DIRECTORY) : -1;
+    if (dir_fd < 0) {
+        if (!relpath[0]) job->root_failed = true;
+        return;
+    }
+
+    char buffer[SCAN_DIRENT_BUFFER];
+    for (;;) {
+        long n = syscall(SYS_getdents64, dir_fd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+
+        for (long pos = 0; pos < n; ) {
+            struct linux_dirent64* d = (struct linux_dirent64*)(buffer + pos);
+            pos += d->d_reclen;
+
+            // Skip . and .. as well as internal state such as .checkpoints
+            if (d->d_name[0] == '.') continue;
+
+            char child[MAX_PATH_LEN];
+            int len = relpath[0]
+                ? snprintf(child, sizeof(child), "%s/%s", relpath, d->d_name)
+                : snprintf(child, sizeof(child), "%s", d->d_name);
+            if (len < 0 || (size_t)len + strlen(state->base_path) + 1 >= MAX_PATH_LEN) {
+                continue;
+            }
+
+            // Follows symlinks, like the registry's stat()
+            struct stat st;
+            if (fstatat(dir_fd, d->d_name, &st, 0) < 0) continue;
+
+            // The scan runs before any writer, so leftover temp files are
+            // from an interrupted run
+            if (S_ISREG(st.st_mode) && is_temp_name(d->d_name)) {
+                unlinkat(dir_fd, d->d_name, 0);
+                continue;
+            }
+
+            register_scanned(job, child, &st);
+
+            if (S_ISDIR(st.st_mode)) {
+                pthread_mutex_lock(&job->mutex);
+                push_dir(job, child);
+                pthread_mutex_unlock(&job->mutex);
+            }
+        }
+    }
+
+    close(dir_fd);
+}
+
+static void* scan_worker_func(void* arg) {
+    ScanJob* job = (ScanJob*)arg;
+
+    pthread_mutex_lock(&job->mutex);
+    for (;;) {
+        // Done once nothing is queued and nobody can queue more
+        while (!job->pending && job->active > 0) {
+            pthread_cond_wait(&job->cond, &job->mutex);
+        }
+        if (!job->pending) break;
+
+        ScanDir* dir = job->pending;
+        job->pending = dir->next;
+        job->active++;
+        pthread_mutex_unlock(&job->mutex);
+
+        scan_directory(job, dir->relpath);
+        free(dir);
+
+        pthread_mutex_lock(&job->mutex);
+        job->active--;
+        if (!job->pending && job->active == 0) {
+            pthread_cond_broadcast(&job->cond);
+        }
+    }
+    pthread_mutex_unlock(&job->mutex);
+
+    return NULL;
+}
+
+int ss_scan_tree(StorageServerState* state, int workers) {
+    if (!state) return -1;
+
+    if (workers <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = (int)(cpus > 0 ? cpus : 1) * SCAN_WORKERS_PER_CPU;
+    }
+    if (workers > SCAN_MAX_WORKERS) workers = SCAN_MAX_WORKERS;
+
+    ScanJob job;
+    memset(&job, 0, sizeof(job));
+    job.state = state;
+    pthread_mutex_init(&job.mutex, NULL);
+    pthread_cond_init(&job.cond, NULL);
+
+    long long started_ms = monotonic_timestamp_ms();
+
+    int result = 0;
+    if (push_dir(&job, "") < 0) {
+        result = -1;
+    } else {
+        pthread_t threads[SCAN_MAX_WORKERS];
+        int started = 0;
+        for (int i = 0; i < workers; i++) {
+            if (pthread_create(&threads[started], NULL, scan_worker_func, &job) == 0) {
+                started++;
+            }
+        }
+
+        // No threads at all: walk on the calling thread
+        if (started == 0) {
+            scan_worker_func(&job);
+        }
+        for (int i = 0; i < started; i++) {
+            pthread_join(threads[i], NULL);
+        }
+
+        result = job.root_failed ? -1 : job.registered;
+    }
+
+    pthread_mutex_destroy(&job.mutex);
+    pthread_cond_destroy(&job.cond);
+
+    if (result < 0) {
+        log_message("SS", "0.0.0.0", state->client_port, "system", "SCAN",
+                   "Cannot read base directory", "ERROR");
+        return -1;
+    }
+
+    char log_msg[128];
+    snprintf(log_msg, sizeof(log_msg), "SCAN_FILES - Found %d files in %lld ms (%d workers)",
+             result, monotonic_timestamp_ms() - started_ms, workers);
+    log_message("SS", "0.0.0.0", state->client_port, "system", "SCAN", log_msg, "SUCCESS");
+
+    return result;
+}
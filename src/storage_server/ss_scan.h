@@ -0,0 +1,71 @@
+#ifndef SS_SCAN_H
+#define SS_SCAN_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCAN_MAX_WORKERS 16
+#define SCAN_WORKERS_PER_CPU 2           // Directory reads block on the disk
+#define SCAN_DIRENT_BUFFER 32768         // getdents64 batch size
+
+typedef struct StorageServerState StorageServerState;
+struct FileEntry;
+
+/**
+ * Sentence Indexer
+ * Background thread that counts sentences for files the startup scan
+ * registered without reading, saving the metadata sidecar each time it
+ * catches up. Requests that need a count before the indexer gets there
+ * compute it themselves (see file_sentence_count).
+ */
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    struct FileEntry** pending;      // Referenced entries, LIFO
+    size_t pending_count;
+    size_t pending_capacity;
+
+    StorageServerState* state;
+    pthread_t thread;
+    bool running;
+    bool started;
+
+    uint64_t indexed;                // Entries taken off the queue
+} SentenceIndexer;
+
+/**
+ * Initialize / destroy the indexer
+ * Destroy stops the thread and drops queued references.
+ */
+void sentence_indexer_init(SentenceIndexer* indexer, StorageServerState* state);
+void sentence_indexer_destroy(SentenceIndexer* indexer);
+
+/**
+ * Start / stop the background thread
+ * @return 0 on success, -1 on error
+ */
+int sentence_indexer_start(SentenceIndexer* indexer);
+void sentence_indexer_stop(SentenceIndexer* indexer);
+
+/**
+ * Queue an entry for background counting (takes its own reference)
+ * @return 0 on success, -1 on allocation failure
+ */
+int sentence_indexer_enqueue(SentenceIndexer* indexer, struct FileEntry* entry);
+
+/**
+ * Walk the base directory recursively with a pool of workers and register
+ * every file and directory found. Entries are registered from directory
+ * metadata and the metadata sidecar only; files the sidecar doesn't
+ * vouch for have their sentences counted later by the indexer. Temp files
+ * left behind by an interrupted write, freeze or revert are removed.
+ * @param state Storage server state
+ * @param workers Worker threads (0 picks SCAN_WORKERS_PER_CPU per CPU)
+ * @return Number of files (not directories) registered, -1 if the base
+ *         directory can't be read
+ */
+int ss_scan_tree(StorageServerState* state, int workers);
+
+#endif // SS_SCAN_H
@@ -1,4 +1,6 @@
 #include "ss_server.h"
+#include "ss_io.h"
+#include "ss_transfer.h"
 #include "../common/utils.h"
 #include "../common/logger.h"
 #include "../common/error_codes.h"
@@ -7,10 +9,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sched.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
-#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <netinet/in.h>
@@ -36,12 +38,21 @@ int ss_init(StorageServerState* state, int ss_id, const char* base_path,
     state->client_port = client_port;
     state->ss_port = ss_port;
     state->running = true;
-    state->file_count = 0;
-    state->active_locks = NULL;
+    
+    if (registry_init(&state->registry) < 0) {
+        return -1;
+    }
     
     // Initialize mutexes
-    pthread_mutex_init(&state->registry_mutex, NULL);
-    pthread_mutex_init(&state->lock_list_mutex, NULL);
+    lock_table_init(&state->lock_table);
+    sentence_indexer_init(&state->indexer, state);
+    cold_freezer_init(&state->freezer, state, COLD_FREEZE_AGE_SEC);
+    if (repl_init(&state->replication, state) < 0) {
+        return -1;
+    }
+    stream_engine_init(&state->stream_engine);
+    content_cache_init(&state->content_cache, CONTENT_CACHE_DEFAULT_BYTES);
+    fd_cache_init(&state->fd_cache, FD_CACHE_DEFAULT_ENTRIES);
     
     // Create base directory if it doesn't exist
     struct stat st;
@@ -52,6 +63,12 @@ int ss_init(StorageServerState* state, int ss_id, const char* base_path,
         }
     }
     
+    if (chunk_store_init(&state->chunk_store, base_path) < 0) {
+        fprintf(stderr, "Failed to initialize checkpoint store\n");
+        return -1;
+    }
+    meta_store_open(&state->meta_store, base_path);
+    
     // Create client listening socket
     state->client_listen_socket = socket(AF_INET, SOCK_STREAM, 0);
     if (state->client_listen_socket < 0) {
@@ -73,7 +90,7 @@ int ss_init(StorageServerState* state, int ss_id, const char* base_path,
         return -1;
     }
     
-    if (listen(state->client_listen_socket, 10) < 0) {
+    if (listen(state->client_listen_socket, SOMAXCONN) < 0) {
         perror("listen client");
         close(state->client_listen_socket);
         return -1;
@@ -97,7 +114,7 @@ int ss_init(StorageServerState* state, int ss_id, const char* base_path,
         return -1;
     }
     
-    if (listen(state->ss_listen_socket, 5) < 0) {
+    if (listen(state->ss_listen_socket, SOMAXCONN) < 0) {
         perror("listen ss");
         close(state->client_listen_socket);
         close(state->ss_listen_socket);
@@ -113,6 +130,23 @@ int ss_init(StorageServerState* state, int ss_id, const char* base_path,
     return 0;
 }
 
+typedef struct {
+    char* buf;
+    size_t size;
+    int offset;
+    int files;
+} RegistrationList;
+
+static bool append_registration_file(FileEntry* entry, void* arg) {
+    RegistrationList* list = (RegistrationList*)arg;
+    if (list->files >= 50 || (size_t)list->offset >= list->size) return false;
+    
+    list->offset += snprintf(list->buf + list->offset, list->size - list->offset,
+                             "FILE:%s\n", entry->filepath);
+    list->files++;
+    return true;
+}
+
 int register_with_name_server(StorageServerState* state) {
     if (!state) return -1;
     
@@ -153,15 +187,11 @@ int register_with_name_server(StorageServerState* state) {
                        "SS_PORT:%d\n", state->ss_port);
     
     // Send file list
-    pthread_mutex_lock(&state->registry_mutex);
     offset += snprintf(reg_msg + offset, sizeof(reg_msg) - offset,
-                       "FILE_COUNT:%d\n", state->file_count);
+                       "FILE_COUNT:%zu\n", registry_count(&state->registry));
     
-    for (int i = 0; i < state->file_count && i < 50; i++) {
-        offset += snprintf(reg_msg + offset, sizeof(reg_msg) - offset,
-                           "FILE:%s\n", state->files[i].filepath);
-    }
-    pthread_mutex_unlock(&state->registry_mutex);
+    RegistrationList list = { reg_msg, sizeof(reg_msg), offset, 0 };
+    registry_foreach(&state->registry, append_registration_file, &list);
     
     // Send message
     if (send_all(state->nm_socket, reg_msg, strlen(reg_msg)) < 0) {
@@ -214,24 +244,25 @@ void ss_cleanup(StorageServerState* state) {
     if (state->client_listen_socket > 0) close(state->client_listen_socket);
     if (state->ss_listen_socket > 0) close(state->ss_listen_socket);
     
-    // Clean up locks
-    pthread_mutex_lock(&state->lock_list_mutex);
-    SentenceLock* lock = state->active_locks;
-    while (lock) {
-        SentenceLock* next = lock->next;
-        pthread_mutex_destroy(&lock->lock_mutex);
-        free(lock);
-        lock = next;
-    }
-    pthread_mutex_unlock(&state->lock_list_mutex);
+    // Stop shipping before the registry it reads from goes away
+    repl_destroy(&state->replication);
+    
+    // Abort streams, then clean up locks
+    stream_engine_destroy(&state->stream_engine);
+    lock_table_destroy(&state->lock_table);
     
-    // Destroy mutexes
-    pthread_mutex_destroy(&state->registry_mutex);
-    pthread_mutex_destroy(&state->lock_list_mutex);
+    chunk_store_destroy(&state->chunk_store);
+    content_cache_destroy(&state->content_cache);
+    sentence_indexer_destroy(&state->indexer);
+    cold_freezer_destroy(&state->freezer);
+    fd_cache_destroy(&state->fd_cache);
     
-    for (int i = 0; i < state->file_count; i++) {
-        pthread_mutex_destroy(&state->files[i].file_mutex);
+    // Counts known now won't need a content read next startup
+    if (registry_count(&state->registry) > 0) {
+        meta_store_save(&state->meta_store, state);
     }
+    meta_store_close(&state->meta_store);
+    registry_destroy(&state->registry);
     
     log_message("SS", "0.0.0.0", state->client_port, "system",
                "SHUTDOWN", "Complete", "SUCCESS");
@@ -243,103 +274,75 @@ void ss_cleanup(StorageServerState* state) {
 
 int scan_and_register_files(StorageServerState* state) {
     if (!state) return -1;
-    
-    DIR* dir = opendir(state->base_path);
-    if (!dir) {
-        perror("opendir");
-        return -1;
-    }
-    
-    struct dirent* entry;
-    int count = 0;
-    
-    while ((entry = readdir(dir)) != NULL) {
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-            continue;
-        }
-        
-        char full_path[MAX_PATH_LEN];
-        snprintf(full_path, sizeof(full_path), "%s/%s", 
-                 state->base_path, entry->d_name);
-        
-        struct stat st;
-        if (stat(full_path, &st) == 0) {
-            bool is_dir = S_ISDIR(st.st_mode);
-            if (add_file_to_registry(state, entry->d_name, is_dir)) {
-                count++;
-            }
-        }
-    }
-    
-    closedir(dir);
-    
-    char log_msg[128];
-    snprintf(log_msg, sizeof(log_msg), "SCAN_FILES - Found %d files", count);
-    log_message("SS", "0.0.0.0", state->client_port, "system", "SCAN", log_msg, "SUCCESS");
-    
-    return count;
+    return ss_scan_tree(state, 0);
 }
 
 FileEntry* add_file_to_registry(StorageServerState* state, 
                                  const char* filepath, bool is_directory) {
     if (!state || !filepath) return NULL;
     
-    pthread_mutex_lock(&state->registry_mutex);
-    
-    if (state->file_count >= MAX_FILES) {
-        pthread_mutex_unlock(&state->registry_mutex);
-        return NULL;
-    }
-    
-    FileEntry* entry = &state->files[state->file_count];
-    memset(entry, 0, sizeof(FileEntry));
-    
-    strncpy(entry->filepath, filepath, sizeof(entry->filepath) - 1);
-    snprintf(entry->full_path, sizeof(entry->full_path), "%s/%s",
-             state->base_path, filepath);
-    entry->is_directory = is_directory;
-    entry->locks = NULL;
+    // Fill the entry in before publishing it; the registry lock is only
+    // held for the insert itself
+    FileEntry* entry = registry_new_entry(state->base_path, filepath, is_directory);
+    if (!entry) return NULL;
     
     struct stat st;
     if (stat(entry->full_path, &st) == 0) {
         entry->file_size = st.st_size;
         entry->created_at = st.st_ctime;
         entry->modified_at = st.st_mtime;
+        entry->inode = st.st_ino;
     }
     
     if (!is_directory) {
         entry->sentence_count = count_sentences(entry->full_path);
     }
     
-    pthread_mutex_init(&entry->file_mutex, NULL);
-    
-    state->file_count++;
-    pthread_mutex_unlock(&state->registry_mutex);
-    
-    return entry;
+    return registry_insert(&state->registry, entry);
+}
+
+// Paths come from the network: keep them inside the storage directory
+bool is_safe_filepath(const char* path) {
+    if (!path || path[0] == '\0' || path[0] == '/' || path[0] == '.') return false;
+    if (strlen(path) >= MAX_PATH_LEN) return false;
+    
+    const char* p = path;
+    while ((p = strstr(p, "..")) != NULL) {
+        bool starts = (p == path || p[-1] == '/');
+        bool ends = (p[2] == '\0' || p[2] == '/');
+        if (starts && ends) return false;
+        p += 2;
+    }
+    return true;
 }
 
 FileEntry* find_file(StorageServerState* state, const char* filepath) {
     if (!state || !filepath) return NULL;
-    
-    pthread_mutex_lock(&state->registry_mutex);
-    
-    for (int i = 0; i < state->file_count; i++) {
-        if (strcmp(state->files[i].filepath, filepath) == 0) {
-            pthread_mutex_unlock(&state->registry_mutex);
-            return &state->files[i];
-        }
+    return registry_lookup(&state->registry, filepath);
+}
+
+// find_file for operations that need file content (not directories)
+static FileEntry* find_regular_file(StorageServerState* state, const char* filepath) {
+    FileEntry* entry = find_file(state, filepath);
+    if (entry && entry->is_directory) {
+        file_entry_release(entry);
+        return NULL;
     }
-    
-    pthread_mutex_unlock(&state->registry_mutex);
-    return NULL;
+    return entry;
 }
 
-int create_file(StorageServerState* state, const char* filepath) {
-    if (!state || !filepath) return ERR_INVALID_OPERATION;
-    
+static bool is_registered_file(StorageServerState* state, const char* filepath) {
+    FileEntry* entry = find_file(state, filepath);
+    file_entry_release(entry);
+    return entry != NULL;
+}
+
+static int create_file_local(StorageServerState* state, const char* filepath) {
     char full_path[MAX_PATH_LEN];
-    snprintf(full_path, sizeof(full_path), "%s/%s", state->base_path, filepath);
+    int path_len = snprintf(full_path, sizeof(full_path), "%s/%s", state->base_path, filepath);
+    if (path_len < 0 || (size_t)path_len >= sizeof(full_path)) {
+        return ERR_INVALID_OPERATION;
+    }
     
     // Check if file already exists
     if (access(full_path, F_OK) == 0) {
@@ -354,10 +357,12 @@ int create_file(StorageServerState* state, const char* filepath) {
     fclose(fp);
     
     // Add to registry
-    if (!add_file_to_registry(state, filepath, false)) {
+    FileEntry* entry = add_file_to_registry(state, filepath, false);
+    if (!entry) {
         unlink(full_path);
         return ERR_INVALID_OPERATION;
     }
+    file_entry_release(entry);
     
     log_message("SS", "0.0.0.0", state->client_port, "system",
                "CREATE", filepath, "SUCCESS");
@@ -365,35 +370,44 @@ int create_file(StorageServerState* state, const char* filepath) {
     return ERR_SUCCESS;
 }
 
-int delete_file(StorageServerState* state, const char* filepath) {
+int create_file(StorageServerState* state, const char* filepath) {
     if (!state || !filepath) return ERR_INVALID_OPERATION;
     
+    int result = create_file_local(state, filepath);
+    if (result == ERR_SUCCESS) {
+        repl_log_append(&state->replication, REPL_OP_CREATE, filepath);
+    }
+    return result;
+}
+
+// Replicas apply their primary's deletes even while local readers hold
+// locks; check_locks is only set for client requests
+static int delete_file_local(StorageServerState* state, const char* filepath,
+                             bool check_locks) {
     FileEntry* entry = find_file(state, filepath);
     if (!entry) {
         return ERR_FILE_NOT_FOUND;
     }
     
     // Check if file has active locks
-    if (entry->locks != NULL) {
+    if (check_locks && is_file_locked(state, filepath)) {
+        file_entry_release(entry);
         return ERR_FILE_LOCKED;
     }
     
     // Delete physical file
     if (unlink(entry->full_path) < 0) {
+        file_entry_release(entry);
         return ERR_INVALID_OPERATION;
     }
     
-    // Remove from registry
-    pthread_mutex_lock(&state->registry_mutex);
-    pthread_mutex_destroy(&entry->file_mutex);
-    
-    // Shift remaining entries
-    for (int i = (entry - state->files); i < state->file_count - 1; i++) {
-        state->files[i] = state->files[i + 1];
-    }
-    state->file_count--;
+    // Remove from registry; threads still holding the entry keep it
+    registry_remove(&state->registry, entry);
+    file_entry_release(entry);
     
-    pthread_mutex_unlock(&state->registry_mutex);
+    chunk_store_drop_file(&state->chunk_store, filepath);
+    content_cache_invalidate(&state->content_cache, ss_file_id(filepath), 0);
+    fd_cache_invalidate(&state->fd_cache, ss_file_id(filepath), 0);
     
     log_message("SS", "0.0.0.0", state->client_port, "system",
                "DELETE", filepath, "SUCCESS");
@@ -401,56 +415,19 @@ int delete_file(StorageServerState* state, const char* filepath) {
     return ERR_SUCCESS;
 }
 
-int copy_file_to_ss(StorageServerState* state, const char* filepath,
-                    const char* dest_ss_ip, int dest_ss_port) {
-    if (!state || !filepath || !dest_ss_ip) return ERR_INVALID_OPERATION;
-    
-    FileEntry* entry = find_file(state, filepath);
-    if (!entry) {
-        return ERR_FILE_NOT_FOUND;
-    }
-    
-    // Connect to destination SS
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) {
-        return ERR_CONNECTION_FAILED;
-    }
-    
-    struct sockaddr_in dest_addr;
-    dest_addr.sin_family = AF_INET;
-    dest_addr.sin_port = htons(dest_ss_port);
-    inet_pton(AF_INET, dest_ss_ip, &dest_addr.sin_addr);
-    
-    if (connect(sock, (struct sockaddr*)&dest_addr, sizeof(dest_addr)) < 0) {
-        close(sock);
-        return ERR_CONNECTION_FAILED;
-    }
-    
-    // Send COPY command
-    char cmd[256];
-    snprintf(cmd, sizeof(cmd), "COPY %s\n", filepath);
-    send_all(sock, cmd, strlen(cmd));
-    
-    // Send file content
-    FILE* fp = fopen(entry->full_path, "r");
-    if (!fp) {
-        close(sock);
-        return ERR_INVALID_OPERATION;
-    }
+int delete_file(StorageServerState* state, const char* filepath) {
+    if (!state || !filepath) return ERR_INVALID_OPERATION;
     
-    char buffer[4096];
-    size_t n;
-    while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
-        send_all(sock, buffer, n);
+    int result = delete_file_local(state, filepath, true);
+    if (result == ERR_SUCCESS) {
+        repl_log_append(&state->replication, REPL_OP_DELETE, filepath);
     }
-    
-    fclose(fp);
-    close(sock);
-    
-    log_message("SS", dest_ss_ip, dest_ss_port, "system",
-               "COPY", filepath, "SUCCESS");
-    
-    return ERR_SUCCESS;
+    return result;
+}
+
+int copy_file_to_ss(StorageServerState* state, const char* filepath,
+                    const char* dest_ss_ip, int dest_ss_port) {
+    return transfer_send_file(state, filepath, dest_ss_ip, dest_ss_port);
 }
 
 /* ===============================================
@@ -460,7 +437,7 @@ int copy_file_to_ss(StorageServerState* state, const char* filepath,
 int count_sentences(const char* filepath) {
     if (!filepath) return -1;
     
-    FILE* fp = fopen(filepath, "r");
+    FILE* fp = cold_fopen(filepath);
     if (!fp) return -1;
     
     int count = 0;
@@ -487,6 +464,27 @@ int count_sentences(const char* filepath) {
     return count > 0 ? count : 0;
 }
 
+int file_sentence_count(StorageServerState* state, FileEntry* entry) {
+    if (!state || !entry) return 0;
+    
+    int count = __atomic_load_n(&entry->sentence_count, __ATOMIC_ACQUIRE);
+    if (count >= 0) return count;
+    
+    // Under the commit mutex so a concurrent commit's count is not
+    // overwritten with one from the previous version
+    pthread_mutex_t* commit_mutex = registry_commit_mutex(&state->registry, entry);
+    pthread_mutex_lock(commit_mutex);
+    count = entry->sentence_count;
+    if (count < 0) {
+        count = count_sentences(entry->full_path);
+        if (count < 0) count = 0;
+        __atomic_store_n(&entry->sentence_count, count, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(commit_mutex);
+    
+    return count;
+}
+
 int read_sentence(const char* filepath, int sentence_idx, 
                   char* buffer, size_t buffer_size) {
     if (!filepath || !buffer || buffer_size == 0) return -1;
@@ -527,33 +525,15 @@ int read_sentence(const char* filepath, int sentence_idx,
     return pos;
 }
 
-int write_sentence(const char* filepath, int sentence_idx, const char* content) {
-    if (!filepath || !content) return ERR_INVALID_OPERATION;
-    
-    // Read entire file
-    FILE* fp = fopen(filepath, "r");
-    if (!fp) return ERR_FILE_NOT_FOUND;
-    
-    fseek(fp, 0, SEEK_END);
-    long file_size = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-    
-    char* file_content = malloc(file_size + 1);
-    if (!file_content) {
-        fclose(fp);
-        return ERR_INVALID_OPERATION;
-    }
-    
-    fread(file_content, 1, file_size, fp);
-    file_content[file_size] = '\0';
-    fclose(fp);
-    
-    // Find sentence boundaries
+// Bounds of a sentence in file content. The sentence just past the last
+// one is empty and sits at the end, so writing it appends a sentence.
+static int find_sentence_span(const char* file_content, size_t file_size, int sentence_idx,
+                              size_t* start, size_t* end) {
     int current_sentence = 0;
-    size_t start_pos = 0, end_pos = 0;
+    size_t start_pos = 0;
     bool in_sentence = false;
     
-    for (size_t i = 0; i < (size_t)file_size; i++) {
+    for (size_t i = 0; i < file_size; i++) {
         char ch = file_content[i];
         
         if (!in_sentence && ch != ' ' && ch != '\t' && ch != '\n') {
@@ -565,48 +545,130 @@ int write_sentence(const char* filepath, int sentence_idx, const char* content)
         
         if (in_sentence && (ch == '.' || ch == '!' || ch == '?')) {
             if (current_sentence == sentence_idx) {
-                end_pos = i + 1;
-                break;
+                *start = start_pos;
+                *end = i + 1;
+                return ERR_SUCCESS;
             }
             current_sentence++;
             in_sentence = false;
         }
     }
     
-    if (current_sentence != sentence_idx) {
-        free(file_content);
+    if (sentence_idx < 0 || current_sentence != sentence_idx) {
+        return ERR_INVALID_OPERATION;
+    }
+    // Unterminated last sentence, or a new one
+    *start = in_sentence ? start_pos : file_size;
+    *end = file_size;
+    return ERR_SUCCESS;
+}
+
+// Builds old content with one sentence replaced; *out is malloc'd and
+// NUL-terminated
+static int splice_sentence(const char* file_content, size_t file_size, int sentence_idx,
+                           const char* content, char** out, size_t* out_size) {
+    size_t start_pos, end_pos;
+    if (find_sentence_span(file_content, file_size, sentence_idx,
+                           &start_pos, &end_pos) != ERR_SUCCESS) {
         return ERR_INVALID_OPERATION;
     }
     
+    // A new sentence is separated from the one before it
+    const char* sep = start_pos == file_size && file_size > 0 &&
+                      file_content[file_size - 1] != ' ' &&
+                      file_content[file_size - 1] != '\n' ? " " : "";
+    
     // Build new content
-    size_t new_size = start_pos + strlen(content) + (file_size - end_pos);
+    size_t sep_len = strlen(sep);
+    size_t content_len = strlen(content);
+    size_t new_size = start_pos + sep_len + content_len + (file_size - end_pos);
     char* new_content = malloc(new_size + 1);
     if (!new_content) {
-        free(file_content);
         return ERR_INVALID_OPERATION;
     }
     
     memcpy(new_content, file_content, start_pos);
-    strcpy(new_content + start_pos, content);
-    memcpy(new_content + start_pos + strlen(content),
+    memcpy(new_content + start_pos, sep, sep_len);
+    memcpy(new_content + start_pos + sep_len, content, content_len);
+    memcpy(new_content + start_pos + sep_len + content_len,
            file_content + end_pos, file_size - end_pos);
     new_content[new_size] = '\0';
     
-    // Write back to file
-    fp = fopen(filepath, "w");
-    if (!fp) {
-        free(file_content);
-        free(new_content);
+    *out = new_content;
+    *out_size = new_size;
+    return ERR_SUCCESS;
+}
+
+// Build the new version beside the old one, then swap it in atomically;
+// readers that already opened the file keep the old inode
+static int replace_file_contents(const char* filepath, const char* data, size_t size) {
+    char tmp_path[MAX_PATH_LEN + 32];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.write.XXXXXX", filepath);
+    
+    int fd = mkstemp(tmp_path);
+    if (fd < 0) {
         return ERR_INVALID_OPERATION;
     }
+    fchmod(fd, 0644);
     
-    fwrite(new_content, 1, new_size, fp);
-    fclose(fp);
+    int result = ERR_SUCCESS;
+    if (ss_io_write_and_sync(fd, data, size) < 0) {
+        result = ERR_INVALID_OPERATION;
+    }
+    close(fd);
+    
+    if (result == ERR_SUCCESS && ss_io_rename(tmp_path, filepath) < 0) {
+        result = ERR_INVALID_OPERATION;
+    }
+    if (result != ERR_SUCCESS) {
+        unlink(tmp_path);
+    }
+    
+    return result;
+}
+
+// Replaces one sentence of the size bytes readable from in_fd and writes
+// the result as the new version of filepath
+static int write_sentence_from(int in_fd, off_t size, const char* filepath,
+                               int sentence_idx, const char* content) {
+    char* file_content = malloc((size_t)size + 1);
+    if (!file_content) {
+        return ERR_INVALID_OPERATION;
+    }
+    
+    ssize_t got = ss_io_pread_all(in_fd, file_content, (size_t)size, 0);
+    if (got < 0) {
+        free(file_content);
+        return ERR_INVALID_OPERATION;
+    }
+    file_content[got] = '\0';
     
+    char* new_content = NULL;
+    size_t new_size = 0;
+    int result = splice_sentence(file_content, (size_t)got, sentence_idx, content,
+                                 &new_content, &new_size);
     free(file_content);
+    if (result != ERR_SUCCESS) return result;
+    
+    result = replace_file_contents(filepath, new_content, new_size);
     free(new_content);
     
-    return ERR_SUCCESS;
+    return result;
+}
+
+int write_sentence(const char* filepath, int sentence_idx, const char* content) {
+    if (!filepath || !content) return ERR_INVALID_OPERATION;
+    
+    int in_fd = open(filepath, O_RDONLY);
+    if (in_fd < 0) return ERR_FILE_NOT_FOUND;
+    
+    struct stat st;
+    int result = fstat(in_fd, &st) < 0
+        ? ERR_INVALID_OPERATION
+        : write_sentence_from(in_fd, st.st_size, filepath, sentence_idx, content);
+    close(in_fd);
+    
+    return result;
 }
 
 int append_to_file(const char* filepath, const char* content) {
@@ -622,244 +684,594 @@ int append_to_file(const char* filepath, const char* content) {
 }
 
 /* ===============================================
- * LOCKING MECHANISMS
+ * VERSIONED SNAPSHOTS
  * =============================================== */
 
-int acquire_read_lock(StorageServerState* state, const char* filepath,
-                      int sentence_idx, int client_fd) {
-    if (!state || !filepath) return ERR_INVALID_OPERATION;
-    
-    pthread_mutex_lock(&state->lock_list_mutex);
-    
-    // Check for existing write lock
-    SentenceLock* lock = state->active_locks;
-    while (lock) {
-        if (strcmp(lock->filepath, filepath) == 0 && 
-            lock->sentence_idx == sentence_idx && 
-            lock->is_write_lock) {
-            pthread_mutex_unlock(&state->lock_list_mutex);
-            return ERR_FILE_LOCKED;
-        }
-        lock = lock->next;
-    }
-    
-    // Check for existing read lock by this client
-    lock = state->active_locks;
-    while (lock) {
-        if (strcmp(lock->filepath, filepath) == 0 && 
-            lock->sentence_idx == sentence_idx && 
-            !lock->is_write_lock) {
-            lock->read_count++;
-            pthread_mutex_unlock(&state->lock_list_mutex);
-            return ERR_SUCCESS;
-        }
-        lock = lock->next;
-    }
-    
-    // Create new read lock
-    SentenceLock* new_lock = malloc(sizeof(SentenceLock));
-    if (!new_lock) {
-        pthread_mutex_unlock(&state->lock_list_mutex);
-        return ERR_INVALID_OPERATION;
+// The version is bumped before the new inode is recorded, so a reader
+// that pairs a version with an inode (see open_stored_snapshot) can only
+// ever see a stale inode, which no descriptor opened since matches
+static void store_file_version(FileEntry* entry, uint64_t version, const struct stat* st) {
+    __atomic_store_n(&entry->version, version, __ATOMIC_RELEASE);
+    __atomic_store_n(&entry->inode, st ? st->st_ino : 0, __ATOMIC_RELEASE);
+}
+
+// Caller holds the entry's commit mutex and has just renamed a new version in
+static void publish_file_version(StorageServerState* state, FileEntry* entry) {
+    struct stat st;
+    bool have_stat = stat(entry->full_path, &st) == 0;
+    if (have_stat) {
+        entry->file_size = st.st_size;
+        entry->modified_at = st.st_mtime;
+        entry->sentence_count = count_sentences(entry->full_path);
     }
-    
-    strncpy(new_lock->filepath, filepath, sizeof(new_lock->filepath) - 1);
-    new_lock->sentence_idx = sentence_idx;
-    new_lock->client_fd = client_fd;
-    new_lock->is_write_lock = false;
-    new_lock->read_count = 1;
-    new_lock->acquired_at = time(NULL);
-    pthread_mutex_init(&new_lock->lock_mutex, NULL);
-    
-    new_lock->next = state->active_locks;
-    state->active_locks = new_lock;
-    
-    pthread_mutex_unlock(&state->lock_list_mutex);
-    
-    return ERR_SUCCESS;
+    uint64_t version = entry->version + 1;
+    store_file_version(entry, version, have_stat ? &st : NULL);
+    content_cache_invalidate(&state->content_cache, entry->file_id, version);
+    fd_cache_invalidate(&state->fd_cache, entry->file_id, version);
 }
 
-int acquire_write_lock(StorageServerState* state, const char* filepath,
-                       int sentence_idx, int client_fd) {
-    if (!state || !filepath) return ERR_INVALID_OPERATION;
-    
-    pthread_mutex_lock(&state->lock_list_mutex);
-    
-    // Check for ANY existing lock on this sentence
-    SentenceLock* lock = state->active_locks;
-    while (lock) {
-        if (strcmp(lock->filepath, filepath) == 0 && 
-            lock->sentence_idx == sentence_idx) {
-            pthread_mutex_unlock(&state->lock_list_mutex);
-            return ERR_FILE_LOCKED;
-        }
-        lock = lock->next;
+// Like publish_file_version, when the committer still has the new
+// content in memory: it goes straight into the cache (taking ownership
+// of data) and its sentence count comes from there, not a re-read
+static void publish_file_content(StorageServerState* state, FileEntry* entry,
+                                 char* data, size_t size) {
+    struct stat st;
+    bool have_stat = stat(entry->full_path, &st) == 0;
+    if (have_stat) {
+        entry->file_size = st.st_size;
+        entry->modified_at = st.st_mtime;
     }
     
-    // Create new write lock
-    SentenceLock* new_lock = malloc(sizeof(SentenceLock));
-    if (!new_lock) {
-        pthread_mutex_unlock(&state->lock_list_mutex);
-        return ERR_INVALID_OPERATION;
+    // Nobody looks the new version up before the bump below
+    uint64_t version = entry->version + 1;
+    CachedContent* content = content_cache_put(&state->content_cache, entry->file_id,
+                                               version, data, size);
+    entry->sentence_count = content ? content->sentence_count
+                                    : count_sentences(entry->full_path);
+    store_file_version(entry, version, have_stat ? &st : NULL);
+    
+    content_cache_invalidate(&state->content_cache, entry->file_id, version);
+    fd_cache_invalidate(&state->fd_cache, entry->file_id, version);
+    content_cache_release(&state->content_cache, content);
+}
+
+// Current version of a file from the cache, loading it on a miss. Returns
+// NULL for files too large to cache; snap is then left open on the
+// version to use instead (snap->fd is -1 on error).
+static CachedContent* load_file_content(StorageServerState* state, FileEntry* entry,
+                                        FileSnapshot* snap) {
+    snap->fd = -1;
+    
+    uint64_t version = __atomic_load_n(&entry->version, __ATOMIC_ACQUIRE);
+    CachedContent* content = content_cache_get(&state->content_cache, entry->file_id,
+                                               version);
+    if (content) return content;
+    
+    if (open_file_snapshot(state, entry, snap) != ERR_SUCCESS) return NULL;
+    if (!content_cache_accepts(&state->content_cache, (size_t)snap->size)) return NULL;
+    
+    char* data = malloc((size_t)snap->size + 1);
+    if (!data) return NULL;
+    
+    ssize_t got = ss_io_pread_all(snap->fd, data, (size_t)snap->size, 0);
+    if (got < 0) {
+        free(data);
+        return NULL;
     }
+    data[got] = '\0';
     
-    strncpy(new_lock->filepath, filepath, sizeof(new_lock->filepath) - 1);
-    new_lock->sentence_idx = sentence_idx;
-    new_lock->client_fd = client_fd;
-    new_lock->is_write_lock = true;
-    new_lock->read_count = 0;
-    new_lock->acquired_at = time(NULL);
-    pthread_mutex_init(&new_lock->lock_mutex, NULL);
-    
-    new_lock->next = state->active_locks;
-    state->active_locks = new_lock;
-    
-    pthread_mutex_unlock(&state->lock_list_mutex);
-    
-    return ERR_SUCCESS;
+    content = content_cache_put(&state->content_cache, entry->file_id, snap->version,
+                                data, (size_t)got);
+    if (content) close_file_snapshot(snap);
+    return content;
 }
 
-int release_lock(StorageServerState* state, const char* filepath,
-                 int sentence_idx, int client_fd) {
-    if (!state || !filepath) return ERR_INVALID_OPERATION;
-    
-    pthread_mutex_lock(&state->lock_list_mutex);
-    
-    SentenceLock* lock = state->active_locks;
-    SentenceLock* prev = NULL;
-    
-    while (lock) {
-        if (strcmp(lock->filepath, filepath) == 0 && 
-            lock->sentence_idx == sentence_idx &&
-            lock->client_fd == client_fd) {
-            
-            if (!lock->is_write_lock) {
-                lock->read_count--;
-                if (lock->read_count > 0) {
-                    pthread_mutex_unlock(&state->lock_list_mutex);
-                    return ERR_SUCCESS;
-                }
-            }
-            
-            // Remove lock
-            if (prev) {
-                prev->next = lock->next;
-            } else {
-                state->active_locks = lock->next;
-            }
-            
-            pthread_mutex_destroy(&lock->lock_mutex);
-            free(lock);
-            
-            pthread_mutex_unlock(&state->lock_list_mutex);
+int open_stored_snapshot(StorageServerState* state, FileEntry* entry, FileSnapshot* snap) {
+    if (!state || !entry || !snap) return ERR_INVALID_OPERATION;
+    snap->fd = -1;
+    snap->fd_cache = &state->fd_cache;
+    snap->cached = NULL;
+    
+    // A commit renames a new inode in, then bumps the version, then records
+    // the inode. A descriptor holds version v only if v is unchanged across
+    // the open and the descriptor is on v's recorded inode: a rename whose
+    // bump is still to come shows up as an inode mismatch.
+    for (int attempt = 1; ; attempt++) {
+        uint64_t before = __atomic_load_n(&entry->version, __ATOMIC_ACQUIRE);
+        ino_t inode = __atomic_load_n(&entry->inode, __ATOMIC_ACQUIRE);
+        
+        CachedFd* cached = fd_cache_get(&state->fd_cache, entry->file_id, before);
+        if (cached) {
+            snap->fd = cached->fd;
+            snap->size = cached->size;
+            snap->version = before;
+            snap->cold = false;
+            snap->cached = cached;
             return ERR_SUCCESS;
         }
         
-        prev = lock;
-        lock = lock->next;
-    }
-    
-    pthread_mutex_unlock(&state->lock_list_mutex);
-    return ERR_INVALID_OPERATION;
-}
-
-int release_all_locks_for_client(StorageServerState* state, int client_fd) {
-    if (!state) return 0;
-    
-    pthread_mutex_lock(&state->lock_list_mutex);
-    
-    int count = 0;
-    SentenceLock* lock = state->active_locks;
-    SentenceLock* prev = NULL;
-    
-    while (lock) {
-        SentenceLock* next = lock->next;
+        int fd = open(entry->full_path, O_RDONLY);
+        if (fd < 0) return ERR_FILE_NOT_FOUND;
+        
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            close(fd);
+            return ERR_INVALID_OPERATION;
+        }
         
-        if (lock->client_fd == client_fd) {
-            if (prev) {
-                prev->next = next;
-            } else {
-                state->active_locks = next;
+        uint64_t after = __atomic_load_n(&entry->version, __ATOMIC_ACQUIRE);
+        if (before != after) {
+            close(fd);
+            continue;
+        }
+        if (st.st_ino != inode) {
+            // Mid-commit: wait for the bump. A mismatch that outlasts the
+            // retries is a file replaced behind the server's back; adopt it
+            // as this version rather than spin on it.
+            if (attempt < SNAPSHOT_OPEN_RETRIES) {
+                close(fd);
+                sched_yield();
+                continue;
             }
-            
-            pthread_mutex_destroy(&lock->lock_mutex);
-            free(lock);
-            count++;
-        } else {
-            prev = lock;
+            __atomic_compare_exchange_n(&entry->inode, &inode, st.st_ino, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED);
         }
         
-        lock = next;
+        snap->fd = fd;
+        snap->size = st.st_size;
+        snap->version = before;
+        snap->cold = cold_file_detect(fd, NULL);
+        
+        // Cold files are expanded or handed off per reader, so only raw
+        // descriptors are shared
+        if (!snap->cold) {
+            snap->cached = fd_cache_put(&state->fd_cache, entry->file_id, before, fd,
+                                        st.st_size);
+            if (snap->cached) snap->fd = snap->cached->fd;
+        }
+        return ERR_SUCCESS;
     }
-    
-    pthread_mutex_unlock(&state->lock_list_mutex);
-    
-    return count;
 }
 
-bool is_sentence_locked(StorageServerState* state, const char* filepath,
-                        int sentence_idx) {
-    if (!state || !filepath) return false;
+int open_file_snapshot(StorageServerState* state, FileEntry* entry, FileSnapshot* snap) {
+    int result = open_stored_snapshot(state, entry, snap);
+    if (result != ERR_SUCCESS || !snap->cold) return result;
+    
+    // Cold files are read through an expanded copy
+    off_t size;
+    int fd = cold_open_content(snap->fd, entry->full_path, &size, NULL);
+    snap->fd = fd;
+    if (fd < 0) return ERR_INVALID_OPERATION;
+    snap->size = size;
+    return ERR_SUCCESS;
+}
+
+void close_file_snapshot(FileSnapshot* snap) {
+    if (!snap || snap->fd < 0) return;
+    if (snap->cached) {
+        fd_cache_release(snap->fd_cache, snap->cached);
+        snap->cached = NULL;
+    } else {
+        close(snap->fd);
+    }
+    snap->fd = -1;
+}
+
+// Caller holds the entry's commit mutex. Splices from the cached current version
+// when there is one and leaves the new version in the cache.
+static int commit_sentence(StorageServerState* state, FileEntry* entry,
+                           int sentence_idx, const char* content) {
+    FileSnapshot snap;
+    CachedContent* current = load_file_content(state, entry, &snap);
+    if (!current) {
+        // Too large to cache: splice from the pinned (expanded) version
+        // instead of opening the file by path again
+        int result = snap.fd < 0 ? ERR_FILE_NOT_FOUND
+                                 : write_sentence_from(snap.fd, snap.size, entry->full_path,
+                                                       sentence_idx, content);
+        close_file_snapshot(&snap);
+        if (result == ERR_SUCCESS) {
+            publish_file_version(state, entry);
+        }
+        return result;
+    }
     
-    pthread_mutex_lock(&state->lock_list_mutex);
+    char* new_content = NULL;
+    size_t new_size = 0;
+    int result = splice_sentence(current->data, current->size, sentence_idx, content,
+                                 &new_content, &new_size);
+    content_cache_release(&state->content_cache, current);
+    if (result != ERR_SUCCESS) return result;
     
-    SentenceLock* lock = state->active_locks;
-    while (lock) {
-        if (strcmp(lock->filepath, filepath) == 0 && 
-            lock->sentence_idx == sentence_idx) {
-            pthread_mutex_unlock(&state->lock_list_mutex);
-            return true;
-        }
-        lock = lock->next;
+    result = replace_file_contents(entry->full_path, new_content, new_size);
+    if (result != ERR_SUCCESS) {
+        free(new_content);
+        return result;
     }
     
-    pthread_mutex_unlock(&state->lock_list_mutex);
-    return false;
+    publish_file_content(state, entry, new_content, new_size);
+    return ERR_SUCCESS;
 }
 
 /* ===============================================
- * REQUEST HANDLERS
+ * CHECKPOINT OPERATIONS
  * =============================================== */
 
-int handle_read_request(StorageServerState* state, int client_fd, 
-                        const char* filepath) {
-    if (!state || !filepath) return ERR_INVALID_OPERATION;
-    
-    FileEntry* entry = find_file(state, filepath);
+// Tags become manifest file names, so keep them to a single path component
+static bool is_valid_checkpoint_tag(const char* tag) {
+    if (!tag || tag[0] == '\0' || tag[0] == '.') return false;
+    if (strlen(tag) >= sizeof(((CheckpointInfo*)0)->tag)) return false;
+    return strchr(tag, '/') == NULL;
+}
+
+int create_checkpoint(StorageServerState* state, const char* filepath,
+                      const char* tag) {
+    if (!state || !filepath || !is_valid_checkpoint_tag(tag)) {
+        return ERR_INVALID_OPERATION;
+    }
+    
+    FileEntry* entry = find_regular_file(state, filepath);
     if (!entry) {
-        send_all(client_fd, "ERROR:FILE_NOT_FOUND\n", 21);
         return ERR_FILE_NOT_FOUND;
     }
     
-    // Read entire file
-    FILE* fp = fopen(entry->full_path, "r");
-    if (!fp) {
-        send_all(client_fd, "ERROR:CANNOT_READ\n", 18);
+    // Chunk a pinned version: a commit renaming a new one in meanwhile
+    // leaves this descriptor (and the mapping over it) untouched. Cold
+    // files are chunked as their content, not their compressed container,
+    // so checkpoints dedup against raw versions and revert to plain text.
+    FileSnapshot snap;
+    int new_chunks = 0;
+    int result = open_file_snapshot(state, entry, &snap);
+    if (result == ERR_SUCCESS) {
+        result = chunk_store_create_checkpoint(&state->chunk_store, filepath, tag,
+                                               snap.fd, snap.size, &new_chunks);
+        close_file_snapshot(&snap);
+    }
+    file_entry_release(entry);
+    
+    char log_msg[256];
+    snprintf(log_msg, sizeof(log_msg), "%s@%s new_chunks=%d", filepath, tag, new_chunks);
+    log_message("SS", "0.0.0.0", state->client_port, "system", "CHECKPOINT",
+               log_msg, result == ERR_SUCCESS ? "SUCCESS" : "ERROR");
+    
+    return result;
+}
+
+int revert_to_checkpoint(StorageServerState* state, const char* filepath,
+                         const char* tag) {
+    if (!state || !filepath || !is_valid_checkpoint_tag(tag)) {
+        return ERR_INVALID_OPERATION;
+    }
+    
+    FileEntry* entry = find_regular_file(state, filepath);
+    if (!entry) {
+        return ERR_FILE_NOT_FOUND;
+    }
+    
+    if (is_file_locked(state, filepath)) {
+        file_entry_release(entry);
+        return ERR_FILE_LOCKED;
+    }
+    
+    pthread_mutex_t* commit_mutex = registry_commit_mutex(&state->registry, entry);
+    pthread_mutex_lock(commit_mutex);
+    
+    int result = chunk_store_restore_checkpoint(&state->chunk_store, filepath, tag,
+                                                entry->full_path);
+    if (result == ERR_SUCCESS) {
+        publish_file_version(state, entry);
+        repl_log_append(&state->replication, REPL_OP_WRITE, filepath);
+    }
+    
+    pthread_mutex_unlock(commit_mutex);
+    file_entry_release(entry);
+    
+    char log_msg[256];
+    snprintf(log_msg, sizeof(log_msg), "%s@%s", filepath, tag);
+    log_message("SS", "0.0.0.0", state->client_port, "system", "REVERT",
+               log_msg, result == ERR_SUCCESS ? "SUCCESS" : "ERROR");
+    
+    return result;
+}
+
+/* ===============================================
+ * REPLICATION
+ * =============================================== */
+
+// mkdir -p for the directories above a file
+static int make_parent_dirs(const char* full_path) {
+    char dir[MAX_PATH_LEN];
+    snprintf(dir, sizeof(dir), "%s", full_path);
+    
+    for (char* p = strchr(dir + 1, '/'); p; p = strchr(p + 1, '/')) {
+        *p = '\0';
+        if (mkdir(dir, 0755) < 0 && errno != EEXIST) return -1;
+        *p = '/';
+    }
+    return 0;
+}
+
+// Records which primary a file came from, so a later snapshot from that
+// primary may prune it
+static void mark_replicated(StorageServerState* state, const char* filepath, int src_id) {
+    FileEntry* entry = find_file(state, filepath);
+    if (!entry) return;
+    
+    pthread_mutex_t* commit_mutex = registry_commit_mutex(&state->registry, entry);
+    pthread_mutex_lock(commit_mutex);
+    entry->repl_source = src_id;
+    pthread_mutex_unlock(commit_mutex);
+    file_entry_release(entry);
+}
+
+int apply_replicated_op(StorageServerState* state, int src_id, char op, const char* filepath,
+                        const char* data, size_t size) {
+    if (!state || !filepath) return ERR_INVALID_OPERATION;
+    
+    // A truncated path would apply the op to some other file
+    char full_path[MAX_PATH_LEN];
+    int path_len = snprintf(full_path, sizeof(full_path), "%s/%s", state->base_path, filepath);
+    if (path_len < 0 || (size_t)path_len >= sizeof(full_path)) {
+        return ERR_INVALID_OPERATION;
+    }
+    
+    // Operations are idempotent so a batch can be re-sent after a reconnect
+    int result;
+    switch (op) {
+        case REPL_OP_CREATE:
+            if (make_parent_dirs(full_path) < 0) return ERR_INVALID_OPERATION;
+            result = create_file_local(state, filepath);
+            if (result == ERR_FILE_EXISTS) result = ERR_SUCCESS;
+            if (result == ERR_SUCCESS) mark_replicated(state, filepath, src_id);
+            return result;
+            
+        case REPL_OP_DELETE:
+            result = delete_file_local(state, filepath, false);
+            return result == ERR_FILE_NOT_FOUND ? ERR_SUCCESS : result;
+            
+        case REPL_OP_WRITE:
+            break;
+            
+        default:
+            return ERR_INVALID_OPERATION;
+    }
+    
+    FileEntry* entry = find_file(state, filepath);
+    if (!entry) {
+        if (make_parent_dirs(full_path) < 0) return ERR_INVALID_OPERATION;
+        result = create_file_local(state, filepath);
+        if (result != ERR_SUCCESS && result != ERR_FILE_EXISTS) return result;
+        entry = find_file(state, filepath);
+        if (!entry) return ERR_INVALID_OPERATION;
+    }
+    if (entry->is_directory) {
+        file_entry_release(entry);
+        return ERR_INVALID_OPERATION;
+    }
+    
+    // Commit like a local write, so readers of the old version keep it
+    char* copy = malloc(size + 1);
+    if (!copy) {
+        file_entry_release(entry);
+        return ERR_INVALID_OPERATION;
+    }
+    memcpy(copy, data, size);
+    copy[size] = '\0';
+    
+    pthread_mutex_t* commit_mutex = registry_commit_mutex(&state->registry, entry);
+    pthread_mutex_lock(commit_mutex);
+    result = replace_file_contents(entry->full_path, copy, size);
+    if (result == ERR_SUCCESS) {
+        publish_file_content(state, entry, copy, size);
+        entry->repl_source = src_id;
+    } else {
+        free(copy);
+    }
+    pthread_mutex_unlock(commit_mutex);
+    file_entry_release(entry);
+    
+    return result;
+}
+
+int install_received_file(StorageServerState* state, const char* filepath,
+                          const char* tmp_path) {
+    if (!state || !filepath || !tmp_path) return ERR_INVALID_OPERATION;
+    
+    char full_path[MAX_PATH_LEN];
+    int path_len = snprintf(full_path, sizeof(full_path), "%s/%s", state->base_path, filepath);
+    if (path_len < 0 || (size_t)path_len >= sizeof(full_path) ||
+        make_parent_dirs(full_path) < 0) {
+        unlink(tmp_path);
         return ERR_INVALID_OPERATION;
     }
     
-    // Send success header
+    // Publish like a committed write so readers of an old copy keep it
+    int result = ERR_SUCCESS;
+    FileEntry* existing = find_file(state, filepath);
+    pthread_mutex_t* commit_mutex =
+        existing ? registry_commit_mutex(&state->registry, existing) : NULL;
+    if (commit_mutex) pthread_mutex_lock(commit_mutex);
+    if (ss_io_rename(tmp_path, full_path) < 0) {
+        unlink(tmp_path);
+        result = ERR_INVALID_OPERATION;
+    } else if (existing) {
+        publish_file_version(state, existing);
+    } else {
+        FileEntry* added = add_file_to_registry(state, filepath, false);
+        if (!added) result = ERR_INVALID_OPERATION;
+        file_entry_release(added);
+    }
+    if (result == ERR_SUCCESS) {
+        repl_log_append(&state->replication, REPL_OP_WRITE, filepath);
+    }
+    if (commit_mutex) pthread_mutex_unlock(commit_mutex);
+    file_entry_release(existing);
+    
+    log_message("SS", "peer", 0, "system", "COPY_RECEIVE", filepath,
+               result == ERR_SUCCESS ? "SUCCESS" : "ERROR");
+    
+    return result;
+}
+    
+/* ===============================================
+ * REQUEST HANDLERS
+ * =============================================== */
+
+// Reply body as wire frames, compressed a frame at a time from memory
+// (data) or from a pinned snapshot (fd), read into a registered buffer
+// when one is free
+static int send_read_frames(StorageServerState* state, int client_fd, const char* data,
+                            int fd, size_t size) {
+    int raw_slot = -1;
+    char* raw = NULL;
+    if (!data) {
+        if (COMPRESS_FRAME_SIZE <= SS_IO_FIXED_BUFFER_SIZE) raw = ss_io_buffer_get(&raw_slot);
+        if (!raw) raw = malloc(COMPRESS_FRAME_SIZE);
+    }
+    char* frame = malloc(compress_frames_bound(COMPRESS_FRAME_SIZE));
+    int rc = (data || raw) && frame ? 0 : -1;
+    
+    size_t wire = 0;
+    for (size_t pos = 0; rc == 0 && pos < size; ) {
+        size_t len = size - pos < COMPRESS_FRAME_SIZE ? size - pos : COMPRESS_FRAME_SIZE;
+        const char* piece = data ? data + pos : raw;
+        if (!data && ss_io_pread_all(fd, raw, len, (off_t)pos) != (ssize_t)len) {
+            rc = -1;
+            break;
+        }
+        size_t frame_len = compress_frames(piece, len, frame,
+                                           compress_frames_bound(COMPRESS_FRAME_SIZE));
+        rc = send_all(client_fd, frame, frame_len) < 0 ? -1 : 0;
+        wire += frame_len;
+        pos += len;
+    }
+    if (raw_slot >= 0) ss_io_buffer_put(raw_slot);
+    else free(raw);
+    free(frame);
+    
+    if (rc == 0) compress_stats_add(&state->wire_stats, size, wire, false);
+    return rc;
+}
+
+static void send_read_header(int client_fd, size_t size, bool framed) {
     char header[128];
-    snprintf(header, sizeof(header), "SUCCESS\nSIZE:%ld\n", entry->file_size);
+    snprintf(header, sizeof(header), framed ? "SUCCESS\nSIZE:%zu\nENCODING:lz4\n"
+                                            : "SUCCESS\nSIZE:%zu\n", size);
     send_all(client_fd, header, strlen(header));
+}
+
+// Cold documents go to LZ4 sessions as stored: their blocks are already
+// LZ4 frames. Returns -1 (snap closed) if the file can't be sent this way.
+static int send_cold_read(StorageServerState* state, int client_fd, FileSnapshot* snap,
+                          const char* filepath) {
+    ColdFile cold;
+    int fd = snap->fd;
+    snap->fd = -1;
+    if (cold_file_open(&cold, fd) < 0) return -1;
+    if (cold.header.block_size != COMPRESS_FRAME_SIZE) {
+        cold_file_close(&cold);
+        return -1;
+    }
     
-    // Send file content
-    char buffer[4096];
-    size_t n;
-    while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
-        send_all(client_fd, buffer, n);
+    send_read_header(client_fd, (size_t)cold.header.raw_size, true);
+    long long sent = cold_file_send_frames(&cold, client_fd);
+    if (sent >= 0) {
+        compress_stats_add(&state->wire_stats, (size_t)cold.header.raw_size, (size_t)sent, true);
     }
+    cold_file_close(&cold);
     
-    fclose(fp);
+    log_message("SS", "client", client_fd, "user", "READ", filepath,
+               sent < 0 ? "ERROR" : "SUCCESS");
+    return sent < 0 ? ERR_CONNECTION_FAILED : ERR_SUCCESS;
+}
+
+int handle_read_request(StorageServerState* state, int client_fd, 
+                        const char* filepath, CompressCodec codec, size_t* bytes_sent) {
+    if (!state || !filepath) return ERR_INVALID_OPERATION;
+    if (bytes_sent) *bytes_sent = 0;
+    
+    FileEntry* entry = find_file(state, filepath);
+    if (!entry) {
+        send_all(client_fd, "ERROR:FILE_NOT_FOUND\n", 21);
+        return ERR_FILE_NOT_FOUND;
+    }
+    
+    // Hot documents are served from memory; writers commit new versions
+    // beside the one being sent
+    FileSnapshot snap;
+    CachedContent* content = content_cache_get(&state->content_cache, entry->file_id,
+                                               __atomic_load_n(&entry->version,
+                                                               __ATOMIC_ACQUIRE));
+    if (!content && codec == COMPRESS_LZ4 && open_stored_snapshot(state, entry, &snap) == ERR_SUCCESS) {
+        if (snap.cold) {
+            int result = send_cold_read(state, client_fd, &snap, filepath);
+            if (result >= 0) {
+                file_entry_release(entry);
+                return result;
+            }
+        }
+        close_file_snapshot(&snap);
+    }
+    if (!content) content = load_file_content(state, entry, &snap);
+    file_entry_release(entry);
+    
+    // Small replies aren't worth a frame header
+    if (content) {
+        bool framed = codec == COMPRESS_LZ4 && content->size >= COMPRESS_MIN_PAYLOAD;
+        send_read_header(client_fd, content->size, framed);
+        int rc = 0;
+        if (framed) {
+            rc = send_read_frames(state, client_fd, content->data, -1, content->size);
+        } else if (content->size > 0) {
+            rc = send_all(client_fd, content->data, content->size);
+        }
+        if (bytes_sent && rc >= 0) *bytes_sent = content->size;
+        content_cache_release(&state->content_cache, content);
+        
+        log_message("SS", "client", client_fd, "user", "READ", filepath,
+                   rc < 0 ? "ERROR" : "SUCCESS");
+        return rc < 0 ? ERR_CONNECTION_FAILED : ERR_SUCCESS;
+    }
+    
+    // Too large to cache: pin the current version instead
+    if (snap.fd < 0) {
+        send_all(client_fd, "ERROR:CANNOT_READ\n", 18);
+        return ERR_INVALID_OPERATION;
+    }
+    
+    bool framed = codec == COMPRESS_LZ4 && snap.size >= COMPRESS_MIN_PAYLOAD;
+    send_read_header(client_fd, (size_t)snap.size, framed);
+    
+    // Send file content (exactly the pinned size, page cache to socket)
+    int rc;
+    if (framed) {
+        rc = send_read_frames(state, client_fd, NULL, snap.fd, (size_t)snap.size);
+    } else {
+        long long sent = send_file_range(client_fd, snap.fd, 0, (size_t)snap.size);
+        rc = sent == (long long)snap.size ? 0 : -1;
+    }
+    close_file_snapshot(&snap);
+    
+    if (rc < 0) {
+        log_message("SS", "client", client_fd, "user", "READ", filepath, "ERROR");
+        return ERR_CONNECTION_FAILED;
+    }
     
     log_message("SS", "client", client_fd, "user", "READ", filepath, "SUCCESS");
+    if (bytes_sent) *bytes_sent = (size_t)snap.size;
     
     return ERR_SUCCESS;
 }
 
+// A client's lock deadline: -1 for the default, at most LOCK_WAIT_MAX_MS
+static int clamp_lock_wait(int wait_ms) {
+    if (wait_ms < 0) return LOCK_WAIT_DEFAULT_MS;
+    return wait_ms > LOCK_WAIT_MAX_MS ? LOCK_WAIT_MAX_MS : wait_ms;
+}
+
 int handle_write_request(StorageServerState* state, int client_fd,
                          const char* filepath, int sentence_idx, 
-                         const char* content) {
+                         const char* content, int wait_ms) {
     if (!state || !filepath || !content) return ERR_INVALID_OPERATION;
     
     FileEntry* entry = find_file(state, filepath);
@@ -868,28 +1280,30 @@ int handle_write_request(StorageServerState* state, int client_fd,
         return ERR_FILE_NOT_FOUND;
     }
     
-    // Acquire write lock
-    int result = acquire_write_lock(state, filepath, sentence_idx, client_fd);
+    // Acquire write lock, queueing behind current holders up to the deadline
+    int result = acquire_write_lock_timed(state, filepath, sentence_idx,
+                                          client_fd, clamp_lock_wait(wait_ms));
     if (result != ERR_SUCCESS) {
+        file_entry_release(entry);
         send_all(client_fd, "ERROR:FILE_LOCKED\n", 18);
         return result;
     }
     
-    // Write sentence
-    result = write_sentence(entry->full_path, sentence_idx, content);
+    // Commit a new version; writers of other sentences queue here, readers
+    // never do
+    pthread_mutex_t* commit_mutex = registry_commit_mutex(&state->registry, entry);
+    pthread_mutex_lock(commit_mutex);
+    result = commit_sentence(state, entry, sentence_idx, content);
+    if (result == ERR_SUCCESS) {
+        repl_log_append(&state->replication, REPL_OP_WRITE, filepath);
+    }
+    pthread_mutex_unlock(commit_mutex);
+    file_entry_release(entry);
     
     // Release lock
     release_lock(state, filepath, sentence_idx, client_fd);
     
     if (result == ERR_SUCCESS) {
-        // Update metadata
-        struct stat st;
-        if (stat(entry->full_path, &st) == 0) {
-            entry->file_size = st.st_size;
-            entry->modified_at = st.st_mtime;
-            entry->sentence_count = count_sentences(entry->full_path);
-        }
-        
         send_all(client_fd, "SUCCESS\n", 8);
         log_message("SS", "client", client_fd, "user", "WRITE", filepath, "SUCCESS");
     } else {
@@ -899,6 +1313,309 @@ int handle_write_request(StorageServerState* state, int client_fd,
     return result;
 }
 
+// Copy of one sentence of the current version; *result says why on NULL
+static char* read_current_sentence(StorageServerState* state, FileEntry* entry,
+                                   int sentence_idx, size_t* len, int* result) {
+    FileSnapshot snap;
+    CachedContent* content = load_file_content(state, entry, &snap);
+    const char* data = content ? content->data : NULL;
+    size_t size = content ? content->size : 0;
+    char* file_data = NULL;
+    
+    *result = ERR_INVALID_OPERATION;
+    if (!content) {
+        if (snap.fd < 0) return NULL;
+        file_data = malloc((size_t)snap.size + 1);
+        ssize_t got = file_data ? ss_io_pread_all(snap.fd, file_data, (size_t)snap.size, 0) : -1;
+        close_file_snapshot(&snap);
+        if (got < 0) {
+            free(file_data);
+            return NULL;
+        }
+        data = file_data;
+        size = (size_t)got;
+    }
+    
+    char* sentence = NULL;
+    size_t start, end;
+    if (find_sentence_span(data, size, sentence_idx, &start, &end) != ERR_SUCCESS) {
+        *result = ERR_SENTENCE_OUT_OF_RANGE;
+    } else if ((sentence = malloc(end - start + 1)) != NULL) {
+        memcpy(sentence, data + start, end - start);
+        sentence[end - start] = '\0';
+        *len = end - start;
+        *result = ERR_SUCCESS;
+    }
+    
+    if (content) content_cache_release(&state->content_cache, content);
+    free(file_data);
+    return sentence;
+}
+
+WriteSession* handle_write_begin(StorageServerState* state, int client_fd,
+                                 const char* filepath, int sentence_idx, int wait_ms) {
+    if (!state || !filepath) return NULL;
+    
+    FileEntry* entry = find_file(state, filepath);
+    if (!entry) {
+        send_all(client_fd, "ERROR:FILE_NOT_FOUND\n", 21);
+        return NULL;
+    }
+    
+    // Held until ETIRW; edits renew the lease
+    if (acquire_write_lock_timed(state, filepath, sentence_idx, client_fd,
+                                 clamp_lock_wait(wait_ms)) != ERR_SUCCESS) {
+        file_entry_release(entry);
+        send_all(client_fd, "ERROR:FILE_LOCKED\n", 18);
+        return NULL;
+    }
+    
+    // The sentence read is of this version or a newer one
+    int result;
+    size_t len = 0;
+    uint64_t base_version = __atomic_load_n(&entry->version, __ATOMIC_ACQUIRE);
+    char* sentence = read_current_sentence(state, entry, sentence_idx, &len, &result);
+    file_entry_release(entry);
+    
+    WriteSession* session = sentence ? calloc(1, sizeof(WriteSession)) : NULL;
+    if (session && sentence_edit_init(&session->edit, sentence, len) < 0) {
+        free(session);
+        session = NULL;
+    }
+    if (!session) {
+        free(sentence);
+        release_lock(state, filepath, sentence_idx, client_fd);
+        if (result == ERR_SENTENCE_OUT_OF_RANGE) {
+            send_all(client_fd, "ERROR:SENTENCE_OUT_OF_RANGE\n", 28);
+        } else {
+            send_all(client_fd, "ERROR:WRITE_FAILED\n", 19);
+        }
+        return NULL;
+    }
+    
+    snprintf(session->filepath, sizeof(session->filepath), "%s", filepath);
+    session->sentence_idx = sentence_idx;
+    session->client_fd = client_fd;
+    session->base_version = base_version;
+    session->base_text = sentence;
+    session->base_len = len;
+    send_all(client_fd, "SUCCESS\n", 8);
+    return session;
+}
+
+int handle_write_edit(StorageServerState* state, WriteSession* session, const char* line) {
+    if (!state || !session || !line) return ERR_INVALID_OPERATION;
+    
+    char* end = NULL;
+    long word_index = strtol(line, &end, 10);
+    if (end == line || word_index < 0 || (*end != ' ' && *end != '\0')) {
+        send_all(session->client_fd, "ERROR:INVALID_ARGS\n", 19);
+        return ERR_INVALID_OPERATION;
+    }
+    const char* content = *end == ' ' ? end + 1 : end;
+    
+    if (renew_lock_lease(state, session->filepath, session->sentence_idx,
+                         session->client_fd) != ERR_SUCCESS) {
+        send_all(session->client_fd, "ERROR:LOCK_EXPIRED\n", 19);
+        return ERR_FILE_LOCKED;
+    }
+    
+    int result = sentence_edit_insert(&session->edit, (size_t)word_index, content,
+                                      strlen(content));
+    if (result == ERR_SUCCESS) {
+        send_all(session->client_fd, "SUCCESS\n", 8);
+    } else if (result == ERR_WORD_OUT_OF_RANGE) {
+        send_all(session->client_fd, "ERROR:WORD_OUT_OF_RANGE\n", 24);
+    } else {
+        send_all(session->client_fd, "ERROR:WRITE_FAILED\n", 19);
+    }
+    return result;
+}
+
+// Parses "<seq> <kind> <word_index> <arg>" and applies it; returns the
+// failure reason, NULL on success
+static const char* apply_write_op(StorageServerState* state, WriteSession* session,
+                                  const char* op) {
+    char* end = NULL;
+    unsigned long long seq = strtoull(op, &end, 10);
+    if (end == op || *end != ' ') return "INVALID_ARGS";
+    if (seq != session->last_seq + 1) return "SEQUENCE";
+    
+    char kind[4];
+    long word_index;
+    int arg_offset = 0;
+    if (sscanf(end + 1, "%3s %ld %n", kind, &word_index, &arg_offset) != 2 ||
+        arg_offset == 0 || word_index < 0) {
+        return "INVALID_ARGS";
+    }
+    const char* arg = end + 1 + arg_offset;
+    
+    if (renew_lock_lease(state, session->filepath, session->sentence_idx,
+                         session->client_fd) != ERR_SUCCESS) {
+        return "LOCK_EXPIRED";
+    }
+    
+    int result;
+    SentenceEdit* edit = &session->edit;
+    if (strcmp(kind, "INS") == 0) {
+        result = sentence_edit_insert(edit, (size_t)word_index, arg, strlen(arg));
+    } else if (strcmp(kind, "DEL") == 0) {
+        long count = strtol(arg, &end, 10);
+        if (end == arg || *end != '\0' || count <= 0) return "INVALID_ARGS";
+        result = sentence_edit_delete(edit, (size_t)word_index, (size_t)count);
+    } else if (strcmp(kind, "REP") == 0) {
+        result = sentence_edit_delete(edit, (size_t)word_index, 1);
+        if (result == ERR_SUCCESS) {
+            result = sentence_edit_insert(edit, (size_t)word_index, arg, strlen(arg));
+        }
+    } else {
+        return "INVALID_ARGS";
+    }
+    
+    if (result == ERR_WORD_OUT_OF_RANGE) return "WORD_OUT_OF_RANGE";
+    if (result != ERR_SUCCESS) return "WRITE_FAILED";
+    session->last_seq = seq;
+    return NULL;
+}
+
+int handle_write_op(StorageServerState* state, WriteSession* session, const char* line) {
+    if (!state || !session || !line) return ERR_INVALID_OPERATION;
+    
+    // Everything after the first failure is dropped; the client learns
+    // of it at SYNC or ETIRW
+    if (session->failed_seq) return ERR_INVALID_OPERATION;
+    
+    const char* reason = strncmp(line, "OP ", 3) == 0 ? apply_write_op(state, session, line + 3)
+                                                       : "INVALID_ARGS";
+    if (reason) {
+        session->failed_seq = session->last_seq + 1;
+        session->failed_reason = reason;
+        return ERR_INVALID_OPERATION;
+    }
+    return ERR_SUCCESS;
+}
+
+// Reports the first failed op if there is one, else acknowledges with
+// ack_fmt (NULL when only a failure needs reporting)
+static void send_write_progress(WriteSession* session, const char* ack_fmt) {
+    char reply[96];
+    int len;
+    if (session->failed_seq) {
+        len = snprintf(reply, sizeof(reply), "ERROR:OP_FAILED %llu %s\n",
+                       (unsigned long long)session->failed_seq, session->failed_reason);
+    } else if (ack_fmt) {
+        len = snprintf(reply, sizeof(reply), ack_fmt, (unsigned long long)session->last_seq);
+    } else {
+        return;
+    }
+    if (len < 0) return;
+    
+    // Keep an overlong reply a single line
+    if ((size_t)len >= sizeof(reply)) {
+        len = (int)sizeof(reply) - 1;
+        reply[len - 1] = '\n';
+    }
+    send_all(session->client_fd, reply, (size_t)len);
+}
+
+void handle_write_sync(WriteSession* session) {
+    if (session) send_write_progress(session, "ACK %llu\n");
+}
+
+static void free_write_session(WriteSession* session) {
+    sentence_edit_free(&session->edit);
+    free(session->base_text);
+    free(session);
+}
+
+// Whether sentence_idx still holds the text the session began from. A
+// commit of another sentence may have split or merged sentences before
+// it, so the index would name someone else's text. Caller holds the
+// entry's commit mutex.
+static bool session_base_intact(StorageServerState* state, FileEntry* entry,
+                                const WriteSession* session) {
+    if (__atomic_load_n(&entry->version, __ATOMIC_ACQUIRE) == session->base_version) {
+        return true;
+    }
+    
+    int result;
+    size_t len = 0;
+    char* current = read_current_sentence(state, entry, session->sentence_idx, &len, &result);
+    bool intact = current && len == session->base_len &&
+                  memcmp(current, session->base_text, len) == 0;
+    free(current);
+    return intact;
+}
+
+int handle_write_end(StorageServerState* state, WriteSession* session) {
+    if (!state || !session) return ERR_INVALID_OPERATION;
+    
+    int client_fd = session->client_fd;
+    if (session->failed_seq) {
+        release_lock(state, session->filepath, session->sentence_idx, client_fd);
+        send_write_progress(session, NULL);
+        free_write_session(session);
+        return ERR_INVALID_OPERATION;
+    }
+    
+    FileEntry* entry = find_file(state, session->filepath);
+    int result = entry ? ERR_SUCCESS : ERR_FILE_NOT_FOUND;
+    
+    // An expired lease may have let another writer in; don't overwrite it
+    if (result == ERR_SUCCESS &&
+        renew_lock_lease(state, session->filepath, session->sentence_idx,
+                         client_fd) != ERR_SUCCESS) {
+        result = ERR_FILE_LOCKED;
+    }
+    
+    // The whole session lands as one version, unless it changed nothing
+    bool conflict = false;
+    bool changed = session->edit.len != session->base_len ||
+                   memcmp(session->edit.text, session->base_text, session->base_len) != 0;
+    if (result == ERR_SUCCESS && changed) {
+        pthread_mutex_t* commit_mutex = registry_commit_mutex(&state->registry, entry);
+        pthread_mutex_lock(commit_mutex);
+        if (!session_base_intact(state, entry, session)) {
+            conflict = true;
+            result = ERR_INVALID_OPERATION;
+        } else {
+            result = commit_sentence(state, entry, session->sentence_idx, session->edit.text);
+        }
+        if (result == ERR_SUCCESS) {
+            repl_log_append(&state->replication, REPL_OP_WRITE, session->filepath);
+        }
+        pthread_mutex_unlock(commit_mutex);
+    }
+    if (entry) file_entry_release(entry);
+    
+    // Release lock
+    release_lock(state, session->filepath, session->sentence_idx, client_fd);
+    
+    if (result == ERR_SUCCESS) {
+        if (session->last_seq > 0) {
+            send_write_progress(session, "SUCCESS\nACK %llu\n");
+        } else {
+            send_all(client_fd, "SUCCESS\n", 8);
+        }
+        log_message("SS", "client", client_fd, "user", "WRITE", session->filepath, "SUCCESS");
+    } else if (result == ERR_FILE_LOCKED) {
+        send_all(client_fd, "ERROR:LOCK_EXPIRED\n", 19);
+    } else if (conflict) {
+        send_all(client_fd, "ERROR:CONFLICT\n", 15);
+    } else {
+        send_all(client_fd, "ERROR:WRITE_FAILED\n", 19);
+    }
+    
+    free_write_session(session);
+    return result;
+}
+
+void write_session_abort(StorageServerState* state, WriteSession* session) {
+    if (!session) return;
+    if (state) release_lock(state, session->filepath, session->sentence_idx, session->client_fd);
+    free_write_session(session);
+}
+
 int handle_create_request(StorageServerState* state, const char* filepath) {
     return create_file(state, filepath);
 }
@@ -922,6 +1639,10 @@ int handle_info_request(StorageServerState* state, int client_fd,
         return ERR_FILE_NOT_FOUND;
     }
     
+    // Cold files report their content size, not what they take on disk
+    off_t size = entry->file_size;
+    if (!entry->is_directory) cold_content_size(entry->full_path, &size);
+    
     char info[512];
     snprintf(info, sizeof(info),
              "SUCCESS\n"
@@ -932,11 +1653,12 @@ int handle_info_request(StorageServerState* state, int client_fd,
              "MODIFIED:%ld\n"
              "IS_DIR:%d\n",
              entry->filepath,
-             entry->file_size,
-             entry->sentence_count,
+             (long)size,
+             file_sentence_count(state, entry),
              entry->created_at,
              entry->modified_at,
              entry->is_directory);
+    file_entry_release(entry);
     
     send_all(client_fd, info, strlen(info));
     
@@ -944,3 +1666,187 @@ int handle_info_request(StorageServerState* state, int client_fd,
     
     return ERR_SUCCESS;
 }
+
+int handle_stream_request(StorageServerState* state, int client_fd,
+                          const char* filepath, StreamDoneFn done, void* done_arg) {
+    if (!state || !filepath) return ERR_INVALID_OPERATION;
+    
+    FileEntry* entry = find_regular_file(state, filepath);
+    if (!entry) {
+        send_all(client_fd, "ERROR:FILE_NOT_FOUND\n", 21);
+        return ERR_FILE_NOT_FOUND;
+    }
+    
+    // Streams of the same version share one word index, built from the
+    // cached content when the document is hot
+    FileSnapshot snap;
+    WordIndex* index = NULL;
+    CachedContent* content = load_file_content(state, entry, &snap);
+    if (content) {
+        index = word_index_acquire_buffer(&state->stream_engine, entry->file_id,
+                                          content->version, content->data, content->size);
+        content_cache_release(&state->content_cache, content);
+    } else if (snap.fd >= 0) {
+        index = word_index_acquire(&state->stream_engine, entry->file_id,
+                                   snap.version, snap.fd, snap.size);
+        close_file_snapshot(&snap);
+    }
+    file_entry_release(entry);
+    
+    if (!index) {
+        send_all(client_fd, "ERROR:CANNOT_READ\n", 18);
+        return ERR_INVALID_OPERATION;
+    }
+    
+    char header[64];
+    snprintf(header, sizeof(header), "SUCCESS\nWORDS:%zu\n", index->word_count);
+    if (send_all(client_fd, header, strlen(header)) < 0) {
+        word_index_release(&state->stream_engine, index);
+        return ERR_CONNECTION_FAILED;
+    }
+    
+    if (stream_engine_open(&state->stream_engine, client_fd, index, done, done_arg) < 0) {
+        word_index_release(&state->stream_engine, index);
+        send_all(client_fd, "ERROR:STREAM_FAILED\n", 20);
+        return ERR_INVALID_OPERATION;
+    }
+    
+    log_message("SS", "client", client_fd, "user", "STREAM", filepath, "SUCCESS");
+    
+    return ERR_SUCCESS;
+}
+
+static void send_checkpoint_error(int client_fd, int result) {
+    switch (result) {
+        case ERR_FILE_NOT_FOUND:
+            send_all(client_fd, "ERROR:CHECKPOINT_NOT_FOUND\n", 27);
+            break;
+        case ERR_FILE_EXISTS:
+            send_all(client_fd, "ERROR:CHECKPOINT_EXISTS\n", 24);
+            break;
+        case ERR_FILE_LOCKED:
+            send_all(client_fd, "ERROR:FILE_LOCKED\n", 18);
+            break;
+        default:
+            send_all(client_fd, "ERROR:CHECKPOINT_FAILED\n", 24);
+            break;
+    }
+}
+
+int handle_checkpoint_request(StorageServerState* state, int client_fd,
+                              const char* filepath, const char* tag) {
+    if (!state || !filepath || !tag) return ERR_INVALID_OPERATION;
+    
+    if (!is_registered_file(state, filepath)) {
+        send_all(client_fd, "ERROR:FILE_NOT_FOUND\n", 21);
+        return ERR_FILE_NOT_FOUND;
+    }
+    
+    int result = create_checkpoint(state, filepath, tag);
+    if (result == ERR_SUCCESS) {
+        send_all(client_fd, "SUCCESS\n", 8);
+    } else {
+        send_checkpoint_error(client_fd, result);
+    }
+    
+    return result;
+}
+
+typedef struct {
+    int client_fd;
+    bool header_sent;
+    long total_size;
+} CheckpointStream;
+
+static int send_checkpoint_chunk(const void* data, size_t len, void* arg) {
+    CheckpointStream* stream = (CheckpointStream*)arg;
+    
+    // Header goes out with the first chunk so errors can still be reported
+    if (!stream->header_sent) {
+        char header[128];
+        snprintf(header, sizeof(header), "SUCCESS\nSIZE:%ld\n", stream->total_size);
+        if (send_all(stream->client_fd, header, strlen(header)) < 0) return -1;
+        stream->header_sent = true;
+    }
+    
+    return send_all(stream->client_fd, data, len) < 0 ? -1 : 0;
+}
+
+int handle_viewcheckpoint_request(StorageServerState* state, int client_fd,
+                                  const char* filepath, const char* tag) {
+    if (!state || !filepath || !tag) return ERR_INVALID_OPERATION;
+    
+    if (!is_valid_checkpoint_tag(tag)) {
+        send_all(client_fd, "ERROR:CHECKPOINT_NOT_FOUND\n", 27);
+        return ERR_INVALID_OPERATION;
+    }
+    
+    CheckpointStream stream = { client_fd, false, 0 };
+    int result = chunk_store_read_checkpoint(&state->chunk_store, filepath, tag,
+                                             send_checkpoint_chunk, &stream,
+                                             &stream.total_size);
+    
+    if (result == ERR_SUCCESS && !stream.header_sent) {
+        // Empty checkpoint: no chunks, header only
+        send_all(client_fd, "SUCCESS\nSIZE:0\n", 15);
+    } else if (result != ERR_SUCCESS && !stream.header_sent) {
+        send_checkpoint_error(client_fd, result);
+    }
+    
+    log_message("SS", "client", client_fd, "user", "VIEWCHECKPOINT", filepath,
+               result == ERR_SUCCESS ? "SUCCESS" : "ERROR");
+    
+    return result;
+}
+
+int handle_revert_request(StorageServerState* state, int client_fd,
+                          const char* filepath, const char* tag) {
+    if (!state || !filepath || !tag) return ERR_INVALID_OPERATION;
+    
+    if (!is_registered_file(state, filepath)) {
+        send_all(client_fd, "ERROR:FILE_NOT_FOUND\n", 21);
+        return ERR_FILE_NOT_FOUND;
+    }
+    
+    int result = revert_to_checkpoint(state, filepath, tag);
+    if (result == ERR_SUCCESS) {
+        send_all(client_fd, "SUCCESS\n", 8);
+    } else {
+        send_checkpoint_error(client_fd, result);
+    }
+    
+    return result;
+}
+
+int handle_listcheckpoints_request(StorageServerState* state, int client_fd,
+                                   const char* filepath) {
+    if (!state || !filepath) return ERR_INVALID_OPERATION;
+    
+    if (!is_registered_file(state, filepath)) {
+        send_all(client_fd, "ERROR:FILE_NOT_FOUND\n", 21);
+        return ERR_FILE_NOT_FOUND;
+    }
+    
+    CheckpointInfo* infos = NULL;
+    int count = 0;
+    if (chunk_store_list_checkpoints(&state->chunk_store, filepath, &infos, &count) < 0) {
+        send_all(client_fd, "ERROR:CHECKPOINT_FAILED\n", 24);
+        return ERR_INVALID_OPERATION;
+    }
+    
+    char line[256];
+    snprintf(line, sizeof(line), "SUCCESS\nCOUNT:%d\n", count);
+    send_all(client_fd, line, strlen(line));
+    
+    for (int i = 0; i < count; i++) {
+        snprintf(line, sizeof(line), "CHECKPOINT:%s CREATED:%ld SIZE:%ld\n",
+                 infos[i].tag, (long)infos[i].created_at, infos[i].size);
+        send_all(client_fd, line, strlen(line));
+    }
+    
+    free(infos);
+    
+    log_message("SS", "client", client_fd, "user", "LISTCHECKPOINTS", filepath, "SUCCESS");
+    
+    return ERR_SUCCESS;
+}
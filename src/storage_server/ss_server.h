@@ -6,48 +6,65 @@
 #include <stdint.h>
 #include <sys/types.h>
 #include <time.h>
+#include "../common/compress.h"
+#include "ss_cache.h"
+#include "ss_chunk_store.h"
+#include "ss_cold.h"
+#include "ss_edit.h"
+#include "ss_fdcache.h"
+#include "ss_locks.h"
+#include "ss_meta.h"
+#include "ss_registry.h"
+#include "ss_repl.h"
+#include "ss_scan.h"
+#include "ss_stream.h"
 
-#define MAX_FILES 10000
-#define MAX_SENTENCE_LOCKS 1000
 #define MAX_PATH_LEN 512
 #define MAX_SENTENCE_LEN 4096
 #define SENTENCE_DELIMITERS ".!?"
+#define SNAPSHOT_OPEN_RETRIES 1000     // Opens racing one commit before giving up on it
 
 // Forward declarations
 typedef struct StorageServerState StorageServerState;
-typedef struct FileEntry FileEntry;
-typedef struct SentenceLock SentenceLock;
 
 /**
- * Sentence Lock Structure
- * Manages sentence-level locking for concurrent writes
+ * File Snapshot
+ * A pinned version of a file. Commits replace the file by rename, so the
+ * open descriptor keeps this version readable until it is closed; the
+ * kernel frees the old inode after its last reader is done. Raw files
+ * are pinned through the descriptor cache, so fd is shared: read it with
+ * pread only, and never close it directly.
  */
-typedef struct SentenceLock {
+typedef struct {
+    int fd;                          // Open descriptor on the pinned version
+    off_t size;                      // Size of the pinned version
+    uint64_t version;                // Version number it corresponds to
+    bool cold;                       // Stored cold (expanded unless opened stored)
+    FdCache* fd_cache;               // Owner of cached, if any
+    CachedFd* cached;                // Cache entry fd belongs to, NULL if owned
+} FileSnapshot;
+
+/**
+ * Write Session
+ * A WRITE in progress: its sentence stays locked and is edited in memory
+ * until ETIRW commits the result as one new version of the file.
+ * Pipelined ops are numbered and not acknowledged one by one; the first
+ * failure stops the rest, and ETIRW then commits nothing. ETIRW also
+ * commits nothing if another writer changed the sentence at sentence_idx
+ * (e.g., split an earlier one) meanwhile.
+ */
+typedef struct WriteSession {
     char filepath[MAX_PATH_LEN];
-    int sentence_idx;           // Which sentence is locked
-    int client_fd;              // Which client holds the lock
-    bool is_write_lock;         // true for write, false for read
-    int read_count;             // Number of concurrent readers
-    time_t acquired_at;         // When lock was acquired
-    pthread_mutex_t lock_mutex; // Mutex for this lock
-    struct SentenceLock* next;  // Linked list
-} SentenceLock;
-
-/**
- * File Entry Structure
- * Represents a file stored on this storage server
- */
-typedef struct FileEntry {
-    char filepath[MAX_PATH_LEN];     // Relative path (e.g., "docs/file.txt")
-    char full_path[MAX_PATH_LEN];    // Absolute path on disk
-    off_t file_size;                 // File size in bytes
-    time_t created_at;               // Creation timestamp
-    time_t modified_at;              // Last modification timestamp
-    int sentence_count;              // Number of sentences in file
-    bool is_directory;               // true if directory
-    SentenceLock* locks;             // Linked list of sentence locks
-    pthread_mutex_t file_mutex;      // Mutex for this file
-} FileEntry;
+    int sentence_idx;
+    int client_fd;
+    uint64_t base_version;           // File version when the session began
+    char* base_text;                 // The sentence as read then
+    size_t base_len;
+    SentenceEdit edit;
+    uint64_t last_seq;               // Last pipelined op applied
+    uint64_t failed_seq;             // First op that failed, 0 if none
+    const char* failed_reason;
+} WriteSession;
 
 /**
  * Storage Server State
@@ -69,13 +86,29 @@ typedef struct StorageServerState {
     int ss_listen_socket;            // Listening socket for other SS
     
     // File registry
-    FileEntry files[MAX_FILES];      // Array of file entries
-    int file_count;                  // Number of files
-    pthread_mutex_t registry_mutex;  // Mutex for file registry
+    FileRegistry registry;           // Hash-indexed, refcounted file entries
+    SentenceIndexer indexer;         // Counts sentences the scan deferred
+    MetaStore meta_store;            // Per-file stats saved by the last run
     
     // Lock management
-    SentenceLock* active_locks;      // Linked list of active locks
-    pthread_mutex_t lock_list_mutex; // Mutex for lock list
+    LockTable lock_table;            // Striped sentence lock table
+    
+    // Checkpoints
+    ChunkStore chunk_store;          // Content-addressed checkpoint store
+    
+    // Word streaming
+    StreamEngine stream_engine;      // Timer-wheel driven STREAM sessions
+    
+    // Hot document content
+    ContentCache content_cache;      // (file ID, version) -> content + sentences
+    FdCache fd_cache;                // (file ID, version) -> open descriptor
+    
+    // Replication
+    Replication replication;         // Change log shipped to replica SSs
+    ColdFreezer freezer;             // Compresses files not written recently
+    
+    // Wire compression
+    CompressStats wire_stats;        // Framed READ, replication and transfer payloads
     
     // Server state
     bool running;                    // Server running flag
@@ -127,7 +160,9 @@ void ss_cleanup(StorageServerState* state);
  * =============================================== */
 
 /**
- * Scan base directory and register all files
+ * Scan base directory (recursively, in parallel) and register all files
+ * Stats of unchanged files come from the metadata sidecar; other
+ * sentence counts are left to the background indexer.
  * @param state Storage server state
  * @return Number of files found, -1 on error
  */
@@ -135,19 +170,29 @@ int scan_and_register_files(StorageServerState* state);
 
 /**
  * Add a file to the registry
+ * Returns the existing entry if the path is already registered.
  * @param state Storage server state
  * @param filepath Relative filepath
  * @param is_directory Whether it's a directory
- * @return Pointer to FileEntry, NULL on failure
+ * @return Referenced FileEntry (release with file_entry_release), NULL on failure
  */
 FileEntry* add_file_to_registry(StorageServerState* state, 
                                  const char* filepath, bool is_directory);
 
+/**
+ * Check that a relative path from the network stays inside the base path
+ * (no absolute paths, no ".." components, no hidden names)
+ * @param path Relative filepath
+ * @return true if safe
+ */
+bool is_safe_filepath(const char* path);
+
 /**
  * Find a file in the registry
+ * The entry stays valid until released, even if the file is deleted.
  * @param state Storage server state
  * @param filepath Relative filepath
- * @return Pointer to FileEntry, NULL if not found
+ * @return Referenced FileEntry (release with file_entry_release), NULL if not found
  */
 FileEntry* find_file(StorageServerState* state, const char* filepath);
 
@@ -190,6 +235,16 @@ int copy_file_to_ss(StorageServerState* state, const char* filepath,
  */
 int count_sentences(const char* filepath);
 
+/**
+ * Sentence count of a registered file
+ * Counts it now if the startup scan deferred it and the indexer has not
+ * reached it yet.
+ * @param state Storage server state
+ * @param entry File entry
+ * @return Number of sentences
+ */
+int file_sentence_count(StorageServerState* state, FileEntry* entry);
+
 /**
  * Read a specific sentence from a file
  * @param filepath Full path to file
@@ -203,6 +258,9 @@ int read_sentence(const char* filepath, int sentence_idx,
 
 /**
  * Write/modify a specific sentence in a file
+ * The new version is built in a temporary file and renamed over the old
+ * one, so concurrent readers see either version whole, never a mix.
+ * Callers serialize commits on the file with registry_commit_mutex.
  * @param filepath Full path to file
  * @param sentence_idx Sentence index (0-based)
  * @param content New sentence content
@@ -218,6 +276,34 @@ int write_sentence(const char* filepath, int sentence_idx, const char* content);
  */
 int append_to_file(const char* filepath, const char* content);
 
+/**
+ * Pin the current version of a file for reading
+ * Never waits on writers. A cached descriptor on the version is reused.
+ * @param state Storage server state
+ * @param entry File entry
+ * @param snap Output snapshot (release with close_file_snapshot)
+ * @return 0 on success, error code on failure
+ */
+int open_file_snapshot(StorageServerState* state, FileEntry* entry, FileSnapshot* snap);
+
+/**
+ * Pin the current version of a file as stored on disk
+ * Like open_file_snapshot, but cold files are not expanded: snap->size
+ * is the stored size, and snap->cold says which format the bytes are in.
+ * Cold descriptors are not cached, so the holder owns them.
+ * @param state Storage server state
+ * @param entry File entry
+ * @param snap Output snapshot (release with close_file_snapshot)
+ * @return 0 on success, error code on failure
+ */
+int open_stored_snapshot(StorageServerState* state, FileEntry* entry, FileSnapshot* snap);
+
+/**
+ * Release a pinned snapshot
+ * @param snap Snapshot
+ */
+void close_file_snapshot(FileSnapshot* snap);
+
 /* ===============================================
  * LOCKING MECHANISMS
  * =============================================== */
@@ -225,6 +311,7 @@ int append_to_file(const char* filepath, const char* content);
 /**
  * Acquire a read lock on a sentence
  * Multiple readers can hold read locks simultaneously
+ * Does not wait: returns ERR_FILE_LOCKED if the lock is not free now
  * @param state Storage server state
  * @param filepath File path
  * @param sentence_idx Sentence index
@@ -237,6 +324,7 @@ int acquire_read_lock(StorageServerState* state, const char* filepath,
 /**
  * Acquire a write lock on a sentence
  * Exclusive lock - no other readers or writers
+ * Does not wait: returns ERR_FILE_LOCKED if the lock is not free now
  * @param state Storage server state
  * @param filepath File path
  * @param sentence_idx Sentence index
@@ -246,6 +334,31 @@ int acquire_read_lock(StorageServerState* state, const char* filepath,
 int acquire_write_lock(StorageServerState* state, const char* filepath,
                        int sentence_idx, int client_fd);
 
+/**
+ * Acquire a read lock, waiting in FIFO order until granted or timed out
+ * New readers queue behind waiting writers, so writers cannot starve
+ * @param state Storage server state
+ * @param filepath File path
+ * @param sentence_idx Sentence index
+ * @param client_fd Client file descriptor
+ * @param timeout_ms Max wait in ms (LOCK_WAIT_NONE / LOCK_WAIT_FOREVER)
+ * @return 0 on success, ERR_FILE_LOCKED on timeout, error code on failure
+ */
+int acquire_read_lock_timed(StorageServerState* state, const char* filepath,
+                            int sentence_idx, int client_fd, int timeout_ms);
+
+/**
+ * Acquire a write lock, waiting in FIFO order until granted or timed out
+ * @param state Storage server state
+ * @param filepath File path
+ * @param sentence_idx Sentence index
+ * @param client_fd Client file descriptor
+ * @param timeout_ms Max wait in ms (LOCK_WAIT_NONE / LOCK_WAIT_FOREVER)
+ * @return 0 on success, ERR_FILE_LOCKED on timeout, error code on failure
+ */
+int acquire_write_lock_timed(StorageServerState* state, const char* filepath,
+                             int sentence_idx, int client_fd, int timeout_ms);
+
 /**
  * Release a lock on a sentence
  * @param state Storage server state
@@ -265,6 +378,25 @@ int release_lock(StorageServerState* state, const char* filepath,
  */
 int release_all_locks_for_client(StorageServerState* state, int client_fd);
 
+/**
+ * Extend the lease on a lock the client holds
+ * @param state Storage server state
+ * @param filepath File path
+ * @param sentence_idx Sentence index
+ * @param client_fd Client file descriptor
+ * @return 0 on success, ERR_INVALID_OPERATION if not held (or already reclaimed)
+ */
+int renew_lock_lease(StorageServerState* state, const char* filepath,
+                     int sentence_idx, int client_fd);
+
+/**
+ * Check if any sentence of a file is locked
+ * @param state Storage server state
+ * @param filepath File path
+ * @return true if locked, false otherwise
+ */
+bool is_file_locked(StorageServerState* state, const char* filepath);
+
 /**
  * Check if a sentence is locked
  * @param state Storage server state
@@ -275,19 +407,50 @@ int release_all_locks_for_client(StorageServerState* state, int client_fd);
 bool is_sentence_locked(StorageServerState* state, const char* filepath,
                         int sentence_idx);
 
+/* ===============================================
+ * CHECKPOINT OPERATIONS
+ * =============================================== */
+
+/**
+ * Save the current state of a file as a named checkpoint
+ * Unchanged chunks are shared with earlier checkpoints
+ * @param state Storage server state
+ * @param filepath Relative filepath
+ * @param tag Checkpoint tag
+ * @return 0 on success, error code on failure
+ */
+int create_checkpoint(StorageServerState* state, const char* filepath,
+                      const char* tag);
+
+/**
+ * Revert a file to a checkpoint
+ * Fails with ERR_FILE_LOCKED while any sentence of the file is locked
+ * @param state Storage server state
+ * @param filepath Relative filepath
+ * @param tag Checkpoint tag
+ * @return 0 on success, error code on failure
+ */
+int revert_to_checkpoint(StorageServerState* state, const char* filepath,
+                         const char* tag);
+
 /* ===============================================
  * REQUEST HANDLERS
  * =============================================== */
 
 /**
  * Handle READ request from client
+ * With COMPRESS_LZ4, content of COMPRESS_MIN_PAYLOAD bytes or more is sent
+ * as wire frames after an "ENCODING:lz4" line; cold files are sent as
+ * stored.
  * @param state Storage server state
  * @param client_fd Client socket
  * @param filepath File to read
+ * @param codec Codec the session negotiated
+ * @param bytes_sent Set to the document bytes sent (0 for cold files), or NULL
  * @return 0 on success, error code on failure
  */
 int handle_read_request(StorageServerState* state, int client_fd, 
-                        const char* filepath);
+                        const char* filepath, CompressCodec codec, size_t* bytes_sent);
 
 /**
  * Handle WRITE request from client
@@ -296,11 +459,79 @@ int handle_read_request(StorageServerState* state, int client_fd,
  * @param filepath File to write
  * @param sentence_idx Sentence to modify
  * @param content New content
+ * @param wait_ms How long to queue for the sentence lock (-1 = default)
  * @return 0 on success, error code on failure
  */
 int handle_write_request(StorageServerState* state, int client_fd,
                          const char* filepath, int sentence_idx, 
-                         const char* content);
+                         const char* content, int wait_ms);
+
+/**
+ * Handle "WRITE <file> <sentence>" without content: lock the sentence
+ * and start a write session on it
+ * The sentence count is a valid index: it starts a new sentence at the end.
+ * @param state Storage server state
+ * @param client_fd Client socket
+ * @param filepath File to write
+ * @param sentence_idx Sentence index
+ * @param wait_ms How long to queue for the sentence lock (-1 = default)
+ * @return Session (finish with handle_write_end or write_session_abort),
+ *         NULL on error (already reported to the client)
+ */
+WriteSession* handle_write_begin(StorageServerState* state, int client_fd,
+                                 const char* filepath, int sentence_idx, int wait_ms);
+
+/**
+ * Handle a "<word_index> <content>" line of a write session
+ * Applied in memory; also renews the sentence lock's lease.
+ * @param state Storage server state
+ * @param session Write session
+ * @param line Edit line
+ * @return 0 on success, error code on failure (ERR_FILE_LOCKED if the
+ *         lease was lost; the caller then aborts the session)
+ */
+int handle_write_edit(StorageServerState* state, WriteSession* session, const char* line);
+
+/**
+ * Handle a pipelined op of a write session (no reply)
+ *   OP <seq> INS <word_index> <content>    insert before a word
+ *   OP <seq> DEL <word_index> <count>      remove words
+ *   OP <seq> REP <word_index> <content>    replace one word
+ * Ops are numbered from 1 and applied in order.
+ * @param state Storage server state
+ * @param session Write session
+ * @param line Op line
+ * @return 0 if applied, error code if this op (or an earlier one) failed
+ */
+int handle_write_op(StorageServerState* state, WriteSession* session, const char* line);
+
+/**
+ * Handle SYNC: report pipelined progress without committing
+ * Replies "ACK <last seq>" or "ERROR:OP_FAILED <seq> <reason>".
+ * @param session Write session
+ */
+void handle_write_sync(WriteSession* session);
+
+/**
+ * Handle ETIRW: commit the edited sentence and release its lock
+ * After pipelined ops the reply carries the cumulative ack
+ * ("SUCCESS\nACK <last seq>", as for SYNC) or the first failing op, in
+ * which case nothing is committed. Replies ERROR:CONFLICT if the sentence moved or
+ * changed since the session began. A session that changed nothing
+ * commits no new version.
+ * Frees the session.
+ * @param state Storage server state
+ * @param session Write session
+ * @return 0 on success, error code on failure
+ */
+int handle_write_end(StorageServerState* state, WriteSession* session);
+
+/**
+ * End a write session without committing (e.g., on disconnect)
+ * @param state Storage server state
+ * @param session Write session (freed)
+ */
+void write_session_abort(StorageServerState* state, WriteSession* session);
 
 /**
  * Handle CREATE request from name server
@@ -329,6 +560,33 @@ int handle_delete_request(StorageServerState* state, const char* filepath);
 int handle_copy_request(StorageServerState* state, const char* filepath,
                         const char* dest_ss_ip, int dest_ss_port);
 
+/**
+ * Apply an operation received from a primary SS
+ * Idempotent, and not logged for further replication. Files created or
+ * written are marked as replicated from src_id.
+ * @param state Storage server state
+ * @param src_id SS ID of the primary
+ * @param op ReplOp
+ * @param filepath Relative filepath
+ * @param data New content (WRITE only)
+ * @param size Content length
+ * @return 0 on success, error code on failure
+ */
+int apply_replicated_op(StorageServerState* state, int src_id, char op, const char* filepath,
+                        const char* data, size_t size);
+
+/**
+ * Install a fully received file under a relative path
+ * Renames tmp_path into place as a new version (or a new file), and logs
+ * it for replication. tmp_path must be on the same filesystem.
+ * @param state Storage server state
+ * @param filepath Relative filepath
+ * @param tmp_path Synced temporary file (consumed either way)
+ * @return 0 on success, error code on failure
+ */
+int install_received_file(StorageServerState* state, const char* filepath,
+                          const char* tmp_path);
+
 /**
  * Handle INFO request (file metadata)
  * @param state Storage server state
@@ -339,4 +597,61 @@ int handle_copy_request(StorageServerState* state, const char* filepath,
 int handle_info_request(StorageServerState* state, int client_fd,
                         const char* filepath);
 
+/**
+ * Handle STREAM request (file sent word by word)
+ * Sends "SUCCESS\nWORDS:<n>\n" and hands the connection to the stream
+ * engine, which then owns client_fd (see stream_engine_open).
+ * @param state Storage server state
+ * @param client_fd Client socket
+ * @param filepath File path
+ * @param done Called when the stream ends (NULL: engine closes client_fd)
+ * @param done_arg Callback argument
+ * @return 0 if the stream started, error code on failure (fd not taken)
+ */
+int handle_stream_request(StorageServerState* state, int client_fd,
+                          const char* filepath, StreamDoneFn done, void* done_arg);
+
+/**
+ * Handle CHECKPOINT request
+ * @param state Storage server state
+ * @param client_fd Client socket
+ * @param filepath File path
+ * @param tag Checkpoint tag
+ * @return 0 on success, error code on failure
+ */
+int handle_checkpoint_request(StorageServerState* state, int client_fd,
+                              const char* filepath, const char* tag);
+
+/**
+ * Handle VIEWCHECKPOINT request (streams checkpoint content)
+ * @param state Storage server state
+ * @param client_fd Client socket
+ * @param filepath File path
+ * @param tag Checkpoint tag
+ * @return 0 on success, error code on failure
+ */
+int handle_viewcheckpoint_request(StorageServerState* state, int client_fd,
+                                  const char* filepath, const char* tag);
+
+/**
+ * Handle REVERT request
+ * @param state Storage server state
+ * @param client_fd Client socket
+ * @param filepath File path
+ * @param tag Checkpoint tag
+ * @return 0 on success, error code on failure
+ */
+int handle_revert_request(StorageServerState* state, int client_fd,
+                          const char* filepath, const char* tag);
+
+/**
+ * Handle LISTCHECKPOINTS request
+ * @param state Storage server state
+ * @param client_fd Client socket
+ * @param filepath File path
+ * @return 0 on success, error code on failure
+ */
+int handle_listcheckpoints_request(StorageServerState* state, int client_fd,
+                                   const char* filepath);
+
 #endif // SS_SERVER_H
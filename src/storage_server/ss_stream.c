@@ -0,0 +1,509 @@
+#include "ss_stream.h"
+#include "../common/utils.h"
+#include "../common/logger.h"
+#include "../common/hash_utils.h"
+#include "../common/error_codes.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+static const char STREAM_TRAILER[] = "STREAM_END\n";
+
+/* ===============================================
+ * WORD INDEX CACHE
+ * =============================================== */
+
+static size_t index_bucket(uint64_t file_id, uint64_t version) {
+    return hash_mix64(file_id ^ (version * 0x9e3779b97f4a7c15ULL)) % WORD_INDEX_BUCKETS;
+}
+
+static bool is_word_separator(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static void free_word_index(WordIndex* index) {
+    if (index->data && index->mapped) munmap((void*)index->data, index->size);
+    else free((void*)index->data);
+    free(index->word_offset);
+    free(index->word_len);
+    free(index);
+}
+
+static int index_words(WordIndex* index) {
+    size_t capacity = 0;
+    size_t i = 0;
+    while (i < index->size) {
+        while (i < index->size && is_word_separator(index->data[i])) i++;
+        if (i >= index->size) break;
+
+        size_t start = i;
+        while (i < index->size && !is_word_separator(index->data[i])) i++;
+
+        if (index->word_count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            size_t* offsets = realloc(index->word_offset, capacity * sizeof(size_t));
+            size_t* lens = offsets ? realloc(index->word_len, capacity * sizeof(size_t)) : NULL;
+            if (offsets) index->word_offset = offsets;
+            if (!offsets || !lens) return -1;
+            index->word_len = lens;
+        }
+        index->word_offset[index->word_count] = start;
+        index->word_len[index->word_count] = i - start;
+        index->word_count++;
+    }
+    return 0;
+}
+
+static WordIndex* build_word_index(uint64_t file_id, uint64_t version, int fd, off_t size) {
+    WordIndex* index = calloc(1, sizeof(WordIndex));
+    if (!index) return NULL;
+
+    index->file_id = file_id;
+    index->version = version;
+    index->size = (size_t)size;
+
+    if (size == 0) return index;
+
+    // The mapping keeps this version alive after the descriptor is closed
+    void* data = mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        free(index);
+        return NULL;
+    }
+    index->data = data;
+    index->mapped = true;
+
+    if (index_words(index) < 0) {
+        free_word_index(index);
+        return NULL;
+    }
+    return index;
+}
+
+static WordIndex* build_word_index_from_buffer(uint64_t file_id, uint64_t version,
+                                               const char* data, size_t size) {
+    WordIndex* index = calloc(1, sizeof(WordIndex));
+    if (!index) return NULL;
+
+    index->file_id = file_id;
+    index->version = version;
+    index->size = size;
+
+    if (size == 0) return index;
+
+    char* copy = malloc(size);
+    if (!copy) {
+        free(index);
+        return NULL;
+    }
+    memcpy(copy, data, size);
+    index->data = copy;
+
+    if (index_words(index) < 0) {
+        free_word_index(index);
+        return NULL;
+    }
+    return index;
+}
+
+// Returns a referenced index of (file_id, version) if one is shared already
+static WordIndex* find_word_index(StreamEngine* engine, uint64_t file_id, uint64_t version) {
+    size_t bucket = index_bucket(file_id, version);
+
+    pthread_mutex_lock(&engine->index_mutex);
+    for (WordIndex* index = engine->index_buckets[bucket]; index; index = index->next) {
+        if (index->file_id == file_id && index->version == version) {
+            index->refcount++;
+            pthread_mutex_unlock(&engine->index_mutex);
+
+            pthread_mutex_lock(&engine->stats_mutex);
+            engine->stats.index_hits++;
+            pthread_mutex_unlock(&engine->stats_mutex);
+            return index;
+        }
+    }
+    pthread_mutex_unlock(&engine->index_mutex);
+    return NULL;
+}
+
+// Publishes a freshly built index; a racing builder of the same version wins
+static WordIndex* publish_word_index(StreamEngine* engine, WordIndex* built) {
+    size_t bucket = index_bucket(built->file_id, built->version);
+
+    pthread_mutex_lock(&engine->index_mutex);
+    for (WordIndex* index = engine->index_buckets[bucket]; index; index = index->next) {
+        if (index->file_id == built->file_id && index->version == built->version) {
+            index->refcount++;
+            pthread_mutex_unlock(&engine->index_mutex);
+            free_word_index(built);
+            return index;
+        }
+    }
+    built->refcount = 1;
+    built->next = engine->index_buckets[bucket];
+    engine->index_buckets[bucket] = built;
+    pthread_mutex_unlock(&engine->index_mutex);
+
+    return built;
+}
+
+WordIndex* word_index_acquire(StreamEngine* engine, uint64_t file_id,
+                              uint64_t version, int fd, off_t size) {
+    if (!engine) return NULL;
+
+    WordIndex* index = find_word_index(engine, file_id, version);
+    if (index) return index;
+
+    // Build outside the lock
+    WordIndex* built = build_word_index(file_id, version, fd, size);
+    return built ? publish_word_index(engine, built) : NULL;
+}
+
+WordIndex* word_index_acquire_buffer(StreamEngine* engine, uint64_t file_id,
+                                     uint64_t version, const char* data, size_t size) {
+    if (!engine || (!data && size > 0)) return NULL;
+
+    WordIndex* index = find_word_index(engine, file_id, version);
+    if (index) return index;
+
+    WordIndex* built = build_word_index_from_buffer(file_id, version, data, size);
+    return built ? publish_word_index(engine, built) : NULL;
+}
+
+void word_index_release(StreamEngine* engine, WordIndex* index) {
+    if (!engine || !index) return;
+
+    pthread_mutex_lock(&engine->index_mutex);
+    if (--index->refcount > 0) {
+        pthread_mutex_unlock(&engine->index_mutex);
+        return;
+    }
+
+    WordIndex** link = &engine->index_buckets[index_bucket(index->file_id, index->version)];
+    while (*link && *link != index) {
+        link = &(*link)->next;
+    }
+    if (*link) *link = index->next;
+    pthread_mutex_unlock(&engine->index_mutex);
+
+    free_word_index(index);
+}
+
+/* ===============================================
+ * SESSION DELIVERY
+ * =============================================== */
+
+static uint64_t stream_tick(long long ms) {
+    return (uint64_t)(ms / STREAM_TICK_MS);
+}
+
+static void finish_session(StreamEngine* engine, StreamSession* session, int status) {
+    pthread_mutex_lock(&engine->stats_mutex);
+    engine->stats.active_streams--;
+    if (status == ERR_SUCCESS) {
+        engine->stats.streams_completed++;
+    } else if (status == ERR_CONNECTION_FAILED) {
+        engine->stats.streams_dropped++;
+    }
+    pthread_mutex_unlock(&engine->stats_mutex);
+
+    if (status == ERR_CONNECTION_FAILED) {
+        char log_msg[128];
+        snprintf(log_msg, sizeof(log_msg),
+                 "STREAM - client %s at word %zu of %zu",
+                 session->stalled_ms ? "stopped reading" : "disconnected",
+                 session->next_word, session->index->word_count);
+        log_message("SS", "client", session->client_fd, "user", "STREAM", log_msg, "ERROR");
+    } else if (status != ERR_SUCCESS) {
+        // Best effort: tell the client the stream was cut short on purpose
+        send(session->client_fd, "\nERROR:STREAM_ABORTED\n", 22, MSG_NOSIGNAL | MSG_DONTWAIT);
+    }
+
+    word_index_release(engine, session->index);
+
+    if (session->done) {
+        session->done(session->client_fd, status, session->done_arg);
+    } else {
+        close(session->client_fd);
+    }
+    free(session);
+}
+
+// Try to push the rest of the current line. Returns 1 when the line is
+// complete, 0 if the socket is full, -1 if the client is gone.
+static int send_current_line(StreamSession* session) {
+    const WordIndex* index = session->index;
+    struct iovec iov[2];
+    int iov_count = 0;
+    size_t line_len;
+
+    if (session->next_word < index->word_count) {
+        const char* word = index->data + index->word_offset[session->next_word];
+        size_t word_len = index->word_len[session->next_word];
+        line_len = word_len + 1;
+
+        if (session->line_sent < word_len) {
+            iov[iov_count].iov_base = (void*)(word + session->line_sent);
+            iov[iov_count].iov_len = word_len - session->line_sent;
+            iov_count++;
+        }
+        iov[iov_count].iov_base = (void*)"\n";
+        iov[iov_count].iov_len = 1;
+        iov_count++;
+    } else {
+        line_len = sizeof(STREAM_TRAILER) - 1;
+        iov[0].iov_base = (void*)(STREAM_TRAILER + session->line_sent);
+        iov[0].iov_len = line_len - session->line_sent;
+        iov_count = 1;
+    }
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iov_count;
+
+    for (;;) {
+        ssize_t n = sendmsg(session->client_fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        session->line_sent += (size_t)n;
+        return session->line_sent >= line_len ? 1 : 0;
+    }
+}
+
+// Runs one due session; returns the tick to run it next, or 0 once finished
+static uint64_t run_session(StreamEngine* engine, StreamSession* session, uint64_t now_tick) {
+    size_t sent_before = session->line_sent;
+    int rc = send_current_line(session);
+    if (rc != 0) session->stalled_ms = 0;
+    if (rc < 0) {
+        finish_session(engine, session, ERR_CONNECTION_FAILED);
+        return 0;
+    }
+    if (rc == 0) {
+        // Slow reader: retry on the next tick rather than blocking the loop,
+        // until it has read nothing for as long as a blocking send would wait
+        long long now_ms = monotonic_timestamp_ms();
+        if (!session->stalled_ms || session->line_sent != sent_before) {
+            session->stalled_ms = now_ms;
+        } else if (now_ms - session->stalled_ms >= STREAM_STALL_TIMEOUT_MS) {
+            finish_session(engine, session, ERR_CONNECTION_FAILED);
+            return 0;
+        }
+        return now_tick + 1;
+    }
+
+    if (session->next_word >= session->index->word_count) {
+        finish_session(engine, session, ERR_SUCCESS);
+        return 0;
+    }
+
+    pthread_mutex_lock(&engine->stats_mutex);
+    engine->stats.words_sent++;
+    pthread_mutex_unlock(&engine->stats_mutex);
+
+    session->next_word++;
+    session->line_sent = 0;
+
+    // The trailer follows the last word immediately
+    if (session->next_word >= session->index->word_count) return now_tick + 1;
+    return now_tick + STREAM_WORD_INTERVAL_MS / STREAM_TICK_MS;
+}
+
+/* ===============================================
+ * EVENT LOOPS
+ * =============================================== */
+
+static void* stream_loop_func(void* arg) {
+    StreamLoop* loop = (StreamLoop*)arg;
+    StreamEngine* engine = loop->engine;
+
+    pthread_mutex_lock(&loop->mutex);
+    while (loop->running) {
+        uint64_t now_tick = stream_tick(monotonic_timestamp_ms());
+        TimerNode* due = timer_wheel_advance(&loop->wheel, now_tick);
+        pthread_mutex_unlock(&loop->mutex);
+
+        // Sessions are only touched by their loop thread, so no lock here
+        TimerNode* reschedule = NULL;
+        while (due) {
+            TimerNode* next = due->next;
+            StreamSession* session = (StreamSession*)due;
+            uint64_t next_tick = run_session(engine, session, now_tick);
+            if (next_tick) {
+                session->timer.expires = next_tick;
+                session->timer.next = reschedule;
+                reschedule = &session->timer;
+            }
+            due = next;
+        }
+
+        pthread_mutex_lock(&loop->mutex);
+        while (reschedule) {
+            TimerNode* next = reschedule->next;
+            timer_wheel_add(&loop->wheel, reschedule, reschedule->expires);
+            reschedule = next;
+        }
+
+        if (!loop->running) break;
+
+        if (loop->wheel.count == 0) {
+            // Idle: sleep until a session arrives
+            pthread_cond_wait(&loop->cond, &loop->mutex);
+        } else {
+            struct timespec deadline;
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_nsec += (long)STREAM_TICK_MS * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&loop->cond, &loop->mutex, &deadline);
+        }
+    }
+    pthread_mutex_unlock(&loop->mutex);
+
+    return NULL;
+}
+
+/* ===============================================
+ * ENGINE LIFECYCLE
+ * =============================================== */
+
+void stream_engine_init(StreamEngine* engine) {
+    memset(engine, 0, sizeof(StreamEngine));
+    pthread_mutex_init(&engine->index_mutex, NULL);
+    pthread_mutex_init(&engine->stats_mutex, NULL);
+
+    for (int i = 0; i < STREAM_MAX_LOOPS; i++) {
+        StreamLoop* loop = &engine->loops[i];
+        loop->engine = engine;
+        timer_wheel_init(&loop->wheel, stream_tick(monotonic_timestamp_ms()));
+        pthread_mutex_init(&loop->mutex, NULL);
+
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&loop->cond, &attr);
+        pthread_condattr_destroy(&attr);
+    }
+}
+
+int stream_engine_start(StreamEngine* engine, int loops) {
+    if (!engine) return -1;
+    if (loops < 1) loops = 1;
+    if (loops > STREAM_MAX_LOOPS) loops = STREAM_MAX_LOOPS;
+
+    for (int i = 0; i < loops; i++) {
+        StreamLoop* loop = &engine->loops[i];
+        loop->running = true;
+        if (pthread_create(&loop->thread, NULL, stream_loop_func, loop) != 0) {
+            loop->running = false;
+            break;
+        }
+        loop->started = true;
+        engine->loop_count = i + 1;
+    }
+
+    return engine->loop_count > 0 ? 0 : -1;
+}
+
+void stream_engine_stop(StreamEngine* engine) {
+    if (!engine) return;
+
+    for (int i = 0; i < engine->loop_count; i++) {
+        StreamLoop* loop = &engine->loops[i];
+        if (!loop->started) continue;
+
+        pthread_mutex_lock(&loop->mutex);
+        loop->running = false;
+        pthread_cond_signal(&loop->cond);
+        pthread_mutex_unlock(&loop->mutex);
+
+        pthread_join(loop->thread, NULL);
+        loop->started = false;
+
+        // With the thread gone every remaining session sits in the wheel
+        for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+            for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+                TimerNode* head = &loop->wheel.slots[level][slot];
+                while (head->next != head) {
+                    TimerNode* node = head->next;
+                    timer_wheel_cancel(&loop->wheel, node);
+                    finish_session(engine, (StreamSession*)node, ERR_INVALID_OPERATION);
+                }
+            }
+        }
+    }
+    engine->loop_count = 0;
+}
+
+void stream_engine_destroy(StreamEngine* engine) {
+    if (!engine) return;
+
+    stream_engine_stop(engine);
+
+    for (int i = 0; i < STREAM_MAX_LOOPS; i++) {
+        pthread_mutex_destroy(&engine->loops[i].mutex);
+        pthread_cond_destroy(&engine->loops[i].cond);
+    }
+
+    // Indexes left here were acquired but never handed to a stream
+    for (int b = 0; b < WORD_INDEX_BUCKETS; b++) {
+        WordIndex* index = engine->index_buckets[b];
+        while (index) {
+            WordIndex* next = index->next;
+            free_word_index(index);
+            index = next;
+        }
+        engine->index_buckets[b] = NULL;
+    }
+
+    pthread_mutex_destroy(&engine->index_mutex);
+    pthread_mutex_destroy(&engine->stats_mutex);
+}
+
+int stream_engine_open(StreamEngine* engine, int client_fd, WordIndex* index,
+                       StreamDoneFn done, void* done_arg) {
+    if (!engine || !index || client_fd < 0 || engine->loop_count == 0) return -1;
+
+    StreamSession* session = calloc(1, sizeof(StreamSession));
+    if (!session) return -1;
+
+    session->client_fd = client_fd;
+    session->index = index;
+    session->started_ms = monotonic_timestamp_ms();
+    session->done = done;
+    session->done_arg = done_arg;
+
+    pthread_mutex_lock(&engine->stats_mutex);
+    unsigned slot = engine->next_loop++ % (unsigned)engine->loop_count;
+    engine->stats.streams_started++;
+    engine->stats.active_streams++;
+    pthread_mutex_unlock(&engine->stats_mutex);
+
+    // First word goes out on the loop's next tick
+    StreamLoop* loop = &engine->loops[slot];
+    pthread_mutex_lock(&loop->mutex);
+    timer_wheel_add(&loop->wheel, &session->timer, loop->wheel.current_tick + 1);
+    pthread_cond_signal(&loop->cond);
+    pthread_mutex_unlock(&loop->mutex);
+
+    return 0;
+}
+
+void stream_engine_get_stats(StreamEngine* engine, StreamStats* stats) {
+    if (!engine || !stats) return;
+
+    pthread_mutex_lock(&engine->stats_mutex);
+    *stats = engine->stats;
+    pthread_mutex_unlock(&engine->stats_mutex);
+}
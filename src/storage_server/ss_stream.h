@@ -0,0 +1,173 @@
+#ifndef SS_STREAM_H
+#define SS_STREAM_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "ss_timer_wheel.h"
+
+#define STREAM_MAX_LOOPS 8               // Upper bound on event-loop threads
+#define STREAM_DEFAULT_LOOPS 2
+#define STREAM_TICK_MS 10                // Wheel granularity
+#define STREAM_WORD_INTERVAL_MS 100      // Gap between words
+#define STREAM_STALL_TIMEOUT_MS 30000    // Client not reading; matches CONN_SEND_TIMEOUT_SEC
+#define WORD_INDEX_BUCKETS 64
+
+/**
+ * Word Index
+ * Word boundaries of one version of a file, over a read-only mapping (or
+ * in-memory copy) of that version. Shared by every stream of the same (file, version) and
+ * freed when the last one finishes.
+ */
+typedef struct WordIndex {
+    uint64_t file_id;
+    uint64_t version;
+    const char* data;           // The version's bytes (NULL if empty)
+    size_t size;
+    bool mapped;                // data is an mmap of the file, else a heap copy
+    size_t* word_offset;
+    size_t* word_len;
+    size_t word_count;
+    int refcount;               // Guarded by the engine's index_mutex
+    struct WordIndex* next;     // Cache bucket chain
+} WordIndex;
+
+/**
+ * Completion callback: called once from a loop thread when a stream ends.
+ * status is 0 when the whole file was sent, ERR_CONNECTION_FAILED if the
+ * client went away, ERR_INVALID_OPERATION if the engine shut down. The
+ * callback owns client_fd afterwards; with no callback the engine closes it.
+ */
+typedef void (*StreamDoneFn)(int client_fd, int status, void* arg);
+
+/**
+ * Stream Session
+ * A cursor into a word index plus delivery state; lives in exactly one
+ * loop's timer wheel while active
+ */
+typedef struct StreamSession {
+    TimerNode timer;            // Must stay first
+    int client_fd;
+    WordIndex* index;
+    size_t next_word;           // word_count means "send the trailer"
+    size_t line_sent;           // Bytes of the current line already sent
+    long long started_ms;
+    long long stalled_ms;       // When the socket filled up, 0 while it drains
+    StreamDoneFn done;
+    void* done_arg;
+} StreamSession;
+
+/**
+ * Stream Loop
+ * One event-loop thread driving its own wheel of sessions
+ */
+typedef struct {
+    TimerWheel wheel;
+    pthread_mutex_t mutex;      // Guards the wheel
+    pthread_cond_t cond;        // Wakes the loop for new sessions or stop
+    pthread_t thread;
+    bool running;
+    bool started;
+    struct StreamEngine* engine;
+} StreamLoop;
+
+/**
+ * Stream Statistics
+ */
+typedef struct {
+    uint64_t streams_started;
+    uint64_t streams_completed;
+    uint64_t streams_dropped;   // Client disconnected or stopped reading mid-stream
+    uint64_t words_sent;
+    uint64_t index_hits;        // Streams that reused a cached index
+    int active_streams;
+} StreamStats;
+
+/**
+ * Stream Engine
+ */
+typedef struct StreamEngine {
+    StreamLoop loops[STREAM_MAX_LOOPS];
+    int loop_count;
+    unsigned next_loop;         // Round-robin assignment
+
+    pthread_mutex_t index_mutex;
+    WordIndex* index_buckets[WORD_INDEX_BUCKETS];
+
+    pthread_mutex_t stats_mutex;
+    StreamStats stats;
+} StreamEngine;
+
+/**
+ * Initialize / destroy the stream engine
+ * Destroy stops the loops and aborts any remaining streams.
+ */
+void stream_engine_init(StreamEngine* engine);
+void stream_engine_destroy(StreamEngine* engine);
+
+/**
+ * Start the event-loop threads
+ * @param engine Stream engine
+ * @param loops Number of loop threads (clamped to 1..STREAM_MAX_LOOPS)
+ * @return 0 on success, -1 on error
+ */
+int stream_engine_start(StreamEngine* engine, int loops);
+
+/**
+ * Stop the loops; sessions still active are aborted
+ * @param engine Stream engine
+ */
+void stream_engine_stop(StreamEngine* engine);
+
+/**
+ * Get (or build) the word index of one file version
+ * @param engine Stream engine
+ * @param file_id File ID
+ * @param version File version
+ * @param fd Descriptor on that version (only read if the index is not cached)
+ * @param size Size of that version
+ * @return Referenced index, NULL on error
+ */
+WordIndex* word_index_acquire(StreamEngine* engine, uint64_t file_id,
+                              uint64_t version, int fd, off_t size);
+
+/**
+ * Get (or build) the word index of one file version already in memory
+ * The index keeps its own copy, so data need only live for the call.
+ * @param engine Stream engine
+ * @param file_id File ID
+ * @param version File version
+ * @param data Content of that version
+ * @param size Content length
+ * @return Referenced index, NULL on error
+ */
+WordIndex* word_index_acquire_buffer(StreamEngine* engine, uint64_t file_id,
+                                     uint64_t version, const char* data, size_t size);
+
+/**
+ * Drop a reference taken with word_index_acquire(_buffer)
+ */
+void word_index_release(StreamEngine* engine, WordIndex* index);
+
+/**
+ * Start streaming an index to a client, one word per line every
+ * STREAM_WORD_INTERVAL_MS, followed by "STREAM_END\n". A client that sees
+ * the words stop without the trailer knows the SS died mid-stream.
+ * @param engine Stream engine (loops must be started)
+ * @param client_fd Client socket (owned by the engine until done runs)
+ * @param index Word index; the engine takes over the caller's reference
+ * @param done Completion callback (may be NULL)
+ * @param done_arg Callback argument
+ * @return 0 on success, -1 on error (caller keeps fd and reference)
+ */
+int stream_engine_open(StreamEngine* engine, int client_fd, WordIndex* index,
+                       StreamDoneFn done, void* done_arg);
+
+/**
+ * Snapshot stream statistics
+ */
+void stream_engine_get_stats(StreamEngine* engine, StreamStats* stats);
+
+#endif // SS_STREAM_H
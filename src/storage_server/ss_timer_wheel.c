@@ -0,0 +1,146 @@
+#include "ss_timer_wheel.h"
+#include <string.h>
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+static void list_init(TimerNode* head) {
+    head->prev = head;
+    head->next = head;
+}
+
+static void list_append(TimerNode* head, TimerNode* node) {
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+static void list_unlink(TimerNode* node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = NULL;
+    node->next = NULL;
+}
+
+void timer_wheel_init(TimerWheel* wheel, uint64_t start_tick) {
+    memset(wheel, 0, sizeof(TimerWheel));
+    wheel->current_tick = start_tick;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            list_init(&wheel->slots[level][slot]);
+        }
+    }
+}
+
+// Place a node by its distance from the current tick
+static void place(TimerWheel* wheel, TimerNode* node) {
+    uint64_t delta = node->expires - wheel->current_tick;
+
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 &&
+           delta >= ((uint64_t)1 << (TIMER_WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+
+    // Timers beyond the top level's span wait in its farthest slot and get
+    // re-placed as they cascade
+    uint64_t span = (uint64_t)1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS);
+    uint64_t target = node->expires;
+    if (delta >= span) {
+        target = wheel->current_tick + span - 1;
+    }
+
+    int slot = (int)((target >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK);
+    list_append(&wheel->slots[level][slot], node);
+}
+
+void timer_wheel_add(TimerWheel* wheel, TimerNode* node, uint64_t expires) {
+    if (node->pending) return;
+
+    // Anything due now or earlier fires on the next tick
+    if (expires <= wheel->current_tick) {
+        expires = wheel->current_tick + 1;
+    }
+
+    node->expires = expires;
+    node->pending = true;
+    place(wheel, node);
+    wheel->count++;
+}
+
+void timer_wheel_cancel(TimerWheel* wheel, TimerNode* node) {
+    if (!node->pending) return;
+
+    list_unlink(node);
+    node->pending = false;
+    wheel->count--;
+}
+
+// Move every node of one upper-level slot to where it now belongs
+static void cascade(TimerWheel* wheel, int level) {
+    int slot = (int)((wheel->current_tick >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK);
+    TimerNode* head = &wheel->slots[level][slot];
+
+    TimerNode pending;
+    list_init(&pending);
+    if (head->next != head) {
+        // Splice the whole slot out before re-placing
+        pending.next = head->next;
+        pending.prev = head->prev;
+        pending.next->prev = &pending;
+        pending.prev->next = &pending;
+        list_init(head);
+    }
+
+    while (pending.next != &pending) {
+        TimerNode* node = pending.next;
+        list_unlink(node);
+        place(wheel, node);
+    }
+}
+
+TimerNode* timer_wheel_advance(TimerWheel* wheel, uint64_t now_tick) {
+    TimerNode* expired = NULL;
+    TimerNode* expired_tail = NULL;
+
+    while (wheel->current_tick < now_tick) {
+        wheel->current_tick++;
+
+        // Higher levels first so their timers can cascade further down now
+        for (int level = TIMER_WHEEL_LEVELS - 1; level >= 1; level--) {
+            uint64_t mask = ((uint64_t)1 << (TIMER_WHEEL_BITS * level)) - 1;
+            if ((wheel->current_tick & mask) == 0) {
+                cascade(wheel, level);
+            }
+        }
+
+        TimerNode* head = &wheel->slots[0][wheel->current_tick & SLOT_MASK];
+        while (head->next != head) {
+            TimerNode* node = head->next;
+            list_unlink(node);
+
+            if (node->expires > wheel->current_tick) {
+                // Clamped far-future timer: not due yet
+                place(wheel, node);
+                continue;
+            }
+
+            node->pending = false;
+            wheel->count--;
+            node->next = NULL;
+            if (expired_tail) {
+                expired_tail->next = node;
+            } else {
+                expired = node;
+            }
+            expired_tail = node;
+        }
+
+        // Nothing scheduled: jump straight to the target tick
+        if (wheel->count == 0) {
+            wheel->current_tick = now_tick;
+        }
+    }
+
+    return expired;
+}
@@ -0,0 +1,68 @@
+#ifndef SS_TIMER_WHEEL_H
+#define SS_TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)   // 64 slots per level
+
+/**
+ * Timer Node
+ * Intrusive timer; embed it in (or allocate it with) the object it times
+ */
+typedef struct TimerNode {
+    struct TimerNode* prev;
+    struct TimerNode* next;
+    uint64_t expires;           // Absolute tick
+    bool pending;               // true while scheduled in a wheel
+    void* arg;                  // Owner data for the caller
+} TimerNode;
+
+/**
+ * Timer Wheel
+ * Hierarchical timing wheel (4 levels x 64 slots). Add and cancel are
+ * O(1); each tick touches one level-0 slot and, every 64^n ticks, cascades
+ * one slot of level n down a level.
+ *
+ * Not thread-safe: callers serialize access with their own mutex.
+ */
+typedef struct {
+    uint64_t current_tick;
+    TimerNode slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];  // List heads
+    size_t count;
+} TimerWheel;
+
+/**
+ * Initialize a timer wheel
+ * @param wheel Timer wheel
+ * @param start_tick Tick the wheel starts at
+ */
+void timer_wheel_init(TimerWheel* wheel, uint64_t start_tick);
+
+/**
+ * Schedule a timer
+ * @param wheel Timer wheel
+ * @param node Timer node (must not be pending)
+ * @param expires Absolute tick; past ticks fire on the next advance
+ */
+void timer_wheel_add(TimerWheel* wheel, TimerNode* node, uint64_t expires);
+
+/**
+ * Cancel a pending timer (no-op if not pending)
+ * @param wheel Timer wheel
+ * @param node Timer node
+ */
+void timer_wheel_cancel(TimerWheel* wheel, TimerNode* node);
+
+/**
+ * Advance the wheel and collect expired timers
+ * @param wheel Timer wheel
+ * @param now_tick Tick to advance to
+ * @return Singly linked list (via next) of expired timers, NULL if none
+ */
+TimerNode* timer_wheel_advance(TimerWheel* wheel, uint64_t now_tick);
+
+#endif // SS_TIMER_WHEEL_H
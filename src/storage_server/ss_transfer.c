@@ -0,0 +1,552 @@
+#include "ss_transfer.h"
+#include "ss_server.h"
+#include "ss_io.h"
+#include "../common/compress.h"
+#include "../common/utils.h"
+#include "../common/logger.h"
+#include "../common/error_codes.h"
+#include "../common/hash_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define TRANSFER_ID_LEN 16
+#define TRANSFER_MAX_NAKS 8              // Per connection, before the receiver gives up
+
+// send_all without SIGPIPE: the other side going away is what resume is for
+static int send_to_peer(int fd, const void* data, size_t len) {
+    const char* p = (const char*)data;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static size_t chunk_length(int64_t size, size_t chunk_size, uint64_t index) {
+    int64_t offset = (int64_t)(index * chunk_size);
+    int64_t left = size - offset;
+    return left < (int64_t)chunk_size ? (size_t)left : chunk_size;
+}
+
+/* ===============================================
+ * SENDING
+ * =============================================== */
+
+/**
+ * Outgoing transfer
+ * Chunk checksums are computed once from the pinned snapshot, so every
+ * attempt sends the same bytes and the receiver can verify them.
+ */
+typedef struct {
+    FileSnapshot snap;
+    const char* filepath;
+    char id[TRANSFER_ID_LEN + 1];
+    size_t chunk_size;
+    uint64_t chunk_count;
+    uint32_t* chunk_crcs;
+    uint32_t file_crc;
+    char* buffer;                    // One chunk
+    char* frames;                    // One chunk as LZ4 frames
+    bool compress;                   // Receiver takes LZ4 chunks (this attempt)
+    CompressStats* stats;
+} OutgoingTransfer;
+
+// Buffered reader for reply lines
+typedef struct {
+    int fd;
+    char buf[256];
+    size_t len;
+} ReplyReader;
+
+static int read_reply(ReplyReader* reader, char* line, size_t size) {
+    for (;;) {
+        char* newline = memchr(reader->buf, '\n', reader->len);
+        if (newline) {
+            size_t line_len = (size_t)(newline - reader->buf);
+            if (line_len >= size) return -1;
+            memcpy(line, reader->buf, line_len);
+            line[line_len] = '\0';
+            reader->len -= line_len + 1;
+            memmove(reader->buf, newline + 1, reader->len);
+            return (int)line_len;
+        }
+        if (reader->len == sizeof(reader->buf)) return -1;
+
+        ssize_t n = recv(reader->fd, reader->buf + reader->len,
+                         sizeof(reader->buf) - reader->len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        reader->len += (size_t)n;
+    }
+}
+
+static int prepare_outgoing(OutgoingTransfer* out, StorageServerState* state) {
+    struct stat st;
+    if (fstat(out->snap.fd, &st) < 0) return -1;
+
+    // Same source, path and content version -> same ID, so the receiver
+    // recognizes a retry of this copy
+    struct {
+        int64_t ss_id;
+        uint64_t inode;
+        int64_t mtime_ns;
+        int64_t size;
+        uint64_t version;
+    } key = { state->ss_id, (uint64_t)st.st_ino,
+              (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec,
+              (int64_t)out->snap.size, out->snap.version };
+    uint64_t id = fnv1a_64(&key, sizeof(key)) ^
+                  (fnv1a_64(out->filepath, strlen(out->filepath)) * 31);
+    snprintf(out->id, sizeof(out->id), "%016llx", (unsigned long long)id);
+
+    out->chunk_size = TRANSFER_CHUNK_SIZE;
+    out->chunk_count = ((uint64_t)out->snap.size + out->chunk_size - 1) / out->chunk_size;
+    out->buffer = malloc(out->chunk_size);
+    out->chunk_crcs = calloc(out->chunk_count ? out->chunk_count : 1, sizeof(uint32_t));
+    if (!out->buffer || !out->chunk_crcs) return -1;
+
+    out->file_crc = 0;
+    for (uint64_t i = 0; i < out->chunk_count; i++) {
+        size_t len = chunk_length(out->snap.size, out->chunk_size, i);
+        if (ss_io_pread_all(out->snap.fd, out->buffer, len,
+                            (off_t)(i * out->chunk_size)) != (ssize_t)len) {
+            return -1;
+        }
+        out->chunk_crcs[i] = crc32c(0, out->buffer, len);
+        out->file_crc = crc32c(out->file_crc, out->buffer, len);
+    }
+    return 0;
+}
+
+static int connect_peer(const char* ip, int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, ip, &addr.sin_addr) <= 0 ||
+        connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    struct timeval tv = { TRANSFER_TIMEOUT_SEC, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+static int send_chunk(OutgoingTransfer* out, int fd, uint64_t index) {
+    size_t len = chunk_length(out->snap.size, out->chunk_size, index);
+    if (ss_io_pread_all(out->snap.fd, out->buffer, len,
+                        (off_t)(index * out->chunk_size)) != (ssize_t)len) {
+        return -1;
+    }
+
+    // Compressed chunks carry their framed length; the CRC stays that of
+    // the chunk itself
+    const char* payload = out->buffer;
+    size_t payload_len = len;
+    if (out->compress && len >= COMPRESS_MIN_PAYLOAD) {
+        size_t cap = compress_frames_bound(out->chunk_size);
+        if (!out->frames) out->frames = malloc(cap);
+        size_t framed = out->frames ? compress_frames(out->buffer, len, out->frames, cap) : 0;
+        if (framed > 0 && framed < len) {
+            payload = out->frames;
+            payload_len = framed;
+        }
+    }
+
+    char header[128];
+    int header_len = snprintf(header, sizeof(header), "CHUNK %llu %zu %08x",
+                              (unsigned long long)index, len, out->chunk_crcs[index]);
+    if (payload != out->buffer) {
+        header_len += snprintf(header + header_len, sizeof(header) - (size_t)header_len,
+                               " %zu", payload_len);
+    }
+    header[header_len++] = '\n';
+    if (send_to_peer(fd, header, (size_t)header_len) < 0 ||
+        send_to_peer(fd, payload, payload_len) < 0) {
+        return -1;
+    }
+    if (payload != out->buffer) compress_stats_add(out->stats, len, payload_len, false);
+    return 0;
+}
+
+// One connection's worth of the transfer. Returns ERR_SUCCESS, or
+// ERR_CONNECTION_FAILED when another attempt may get further, or
+// ERR_FILE_LOCKED while an older connection of ours still holds the
+// receiver's partial file; *resumed is set to the offset the receiver
+// already had.
+static int send_attempt(OutgoingTransfer* out, const char* ip, int port, int64_t* resumed) {
+    int fd = connect_peer(ip, port);
+    if (fd < 0) return ERR_CONNECTION_FAILED;
+
+    ReplyReader reader = { .fd = fd, .len = 0 };
+    char line[128];
+    int result = ERR_CONNECTION_FAILED;
+
+    char begin[MAX_PATH_LEN + 96];
+    int begin_len = snprintf(begin, sizeof(begin), "COPY_BEGIN %s %lld %zu %s\n", out->id,
+                             (long long)out->snap.size, out->chunk_size, out->filepath);
+    long long offset;
+    char options[32] = "";
+    if (send_to_peer(fd, begin, (size_t)begin_len) < 0 ||
+        read_reply(&reader, line, sizeof(line)) < 0) {
+        goto done;
+    }
+    if (sscanf(line, "RESUME %lld %31s", &offset, options) < 1 || offset < 0 ||
+        offset > (long long)out->snap.size ||
+        (offset % (long long)out->chunk_size != 0 && offset != (long long)out->snap.size)) {
+        result = strncmp(line, "ERROR:BUSY", 10) == 0 ? ERR_FILE_LOCKED
+               : strncmp(line, "ERROR", 5) == 0 ? ERR_INVALID_OPERATION : ERR_CONNECTION_FAILED;
+        goto done;
+    }
+    *resumed = offset;
+    out->compress = strncmp(options, "COMPRESS=", 9) == 0 &&
+                    compress_negotiate(options + 9) == COMPRESS_LZ4;
+
+    // Go-back-N: keep a window of chunks in flight; ACKs arrive in order
+    // and a NAK rewinds to the chunk the receiver still expects
+    uint64_t next_ack = (uint64_t)offset / out->chunk_size;
+    if (offset == (long long)out->snap.size) next_ack = out->chunk_count;
+    uint64_t next_send = next_ack;
+    while (next_ack < out->chunk_count) {
+        while (next_send < out->chunk_count && next_send - next_ack < TRANSFER_WINDOW) {
+            if (send_chunk(out, fd, next_send) < 0) goto done;
+            next_send++;
+        }
+
+        unsigned long long index;
+        if (read_reply(&reader, line, sizeof(line)) < 0) goto done;
+        if (sscanf(line, "ACK %llu", &index) == 1 && index == next_ack) {
+            next_ack++;
+        } else if (sscanf(line, "NAK %llu", &index) == 1 && index == next_ack) {
+            next_send = next_ack;
+        } else {
+            goto done;
+        }
+    }
+
+    char end[64];
+    int end_len = snprintf(end, sizeof(end), "COPY_END %08x\n", out->file_crc);
+    if (send_to_peer(fd, end, (size_t)end_len) < 0 ||
+        read_reply(&reader, line, sizeof(line)) < 0) {
+        goto done;
+    }
+    if (strcmp(line, "SUCCESS") == 0) {
+        result = ERR_SUCCESS;
+    } else if (strcmp(line, "ERROR:CHECKSUM") != 0) {
+        // A checksum failure discarded the partial file and is worth
+        // retrying; anything else is the receiver refusing the file
+        result = ERR_INVALID_OPERATION;
+    }
+
+done:
+    close(fd);
+    return result;
+}
+
+int transfer_send_file(StorageServerState* state, const char* filepath,
+                       const char* dest_ip, int dest_port) {
+    if (!state || !filepath || !dest_ip) return ERR_INVALID_OPERATION;
+
+    FileEntry* entry = find_file(state, filepath);
+    if (!entry) return ERR_FILE_NOT_FOUND;
+
+    // Pin the version to send; every attempt sends this one
+    OutgoingTransfer out;
+    memset(&out, 0, sizeof(out));
+    out.filepath = filepath;
+    out.stats = &state->wire_stats;
+    int result = open_file_snapshot(state, entry, &out.snap);
+    file_entry_release(entry);
+    if (result != ERR_SUCCESS) return ERR_INVALID_OPERATION;
+
+    if (prepare_outgoing(&out, state) < 0) {
+        result = ERR_INVALID_OPERATION;
+    } else {
+        result = ERR_CONNECTION_FAILED;
+        for (int attempt = 1; attempt <= TRANSFER_MAX_ATTEMPTS; attempt++) {
+            int64_t resumed = 0;
+            result = send_attempt(&out, dest_ip, dest_port, &resumed);
+
+            char log_msg[MAX_PATH_LEN + 96];
+            snprintf(log_msg, sizeof(log_msg), "%s - %lld bytes, attempt %d, resumed at %lld",
+                     filepath, (long long)out.snap.size, attempt, (long long)resumed);
+            log_message("SS", dest_ip, dest_port, "system", "COPY", log_msg,
+                       result == ERR_SUCCESS ? "SUCCESS" : "ERROR");
+
+            if (result != ERR_CONNECTION_FAILED && result != ERR_FILE_LOCKED) break;
+            if (attempt < TRANSFER_MAX_ATTEMPTS) {
+                // The stale receiver lets go once its read times out
+                if (result == ERR_FILE_LOCKED) {
+                    sleep(TRANSFER_TIMEOUT_SEC);
+                } else {
+                    usleep((useconds_t)attempt * TRANSFER_RETRY_MS * 1000);
+                }
+            }
+        }
+    }
+
+    free(out.buffer);
+    free(out.frames);
+    free(out.chunk_crcs);
+    close_file_snapshot(&out.snap);
+    return result;
+}
+
+/* ===============================================
+ * RECEIVING
+ * =============================================== */
+
+// Buffered session input first, then the socket
+static int read_payload(int fd, char* out, size_t len, char* inbuf, size_t* inlen) {
+    size_t from_buffer = *inlen < len ? *inlen : len;
+    memcpy(out, inbuf, from_buffer);
+    *inlen -= from_buffer;
+    memmove(inbuf, inbuf + from_buffer, *inlen);
+
+    if (len > from_buffer && recv_all(fd, out + from_buffer, len - from_buffer) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Reads a frame line, from the buffered input first
+static int read_frame_line(int fd, char* line, size_t size, char* inbuf, size_t* inlen) {
+    size_t len = 0;
+    while (len + 1 < size) {
+        char c;
+        if (*inlen > 0) {
+            c = inbuf[0];
+            (*inlen)--;
+            memmove(inbuf, inbuf + 1, *inlen);
+        } else {
+            ssize_t n = recv(fd, &c, 1, 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return -1;
+        }
+        if (c == '\n') {
+            if (len > 0 && line[len - 1] == '\r') len--;
+            line[len] = '\0';
+            return (int)len;
+        }
+        line[len++] = c;
+    }
+    return -1;
+}
+
+static bool is_transfer_id(const char* id) {
+    if (strlen(id) != TRANSFER_ID_LEN) return false;
+    for (const char* p = id; *p; p++) {
+        if (!((*p >= '0' && *p <= '9') || (*p >= 'a' && *p <= 'f'))) return false;
+    }
+    return true;
+}
+
+// Partial files nobody came back for
+static void sweep_stale_parts(const char* dir_path) {
+    DIR* dir = opendir(dir_path);
+    if (!dir) return;
+
+    time_t cutoff = time(NULL) - TRANSFER_PART_TTL_SEC;
+    struct dirent* de;
+    while ((de = readdir(dir)) != NULL) {
+        size_t name_len = strlen(de->d_name);
+        if (name_len < 5 || strcmp(de->d_name + name_len - 5, ".part") != 0) continue;
+
+        char path[MAX_PATH_LEN + 64];
+        int path_len = snprintf(path, sizeof(path), "%s/%s", dir_path, de->d_name);
+        if (path_len < 0 || (size_t)path_len >= sizeof(path)) continue;
+        struct stat st;
+        if (stat(path, &st) == 0 && st.st_mtime < cutoff) unlink(path);
+    }
+    closedir(dir);
+}
+
+// Keeps whole verified chunks of an earlier attempt; returns the resume
+// offset with *crc covering the bytes before it, -1 on error
+static int64_t prepare_part(int fd, int64_t size, size_t chunk_size, char* buffer,
+                            uint32_t* crc) {
+    struct stat st;
+    if (fstat(fd, &st) < 0) return -1;
+
+    int64_t have = st.st_size <= size ? st.st_size : 0;
+    if (have < size) have -= have % (int64_t)chunk_size;
+    if (ftruncate(fd, (off_t)have) < 0) return -1;
+
+    *crc = 0;
+    for (int64_t offset = 0; offset < have; ) {
+        size_t len = have - offset < (int64_t)chunk_size ? (size_t)(have - offset) : chunk_size;
+        if (ss_io_pread_all(fd, buffer, len, (off_t)offset) != (ssize_t)len) return -1;
+        *crc = crc32c(*crc, buffer, len);
+        offset += (int64_t)len;
+    }
+    return have;
+}
+
+static int send_line(int fd, const char* fmt, unsigned long long value) {
+    char line[64];
+    int len = snprintf(line, sizeof(line), fmt, value);
+    return send_to_peer(fd, line, (size_t)len);
+}
+
+int transfer_receive(StorageServerState* state, int fd, const char* line,
+                     char* inbuf, size_t* inlen) {
+    if (!state || !line || !inbuf || !inlen) return ERR_INVALID_OPERATION;
+
+    char id[TRANSFER_ID_LEN + 2];
+    long long size_arg;
+    size_t chunk_size;
+    int path_offset = 0;
+    if (sscanf(line, "COPY_BEGIN %17s %lld %zu %n", id, &size_arg, &chunk_size,
+               &path_offset) != 3 || path_offset == 0 || !is_transfer_id(id) ||
+        size_arg < 0 || chunk_size < TRANSFER_MIN_CHUNK || chunk_size > TRANSFER_MAX_CHUNK ||
+        !is_safe_filepath(line + path_offset)) {
+        send_to_peer(fd, "ERROR:INVALID_ARGS\n", 19);
+        return ERR_INVALID_OPERATION;
+    }
+    const char* filepath = line + path_offset;
+    int64_t size = size_arg;
+
+    char dir_path[MAX_PATH_LEN + 32];
+    snprintf(dir_path, sizeof(dir_path), "%s/%s", state->base_path, TRANSFER_DIR);
+    if (mkdir(dir_path, 0755) < 0 && errno != EEXIST) {
+        send_to_peer(fd, "ERROR:OPERATION_FAILED\n", 23);
+        return ERR_INVALID_OPERATION;
+    }
+    sweep_stale_parts(dir_path);
+
+    char part_path[MAX_PATH_LEN + 64];
+    snprintf(part_path, sizeof(part_path), "%s/%s.part", dir_path, id);
+    int part_fd = open(part_path, O_RDWR | O_CREAT, 0644);
+    if (part_fd < 0) {
+        send_to_peer(fd, "ERROR:OPERATION_FAILED\n", 23);
+        return ERR_INVALID_OPERATION;
+    }
+    // A sender that timed out and retried can race its own old connection
+    if (flock(part_fd, LOCK_EX | LOCK_NB) < 0) {
+        close(part_fd);
+        send_to_peer(fd, "ERROR:BUSY\n", 11);
+        return ERR_FILE_LOCKED;
+    }
+
+    char* buffer = malloc(chunk_size);
+    uint32_t crc = 0;
+    int64_t offset = buffer ? prepare_part(part_fd, size, chunk_size, buffer, &crc) : -1;
+    if (offset < 0) {
+        free(buffer);
+        close(part_fd);
+        send_to_peer(fd, "ERROR:OPERATION_FAILED\n", 23);
+        return ERR_INVALID_OPERATION;
+    }
+
+    int result = ERR_CONNECTION_FAILED;
+    bool keep_part = true;
+    char* frames = NULL;             // Compressed chunk as received
+    if (send_line(fd, "RESUME %llu COMPRESS=lz4\n", (unsigned long long)offset) < 0) goto done;
+
+    uint64_t expected = (uint64_t)offset / chunk_size;
+    int naks = 0;
+    char frame[128];
+    for (;;) {
+        if (read_frame_line(fd, frame, sizeof(frame), inbuf, inlen) < 0) goto done;
+
+        unsigned long long index;
+        size_t len, framed = 0;
+        unsigned int chunk_crc;
+        int fields = sscanf(frame, "CHUNK %llu %zu %x %zu", &index, &len, &chunk_crc, &framed);
+        if (fields >= 3) {
+            bool compressed = fields == 4;
+            if (len > chunk_size || (compressed && framed > compress_frames_bound(chunk_size))) {
+                goto done;
+            }
+            if (compressed && !frames && !(frames = malloc(compress_frames_bound(chunk_size)))) {
+                goto done;
+            }
+            if (read_payload(fd, compressed ? frames : buffer, compressed ? framed : len,
+                             inbuf, inlen) < 0) {
+                goto done;
+            }
+
+            // Chunks sent before a NAK was seen are dropped until the
+            // sender rewinds to the expected one
+            if (index != expected) continue;
+
+            if (offset >= size || len != chunk_length(size, chunk_size, index) ||
+                (compressed && decompress_frames(frames, framed, buffer, len) < 0) ||
+                crc32c(0, buffer, len) != chunk_crc) {
+                if (++naks > TRANSFER_MAX_NAKS ||
+                    send_line(fd, "NAK %llu\n", (unsigned long long)expected) < 0) {
+                    goto done;
+                }
+                continue;
+            }
+
+            if (ss_io_pwrite_all(part_fd, buffer, len, (off_t)offset) < 0) {
+                send_to_peer(fd, "ERROR:OPERATION_FAILED\n", 23);
+                result = ERR_INVALID_OPERATION;
+                goto done;
+            }
+            crc = crc32c(crc, buffer, len);
+            offset += (int64_t)len;
+            expected++;
+            if (send_line(fd, "ACK %llu\n", index) < 0) goto done;
+            continue;
+        }
+
+        unsigned int file_crc;
+        if (sscanf(frame, "COPY_END %x", &file_crc) == 1) {
+            if (offset != size) {
+                send_to_peer(fd, "ERROR:INCOMPLETE\n", 17);
+                result = ERR_INVALID_OPERATION;
+            } else if (file_crc != crc) {
+                keep_part = false;
+                send_to_peer(fd, "ERROR:CHECKSUM\n", 15);
+                result = ERR_INVALID_OPERATION;
+            } else if (ss_io_write_and_sync(part_fd, NULL, 0) < 0) {
+                send_to_peer(fd, "ERROR:OPERATION_FAILED\n", 23);
+                result = ERR_INVALID_OPERATION;
+            } else {
+                // Installed by rename; nothing left to keep either way
+                keep_part = false;
+                result = install_received_file(state, filepath, part_path);
+                if (result == ERR_SUCCESS) {
+                    send_to_peer(fd, "SUCCESS\n", 8);
+                } else {
+                    send_to_peer(fd, "ERROR:OPERATION_FAILED\n", 23);
+                }
+            }
+            goto done;
+        }
+
+        send_to_peer(fd, "ERROR:INVALID_ARGS\n", 19);
+        result = ERR_INVALID_OPERATION;
+        goto done;
+    }
+
+done:
+    // Dropped connections leave the partial file for the sender's retry
+    if (!keep_part) unlink(part_path);
+    close(part_fd);
+    free(buffer);
+    free(frames);
+    return result;
+}
@@ -0,0 +1,61 @@
+#ifndef SS_TRANSFER_H
+#define SS_TRANSFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRANSFER_DIR ".transfers"        // Partial receives, under the SS base path
+#define TRANSFER_CHUNK_SIZE (256 * 1024)
+#define TRANSFER_MIN_CHUNK 4096
+#define TRANSFER_MAX_CHUNK (4 * 1024 * 1024)
+#define TRANSFER_WINDOW 8                // Unacknowledged chunks in flight
+#define TRANSFER_MAX_ATTEMPTS 5          // Connections per copy before giving up
+#define TRANSFER_RETRY_MS 500            // Backoff step between attempts
+#define TRANSFER_TIMEOUT_SEC 30
+#define TRANSFER_PART_TTL_SEC 86400      // Abandoned partial files are swept after this
+
+typedef struct StorageServerState StorageServerState;
+
+/*
+ * SS-to-SS transfer protocol (one file per connection)
+ *
+ *   -> COPY_BEGIN <transfer_id> <size> <chunk_size> <path>
+ *   <- RESUME <offset> [COMPRESS=lz4]    bytes already held from an earlier attempt
+ *   -> CHUNK <index> <len> <crc32c> [<framed_len>]
+ *                                        followed by len bytes (or framed_len bytes
+ *                                        of LZ4 frames, if offered), up to
+ *                                        TRANSFER_WINDOW chunks unacknowledged
+ *   <- ACK <index> | NAK <index>         NAK: resend from index
+ *   -> COPY_END <crc32c of whole file>
+ *   <- SUCCESS | ERROR:<reason>
+ *
+ * The transfer ID names one version of the source file, so a retry
+ * after a dropped connection resumes where the last one stopped, while a
+ * changed source starts over.
+ */
+
+/**
+ * Push a file to another SS, resuming across dropped connections
+ * @param state Storage server state
+ * @param filepath Relative filepath
+ * @param dest_ip Destination SS IP
+ * @param dest_port Destination SS port
+ * @return 0 on success, error code on failure
+ */
+int transfer_send_file(StorageServerState* state, const char* filepath,
+                       const char* dest_ip, int dest_port);
+
+/**
+ * Receive a file for a "COPY_BEGIN ..." line (peer side)
+ * Input already buffered by the session is consumed first.
+ * @param state Storage server state
+ * @param fd Peer connection
+ * @param line COPY_BEGIN line
+ * @param inbuf Session input buffer
+ * @param inlen Bytes buffered (updated)
+ * @return 0 on success, error code on failure
+ */
+int transfer_receive(StorageServerState* state, int fd, const char* line,
+                     char* inbuf, size_t* inlen);
+
+#endif // SS_TRANSFER_H
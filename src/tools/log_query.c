@@ -0,0 +1,360 @@
+// log_query: filter and aggregate binary request logs (see LogRecord in
+// common/logger.h) without going through the text logs.
+//
+//   log_query [options] FILE...
+//     --op NAME         Only this operation (READ, WRITE, ...)
+//     --component NAME  Only records from NM, SS or CLIENT
+//     --user NAME       Only this user
+//     --file PATH       Only this file (path as the storage server sees it)
+//     --since EPOCH     Only requests finished at or after this time (seconds)
+//     --until EPOCH     Only requests finished before this time (seconds)
+//     --errors          Only failed requests
+//     --group KEY       op (default), hour, op-hour, status or none
+//     --dump            Print matching records instead of aggregating
+//
+// Example, p99 latency per op per hour:
+//   log_query --group op-hour logs/storage_server_1.bin*
+#include "../common/logger.h"
+#include "../common/hash_utils.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define READ_CHUNK 4096                  // Records per fread
+
+typedef enum {
+    GROUP_OP,
+    GROUP_HOUR,
+    GROUP_OP_HOUR,
+    GROUP_STATUS,
+    GROUP_NONE
+} GroupBy;
+
+typedef struct {
+    bool has_op;
+    LogOp op;
+    bool has_component;
+    LogComponent component;
+    bool has_user;
+    uint64_t user_id;
+    bool has_file;
+    uint64_t file_id;
+    uint64_t since_ns;
+    uint64_t until_ns;                   // 0 = no limit
+    bool errors_only;
+    GroupBy group_by;
+    bool dump;
+} QueryOptions;
+
+// One output row: the requests sharing a group key
+typedef struct {
+    int op;                              // -1 when not grouped by op
+    int64_t hour;                        // Epoch hour, -1 when not grouped by hour
+    int status;                          // -1 when not grouped by status
+    uint64_t count;
+    uint64_t errors;
+    uint64_t bytes;
+    uint32_t* latencies;
+    size_t latency_cap;
+} Group;
+
+typedef struct {
+    Group* groups;
+    size_t count;
+    size_t cap;
+    size_t* slots;                       // Open addressing: group index + 1, 0 = empty
+    size_t slot_count;
+} GroupTable;
+
+/* ===============================================
+ * GROUPS
+ * =============================================== */
+
+static uint64_t group_hash(int op, int64_t hour, int status) {
+    return hash_mix64(((uint64_t)hour << 24) ^ ((uint64_t)(op + 1) << 16) ^
+                      (uint64_t)(status + 1));
+}
+
+static int grow_slots(GroupTable* table) {
+    size_t slot_count = table->slot_count ? table->slot_count * 2 : 256;
+    size_t* slots = calloc(slot_count, sizeof(size_t));
+    if (!slots) return -1;
+    for (size_t i = 0; i < table->count; i++) {
+        Group* g = &table->groups[i];
+        size_t slot = group_hash(g->op, g->hour, g->status) & (slot_count - 1);
+        while (slots[slot]) slot = (slot + 1) & (slot_count - 1);
+        slots[slot] = i + 1;
+    }
+    free(table->slots);
+    table->slots = slots;
+    table->slot_count = slot_count;
+    return 0;
+}
+
+static Group* find_group(GroupTable* table, int op, int64_t hour, int status) {
+    if ((table->count + 1) * 2 > table->slot_count && grow_slots(table) < 0) return NULL;
+
+    size_t slot = group_hash(op, hour, status) & (table->slot_count - 1);
+    while (table->slots[slot]) {
+        Group* g = &table->groups[table->slots[slot] - 1];
+        if (g->op == op && g->hour == hour && g->status == status) return g;
+        slot = (slot + 1) & (table->slot_count - 1);
+    }
+
+    if (table->count == table->cap) {
+        size_t cap = table->cap ? table->cap * 2 : 64;
+        Group* groups = realloc(table->groups, cap * sizeof(Group));
+        if (!groups) return NULL;
+        table->groups = groups;
+        table->cap = cap;
+    }
+    Group* g = &table->groups[table->count];
+    memset(g, 0, sizeof(Group));
+    g->op = op;
+    g->hour = hour;
+    g->status = status;
+    table->slots[slot] = ++table->count;
+    return g;
+}
+
+static int add_record(GroupTable* table, const QueryOptions* opts, const LogRecord* rec) {
+    bool by_op = opts->group_by == GROUP_OP || opts->group_by == GROUP_OP_HOUR;
+    bool by_hour = opts->group_by == GROUP_HOUR || opts->group_by == GROUP_OP_HOUR;
+    bool by_status = opts->group_by == GROUP_STATUS;
+
+    Group* g = find_group(table, by_op ? rec->op : -1,
+                          by_hour ? (int64_t)(rec->timestamp_ns / 3600000000000ULL) : -1,
+                          by_status ? rec->status : -1);
+    if (!g) return -1;
+
+    if (g->count == g->latency_cap) {
+        size_t cap = g->latency_cap ? g->latency_cap * 2 : 16;
+        uint32_t* latencies = realloc(g->latencies, cap * sizeof(uint32_t));
+        if (!latencies) return -1;
+        g->latencies = latencies;
+        g->latency_cap = cap;
+    }
+    g->latencies[g->count++] = rec->latency_us;
+    if (rec->status != 0) g->errors++;
+    g->bytes += rec->bytes;
+    return 0;
+}
+
+/* ===============================================
+ * OUTPUT
+ * =============================================== */
+
+static int compare_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static int compare_groups(const void* a, const void* b) {
+    const Group* x = (const Group*)a;
+    const Group* y = (const Group*)b;
+    if (x->hour != y->hour) return x->hour < y->hour ? -1 : 1;
+    if (x->op != y->op) return x->op < y->op ? -1 : 1;
+    return x->status - y->status;
+}
+
+// Nearest-rank percentile of sorted values
+static uint32_t percentile(const uint32_t* sorted, size_t n, int pct) {
+    size_t rank = (n * (size_t)pct + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static void format_hour(int64_t hour, char* buf, size_t len) {
+    time_t t = (time_t)(hour * 3600);
+    struct tm tm_info;
+    localtime_r(&t, &tm_info);
+    strftime(buf, len, "%Y-%m-%d %H:00", &tm_info);
+}
+
+static void print_groups(GroupTable* table) {
+    qsort(table->groups, table->count, sizeof(Group), compare_groups);
+
+    printf("%-16s %-16s %-6s %10s %8s %12s %9s %9s %9s %9s\n", "HOUR", "OP", "STATUS",
+           "COUNT", "ERRORS", "BYTES", "P50_US", "P95_US", "P99_US", "MAX_US");
+    for (size_t i = 0; i < table->count; i++) {
+        Group* g = &table->groups[i];
+        qsort(g->latencies, g->count, sizeof(uint32_t), compare_u32);
+
+        char hour[32] = "*";
+        char status[16] = "*";
+        if (g->hour >= 0) format_hour(g->hour, hour, sizeof(hour));
+        if (g->status >= 0) snprintf(status, sizeof(status), "%d", g->status);
+        printf("%-16s %-16s %-6s %10llu %8llu %12llu %9u %9u %9u %9u\n", hour,
+               g->op >= 0 ? log_op_name((LogOp)g->op) : "*", status,
+               (unsigned long long)g->count, (unsigned long long)g->errors,
+               (unsigned long long)g->bytes, percentile(g->latencies, g->count, 50),
+               percentile(g->latencies, g->count, 95), percentile(g->latencies, g->count, 99),
+               g->latencies[g->count - 1]);
+    }
+}
+
+static void dump_record(const LogRecord* rec) {
+    time_t sec = (time_t)(rec->timestamp_ns / 1000000000ULL);
+    struct tm tm_info;
+    localtime_r(&sec, &tm_info);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm_info);
+
+    printf("%s.%06llu %-6s %-16s trace=%016llx user=%016llx file=%016llx status=%u "
+           "latency_us=%u lock_wait_us=%u disk_us=%u bytes=%u\n",
+           stamp, (unsigned long long)(rec->timestamp_ns % 1000000000ULL / 1000),
+           log_component_name((LogComponent)rec->component), log_op_name((LogOp)rec->op),
+           (unsigned long long)rec->trace_id, (unsigned long long)rec->user_id,
+           (unsigned long long)rec->file_id, rec->status, rec->latency_us, rec->lock_wait_us,
+           rec->disk_us, rec->bytes);
+}
+
+/* ===============================================
+ * INPUT
+ * =============================================== */
+
+static bool matches(const QueryOptions* opts, const LogRecord* rec) {
+    if (opts->has_op && rec->op != opts->op) return false;
+    if (opts->has_component && rec->component != opts->component) return false;
+    if (opts->has_user && rec->user_id != opts->user_id) return false;
+    if (opts->has_file && rec->file_id != opts->file_id) return false;
+    if (rec->timestamp_ns < opts->since_ns) return false;
+    if (opts->until_ns && rec->timestamp_ns >= opts->until_ns) return false;
+    if (opts->errors_only && rec->status == 0) return false;
+    return true;
+}
+
+// Returns matching records, -1 if the file isn't a readable binary log
+static long scan_file(const char* path, const QueryOptions* opts, GroupTable* table) {
+    FILE* fp = log_open_binary(path);
+    if (!fp) {
+        fprintf(stderr, "%s: not a readable binary request log (version %d)\n", path,
+                LOG_BINARY_VERSION);
+        return -1;
+    }
+
+    static LogRecord chunk[READ_CHUNK];
+    long matched = 0;
+    size_t n;
+    while ((n = fread(chunk, sizeof(LogRecord), READ_CHUNK, fp)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            if (!matches(opts, &chunk[i])) continue;
+            matched++;
+            if (opts->dump) {
+                dump_record(&chunk[i]);
+            } else if (add_record(table, opts, &chunk[i]) < 0) {
+                fprintf(stderr, "Out of memory\n");
+                fclose(fp);
+                return -1;
+            }
+        }
+    }
+    fclose(fp);
+    return matched;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [--op NAME] [--component NM|SS|CLIENT] [--user NAME] [--file PATH]\n"
+            "          [--since EPOCH] [--until EPOCH] [--errors]\n"
+            "          [--group op|hour|op-hour|status|none] [--dump] FILE...\n", prog);
+}
+
+static int parse_group(const char* name, GroupBy* group_by) {
+    static const struct { const char* name; GroupBy group_by; } keys[] = {
+        { "op", GROUP_OP }, { "hour", GROUP_HOUR }, { "op-hour", GROUP_OP_HOUR },
+        { "status", GROUP_STATUS }, { "none", GROUP_NONE },
+    };
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        if (strcmp(name, keys[i].name) == 0) {
+            *group_by = keys[i].group_by;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int main(int argc, char* argv[]) {
+    QueryOptions opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.group_by = GROUP_OP;
+
+    int first_file = argc;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        bool takes_value = true;
+
+        if (strcmp(arg, "--errors") == 0) {
+            opts.errors_only = true;
+            takes_value = false;
+        } else if (strcmp(arg, "--dump") == 0) {
+            opts.dump = true;
+            takes_value = false;
+        } else if (strncmp(arg, "--", 2) != 0) {
+            first_file = i;
+            break;
+        } else if (!value) {
+            usage(argv[0]);
+            return 1;
+        } else if (strcmp(arg, "--op") == 0) {
+            opts.has_op = true;
+            opts.op = log_op_from_name(value);
+        } else if (strcmp(arg, "--component") == 0) {
+            opts.has_component = true;
+            opts.component = strcmp(value, "NM") == 0 ? LOG_COMP_NM
+                           : strcmp(value, "SS") == 0 ? LOG_COMP_SS
+                           : strcmp(value, "CLIENT") == 0 ? LOG_COMP_CLIENT
+                           : LOG_COMP_UNKNOWN;
+        } else if (strcmp(arg, "--user") == 0) {
+            opts.has_user = true;
+            opts.user_id = fnv1a_64(value, strlen(value));
+        } else if (strcmp(arg, "--file") == 0) {
+            opts.has_file = true;
+            opts.file_id = fnv1a_64(value, strlen(value));
+        } else if (strcmp(arg, "--since") == 0) {
+            opts.since_ns = strtoull(value, NULL, 10) * 1000000000ULL;
+        } else if (strcmp(arg, "--until") == 0) {
+            opts.until_ns = strtoull(value, NULL, 10) * 1000000000ULL;
+        } else if (strcmp(arg, "--group") == 0) {
+            if (parse_group(value, &opts.group_by) < 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+        if (takes_value) i++;
+    }
+    if (first_file >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    GroupTable table;
+    memset(&table, 0, sizeof(table));
+    long total = 0;
+    int status = 0;
+    for (int i = first_file; i < argc; i++) {
+        long matched = scan_file(argv[i], &opts, &table);
+        if (matched < 0) {
+            status = 1;
+        } else {
+            total += matched;
+        }
+    }
+
+    if (!opts.dump) {
+        if (table.count > 0) print_groups(&table);
+        printf("%ld matching requests\n", total);
+    }
+
+    for (size_t i = 0; i < table.count; i++) free(table.groups[i].latencies);
+    free(table.groups);
+    free(table.slots);
+    return status;
+}
@@ -0,0 +1,265 @@
+// trace_assemble: join the binary request logs of the NM and storage
+// servers into per-request timelines (see common/trace.h), to find which
+// stage made a request slow.
+//
+//   trace_assemble [options] FILE...
+//     --trace ID     Only this trace (hex, as printed)
+//     --min-ms N     Only traces that took at least N milliseconds
+//     --top N        Only the N slowest traces
+//
+// Stages: nm.route (NM routing), client (time between hops: the client
+// connecting to the SS, network, session edits), ss.lock_wait, ss.disk
+// and ss.other (the rest of the SS's time). Timestamps come from each
+// host's wall clock, so hosts should be time-synchronized.
+//
+// Example:
+//   trace_assemble --top 20 logs/name_server.bin logs/storage_server_*.bin
+#include "../common/logger.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    STAGE_NM_ROUTE = 0,
+    STAGE_CLIENT,
+    STAGE_SS_LOCK_WAIT,
+    STAGE_SS_DISK,
+    STAGE_SS_OTHER,
+    STAGE_COUNT
+} Stage;
+
+static const char* const stage_names[STAGE_COUNT] = {
+    "nm.route", "client", "ss.lock_wait", "ss.disk", "ss.other",
+};
+
+typedef struct {
+    LogRecord* records;                  // Sorted by trace, then start time
+    size_t count;
+    size_t cap;
+} RecordSet;
+
+// One request's timeline: records[first .. first + hops)
+typedef struct {
+    uint64_t trace_id;
+    size_t first;
+    size_t hops;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint64_t stage_us[STAGE_COUNT];
+    Stage slowest;
+} Timeline;
+
+static uint64_t record_start_ns(const LogRecord* rec) {
+    uint64_t latency_ns = (uint64_t)rec->latency_us * 1000ULL;
+    return rec->timestamp_ns > latency_ns ? rec->timestamp_ns - latency_ns : 0;
+}
+
+/* ===============================================
+ * INPUT
+ * =============================================== */
+
+static int load_file(const char* path, RecordSet* set) {
+    FILE* fp = log_open_binary(path);
+    if (!fp) {
+        fprintf(stderr, "%s: not a readable binary request log (version %d)\n", path,
+                LOG_BINARY_VERSION);
+        return -1;
+    }
+
+    LogRecord rec;
+    while (fread(&rec, sizeof(rec), 1, fp) == 1) {
+        if (rec.trace_id == 0) continue;
+        if (set->count == set->cap) {
+            size_t cap = set->cap ? set->cap * 2 : 1024;
+            LogRecord* records = realloc(set->records, cap * sizeof(LogRecord));
+            if (!records) {
+                fclose(fp);
+                return -1;
+            }
+            set->records = records;
+            set->cap = cap;
+        }
+        set->records[set->count++] = rec;
+    }
+    fclose(fp);
+    return 0;
+}
+
+static int compare_records(const void* a, const void* b) {
+    const LogRecord* x = (const LogRecord*)a;
+    const LogRecord* y = (const LogRecord*)b;
+    if (x->trace_id != y->trace_id) return x->trace_id < y->trace_id ? -1 : 1;
+    uint64_t xs = record_start_ns(x);
+    uint64_t ys = record_start_ns(y);
+    return xs < ys ? -1 : xs > ys;
+}
+
+/* ===============================================
+ * TIMELINES
+ * =============================================== */
+
+static void build_timeline(const RecordSet* set, size_t first, size_t hops, Timeline* t) {
+    memset(t, 0, sizeof(Timeline));
+    t->trace_id = set->records[first].trace_id;
+    t->first = first;
+    t->hops = hops;
+    t->start_ns = record_start_ns(&set->records[first]);
+
+    uint64_t covered_ns = t->start_ns;   // End of the latest hop so far
+    for (size_t i = first; i < first + hops; i++) {
+        const LogRecord* rec = &set->records[i];
+        uint64_t start = record_start_ns(rec);
+        if (start > covered_ns) t->stage_us[STAGE_CLIENT] += (start - covered_ns) / 1000;
+        if (rec->timestamp_ns > covered_ns) covered_ns = rec->timestamp_ns;
+
+        if (rec->component == LOG_COMP_NM) {
+            t->stage_us[STAGE_NM_ROUTE] += rec->latency_us;
+        } else {
+            uint32_t inner = rec->lock_wait_us + rec->disk_us;
+            t->stage_us[STAGE_SS_LOCK_WAIT] += rec->lock_wait_us;
+            t->stage_us[STAGE_SS_DISK] += rec->disk_us;
+            t->stage_us[STAGE_SS_OTHER] += rec->latency_us > inner ? rec->latency_us - inner : 0;
+        }
+    }
+    t->end_ns = covered_ns;
+
+    t->slowest = STAGE_NM_ROUTE;
+    for (int s = 1; s < STAGE_COUNT; s++) {
+        if (t->stage_us[s] > t->stage_us[t->slowest]) t->slowest = (Stage)s;
+    }
+}
+
+static int compare_by_duration(const void* a, const void* b) {
+    const Timeline* x = (const Timeline*)a;
+    const Timeline* y = (const Timeline*)b;
+    uint64_t dx = x->end_ns - x->start_ns;
+    uint64_t dy = y->end_ns - y->start_ns;
+    return dx > dy ? -1 : dx < dy;
+}
+
+static int compare_by_start(const void* a, const void* b) {
+    const Timeline* x = (const Timeline*)a;
+    const Timeline* y = (const Timeline*)b;
+    return x->start_ns < y->start_ns ? -1 : x->start_ns > y->start_ns;
+}
+
+static void print_timeline(const RecordSet* set, const Timeline* t) {
+    // Named after the first SS hop, else the NM's
+    const LogRecord* main_hop = &set->records[t->first];
+    for (size_t i = t->first; i < t->first + t->hops; i++) {
+        if (set->records[i].component == LOG_COMP_SS) {
+            main_hop = &set->records[i];
+            break;
+        }
+    }
+    printf("trace %016llx  %s  total %.3f ms  slowest %s (%.3f ms)\n",
+           (unsigned long long)t->trace_id, log_op_name((LogOp)main_hop->op),
+           (double)(t->end_ns - t->start_ns) / 1e6, stage_names[t->slowest],
+           (double)t->stage_us[t->slowest] / 1e3);
+
+    uint64_t covered_ns = t->start_ns;
+    for (size_t i = t->first; i < t->first + t->hops; i++) {
+        const LogRecord* rec = &set->records[i];
+        uint64_t start = record_start_ns(rec);
+        if (start > covered_ns) {
+            printf("  +%9.3f ms  client        %9.3f ms\n",
+                   (double)(covered_ns - t->start_ns) / 1e6, (double)(start - covered_ns) / 1e6);
+        }
+        if (rec->timestamp_ns > covered_ns) covered_ns = rec->timestamp_ns;
+
+        printf("  +%9.3f ms  %-3s %-9s %9.3f ms", (double)(start - t->start_ns) / 1e6,
+               log_component_name((LogComponent)rec->component), log_op_name((LogOp)rec->op),
+               (double)rec->latency_us / 1e3);
+        if (rec->component != LOG_COMP_NM) {
+            printf("  lock_wait %.3f  disk %.3f", (double)rec->lock_wait_us / 1e3,
+                   (double)rec->disk_us / 1e3);
+        }
+        printf("  status %u\n", rec->status);
+    }
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [--trace ID] [--min-ms N] [--top N] FILE...\n", prog);
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t only_trace = 0;
+    double min_ms = 0;
+    long top = 0;
+
+    int first_file = argc;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            first_file = i;
+            break;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--trace") == 0) {
+            only_trace = strtoull(argv[i + 1], NULL, 16);
+        } else if (strcmp(argv[i], "--min-ms") == 0) {
+            min_ms = atof(argv[i + 1]);
+        } else if (strcmp(argv[i], "--top") == 0) {
+            top = atol(argv[i + 1]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    if (first_file >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    RecordSet set;
+    memset(&set, 0, sizeof(set));
+    int status = 0;
+    for (int i = first_file; i < argc; i++) {
+        if (load_file(argv[i], &set) < 0) status = 1;
+    }
+    qsort(set.records, set.count, sizeof(LogRecord), compare_records);
+
+    Timeline* timelines = malloc((set.count ? set.count : 1) * sizeof(Timeline));
+    if (!timelines) {
+        fprintf(stderr, "Out of memory\n");
+        free(set.records);
+        return 1;
+    }
+    size_t traces = 0;
+    for (size_t i = 0; i < set.count;) {
+        size_t j = i;
+        while (j < set.count && set.records[j].trace_id == set.records[i].trace_id) j++;
+        Timeline t;
+        build_timeline(&set, i, j - i, &t);
+        if ((only_trace == 0 || t.trace_id == only_trace) &&
+            (double)(t.end_ns - t.start_ns) / 1e6 >= min_ms) {
+            timelines[traces++] = t;
+        }
+        i = j;
+    }
+
+    // Slowest first when asked for the top N, otherwise in time order
+    qsort(timelines, traces, sizeof(Timeline), top > 0 ? compare_by_duration : compare_by_start);
+    if (top > 0 && (size_t)top < traces) traces = (size_t)top;
+
+    uint64_t slowest_counts[STAGE_COUNT] = { 0 };
+    for (size_t i = 0; i < traces; i++) {
+        print_timeline(&set, &timelines[i]);
+        slowest_counts[timelines[i].slowest]++;
+    }
+
+    printf("%zu traces; slowest stage:", traces);
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        printf(" %s=%llu", stage_names[s], (unsigned long long)slowest_counts[s]);
+    }
+    printf("\n");
+
+    free(timelines);
+    free(set.records);
+    return status;
+}